@@ -0,0 +1,300 @@
+#include "standard.h"
+
+#define GEN_TREE_DEFAULT_DEPTH (2)
+#define GEN_TREE_DEFAULT_FANOUT (16)
+#define GEN_TREE_DEFAULT_MIN_SIZE (64)
+#define GEN_TREE_DEFAULT_MAX_SIZE (64 * 1024)
+#define GEN_TREE_DEFAULT_SEED (1)
+#define GEN_TREE_EDIT_SIZE (64)
+
+typedef struct gen_tree_options_s{
+    unsigned int num_of_files;
+    unsigned int depth;
+    unsigned int fanout;
+    unsigned int min_size;
+    unsigned int max_size;
+    unsigned long long seed;
+    double edit_ratio;
+}gen_tree_options_t;
+
+/**
+ * @brief: Gets the next number of a xorshift64* generator, so trees are identical for the same seed
+ * @param[IN] state: The state of the generator
+ *
+ * @returns: The next pseudo-random number
+ */
+static unsigned long long gen_tree_random(IN unsigned long long * state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief: Gets the size of a file, spread log-uniformly between the minimal and maximal sizes
+ * @param[IN] options: The options of the tree
+ * @param[IN] state: The state of the generator
+ *
+ * @returns: The size of the file
+ * @notes: Real trees have many small files and few large ones, which a uniform spread doesn't capture
+ */
+static unsigned int gen_tree_size(IN gen_tree_options_t * options, IN unsigned long long * state){
+    unsigned int bits = 0;
+    unsigned int size = 0;
+    unsigned int max_bits = 0;
+    unsigned int min_bits = 0;
+
+    while((1U << max_bits) < options->max_size && max_bits < 30){
+        max_bits++;
+    }
+    while((1U << min_bits) < options->min_size && min_bits < max_bits){
+        min_bits++;
+    }
+
+    bits = min_bits + gen_tree_random(state) % (max_bits - min_bits + 1);
+    size = (1U << bits) + gen_tree_random(state) % (1U << bits);
+
+    return min(max(size, options->min_size), options->max_size);
+}
+
+/**
+ * @brief: Gets the path of a file in the tree, creating its parent directories if needed
+ * @param[IN] options: The options of the tree
+ * @param[IN] file_num: The number of the file
+ * @param[IN] create_dirs: If the parent directories should be created
+ * @param[OUT] path: The path (PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Consecutive files land in different directories, like d3/d0/f19 for the 19th file
+ */
+static error_code_t gen_tree_path(IN gen_tree_options_t * options, IN unsigned int file_num, IN bool create_dirs, OUT char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned int i = 0;
+    unsigned int divisor = 1;
+    int length = 0;
+
+    for(i=0; i<options->depth; i++){
+        length += snprintf(path + length, PATH_MAX - length, "d%u/", (file_num / divisor) % options->fanout);
+        divisor *= options->fanout;
+
+        if(create_dirs){
+            path[length - 1] = '\0';
+            return_value = make_dir(path);
+            if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_ALREADY_EXISTS != return_value){
+                goto cleanup;
+            }
+            path[length - 1] = '/';
+        }
+    }
+
+    snprintf(path + length, PATH_MAX - length, "f%u", file_num);
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes pseudo-random data to a file
+ * @param[IN] fd: The file descriptor of the file
+ * @param[IN] size: The number of bytes to write
+ * @param[IN] state: The state of the generator
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t gen_tree_fill(IN int fd, IN unsigned int size, IN unsigned long long * state){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    unsigned int i = 0;
+    unsigned int chunk = 0;
+    unsigned long long buffer[BUFFER_SIZE / sizeof(unsigned long long)] = {0};
+
+    while(size > 0){
+        for(i=0; i<sizeof(buffer) / sizeof(buffer[0]); i++){
+            buffer[i] = gen_tree_random(state);
+        }
+
+        chunk = min(size, sizeof(buffer));
+        error_check = write(fd, buffer, chunk);
+        if(-1 == error_check){
+            perror("GEN_TREE_FILL: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        size -= chunk;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Creates a synthetic tree in the working directory and prints the path of every file
+ * @param[IN] options: The options of the tree
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t gen_tree_create(IN gen_tree_options_t * options){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned int i = 0;
+    int fd = -1;
+    unsigned long long state = options->seed;
+    char path[PATH_MAX] = {0};
+
+    for(i=0; i<options->num_of_files; i++){
+        return_value = gen_tree_path(options, i, true, path);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(-1 == fd){
+            perror("GEN_TREE_CREATE: Open error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+
+        return_value = gen_tree_fill(fd, gen_tree_size(options, &state), &state);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        close(fd);
+        fd = -1;
+
+        printf("%s\n", path);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Appends data to a fraction of the files of a tree made by gen_tree_create and prints their paths
+ * @param[IN] options: The options the tree was created with, and the fraction of files to edit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Which files are edited depends on the seed, so use a different seed for every round of edits
+ */
+static error_code_t gen_tree_edit(IN gen_tree_options_t * options){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned int i = 0;
+    int fd = -1;
+    unsigned long long state = options->seed;
+    char path[PATH_MAX] = {0};
+
+    for(i=0; i<options->num_of_files; i++){
+        if((gen_tree_random(&state) >> 11) * (1.0 / 9007199254740992.0) >= options->edit_ratio){
+            continue;
+        }
+
+        return_value = gen_tree_path(options, i, false, path);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        fd = open(path, O_WRONLY | O_APPEND);
+        if(-1 == fd){
+            perror("GEN_TREE_EDIT: Open error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+
+        return_value = gen_tree_fill(fd, GEN_TREE_EDIT_SIZE, &state);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        close(fd);
+        fd = -1;
+
+        printf("%s\n", path);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+int main(int argc, char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    gen_tree_options_t options = {0};
+
+    options.depth = GEN_TREE_DEFAULT_DEPTH;
+    options.fanout = GEN_TREE_DEFAULT_FANOUT;
+    options.min_size = GEN_TREE_DEFAULT_MIN_SIZE;
+    options.max_size = GEN_TREE_DEFAULT_MAX_SIZE;
+    options.seed = GEN_TREE_DEFAULT_SEED;
+
+    if(argc < 3 || (0 == valid_strncmp(argv[1], "edit") && argc < 4)){
+        goto usage;
+    }
+
+    options.num_of_files = strtoul(argv[2], NULL, 10);
+    i = 3;
+    if(0 == valid_strncmp(argv[1], "edit")){
+        options.edit_ratio = strtod(argv[3], NULL);
+        i = 4;
+    }
+
+    for(; i+1<argc; i+=2){
+        if(0 == valid_strncmp(argv[i], "--depth")){
+            options.depth = strtoul(argv[i + 1], NULL, 10);
+        }
+        else if(0 == valid_strncmp(argv[i], "--fanout")){
+            options.fanout = max(strtoul(argv[i + 1], NULL, 10), 1);
+        }
+        else if(0 == valid_strncmp(argv[i], "--min-size")){
+            options.min_size = strtoul(argv[i + 1], NULL, 10);
+        }
+        else if(0 == valid_strncmp(argv[i], "--max-size")){
+            options.max_size = strtoul(argv[i + 1], NULL, 10);
+        }
+        else if(0 == valid_strncmp(argv[i], "--seed")){
+            options.seed = max(strtoull(argv[i + 1], NULL, 10), 1);
+        }
+        else{
+            goto usage;
+        }
+    }
+    if(i != argc || options.min_size > options.max_size){
+        goto usage;
+    }
+
+    if(0 == valid_strncmp(argv[1], "create")){
+        return_value = gen_tree_create(&options);
+    }
+    else if(0 == valid_strncmp(argv[1], "edit")){
+        return_value = gen_tree_edit(&options);
+    }
+    else{
+        goto usage;
+    }
+
+    return (ERROR_CODE_SUCCESS == return_value) ? 0 : 1;
+
+usage:
+    printf("USAGE: %s create <files> [options]\n", argv[0]);
+    printf("       %s edit <files> <ratio> [options]\n", argv[0]);
+    printf("OPTIONS: --depth <n> --fanout <n> --min-size <bytes> --max-size <bytes> --seed <n>\n");
+    return 1;
+}
@@ -0,0 +1,615 @@
+#include "slap_commands.h"
+
+#include <time.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#define MICRO_DEFAULT_TIME_MS (200)
+#define MICRO_MAX_ITERATIONS (1UL << 30)
+#define MICRO_SEGMENTS (1024)
+#define MICRO_INSERT_FILE_SIZE (4096)
+#define MICRO_INSERTION_SIZE (64)
+
+typedef struct micro_context_s{
+    char * path;
+    int in_fd;
+    int out_fd;
+    size_t bytes_per_op;
+}micro_context_t;
+
+typedef error_code_t (*micro_function_t)(IN micro_context_t * context, IN unsigned long iterations);
+
+typedef struct micro_benchmark_s{
+    const char * name;
+    micro_function_t function;
+    char * in_path;
+    char * out_path;
+    size_t bytes_per_op;
+}micro_benchmark_t;
+
+/**
+ * @brief: Gets the current time of the monotonic clock
+ *
+ * @returns: The time in nanoseconds
+ */
+static unsigned long long micro_now(){
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief: Benchmarks get_hash on a fixture file
+ * @param[IN] context: The context, path is the file to hash
+ * @param[IN] iterations: The number of times to hash it
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_get_hash(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    unsigned long i = 0;
+    unsigned char * hash = NULL;
+
+    for(i=0; i<iterations; i++){
+        error_check = get_hash(context->path, &hash);
+        if(-1 == error_check){
+            return_value = ERROR_CODE_COULDNT_GET_HASH;
+            goto cleanup;
+        }
+        free(hash);
+        hash = NULL;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks get_blob_path on a different sha each iteration
+ * @param[IN] context: The context (unused)
+ * @param[IN] iterations: The number of paths to format
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_get_blob_path(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned long i = 0;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char * blob_path = NULL;
+    char * parent_path = NULL;
+
+    for(i=0; i<iterations; i++){
+        memcpy(hash, &i, sizeof(i));
+
+        return_value = get_blob_path(hash, &blob_path, &parent_path);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        free(blob_path);
+        free(parent_path);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks get_next_index_segment, reading the index fixture over and over
+ * @param[IN] context: The context, in_fd is the index fixture
+ * @param[IN] iterations: The number of segments to read
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_get_next_index_segment(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned long i = 0;
+    index_file_segement_t segment = {0};
+
+    for(i=0; i<iterations; i++){
+        if(0 == i % MICRO_SEGMENTS){
+            lseek(context->in_fd, 0, SEEK_SET);
+        }
+
+        return_value = get_next_index_segment(context->in_fd, &segment);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        free(segment.name);
+        segment.name = NULL;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks get_next_commit_segment, reading the commit fixture over and over
+ * @param[IN] context: The context, in_fd is the commit fixture
+ * @param[IN] iterations: The number of segments to read
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_get_next_commit_segment(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned long i = 0;
+    commit_file_segment_t segment = {0};
+
+    for(i=0; i<iterations; i++){
+        if(0 == i % MICRO_SEGMENTS){
+            lseek(context->in_fd, 0, SEEK_SET);
+        }
+
+        return_value = get_next_commit_segment(context->in_fd, &segment);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        free(segment.name);
+        segment.name = NULL;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks write_index_segment, overwriting the first MICRO_SEGMENTS segments of the output over and over
+ * @param[IN] context: The context, out_fd is the output file
+ * @param[IN] iterations: The number of segments to write
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_write_index_segment(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned long i = 0;
+    char name[] = "d3/d7/f1234";
+    index_file_segement_t segment = {0};
+
+    segment.mode = 0100644;
+    segment.name = name;
+    segment.name_len = strlen(name);
+
+    for(i=0; i<iterations; i++){
+        if(0 == i % MICRO_SEGMENTS){
+            lseek(context->out_fd, 0, SEEK_SET);
+        }
+        memcpy(segment.wdir_sha, &i, sizeof(i));
+
+        return_value = write_index_segment(context->out_fd, segment);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks copying a whole fixture file with copy_file_range
+ * @param[IN] context: The context, in_fd is the fixture and out_fd the copy
+ * @param[IN] iterations: The number of copies
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_copy_file_range(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    unsigned long i = 0;
+
+    for(i=0; i<iterations; i++){
+        error_check = copy_file_range(context->in_fd, 0, context->out_fd, 0, -1);
+        if(-1 == error_check){
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Benchmarks file_insertion of MICRO_INSERTION_SIZE bytes in the middle of a fixture file
+ * @param[IN] context: The context, path and out_fd are the fixture
+ * @param[IN] iterations: The number of insertions
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Every insertion is followed by an ftruncate back to the original size, which is part of the measurement
+ */
+static error_code_t micro_file_insertion(IN micro_context_t * context, IN unsigned long iterations){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    unsigned long i = 0;
+    char insertion[MICRO_INSERTION_SIZE] = {0};
+
+    memset(insertion, 'i', sizeof(insertion));
+
+    for(i=0; i<iterations; i++){
+        error_check = file_insertion(context->out_fd, context->path, insertion, MICRO_INSERT_FILE_SIZE / 2, sizeof(insertion));
+        if(-1 == error_check){
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+
+        error_check = ftruncate(context->out_fd, MICRO_INSERT_FILE_SIZE);
+        if(-1 == error_check){
+            perror("MICRO_FILE_INSERTION: Ftruncate error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_TRUNCATE;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Creates a fixture file with pseudo-random contents
+ * @param[IN] path: The path of the file
+ * @param[IN] size: The size of the file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_create_file(IN char * path, IN size_t size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    size_t i = 0;
+    unsigned int state = 1;
+    unsigned char buffer[BUFFER_SIZE] = {0};
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(-1 == fd){
+        perror("MICRO_CREATE_FILE: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(size > 0){
+        for(i=0; i<sizeof(buffer); i++){
+            state = state * 1103515245 + 12345;
+            buffer[i] = state >> 16;
+        }
+
+        error_check = write(fd, buffer, min(size, sizeof(buffer)));
+        if(-1 == error_check){
+            perror("MICRO_CREATE_FILE: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        size -= error_check;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Creates the index and commit fixtures, MICRO_SEGMENTS segments each
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_create_segments(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int i = 0;
+    int index_fd = -1;
+    int commit_fd = -1;
+    char name[PATH_MAX] = {0};
+    index_file_segement_t index_segment = {0};
+    commit_file_segment_t commit_segment = {0};
+
+    index_fd = open("index", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    commit_fd = open("commit", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(-1 == index_fd || -1 == commit_fd){
+        perror("MICRO_CREATE_SEGMENTS: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    for(i=0; i<MICRO_SEGMENTS; i++){
+        snprintf(name, sizeof(name), "d%i/d%i/f%i", i % 16, (i / 16) % 16, i);
+
+        memcpy(index_segment.wdir_sha, &i, sizeof(i));
+        index_segment.mode = 0100644;
+        index_segment.name = name;
+        index_segment.name_len = strlen(name);
+
+        return_value = write_index_segment(index_fd, index_segment);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        memcpy(commit_segment.sha, &i, sizeof(i));
+        commit_segment.mode = 0100644;
+        commit_segment.name_len = strlen(name);
+
+        error_check = write(commit_fd, &commit_segment, SHA_DIGEST_LENGTH + 2 * sizeof(int));
+        if(-1 != error_check){
+            error_check = write(commit_fd, name, commit_segment.name_len);
+        }
+        if(-1 == error_check){
+            perror("MICRO_CREATE_SEGMENTS: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != index_fd){
+        close(index_fd);
+    }
+    if(-1 != commit_fd){
+        close(commit_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Creates a directory for the fixtures and changes into it
+ * @param[OUT] fixture_dir: The path of the directory (PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: MICRO_DIR picks the parent directory, else /dev/shm is used if it is a tmpfs, so the
+ *         numbers measure the primitives and the page cache rather than the disk
+ */
+static error_code_t micro_enter_fixture_dir(OUT char * fixture_dir){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    char * parent = NULL;
+    struct statfs statfsbuf = {0};
+
+    parent = getenv("MICRO_DIR");
+    if(NULL == parent){
+        parent = "/tmp";
+        error_check = statfs("/dev/shm", &statfsbuf);
+        if(0 == error_check && TMPFS_MAGIC == statfsbuf.f_type){
+            parent = "/dev/shm";
+        }
+    }
+
+    error_check = statfs(parent, &statfsbuf);
+    if(0 == error_check && TMPFS_MAGIC != statfsbuf.f_type){
+        printf("\e[38;2;255;150;0m%s isn't a tmpfs, the results include disk I/O.\e[0m\n", parent);
+    }
+
+    snprintf(fixture_dir, PATH_MAX, "%s/slap-micro.XXXXXX", parent);
+    if(NULL == mkdtemp(fixture_dir)){
+        perror("MICRO_ENTER_FIXTURE_DIR: Mkdtemp error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    error_check = chdir(fixture_dir);
+    if(-1 == error_check){
+        perror("MICRO_ENTER_FIXTURE_DIR: Chdir error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs a benchmark, doubling (or extrapolating) the number of iterations until a run takes long enough
+ * @param[IN] benchmark: The benchmark
+ * @param[IN] target_ns: The minimal duration of the measured run
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t micro_run(IN micro_benchmark_t * benchmark, IN unsigned long long target_ns){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned long iterations = 1;
+    unsigned long next_iterations = 0;
+    unsigned long allocations = 0;
+    unsigned long long start = 0;
+    unsigned long long elapsed = 0;
+    double ns_per_op = 0;
+    micro_context_t context = {0};
+
+    context.path = (NULL != benchmark->in_path) ? benchmark->in_path : benchmark->out_path;
+    context.bytes_per_op = benchmark->bytes_per_op;
+    context.in_fd = -1;
+    context.out_fd = -1;
+
+    if(NULL != benchmark->in_path){
+        context.in_fd = open(benchmark->in_path, O_RDONLY);
+        if(-1 == context.in_fd){
+            perror("MICRO_RUN: Open error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+    }
+
+    if(NULL != benchmark->out_path){
+        context.out_fd = open(benchmark->out_path, O_RDWR | O_CREAT, 0666);
+        if(-1 == context.out_fd){
+            perror("MICRO_RUN: Open error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+    }
+
+    while(true){
+        allocations = trace_allocations;
+        start = micro_now();
+
+        return_value = benchmark->function(&context, iterations);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        elapsed = micro_now() - start;
+        allocations = trace_allocations - allocations;
+        if(elapsed >= target_ns || iterations >= MICRO_MAX_ITERATIONS){
+            break;
+        }
+
+        /* Aim 20% past the target, growing at least 2x and at most 100x per round */
+        next_iterations = (0 == elapsed) ? iterations * 100 : (unsigned long)((double)iterations * target_ns * 1.2 / elapsed);
+        iterations = min(max(next_iterations, iterations * 2), iterations * 100);
+    }
+
+    ns_per_op = (double)elapsed / iterations;
+    printf("%-32s %12lu %14.1f ns/op", benchmark->name, iterations, ns_per_op);
+    if(0 != benchmark->bytes_per_op){
+        printf(" %10.1f MB/s", benchmark->bytes_per_op * 1000.0 / ns_per_op);
+    }
+    else{
+        printf(" %10s     ", "-");
+    }
+    printf(" %8.2f allocs/op\n", (double)allocations / iterations);
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != context.in_fd){
+        close(context.in_fd);
+    }
+    if(-1 != context.out_fd){
+        close(context.out_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Creates the fixtures and runs the micro-benchmarks
+ * @param[IN] argc: The number of arguments
+ * @param[IN] argv: The arguments: [filter], only benchmarks whose name contains filter are run
+ *
+ * @returns: 0 upon success, else 1
+ */
+int main(int argc, char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    unsigned long long target_ns = MICRO_DEFAULT_TIME_MS * 1000000ULL;
+    char fixture_dir[PATH_MAX] = {0};
+    char * time_ms = NULL;
+    struct stat statbuf = {0};
+    micro_benchmark_t benchmarks[] = {
+        {"get_hash/64B", micro_get_hash, "hash_64", NULL, 64},
+        {"get_hash/4KiB", micro_get_hash, "hash_4096", NULL, 4096},
+        {"get_hash/64KiB", micro_get_hash, "hash_65536", NULL, 65536},
+        {"get_hash/1MiB", micro_get_hash, "hash_1048576", NULL, 1048576},
+        {"get_blob_path", micro_get_blob_path, NULL, NULL, 0},
+        {"get_next_index_segment", micro_get_next_index_segment, "index", NULL, 0},
+        {"get_next_commit_segment", micro_get_next_commit_segment, "commit", NULL, 0},
+        {"write_index_segment", micro_write_index_segment, NULL, "index_out", 0},
+        {"copy_file_range/64KiB", micro_copy_file_range, "hash_65536", "copy_out", 65536},
+        {"file_insertion/4KiB", micro_file_insertion, NULL, "insert", MICRO_INSERT_FILE_SIZE},
+    };
+
+    if(argc > 2 || (2 == argc && '-' == argv[1][0])){
+        printf("USAGE: %s [filter]\n", argv[0]);
+        printf("Runs the micro-benchmarks whose name contains filter. MICRO_TIME_MS sets the duration of each (default: %i)\n", MICRO_DEFAULT_TIME_MS);
+        return 1;
+    }
+
+    time_ms = getenv("MICRO_TIME_MS");
+    if(NULL != time_ms){
+        target_ns = strtoull(time_ms, NULL, 10) * 1000000ULL;
+    }
+
+    return_value = micro_enter_fixture_dir(fixture_dir);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = micro_create_file("hash_64", 64);
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = micro_create_file("hash_4096", 4096);
+    }
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = micro_create_file("hash_65536", 65536);
+    }
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = micro_create_file("hash_1048576", 1048576);
+    }
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = micro_create_file("insert", MICRO_INSERT_FILE_SIZE);
+    }
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = micro_create_segments();
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    /* The segment fixtures hold segments of different sizes, so report their average */
+    if(0 == stat("index", &statbuf)){
+        benchmarks[5].bytes_per_op = statbuf.st_size / MICRO_SEGMENTS;
+        benchmarks[7].bytes_per_op = statbuf.st_size / MICRO_SEGMENTS;
+    }
+    if(0 == stat("commit", &statbuf)){
+        benchmarks[6].bytes_per_op = statbuf.st_size / MICRO_SEGMENTS;
+    }
+
+    printf("%-32s %12s %20s %15s %18s\n", "BENCHMARK", "ITERATIONS", "TIME", "THROUGHPUT", "ALLOCATIONS");
+    for(i=0; i<sizeof(benchmarks) / sizeof(benchmarks[0]); i++){
+        if(2 == argc && NULL == strstr(benchmarks[i].name, argv[1])){
+            continue;
+        }
+
+        return_value = micro_run(&benchmarks[i], target_ns);
+        if(ERROR_CODE_SUCCESS != return_value){
+            printf("\e[31m%s failed\e[0m\n", benchmarks[i].name);
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    if(0 != fixture_dir[0]){
+        remove("hash_64");
+        remove("hash_4096");
+        remove("hash_65536");
+        remove("hash_1048576");
+        remove("insert");
+        remove("index");
+        remove("commit");
+        remove("copy_out");
+        remove("index_out");
+        chdir("/");
+        rmdir(fixture_dir);
+    }
+
+    return (ERROR_CODE_SUCCESS == return_value) ? 0 : 1;
+}
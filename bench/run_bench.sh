@@ -0,0 +1,173 @@
+#!/bin/sh
+#
+# End-to-end benchmark of slap on synthetic trees made by gen_tree.
+#
+# USAGE: run_bench.sh                          Run every scale and write the results
+#        run_bench.sh --compare <base> <new>   Compare two result files and flag regressions
+#
+# Environment:
+#   BENCH_SCALES     The numbers of files to benchmark (default: "1000 100000 1000000")
+#   BENCH_DEPTH      The directory depth of the trees (default: 2)
+#   BENCH_FANOUT     The number of subdirectories per directory (default: 16)
+#   BENCH_MIN_SIZE   The minimal file size in bytes (default: 64)
+#   BENCH_MAX_SIZE   The maximal file size in bytes (default: 65536)
+#   BENCH_EDIT_RATIO The fraction of files edited between the two commits (default: 0.1)
+#   BENCH_SEED       The seed of the trees (default: 1)
+#   BENCH_DIR        Where the trees are created, preferably a tmpfs (default: /tmp)
+#   BENCH_OUTPUT     The result file (default: bench/results.json)
+#   BENCH_BASELINE   The baseline the results are compared to, if it exists (default: bench/baseline.json)
+#   BENCH_THRESHOLD  The slowdown in percent that counts as a regression (default: 10)
+#   BENCH_MIN_DELTA  Slowdowns below this many milliseconds are ignored as noise (default: 5)
+#
+# The results are a JSON array with one object per scale, one object per line, holding the
+# wall clock time in milliseconds of every step:
+#   init, add (every file), commit, add_edit (the edited files), commit_edit, status, checkout (the first commit)
+
+set -e
+
+BENCH_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$BENCH_ROOT/../slap"
+GEN_TREE="$BENCH_ROOT/gen_tree"
+
+BENCH_SCALES=${BENCH_SCALES:-"1000 100000 1000000"}
+BENCH_DEPTH=${BENCH_DEPTH:-2}
+BENCH_FANOUT=${BENCH_FANOUT:-16}
+BENCH_MIN_SIZE=${BENCH_MIN_SIZE:-64}
+BENCH_MAX_SIZE=${BENCH_MAX_SIZE:-65536}
+BENCH_EDIT_RATIO=${BENCH_EDIT_RATIO:-0.1}
+BENCH_SEED=${BENCH_SEED:-1}
+BENCH_DIR=${BENCH_DIR:-/tmp}
+BENCH_OUTPUT=${BENCH_OUTPUT:-"$BENCH_ROOT/results.json"}
+BENCH_BASELINE=${BENCH_BASELINE:-"$BENCH_ROOT/baseline.json"}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}
+BENCH_MIN_DELTA=${BENCH_MIN_DELTA:-5}
+
+now_ms(){
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Compares two result files, prints every step and exits with 1 if any of them regressed
+compare(){
+    awk -v threshold="$BENCH_THRESHOLD" -v min_delta="$BENCH_MIN_DELTA" '
+        function parse(line, values,    pairs, n, i, kv){
+            gsub(/[{} "]/, "", line)
+            sub(/,$/, "", line)
+            n = split(line, pairs, ",")
+            for(i=1; i<=n; i++){
+                split(pairs[i], kv, ":")
+                values[kv[1]] = kv[2]
+            }
+        }
+        BEGIN{
+            num_of_steps = split("init add commit status add_edit commit_edit checkout", steps, " ")
+        }
+        FNR == NR && /"files"/{
+            delete values
+            parse($0, values)
+            for(key in values){
+                baseline[values["files"], key] = values[key]
+            }
+            next
+        }
+        /"files"/{
+            delete values
+            parse($0, values)
+            for(i=1; i<=num_of_steps; i++){
+                key = steps[i]
+                if(!((values["files"], key) in baseline) || !(key in values)){
+                    continue
+                }
+                old = baseline[values["files"], key]
+                new = values[key]
+                change = (old > 0) ? (new - old) * 100 / old : 0
+                flag = ""
+                if(change > threshold && new - old > min_delta){
+                    flag = "  REGRESSION"
+                    regressions++
+                }
+                printf("%9s files %-14s %10d ms -> %10d ms (%+.1f%%)%s\n", values["files"], key, old, new, change, flag)
+            }
+        }
+        END{
+            if(regressions > 0){
+                printf("\n%d regression(s) above %s%%\n", regressions, threshold)
+                exit 1
+            }
+        }
+    ' "$1" "$2"
+}
+
+# Times a command in milliseconds, discarding its output
+time_step(){
+    start=$(now_ms)
+    "$@" > /dev/null
+    echo $(( $(now_ms) - start ))
+}
+
+run_scale(){
+    files=$1
+    work_dir=$(mktemp -d "$BENCH_DIR/slap-bench.XXXXXX")
+    tree_options="--depth $BENCH_DEPTH --fanout $BENCH_FANOUT --min-size $BENCH_MIN_SIZE --max-size $BENCH_MAX_SIZE"
+
+    mkdir "$work_dir/tree"
+    cd "$work_dir/tree"
+
+    "$GEN_TREE" create "$files" $tree_options --seed "$BENCH_SEED" > "$work_dir/files"
+
+    init_ms=$(time_step "$SLAP" init)
+    add_ms=$(time_step xargs -d '\n' -a "$work_dir/files" "$SLAP" add)
+    commit_ms=$(time_step "$SLAP" commit < /dev/null)
+    first_commit=$(od -An -tx1 .slap/HEAD | tr -d ' \n')
+
+    "$GEN_TREE" edit "$files" "$BENCH_EDIT_RATIO" $tree_options --seed $((BENCH_SEED + 1)) > "$work_dir/edited"
+
+    status_ms=$(time_step "$SLAP" status)
+    if [ -s "$work_dir/edited" ]; then
+        add_edit_ms=$(time_step xargs -d '\n' -a "$work_dir/edited" "$SLAP" add)
+    else
+        add_edit_ms=0
+    fi
+    commit_edit_ms=$(time_step "$SLAP" commit < /dev/null)
+    checkout_ms=$(time_step "$SLAP" checkout "$first_commit")
+
+    cd "$BENCH_ROOT"
+    rm -rf "$work_dir"
+
+    printf '{"files": %s, "init": %s, "add": %s, "commit": %s, "status": %s, "add_edit": %s, "commit_edit": %s, "checkout": %s}' \
+        "$files" "$init_ms" "$add_ms" "$commit_ms" "$status_ms" "$add_edit_ms" "$commit_edit_ms" "$checkout_ms"
+}
+
+if [ "$1" = "--compare" ]; then
+    if [ $# -ne 3 ]; then
+        echo "USAGE: $0 --compare <baseline> <results>"
+        exit 1
+    fi
+    compare "$2" "$3"
+    exit $?
+fi
+
+if [ ! -x "$SLAP" ] || [ ! -x "$GEN_TREE" ]; then
+    echo "Build slap and bench/gen_tree first (make bench)"
+    exit 1
+fi
+
+separator=""
+results="["
+for files in $BENCH_SCALES; do
+    echo "Benchmarking $files files..." >&2
+    result=$(run_scale "$files")
+    echo "$result" >&2
+    results="$results$separator
+  $result"
+    separator=","
+done
+results="$results
+]"
+
+echo "$results" > "$BENCH_OUTPUT"
+echo "Results written to $BENCH_OUTPUT" >&2
+
+if [ -f "$BENCH_BASELINE" ]; then
+    echo "Comparing to $BENCH_BASELINE" >&2
+    compare "$BENCH_BASELINE" "$BENCH_OUTPUT"
+fi
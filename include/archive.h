@@ -0,0 +1,50 @@
+#ifndef _ARCHIVE_HEADER
+#define _ARCHIVE_HEADER
+
+#include "standard.h"
+
+#include <zlib.h>
+
+#define ARCHIVE_BUFFER_SIZE (1024 * 1024)
+/* Blobs at least this big are sent with sendfile instead of through the output buffer (not when gzipping) */
+#define ARCHIVE_SENDFILE_MIN (64 * 1024)
+#define ARCHIVE_BLOCK_SIZE (512)
+/* The biggest size the octal size field of a ustar header can hold, bigger ones go in a pax header */
+#define ARCHIVE_USTAR_MAX_SIZE (077777777777ULL)
+
+/* A ustar header, one block */
+typedef struct archive_header_s{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char link_name[100];
+    char magic[6];
+    char version[2];
+    char user_name[32];
+    char group_name[32];
+    char device_major[8];
+    char device_minor[8];
+    char prefix[155];
+    char padding[12];
+}archive_header_t;
+
+typedef struct archive_output_s{
+    int fd;
+    bool gzip;
+    unsigned char * buffer;
+    size_t length;
+    /* The deflate output, only when gzipping */
+    unsigned char * compressed;
+    z_stream stream;
+    unsigned long long num_of_bytes;
+}archive_output_t;
+
+error_code_t archive_commit(IN const char * commit, IN const char * path, IN bool gzip);
+error_code_t archive_command(IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _BATCH_HEADER
+#define _BATCH_HEADER
+
+#include "standard.h"
+
+typedef struct batch_state_s{
+    char ** pending_paths;
+    int num_of_pending;
+    int pending_capacity;
+    unsigned long num_of_commands;
+}batch_state_t;
+
+error_code_t batch(IN char delimiter);
+error_code_t batch_command(IN int argc, IN char ** argv);
+
+#endif
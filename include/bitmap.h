@@ -0,0 +1,71 @@
+#ifndef _BITMAP_HEADER
+#define _BITMAP_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define BITMAP_MAGIC (0x504D4253) /* "SBMP" */
+#define BITMAP_VERSION (1)
+#define BITMAP_SPACING (64)
+#define BITMAP_BATCH (4)
+#define BITMAP_WORDS(bits) (((bits) + 63) / 64)
+
+/* An EWAH marker word: bit 0 is the running bit, bits 1-32 the running length, bits 33-63 the number of literals */
+#define EWAH_RUN_BITS (32)
+#define EWAH_MAX_RUN ((1ULL << EWAH_RUN_BITS) - 1)
+#define EWAH_MAX_LITERALS ((1ULL << 31) - 1)
+
+typedef struct bitmap_header_s{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int num_of_objects;
+    unsigned int num_of_bitmaps;
+}bitmap_header_t;
+
+typedef struct bitmap_entry_s{
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    unsigned int num_of_words;
+    unsigned long long offset;
+}bitmap_entry_t;
+
+/* The objects reachable from a commit: bits over the bitmap ordering, plus the shas that aren't in it */
+typedef struct reachability_s{
+    const unsigned char * ordering;
+    size_t num_of_objects;
+    unsigned long long * words;
+    unsigned char * extra;
+    size_t num_of_extra;
+    size_t extra_capacity;
+}reachability_t;
+
+/* The bitmap file of a repository, mapped once it is first needed */
+typedef struct bitmap_cache_s{
+    bool loaded;
+    void * map;
+    size_t map_len;
+    const bitmap_header_t * header;
+    const unsigned char * shas;
+    const unsigned int * lookup;
+    const bitmap_entry_t * entries;
+    const unsigned long long * data;
+    size_t data_len;
+}bitmap_cache_t;
+
+typedef error_code_t (*sha_callback_t)(IN const unsigned char * hash, IN void * context);
+
+extern const char * bitmap_file_name;
+
+error_code_t ewah_compress(IN const unsigned long long * words, IN size_t num_of_words, OUT unsigned long long ** compressed, OUT size_t * num_of_compressed);
+error_code_t ewah_or(IN const unsigned long long * compressed, IN size_t num_of_compressed, IN OUT unsigned long long * words, IN size_t num_of_words);
+error_code_t bitmap_ordering(OUT const unsigned char ** shas, OUT size_t * count);
+error_code_t bitmap_or(IN const unsigned char * commit, IN OUT unsigned long long * words, OUT bool * found);
+error_code_t bitmap_write();
+void bitmap_close();
+error_code_t reachability_compute(IN const unsigned char * commit, OUT reachability_t * reachability);
+void reachability_andnot(IN OUT reachability_t * reachability, IN const reachability_t * other);
+size_t reachability_count(IN const reachability_t * reachability);
+error_code_t reachability_for_each(IN const reachability_t * reachability, IN sha_callback_t callback, IN void * context);
+void reachability_free(IN reachability_t * reachability);
+error_code_t bitmap_command(IN int argc, IN char ** argv);
+
+#endif
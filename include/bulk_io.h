@@ -0,0 +1,46 @@
+#ifndef _BULK_IO_HEADER
+#define _BULK_IO_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+#include "objects.h"
+
+#define BULK_IO_SLOTS (32)
+#define BULK_IO_BUFFER_SIZE (64 * 1024)
+#define BULK_IO_CHUNK (4096)
+
+typedef enum io_backend_e{
+    IO_BACKEND_SYNC = 0,
+    IO_BACKEND_URING
+}io_backend_t;
+
+/* The core.io setting of a repository, read once it is first needed */
+typedef struct io_backend_cache_s{
+    bool loaded;
+    io_backend_t backend;
+}io_backend_cache_t;
+
+typedef struct bulk_job_s{
+    int src_dir_fd;
+    const char * src_name;
+    int dst_dir_fd;
+    const char * dst_name;
+    int dst_flags;
+    mode_t dst_mode;
+    bool sync_dst;
+    bool skipped;
+    /* If set, a source that doesn't exist marks the job as missing instead of failing */
+    bool allow_missing;
+    bool missing;
+    off_t size;
+    unsigned char * hash;
+    char name_buffer[OBJECT_NAME_LEN + 1];
+}bulk_job_t;
+
+io_backend_t get_io_backend();
+void reset_io_backend();
+error_code_t bulk_run(IN bulk_job_t * jobs, IN int num_of_jobs);
+error_code_t bulk_hash_files(IN char ** paths, IN int num_of_paths, IN bool allow_missing, OUT unsigned char * hashes);
+error_code_t bulk_write_objects(IN char ** paths, IN int num_of_paths, OUT unsigned char * hashes);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _BUNDLE_HEADER
+#define _BUNDLE_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define BUNDLE_MAGIC (0x4C444253) /* "SBDL" */
+#define BUNDLE_VERSION (1)
+/* The size of the reads and writes of the bundle itself */
+#define BUNDLE_BUFFER_SIZE (1024 * 1024)
+/* Unbundled objects are collected until they take this many bytes, then verified and written on a thread pool */
+#define BUNDLE_BATCH_SIZE (64 * 1024 * 1024)
+#define BUNDLE_WORKER_BATCH (16)
+/* Bigger objects are taken as a corrupt bundle, before anything is allocated for them */
+#define BUNDLE_MAX_OBJECT_SIZE (1ULL << 40)
+
+/*
+ * A bundle is the header, the refs (each a sha, the length of its name and the name), and then every object
+ * as its sha, its size (8 bytes) and its contents. It ends with the SHA1 of everything before it except the
+ * contents of the objects, which are covered by their own shas.
+ */
+typedef struct bundle_header_s{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int num_of_refs;
+    unsigned int reserved;
+    unsigned long long num_of_objects;
+}bundle_header_t;
+
+typedef struct bundle_stream_s{
+    int fd;
+    unsigned char * buffer;
+    size_t start;
+    size_t end;
+    unsigned long long bytes;
+    SHA_CTX checksum;
+}bundle_stream_t;
+
+typedef struct bundle_entry_s{
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    size_t offset;
+    size_t size;
+    int dir_fd;
+    int error_number;
+    bool exists;
+    bool written;
+    bool corrupt;
+    error_code_t result;
+}bundle_entry_t;
+
+typedef struct bundle_batch_s{
+    unsigned char * data;
+    size_t data_len;
+    size_t data_capacity;
+    bundle_entry_t * entries;
+    size_t num_of_entries;
+    size_t entries_capacity;
+    size_t next;
+    bool sync;
+    size_t num_of_written;
+}bundle_batch_t;
+
+error_code_t bundle_create(IN const char * path);
+error_code_t bundle_unbundle(IN const char * path);
+error_code_t bundle_command(IN int argc, IN char ** argv);
+
+#endif
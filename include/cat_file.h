@@ -0,0 +1,21 @@
+#ifndef _CAT_FILE_HEADER
+#define _CAT_FILE_HEADER
+
+#include "standard.h"
+
+#define CAT_FILE_BUFFER_SIZE (1024 * 1024)
+/* Objects at least this big are sent with sendfile instead of through the output buffer */
+#define CAT_FILE_SENDFILE_MIN (64 * 1024)
+
+typedef struct cat_file_output_s{
+    /* The real standard output, the standard output itself points at the standard error meanwhile */
+    int fd;
+    char * buffer;
+    size_t length;
+}cat_file_output_t;
+
+error_code_t cat_file_batch();
+error_code_t cat_file(IN char * object);
+error_code_t cat_file_command(IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _CLONE_HEADER
+#define _CLONE_HEADER
+
+#include "standard.h"
+
+typedef struct clone_stats_s{
+    size_t linked;
+    size_t reflinked;
+    size_t copied;
+    /* Set after the first EXDEV, so the other objects don't try linkat */
+    bool cross_device;
+    /* Set after the first failed FICLONE, so the other objects are copied right away */
+    bool no_reflink;
+}clone_stats_t;
+
+error_code_t clone_repository(IN const char * source, IN const char * destination);
+error_code_t clone_command(IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _CONFIG_HEADER
+#define _CONFIG_HEADER
+
+#include "standard.h"
+
+#define CONFIG_LINE_MAX (BUFFER_SIZE)
+
+extern const char * config_file_name;
+
+error_code_t config_get(IN const char * key, OUT char * value, IN size_t value_len);
+error_code_t config_set(IN const char * key, IN const char * value);
+error_code_t config_command(IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _DIFF_HEADER
+#define _DIFF_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+#include "objects.h"
+#include "sketch.h"
+
+#define DIFF_CONTEXT (3)
+/* Only this many bytes from the start of a file are searched for a NUL to decide it is binary */
+#define DIFF_BINARY_CHECK (8000)
+/* The least number of edit steps a middle snake search may take before settling for a good enough split */
+#define DIFF_MIN_COST (256)
+/* The least estimated similarity, in percent, for an added path to be paired with a removed one */
+#define DIFF_RENAME_THRESHOLD (50)
+
+typedef enum diff_renames_e{
+    DIFF_RENAMES_NONE = 0,
+    DIFF_RENAMES_RENAMES,
+    DIFF_RENAMES_COPIES
+}diff_renames_t;
+
+typedef struct diff_side_s{
+    const char * data;
+    size_t size;
+    size_t num_of_lines;
+    /* num_of_lines + 1 line starts, the last one is data + size */
+    const char ** lines;
+    int * ids;
+    char * changed;
+}diff_side_t;
+
+typedef struct diff_class_s{
+    const char * start;
+    size_t length;
+    unsigned int hash;
+    int id;
+}diff_class_t;
+
+typedef struct diff_block_s{
+    size_t a_start;
+    size_t a_end;
+    size_t b_start;
+    size_t b_end;
+}diff_block_t;
+
+typedef struct diff_tree_s{
+    void * data;
+    size_t size;
+    size_t offset;
+    /* The entries of a commit that wasn't written in path order, sorted */
+    commit_entry_t * sorted;
+    size_t num_of_sorted;
+    size_t position;
+}diff_tree_t;
+
+typedef struct diff_change_s{
+    /* The sha of an entry is NULL for the missing side of an added or removed path */
+    commit_entry_t old_entry;
+    commit_entry_t new_entry;
+    /* A, D, M, T, R or C */
+    char status;
+    /* The similarity of a rename or a copy, in percent */
+    int score;
+}diff_change_t;
+
+typedef struct diff_source_s{
+    const unsigned char * sha;
+    size_t change;
+    bool removed;
+}diff_source_t;
+
+typedef struct diff_band_s{
+    uint64_t key;
+    size_t source;
+}diff_band_t;
+
+typedef struct diff_candidate_s{
+    int score;
+    size_t target;
+    size_t source;
+}diff_candidate_t;
+
+typedef struct diff_search_s{
+    const int * a;
+    const int * b;
+    char * a_changed;
+    char * b_changed;
+    long * forward;
+    long * backward;
+    long too_expensive;
+}diff_search_t;
+
+error_code_t diff_files(IN const char * old_name, IN int old_fd, IN mode_t old_mode,
+                        IN const char * new_name, IN int new_fd, IN mode_t new_mode, IN const char * extended);
+error_code_t diff_worktree();
+error_code_t diff_cached();
+error_code_t diff_commits(IN const char * old_commit, IN const char * new_commit, IN bool name_status, IN diff_renames_t renames);
+error_code_t diff_command(IN int argc, IN char ** argv);
+
+#endif
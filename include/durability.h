@@ -0,0 +1,27 @@
+#ifndef _DURABILITY_HEADER
+#define _DURABILITY_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+typedef enum fsync_mode_e{
+    FSYNC_MODE_NONE = 0,
+    FSYNC_MODE_BATCH,
+    FSYNC_MODE_FULL
+}fsync_mode_t;
+
+/* The core.fsync setting of a repository, and whether objects were written that sync_objects should sync */
+typedef struct durability_cache_s{
+    bool fsync_mode_loaded;
+    fsync_mode_t fsync_mode;
+    bool objects_pending;
+}durability_cache_t;
+
+fsync_mode_t get_fsync_mode();
+void reset_fsync_mode();
+error_code_t sync_new_object(IN int object_fd, IN const unsigned char * hash);
+error_code_t sync_objects();
+error_code_t sync_file(IN int fd);
+error_code_t replace_file(IN const char * path, IN const void * data, IN size_t length);
+
+#endif
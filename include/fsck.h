@@ -0,0 +1,13 @@
+#ifndef _FSCK_HEADER
+#define _FSCK_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define FSCK_BUFFER_SIZE (64 * 1024)
+#define FSCK_BATCH (64)
+
+error_code_t fsck(IN size_t sample);
+error_code_t fsck_command(IN int argc, IN char ** argv);
+
+#endif
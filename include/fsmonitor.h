@@ -0,0 +1,34 @@
+#ifndef _FSMONITOR_HEADER
+#define _FSMONITOR_HEADER
+
+#include "standard.h"
+
+#define FSMONITOR_TOKEN_LEN (64)
+#define FSMONITOR_MAX_DIRTY (1 << 20)
+#define FSMONITOR_SYNC_TIMEOUT (1000)
+/* How long the daemon waits on a client before dropping it */
+#define FSMONITOR_CLIENT_TIMEOUT (1000)
+/* How long a query waits on the daemon before falling back to a full scan */
+#define FSMONITOR_QUERY_TIMEOUT (FSMONITOR_SYNC_TIMEOUT + FSMONITOR_CLIENT_TIMEOUT + 1000)
+
+typedef struct fsmonitor_result_s{
+    bool available;
+    bool full_scan;
+    char token[FSMONITOR_TOKEN_LEN];
+    int num_of_paths;
+    char ** paths;
+    char * path_buffer;
+}fsmonitor_result_t;
+
+extern const char * fsmonitor_socket_name;
+extern const char * fsmonitor_token_name;
+extern const char * fsmonitor_cookie_name;
+
+error_code_t fsmonitor_start();
+error_code_t fsmonitor_stop();
+error_code_t fsmonitor_query(OUT fsmonitor_result_t * result);
+error_code_t fsmonitor_save_token(IN fsmonitor_result_t * result);
+bool fsmonitor_is_dirty(IN fsmonitor_result_t * result, IN char * path);
+void fsmonitor_free_result(IN fsmonitor_result_t * result);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _GC_HEADER
+#define _GC_HEADER
+
+#include <time.h>
+#include "standard.h"
+
+#define GC_DEFAULT_GRACE (14 * 24 * 60 * 60)
+
+error_code_t gc(IN time_t grace);
+error_code_t gc_command(IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _HISTORY_HEADER
+#define _HISTORY_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+/* Called for every commit of a walk, newest first. Clearing descend skips the parents of the commit */
+typedef error_code_t (*history_callback_t)(IN const unsigned char * hash, IN void * context, OUT bool * descend);
+
+error_code_t read_head_file(IN const char * path, OUT unsigned char * hash, OUT bool * exists);
+error_code_t read_head(OUT unsigned char * hash, OUT bool * exists);
+error_code_t resolve_commit(IN const char * commit, OUT unsigned char * hash);
+error_code_t history_walk(IN const unsigned char * start, IN history_callback_t callback, IN void * context);
+
+#endif
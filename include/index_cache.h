@@ -0,0 +1,50 @@
+#ifndef _INDEX_CACHE_HEADER
+#define _INDEX_CACHE_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+/* Included by slap_commands.h after index_file_segement_t is defined */
+
+/* The index and HEAD of a repository, loaded once they are first needed and written back by index_cache_flush */
+typedef struct index_cache_s{
+    bool loaded;
+    bool sorted;
+    bool dirty;
+    bool deferred;
+    index_file_segement_t * entries;
+    size_t count;
+    size_t capacity;
+    unsigned int * slots;
+    size_t num_of_slots;
+    struct stat index_stat;
+
+    bool head_loaded;
+    bool head_exists;
+    bool head_dirty;
+    unsigned char head_sha[SHA_DIGEST_LENGTH];
+    struct stat head_stat;
+
+    /* The entries of the commit HEAD points to, for the committed sha of paths that are added to the index */
+    bool head_commit_loaded;
+    unsigned char * head_commit_data;
+    size_t head_commit_size;
+    commit_entry_t * head_commit_entries;
+    size_t head_commit_count;
+}index_cache_t;
+
+error_code_t index_cache_load();
+error_code_t index_cache_entries(OUT index_file_segement_t ** entries, OUT size_t * count);
+error_code_t index_cache_find(IN const char * name, IN int name_len, OUT index_file_segement_t ** entry);
+error_code_t index_cache_add(IN const char * name, IN int name_len, OUT index_file_segement_t ** entry);
+void index_cache_changed();
+error_code_t index_cache_head(OUT unsigned char * hash, OUT bool * exists);
+void index_cache_set_head(IN const unsigned char * hash);
+error_code_t index_cache_write();
+error_code_t index_cache_flush();
+error_code_t index_cache_validate();
+void index_cache_defer(IN bool defer);
+void index_cache_init(OUT index_cache_t * cache);
+void index_cache_close();
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _OBJECT_INDEX_HEADER
+#define _OBJECT_INDEX_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define OBJECT_INDEX_MAGIC (0x58444953) /* "SIDX" */
+#define OBJECT_INDEX_VERSION (1)
+#define OBJECT_INDEX_JOURNAL_MAX (4096)
+#define OBJECT_INDEX_MIN_PREFIX (4)
+
+typedef struct object_index_header_s{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int num_of_objects;
+    unsigned int fanout[256];
+}object_index_header_t;
+
+/* The object index of a repository, mapped once it is first needed, and its journal */
+typedef struct object_index_cache_s{
+    bool loaded;
+    void * map;
+    size_t map_len;
+    const object_index_header_t * header;
+    const unsigned char * shas;
+    int journal_fd;
+    /* A descriptor of its own holds the exclusive lock of the journal, so it is independent of journal_fd */
+    int journal_lock_fd;
+    int journal_lock_depth;
+    unsigned char * journal_shas;
+    size_t journal_count;
+    size_t journal_capacity;
+    unsigned char * pending_shas;
+    size_t pending_count;
+    unsigned int * pending_slots;
+    size_t pending_slot_capacity;
+}object_index_cache_t;
+
+extern const char * object_index_name;
+extern const char * object_index_journal_name;
+
+error_code_t object_index_contains(IN const unsigned char * hash, OUT bool * exists);
+error_code_t object_index_add(IN const unsigned char * hash);
+error_code_t object_index_flush();
+error_code_t object_index_resolve(IN const char * prefix, OUT unsigned char * hash);
+error_code_t object_index_rebuild();
+error_code_t object_index_table(OUT const unsigned char ** shas, OUT size_t * count);
+error_code_t object_index_position(IN const unsigned char * hash, OUT size_t * position);
+error_code_t object_index_prune(IN const unsigned char * removed);
+error_code_t object_index_create();
+void object_index_cache_init(OUT object_index_cache_t * cache);
+void object_index_close();
+
+#endif
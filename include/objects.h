@@ -0,0 +1,54 @@
+#ifndef _OBJECTS_HEADER
+#define _OBJECTS_HEADER
+
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define OBJECT_FANOUT (256)
+#define OBJECT_HEX_LEN (SHA_DIGEST_LENGTH * 2)
+#define OBJECT_NAME_LEN (OBJECT_HEX_LEN - 2)
+/* The most object directories that are listed in the alternates file */
+#define OBJECT_MAX_ALTERNATES (16)
+/* Objects are never changed once written, so every path that creates one makes it read-only */
+#define OBJECT_FILE_MODE (0444)
+
+typedef struct commit_entry_s{
+    const unsigned char * sha;
+    mode_t mode;
+    int name_len;
+    const char * name;
+}commit_entry_t;
+
+/* The object directories of a repository, opened once they are first needed */
+typedef struct objects_cache_s{
+    int objects_fd;
+    int fanout_fds[OBJECT_FANOUT];
+    bool alternates_loaded;
+    int num_of_alternates;
+    char * alternate_paths[OBJECT_MAX_ALTERNATES];
+    int alternate_fanout_fds[OBJECT_MAX_ALTERNATES][OBJECT_FANOUT];
+}objects_cache_t;
+
+/* Called for every object, with the fanout directory it is in and its name there */
+typedef error_code_t (*object_callback_t)(IN const unsigned char * hash, IN int fanout_fd, IN const char * name, IN void * context);
+
+extern const char * alternates_file_name;
+
+int hex_value(IN char digit);
+void sha_to_hex(IN const unsigned char * hash, OUT char * hex);
+void object_name(IN const unsigned char * hash, OUT char * name);
+error_code_t object_dir_fd(OUT int * fd);
+error_code_t object_fanout_fd(IN unsigned char fanout, IN bool create, OUT int * fd);
+error_code_t object_locate(IN const unsigned char * hash, OUT int * fd, OUT int * alternate);
+bool object_alternate_exists(IN const unsigned char * hash);
+const char * object_alternate_path(IN int alternate);
+error_code_t open_object(IN const unsigned char * hash, IN int flags, IN mode_t mode, OUT int * fd);
+error_code_t read_object(IN const unsigned char * hash, OUT unsigned char ** data, OUT size_t * size);
+error_code_t commit_parents(IN const unsigned char * data, IN size_t size, OUT int * num_of_parents, OUT const unsigned char ** parents);
+error_code_t commit_next_entry(IN const unsigned char * data, IN size_t size, IN OUT size_t * offset, OUT commit_entry_t * entry);
+error_code_t object_path(IN const unsigned char * hash, OUT char * path);
+error_code_t object_for_each(IN object_callback_t callback, IN void * context);
+void objects_cache_init(OUT objects_cache_t * cache);
+void close_object_dirs();
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _PROBES_HEADER
+#define _PROBES_HEADER
+
+/*
+ * USDT probes (provider "slap") for perf and bpftrace, for example:
+ *     bpftrace -e 'usdt:./slap:slap:hash__done { @bytes = hist(arg1); }'
+ * An unattached probe is a single nop. Every sha argument points to SHA_DIGEST_LENGTH raw bytes.
+ *
+ *     hash__start(path)                       Hashing a file started
+ *     hash__done(path, size, sha)             Hashing a file finished
+ *     object__open(path, sha, exists)         The blob of a file was looked up or created by s_add_file
+ *     object__create(path, size, sha)         The blob of a file was written
+ *     index__read(path, size, sha)            An index entry of size bytes was read (sha is the working directory sha)
+ *     index__write(path, size, sha)           An index entry of size bytes was written (sha is the working directory sha)
+ *     commit__write(sha, size, num_of_parents) A commit object was written
+ *     checkout__file(path, size, sha)         A file was checked out
+ *
+ * Building with PROBES=0 (-DSLAP_NO_PROBES), or without <sys/sdt.h> (systemtap-sdt-dev), compiles them out.
+ * The Makefile warns when <sys/sdt.h> is missing, and fails if PROBES=1 asked for them.
+ */
+
+#if !defined(SLAP_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SLAP_HAVE_PROBES
+#endif
+#endif
+
+#ifdef SLAP_HAVE_PROBES
+#define PROBE1(name, a) DTRACE_PROBE1(slap, name, a)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(slap, name, a, b, c)
+#else
+#define PROBE1(name, a) do{}while(0)
+#define PROBE3(name, a, b, c) do{}while(0)
+#endif
+
+#endif
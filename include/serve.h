@@ -0,0 +1,29 @@
+#ifndef _SERVE_HEADER
+#define _SERVE_HEADER
+
+#include <sys/stat.h>
+#include "standard.h"
+#include "slap.h"
+
+#define SERVE_MAX_REQUEST (64 * 1024)
+#define SERVE_MAX_ARGS (1024)
+#define SERVE_NUM_OF_FDS (3)
+#define SERVE_NUM_OF_WATCHED (7)
+/* How long the server waits on a client before dropping it */
+#define SERVE_CLIENT_TIMEOUT (1000)
+/* Sent without fds, since "serve stop" never runs inside the server */
+#define SERVE_STOP_REQUEST "serve\0stop"
+
+/* What the caches of a server were loaded from, so changes made by other processes can be noticed */
+typedef struct serve_snapshot_s{
+    struct stat stats[SERVE_NUM_OF_WATCHED];
+}serve_snapshot_t;
+
+extern const char * serve_socket_name;
+
+error_code_t serve_forward(IN int argc, IN char ** argv, OUT bool * forwarded, OUT error_code_t * result);
+error_code_t serve_start(IN slap_repository_t * repository, IN bool foreground);
+error_code_t serve_stop();
+error_code_t serve_command(IN slap_repository_t * repository, IN int argc, IN char ** argv);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _SKETCH_HEADER
+#define _SKETCH_HEADER
+
+#include <stdint.h>
+#include <openssl/sha.h>
+#include "standard.h"
+
+#define SKETCH_MAGIC (0x48435453) /* "STCH" */
+#define SKETCH_VERSION (1)
+/* The number of MinHash values per blob, each the least hash of the blob's lines under another seed */
+#define SKETCH_SIZE (64)
+/* Sketches are split into bands for locality sensitive hashing, two blobs are candidates if a whole band matches */
+#define SKETCH_BANDS (16)
+#define SKETCH_ROWS (SKETCH_SIZE / SKETCH_BANDS)
+
+typedef struct sketch_header_s{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int size;
+}sketch_header_t;
+
+typedef struct sketch_s{
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    uint32_t mins[SKETCH_SIZE];
+}sketch_t;
+
+/* The sketches of a repository, loaded once they are first needed */
+typedef struct sketch_cache_s{
+    bool loaded;
+    int fd;
+    bool writable;
+    sketch_t * sketches;
+    size_t count;
+    size_t capacity;
+    unsigned int * slots;
+    size_t num_of_slots;
+}sketch_cache_t;
+
+extern const char * sketch_file_name;
+
+error_code_t sketch_get(IN const unsigned char * hash, OUT sketch_t * sketch);
+bool sketch_is_empty(IN const sketch_t * sketch);
+int sketch_similarity(IN const sketch_t * a, IN const sketch_t * b);
+uint64_t sketch_band(IN const sketch_t * sketch, IN int band);
+void sketch_cache_init(OUT sketch_cache_t * cache);
+void sketch_close();
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _SLAP_HEADER
+#define _SLAP_HEADER
+
+#include <time.h>
+#include "standard.h"
+
+/*
+ * libslap, the core of slap as a library (make lib builds libslap.a and libslap.so).
+ * A client opens a repository once and runs any number of operations on the handle, so the object
+ * directory fds, the object index, the parsed index, HEAD and the bitmaps stay loaded between them.
+ * Those caches belong to the handle, so several repositories can be open at a time. Operations resolve
+ * their paths against the work tree without changing the working directory of the process, but one handle
+ * mustn't be used by two threads at a time. The library doesn't wrap the allocation functions, so
+ * --trace only counts allocations in the slap program itself.
+ */
+
+typedef struct slap_repository_s{
+    char * work_tree;
+    /* An fd of the work tree, which the operations resolve their paths against */
+    int work_tree_fd;
+    /* The caches of the repository, which the operations switch the calling thread to */
+    struct repository_state_s * state;
+}slap_repository_t;
+
+error_code_t slap_open(IN const char * path, OUT slap_repository_t ** repository);
+error_code_t slap_init(IN slap_repository_t * repository);
+error_code_t slap_add(IN slap_repository_t * repository, IN int num_of_files, IN char ** files);
+error_code_t slap_commit(IN slap_repository_t * repository);
+error_code_t slap_checkout(IN slap_repository_t * repository, IN char * commit);
+error_code_t slap_status(IN slap_repository_t * repository);
+error_code_t slap_fsck(IN slap_repository_t * repository, IN size_t sample);
+error_code_t slap_gc(IN slap_repository_t * repository, IN time_t grace);
+error_code_t slap_flush(IN slap_repository_t * repository);
+error_code_t slap_run(IN slap_repository_t * repository, IN int argc, IN char ** argv);
+void slap_close(IN slap_repository_t * repository);
+
+#endif
@@ -1,5 +1,30 @@
 #include "hash.h"
 #include "standard.h"
+#include "fsmonitor.h"
+#include "objects.h"
+#include "object_index.h"
+#include "config.h"
+#include "durability.h"
+#include "uring.h"
+#include "bulk_io.h"
+#include "trace.h"
+#include "probes.h"
+#include "workers.h"
+#include "fsck.h"
+#include "gc.h"
+#include "history.h"
+#include "bitmap.h"
+#include "slap.h"
+#include "serve.h"
+#include "batch.h"
+#include "cat_file.h"
+#include "sketch.h"
+#include "diff.h"
+#include "sparse.h"
+#include "worktree.h"
+#include "clone.h"
+#include "bundle.h"
+#include "archive.h"
 
 #define DETACHED (0) 
 #define BRANCH (1)
@@ -12,6 +37,8 @@ typedef struct index_file_segement_s{
     int name_len;
     char * name;
 }index_file_segement_t;
+/* The size of an index entry on disk, without its name */
+#define INDEX_SEGMENT_HEADER_SIZE (3 * SHA_DIGEST_LENGTH + sizeof(mode_t) + sizeof(int))
 
 typedef struct commit_file_segment_s{
     unsigned char sha[SHA_DIGEST_LENGTH];
@@ -20,6 +47,22 @@ typedef struct commit_file_segment_s{
     char * name;
 }commit_file_segment_t;
 
+#include "index_cache.h"
+
+/* Everything the core caches about one repository. The core works on the current state of the calling thread. */
+typedef struct repository_state_s{
+    /* The work tree, which every relative path is resolved against (AT_FDCWD for the working directory) */
+    int work_tree_fd;
+    objects_cache_t objects;
+    object_index_cache_t object_index;
+    index_cache_t index;
+    bitmap_cache_t bitmap;
+    sketch_cache_t sketch;
+    sparse_cache_t sparse;
+    durability_cache_t durability;
+    io_backend_cache_t io_backend;
+}repository_state_t;
+
 
 extern const char * repo_dir_name;
 extern char * object_dir_path;
@@ -29,14 +72,21 @@ extern char * HEAD_file_path;
 extern const char * delete_file_name;
 
 error_code_t init();
-error_code_t write_file_to_index(int index_fd, char * file_path, unsigned char * hash);
-error_code_t s_add_file(int index_fd, char * file_path, off_t offset, bool insert);
+repository_state_t * repository_state();
+repository_state_t * repository_state_switch(IN repository_state_t * state);
+error_code_t repository_state_create(IN int dir_fd, OUT repository_state_t ** state);
+void repository_state_destroy(IN repository_state_t * state);
+int work_tree_fd();
+void close_caches();
+error_code_t s_add_file(char * file_path, unsigned char * file_hash);
 error_code_t get_next_commit_segment(int commit_fd, commit_file_segment_t * file_segment);
 error_code_t get_next_index_segment(int index_fd, index_file_segement_t * file_segment);
-error_code_t add_file(char * relative_path);
+error_code_t add_file(char * relative_path, fsmonitor_result_t * fsmonitor_result, unsigned char * file_hash);
 error_code_t add_files(int argc, char ** argv);
-error_code_t commit(char * message);
-error_code_t get_head(int head_fd, unsigned char hash[SHA_DIGEST_LENGTH]);
+error_code_t commit(char * message, bool interactive);
 error_code_t write_index_segment(int fd, index_file_segement_t index_segment);
+error_code_t open_commit(char * commit, int * commit_fd);
 error_code_t checkout(char * path);
-error_code_t get_blob_path(unsigned char * hash, char ** blob_path, char ** parent_path);
\ No newline at end of file
+error_code_t get_blob_path(unsigned char * hash, char ** blob_path, char ** parent_path);
+error_code_t refresh_index(fsmonitor_result_t * fsmonitor_result);
+error_code_t status();
\ No newline at end of file
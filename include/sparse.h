@@ -0,0 +1,29 @@
+#ifndef _SPARSE_HEADER
+#define _SPARSE_HEADER
+
+#include "standard.h"
+
+/* A node of the pattern trie, one per byte. Children are linked through their siblings. */
+typedef struct sparse_node_s{
+    int child;
+    int sibling;
+    char byte;
+    bool terminal;
+}sparse_node_t;
+
+/* The sparse patterns of a repository, loaded by sparse_load */
+typedef struct sparse_cache_s{
+    bool enabled;
+    sparse_node_t * nodes;
+    int num_of_nodes;
+    int capacity;
+}sparse_cache_t;
+
+extern const char * sparse_file_name;
+
+error_code_t sparse_load();
+bool sparse_contains(IN const char * path, IN int path_len);
+void sparse_close();
+error_code_t sparse_command(IN int argc, IN char ** argv);
+
+#endif
@@ -43,6 +43,7 @@ typedef enum error_code_s {
     ERROR_CODE_COULDNT_CHMOD,
     ERROR_CODE_COULDNT_GET_PATH,
     ERROR_CODE_COULDNT_GET_STAT,
+    ERROR_CODE_COULDNT_LOCK,
 
     ERROR_CODE_COULDNT_ALLOCATE_MEMORY,
     ERROR_CODE_COULDNT_SPRINTF,
@@ -52,7 +53,11 @@ typedef enum error_code_s {
     ERROR_CODE_COULDNT_EXTRACT_FILE_NAME,
     ERROR_CODE_COULDNT_GET_HASH,
 
+    ERROR_CODE_NOT_FOUND,
+    ERROR_CODE_AMBIGUOUS,
+
     ERROR_CODE_INVALID_INPUT,
+    ERROR_CODE_CHANGED_ON_DISK,
     ERROR_CODE_UNDEFINED,
     ERROR_CODE_UNKNOWN
 }error_code_t;
@@ -62,5 +67,12 @@ error_code_t make_dir(const char * path);
 int extract_file_name(char * file_path, char ** file_name);
 int extract_dir(char * path, int dir_num, char ** dir_name);
 int copy_file_range(int in_fd, loff_t in_offset, int out_fd, loff_t out_offset, int length);
+int file_insertion(int in_fd, char * in_path, void * insertion, off_t offset, int length);
+error_code_t redirect_stdout(OUT int * stdout_fd);
+error_code_t restore_stdout(IN int stdout_fd);
+error_code_t set_socket_timeout(IN int socket_fd, IN int milliseconds);
+error_code_t path_at(IN int dir_fd, IN const char * path, OUT char * full_path, IN size_t size);
+FILE * fopenat(IN int dir_fd, IN const char * path, IN const char * mode);
+char * realpathat(IN int dir_fd, IN const char * path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef _TRACE_HEADER
+#define _TRACE_HEADER
+
+#include "standard.h"
+
+#define TRACE_MAX_DEPTH (32)
+#define TRACE_ENV_VAR "SLAP_TRACE"
+#define TRACE_OPTION "--trace="
+
+extern bool trace_enabled;
+extern unsigned long long trace_bytes_hashed;
+extern unsigned long long trace_allocations;
+extern unsigned long long trace_reads;
+extern unsigned long long trace_writes;
+extern unsigned long long trace_bytes_read;
+extern unsigned long long trace_bytes_written;
+extern unsigned long long trace_opens;
+extern unsigned long long trace_closes;
+extern unsigned long long trace_stats;
+extern unsigned long long trace_syncs;
+
+/* The checks are inlined, so a disabled trace costs a branch per span. Counting is atomic since fsck hashes on many threads */
+#define TRACE_BEGIN(name) do{ if(trace_enabled){ trace_begin(name); } }while(0)
+#define TRACE_END(name) do{ if(trace_enabled){ trace_end(name); } }while(0)
+#define TRACE_COUNT_HASHED(bytes) __atomic_fetch_add(&trace_bytes_hashed, (bytes), __ATOMIC_RELAXED)
+/* I/O is counted where it is done (a system call, or a completed io_uring request), so io_uring I/O is counted too */
+#define TRACE_COUNT_READ(bytes) do{ __atomic_fetch_add(&trace_reads, 1, __ATOMIC_RELAXED); __atomic_fetch_add(&trace_bytes_read, (bytes), __ATOMIC_RELAXED); }while(0)
+#define TRACE_COUNT_WRITE(bytes) do{ __atomic_fetch_add(&trace_writes, 1, __ATOMIC_RELAXED); __atomic_fetch_add(&trace_bytes_written, (bytes), __ATOMIC_RELAXED); }while(0)
+#define TRACE_COUNT_OPEN() __atomic_fetch_add(&trace_opens, 1, __ATOMIC_RELAXED)
+#define TRACE_COUNT_CLOSE() __atomic_fetch_add(&trace_closes, 1, __ATOMIC_RELAXED)
+#define TRACE_COUNT_STAT() __atomic_fetch_add(&trace_stats, 1, __ATOMIC_RELAXED)
+#define TRACE_COUNT_SYNC() __atomic_fetch_add(&trace_syncs, 1, __ATOMIC_RELAXED)
+
+error_code_t trace_start(IN const char * path);
+void trace_begin(IN const char * name);
+void trace_end(IN const char * name);
+void trace_stop();
+
+#endif
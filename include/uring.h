@@ -0,0 +1,39 @@
+#ifndef _URING_HEADER
+#define _URING_HEADER
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include "standard.h"
+
+typedef struct uring_s{
+    int ring_fd;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+
+    void * sq_map;
+    size_t sq_map_len;
+    void * cq_map;
+    size_t cq_map_len;
+    struct io_uring_sqe * sqes;
+    size_t sqes_len;
+
+    unsigned int * sq_head;
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_array;
+    unsigned int sq_local_tail;
+
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    struct io_uring_cqe * cqes;
+}uring_t;
+
+error_code_t uring_init(OUT uring_t * ring, IN unsigned int entries);
+error_code_t uring_register_buffers(IN uring_t * ring, IN struct iovec * buffers, IN unsigned int num_of_buffers);
+struct io_uring_sqe * uring_get_sqe(IN uring_t * ring);
+error_code_t uring_submit_and_wait(IN uring_t * ring, IN unsigned int wait_for);
+bool uring_next_cqe(IN uring_t * ring, OUT struct io_uring_cqe * cqe);
+void uring_close(IN uring_t * ring);
+
+#endif
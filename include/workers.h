@@ -0,0 +1,12 @@
+#ifndef _WORKERS_HEADER
+#define _WORKERS_HEADER
+
+#include "standard.h"
+
+#define WORKERS_MAX_THREADS (64)
+
+typedef void * (*worker_t)(IN void * argument);
+
+void run_workers(IN worker_t worker, IN void * argument, IN size_t num_of_items, IN size_t batch);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _WORKTREE_HEADER
+#define _WORKTREE_HEADER
+
+#include "standard.h"
+
+/* Called with the repository directory (.slap) of every other work tree that shares the objects directory */
+typedef error_code_t (*worktree_callback_t)(IN const char * repo_dir, IN void * context);
+
+extern const char * worktree_file_name;
+
+error_code_t worktree_for_each(IN worktree_callback_t callback, IN void * context);
+error_code_t worktree_write_index(IN const unsigned char * hash);
+error_code_t worktree_add(IN const char * path, IN const char * commit);
+error_code_t worktree_command(IN int argc, IN char ** argv);
+
+#endif
@@ -1,7 +1,7 @@
 #include "slap_commands.h"
 
 /**
- * @brief: Initializes an empty repository in the working directory
+ * @brief: Initializes an empty repository in the work tree
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
  * @notes: If a repository already exists, nothing occurs.
@@ -26,26 +26,33 @@ error_code_t init(){
             goto cleanup;
         }
 
-        error_check = creat(index_file_path, 0666);
+        return_value = object_index_create();
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = openat(work_tree_fd(), index_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
         if(-1 == error_check){
-            perror("INIT: Creat error");
+            perror("INIT: Openat error");
             printf("(Errno: %i)\n", errno);
             return_value = ERROR_CODE_COULDNT_CREATE;
             goto cleanup;
         }
+        close(error_check);
 
-        error_check = creat(HEAD_file_path, 0666);
+        error_check = openat(work_tree_fd(), HEAD_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
         if(-1 == error_check){
-            perror("INIT: Creat error");
+            perror("INIT: Openat error");
             printf("(Errno: %i)\n", errno);
             return_value = ERROR_CODE_COULDNT_CREATE;
             goto cleanup;
         }
+        close(error_check);
     }
 
-    real_path = realpath("./", real_path);
+    real_path = realpathat(work_tree_fd(), ".");
     if(NULL == real_path){
-        perror("INIT: Realpath error");
+        perror("INIT: Realpathat error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_GET_PATH;
         goto cleanup;
@@ -65,185 +72,6 @@ cleanup:
     return return_value;
 }
 
-/**
- * @brief: Writes a file segement to the index file
- * @param[IN] index_fd: The file descriptor of the index file
- * @param[IN] file_path: The path of the file to write to the index file
- * @param[IN] hash: The hash of the file specified by file_path
- * 
- * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
- */
-error_code_t write_file_to_index(IN int index_fd, IN char * file_path, IN unsigned char * hash){
-    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
-    int path_len = 0;
-    int error_check = 0;
-    int head_fd = -1;
-    int commit_fd = -1;
-    int i = 0;
-    int difference = 0;
-    int num_of_parents = 0;
-    unsigned char commit_hash[SHA_DIGEST_LENGTH] = {0};
-    unsigned char repo_blob_hash[SHA_DIGEST_LENGTH] = {0};
-    char * commit_path = NULL;
-    commit_file_segment_t file_segment = {0};
-    struct stat statbuf = {0};
-
-    commit_path = malloc(SHA_DIGEST_LENGTH * 2 + strnlen(object_dir_path, BUFFER_SIZE) + 3);
-    if(NULL == commit_path){
-        perror("WRITE_FILE_TO_INDEX: Malloc error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
-        goto cleanup;
-    }
-
-    path_len = strnlen(file_path, BUFFER_SIZE);
-
-    if(NULL == hash){
-        error_check = get_hash(file_path, &hash);
-        if(-1 == error_check){
-            return_value = ERROR_CODE_UNDEFINED;
-            goto cleanup;
-        }
-    }
-
-    head_fd = open(HEAD_file_path, O_RDONLY);
-    if(-1 == head_fd){
-        perror("WRITE_FILE_TO_INDEX: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
-        goto cleanup;
-    }
-
-    error_check = read(head_fd, commit_hash, SHA_DIGEST_LENGTH);
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: Read error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_READ;
-        goto cleanup;
-    }
-
-    if(0 != error_check){
-        sprintf(commit_path, "%s/%.2x/", object_dir_path, commit_hash[0]);
-        for(i=1; i<SHA_DIGEST_LENGTH; i++){
-            sprintf(commit_path, "%s%.2x", commit_path, commit_hash[i]);
-        }
-
-        commit_fd = open(commit_path, O_RDONLY);
-        if(-1 == commit_fd){
-            perror("WRITE_FILE_TO_INDEX: Open error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_OPEN;
-            goto cleanup;
-        }
-
-        error_check = read(commit_fd, &num_of_parents, sizeof(num_of_parents));
-        if(-1 == error_check){
-            perror("WRITE_FILE_TO_INDEX: Read error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_READ;
-            goto cleanup;
-        }
-
-        error_check = lseek(commit_fd, SHA_DIGEST_LENGTH * num_of_parents, SEEK_CUR);
-        if(-1 == commit_fd){
-            perror("WRITE_FILE_TO_INDEX: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        do{
-            if(NULL != file_segment.name){
-                free(file_segment.name);
-                file_segment.name = NULL;
-            }
-            return_value = get_next_commit_segment(commit_fd, &file_segment);
-            if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_EOF != return_value){
-                goto cleanup;
-            }
-
-            if(ERROR_CODE_EOF == return_value){
-                break;
-            }
-
-            difference = valid_strncmp(file_segment.name, file_path);
-
-        }while(difference != 0);
-
-        if(0 == difference){
-            memcpy(repo_blob_hash, file_segment.sha, SHA_DIGEST_LENGTH);
-        }
-    }
-
-    for(i=0; i<2; i++){
-        error_check = write(index_fd, hash, SHA_DIGEST_LENGTH);
-        if(-1 == error_check){
-            perror("WRITE_FILE_TO_INDEX: Write error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_WRITE;
-            goto cleanup;
-        }
-    }
-
-    error_check = write(index_fd, repo_blob_hash, SHA_DIGEST_LENGTH);
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: Write error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_WRITE;
-        goto cleanup;
-    }
-
-    error_check = stat(file_path, &statbuf);
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: stat error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_GET_STAT;
-        goto cleanup;
-    }
-
-    error_check = write(index_fd, &statbuf.st_mode, sizeof(statbuf.st_mode));
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: Write error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_WRITE;
-        goto cleanup;
-    }
-
-    error_check = write(index_fd, &path_len, sizeof(path_len));
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: Write error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_WRITE;
-        goto cleanup;
-    }
-
-    error_check = write(index_fd, file_path, path_len);
-    if(-1 == error_check){
-        perror("WRITE_FILE_TO_INDEX: Write error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_WRITE;
-        goto cleanup;
-    }
-
-    return_value = ERROR_CODE_SUCCESS;
-
-cleanup:
-    if(NULL != file_segment.name){
-        free(file_segment.name);
-    }
-    if(NULL != commit_path){
-        free(commit_path);
-    }
-    if(-1 != head_fd){
-        close(head_fd);
-    }
-    if(-1 != commit_fd){
-        close(commit_fd);
-    }
-
-    return return_value;
-}
-
 /**
  * @brief: Gets the path of a blob (if one were to exist) based on the hash of the file
  * @param[IN] hash: The hash of the file
@@ -251,36 +79,37 @@ cleanup:
  * @param[OUT] parent_path: The path to the parent directory of the blob file
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The hot paths open objects with open_object instead, this is for callers that need the path itself.
+ *         Only the path is formatted, nothing is opened, so objects in an alternate objects directory are
+ *         found with object_locate or open_object instead.
  */
 error_code_t get_blob_path(IN unsigned char * hash, OUT char ** blob_path, OUT char ** parent_path){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
-    int error_check = 0;
-    int i = 0;
+    char hex[OBJECT_HEX_LEN + 1] = {0};
 
-    *blob_path = malloc(strnlen(object_dir_path, BUFFER_SIZE) + SHA_DIGEST_LENGTH*2 + 3);
+    *blob_path = malloc(strnlen(object_dir_path, BUFFER_SIZE) + OBJECT_HEX_LEN + 3);
     if(NULL == *blob_path){
-        perror("S_ADD_FILE: Malloc error");
+        perror("GET_BLOB_PATH: Malloc error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
         goto cleanup;
     }
 
     if(NULL != parent_path){
-        *parent_path = malloc(strnlen(object_dir_path, BUFFER_SIZE) + 4 + 2);
-        if(NULL == *blob_path){
-            perror("S_ADD_FILE: Malloc error");
+        *parent_path = malloc(strnlen(object_dir_path, BUFFER_SIZE) + 4);
+        if(NULL == *parent_path){
+            perror("GET_BLOB_PATH: Malloc error");
             printf("(Errno: %i)\n", errno);
             return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
             goto cleanup;
         }
     }
 
-    sprintf(*blob_path, "%s/%.2x/", object_dir_path, hash[0]);
+    sha_to_hex(hash, hex);
+
+    sprintf(*blob_path, "%s/%.2s/%s", object_dir_path, hex, hex + 2);
     if(NULL != parent_path){
-        sprintf(*parent_path, "%s/%.2x", object_dir_path, hash[0]);
-    }
-    for(i=1; i<SHA_DIGEST_LENGTH; i++){
-        sprintf(*blob_path, "%s%.2x", *blob_path, hash[i]);
+        sprintf(*parent_path, "%s/%.2s", object_dir_path, hex);
     }
 
     return_value = ERROR_CODE_SUCCESS;
@@ -291,62 +120,65 @@ cleanup:
 
 /**
  * @brief: Adds a file to the repository
- * @param[IN] index_fd: The file descriptor of the index file
  * @param[IN] file_path: The path to the file to add
- * @param[IN] offset: The offset in the index file to add the file segment to
- * @param[IN] insert: If the segment should be inserted (without overwriting) (This is probably redundant)
+ * @param[IN] file_hash: The hash of the file if it is already known (and its blob already written), else NULL
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only the cached index is updated, index_cache_write writes it
  */
-error_code_t s_add_file(IN int index_fd, IN char * file_path, IN off_t offset, IN bool insert){
+error_code_t s_add_file(IN char * file_path, IN unsigned char * file_hash){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
     int error_check = 0;
-    int new_index_fd = -1;
-    int i = 0;
     int bytes_read = 0;
     int file_fd = -1;
     int blob_fd = -1;
-    loff_t out_offset = 0;
-    loff_t in_offset = 0;
-    unsigned char * hash = NULL;
-    char * blob_path = NULL;
-    char * blob_parent = NULL;
+    off_t blob_size = 0;
+    unsigned char * hash = file_hash;
+    unsigned char * computed_hash = NULL;
     char buffer[BUFFER_SIZE] = {0};
-    struct stat index_statbuf = {0};
+    struct stat statbuf = {0};
+    bool blob_exists = false;
+    index_file_segement_t * entry = NULL;
 
-    error_check = get_hash(file_path, &hash);
-    if(-1 == error_check){
-        return_value = ERROR_CODE_UNDEFINED;
-        goto cleanup;
+    if(NULL == hash){
+        error_check = get_hash(file_path, &computed_hash);
+        if(-1 == error_check){
+            return_value = ERROR_CODE_UNDEFINED;
+            goto cleanup;
+        }
+        hash = computed_hash;
     }
 
-    return_value = get_blob_path(hash, &blob_path, &blob_parent);
+    return_value = object_index_contains(hash, &blob_exists);
     if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    file_fd = open(file_path, O_RDWR);
-    if(-1 == error_check){
-        perror("S_ADD_FILE: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
-        goto cleanup;
+    if(!blob_exists){
+        return_value = open_object(hash, O_RDWR | O_EXCL | O_CREAT, OBJECT_FILE_MODE, &blob_fd);
+        if(ERROR_CODE_ALREADY_EXISTS == return_value){
+            blob_exists = true;
+            errno = 0;
+        }
+        else if(ERROR_CODE_SUCCESS != return_value){
+            perror("S_ADD_FILE: Open error");
+            printf("(Errno: %i)\n", errno);
+            goto cleanup;
+        }
     }
+    PROBE3(object__open, file_path, hash, blob_exists);
+
+    if(!blob_exists){
+        file_fd = openat(work_tree_fd(), file_path, O_RDONLY);
+        if(-1 == file_fd){
+            perror("S_ADD_FILE: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+        TRACE_COUNT_OPEN();
 
-    errno = 0;
-    return_value = make_dir(blob_parent);
-    if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_ALREADY_EXISTS != return_value){
-        goto cleanup;
-    }
-    blob_fd = open(blob_path, O_RDWR | O_EXCL | O_CREAT, 0666);
-    if(-1 == blob_fd && EEXIST != errno){
-        perror("S_ADD_FILE: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
-        goto cleanup;
-    }
 
-    if(EEXIST != errno){
         do{
             bytes_read = read(file_fd, buffer, BUFFER_SIZE);
             if(-1 == bytes_read){
@@ -355,6 +187,7 @@ error_code_t s_add_file(IN int index_fd, IN char * file_path, IN off_t offset, I
                 return_value = ERROR_CODE_COULDNT_READ;
                 goto cleanup;
             }
+            TRACE_COUNT_READ(bytes_read);
 
             error_check = write(blob_fd, buffer, bytes_read);
             if(-1 == error_check){
@@ -363,115 +196,54 @@ error_code_t s_add_file(IN int index_fd, IN char * file_path, IN off_t offset, I
                 return_value = ERROR_CODE_COULDNT_WRITE;
                 goto cleanup;
             }
+            TRACE_COUNT_WRITE(error_check);
+            blob_size += bytes_read;
         }while(bytes_read != 0);
+        PROBE3(object__create, file_path, blob_size, hash);
+
+        return_value = sync_new_object(blob_fd, hash);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
     }
 
+    return_value = object_index_add(hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
 
     /* Adding file to the index */
-    error_check = stat(index_file_path, &index_statbuf);
+    error_check = fstatat(work_tree_fd(), file_path, &statbuf, 0);
     if(-1 == error_check){
-        perror("S_ADD_FILE: Stat error");
+        perror("S_ADD_FILE: Fstatat error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_GET_STAT;
         goto cleanup;
     }
+    TRACE_COUNT_STAT();
 
-    if(offset >= index_statbuf.st_size || offset < 0){
-        error_check = lseek(index_fd, 0, SEEK_END);
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        return_value = write_file_to_index(index_fd, file_path, hash);
-        if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
-    }
-    else if(!insert){
-        error_check = lseek(index_fd, offset, SEEK_SET);
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        return_value = write_file_to_index(index_fd, file_path, hash);
-        if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
+    return_value = index_cache_add(file_path, strnlen(file_path, BUFFER_SIZE), &entry);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
     }
-    else{
-        error_check = rename(index_file_path, ".repo/del");
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Rename error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_RENAME;
-            goto cleanup;
-        }
-        
-        new_index_fd = creat(index_file_path, 0666);
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Creat error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_CREATE;
-            goto cleanup;
-        }
-
-        errno = 0;
-        error_check = copy_file_range(index_fd, in_offset, new_index_fd, out_offset, offset);
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Copy_file_range error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_WRITE;
-            goto cleanup;
-        }
-
-        return_value = write_file_to_index(new_index_fd, file_path, hash);
-        if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
-
-        out_offset = lseek(new_index_fd, 0, SEEK_CUR);
-        if(-1 == out_offset){
-            perror("S_ADD_FILE: NEW Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        in_offset = offset;
-
-        error_check = copy_file_range(index_fd, in_offset, new_index_fd, out_offset, index_statbuf.st_size - offset);
-        if(-1 == error_check){
-            perror("S_ADD_FILE: Copy_file_range error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_WRITE;
-            goto cleanup;
-        }
 
-        remove(".repo/del");
-    }
+    memcpy(entry->wdir_sha, hash, SHA_DIGEST_LENGTH);
+    memcpy(entry->stage_sha, hash, SHA_DIGEST_LENGTH);
+    entry->mode = statbuf.st_mode;
+    index_cache_changed();
 
 cleanup:
-    if(NULL != hash){
-        free(hash);
-    }
-    if(NULL != blob_path){
-        free(blob_path);
-    }
-    if(NULL != blob_parent){
-        free(blob_parent);
+    if(NULL != computed_hash){
+        free(computed_hash);
     }
 
     if(-1 != blob_fd){
         close(blob_fd);
+        TRACE_COUNT_CLOSE();
     }
     if(-1 != file_fd){
         close(file_fd);
+        TRACE_COUNT_CLOSE();
     }
 
     return return_value;
@@ -655,6 +427,9 @@ error_code_t get_next_index_segment(int index_fd, index_file_segement_t * file_s
     if(0 == error_check){
         return_value = ERROR_CODE_EOF;
     }
+    else{
+        PROBE3(index__read, file_segment->name, INDEX_SEGMENT_HEADER_SIZE + name_len, file_segment->wdir_sha);
+    }
 
 cleanup:
     if(NULL != name){
@@ -667,92 +442,34 @@ cleanup:
 /**
  * @brief: Adds a file to the index
  * @param[IN] relative_path: The path to the file to add
+ * @param[IN] fsmonitor_result: The result of fsmonitor_query, used to skip files that are already staged
+ * @param[IN] file_hash: The hash of the file if its blob was already written by add_files, else NULL
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
- * @notes: This function just gets the necessary information to call s_add_file
+ * @notes: This function just looks the file up in the cached index to call s_add_file
  */
-error_code_t add_file(IN char * relative_path){
+error_code_t add_file(IN char * relative_path, IN fsmonitor_result_t * fsmonitor_result, IN unsigned char * file_hash){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
-    int error_check = 0;
-    int i = 0;
-    int relative_path_len = 0;
-    int index_fd = -1;
-    int difference = 0;
-    off_t index_offset = 0;
-    unsigned char * hash = NULL;
-    index_file_segement_t curr_file_segment = {0};
-    struct stat index_statbuf = {0};
+    index_file_segement_t * entry = NULL;
 
-
-    index_fd = open(index_file_path, O_RDWR);
-    if(-1 == index_fd){
-        perror("ADD_FILE: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+    return_value = index_cache_find(relative_path, strnlen(relative_path, BUFFER_SIZE), &entry);
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    error_check = stat(index_file_path, &index_statbuf);
-    if(-1 == error_check){
-        perror("ADD_FILE: Stat error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_GET_STAT;
+    if(NULL != entry && !fsmonitor_is_dirty(fsmonitor_result, relative_path) &&
+       0 == memcmp(entry->wdir_sha, entry->stage_sha, SHA_DIGEST_LENGTH)){
+        return_value = ERROR_CODE_SUCCESS;
         goto cleanup;
     }
 
-    relative_path_len = strnlen(relative_path, BUFFER_SIZE);
-
-    while(true){
-        index_offset = lseek(index_fd, 0, SEEK_CUR);
-        if(-1 == index_offset){
-            perror("ADD_FILE: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        if(index_offset > index_statbuf.st_size){
-            printf("File error..?");
-            return_value = ERROR_CODE_UNKNOWN;
-            goto cleanup;
-        }
-
-        if(index_offset == index_statbuf.st_size){
-            break;
-        }
-        if(NULL != curr_file_segment.name){
-            free(curr_file_segment.name);
-        }
-        return_value = get_next_index_segment(index_fd, &curr_file_segment);
-        if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_EOF != return_value){
-            goto cleanup;
-        }
-
-        difference = strncmp(relative_path, curr_file_segment.name, max(relative_path_len, curr_file_segment.name_len));
-        if(0 == difference){
-            error_check = lseek(index_fd, index_offset, SEEK_SET);
-            if(-1 == error_check){
-                perror("ADD_FILE: Lseek error");
-                printf("(Errno: %i)\n", errno);
-                return_value = ERROR_CODE_COULDNT_LSEEK;
-                goto cleanup;
-            }
-
-            break;
-        }
-    }
-
-    return_value = s_add_file(index_fd, relative_path, index_offset, false);
+    return_value = s_add_file(relative_path, file_hash);
     if(ERROR_CODE_SUCCESS != return_value){
         return_value = ERROR_CODE_COULDNT_WRITE;
         goto cleanup;
     }
 
 cleanup:
-    if(NULL != curr_file_segment.name){
-        free(curr_file_segment.name);
-    }
-
     return return_value;
 }
 
@@ -762,52 +479,128 @@ cleanup:
  * @param[IN] argv: The file paths to add to the index
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
- * @notes: This function just iterates over argv and calls add_file with each element
+ * @notes: The blobs of the files that may have changed are written first, BULK_IO_CHUNK files at a time
+ *         with bulk_write_objects, then add_file is called with each element of argv
  */
 error_code_t add_files(IN int argc, IN char ** argv){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
     int i = 0;
+    int j = 0;
+    int chunk_start = 0;
+    int chunk_end = 0;
+    int num_of_paths = 0;
+    char ** paths = NULL;
+    unsigned char * hashes = NULL;
+    fsmonitor_result_t fsmonitor_result = {0};
+
+    TRACE_BEGIN("add_files");
+
+    return_value = sparse_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("fsmonitor_query");
+    return_value = fsmonitor_query(&fsmonitor_result);
+    TRACE_END("fsmonitor_query");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    paths = calloc(BULK_IO_CHUNK, sizeof(*paths));
+    hashes = malloc((size_t)BULK_IO_CHUNK * SHA_DIGEST_LENGTH);
+    if(NULL == paths || NULL == hashes){
+        perror("ADD_FILES: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(chunk_start=0; chunk_start<argc; chunk_start=chunk_end){
+        num_of_paths = 0;
+        for(chunk_end=chunk_start; chunk_end<argc && num_of_paths<BULK_IO_CHUNK; chunk_end++){
+            if(sparse_contains(argv[chunk_end], strlen(argv[chunk_end])) && fsmonitor_is_dirty(&fsmonitor_result, argv[chunk_end])){
+                paths[num_of_paths++] = argv[chunk_end];
+            }
+        }
 
-    for(i=0; i<argc; i++){
-        return_value = add_file(argv[i]);
+        TRACE_BEGIN("write_objects");
+        return_value = bulk_write_objects(paths, num_of_paths, hashes);
+        TRACE_END("write_objects");
         if(ERROR_CODE_SUCCESS != return_value){
             goto cleanup;
         }
+
+        TRACE_BEGIN("update_index");
+        for(i=chunk_start, j=0; i<chunk_end; i++){
+            if(!sparse_contains(argv[i], strlen(argv[i]))){
+                printf("\e[38;2;200;100;0m%s is outside the sparse checkout\e[0m, skipping\n", argv[i]);
+                continue;
+            }
+            if(j<num_of_paths && paths[j] == argv[i]){
+                return_value = add_file(argv[i], &fsmonitor_result, hashes + (size_t)j * SHA_DIGEST_LENGTH);
+                j++;
+            }
+            else{
+                return_value = add_file(argv[i], &fsmonitor_result, NULL);
+            }
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+        TRACE_END("update_index");
     }
 
-    return_value = ERROR_CODE_SUCCESS;
+    /* The new objects have to be durable before the index that references them, index_cache_write syncs them first */
+    return_value = index_cache_write();
 
 cleanup:
+    if(NULL != paths){
+        free(paths);
+    }
+    if(NULL != hashes){
+        free(hashes);
+    }
+    fsmonitor_free_result(&fsmonitor_result);
+    TRACE_END("add_files");
+
     return return_value;
 }
 
 /**
  * @brief: Commits an index to the repository
  * @param[IN] message: The commit message to add to the commit object (redundant for now, set to NULL)
+ * @param[IN] interactive: Ask before committing files that changed since they were added, else commit what was added
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The index and HEAD are taken from the index cache and written with index_cache_write. The cached
+ *         index is already sorted by path (index_cache_entries sorts it, and it is written sorted), so its
+ *         entries are hashed and written to the commit object as they are read, without another copy of the
+ *         index in memory.
  */
-error_code_t commit(IN char * message){
+error_code_t commit(IN char * message, IN bool interactive){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
     unsigned char hash[SHA_DIGEST_LENGTH] = {0};
     unsigned char head_hash[SHA_DIGEST_LENGTH] = {0};
-    unsigned char * file_hash = NULL;
-    char * blob_path = NULL;
-    char * blob_parent = NULL;
+    char blob_path[PATH_MAX] = {0};
     int error_check = 0;
-    int i = 0;
     int num_of_parents = 0;
     int blob_fd = -1;
     int temp_fd = -1;
-    int index_fd = -1;
-    int head_fd = 0;
     int difference = 0;
     char input = 0;
+    bool blob_exists = false;
+    bool head_exists = false;
     char * temp_commit_name = NULL;
     struct stat statbuf = {0};
     SHA_CTX sha_struct = {0};
-    index_file_segement_t file_segment = {0};
+    size_t j = 0;
+    size_t num_of_entries = 0;
+    index_file_segement_t * entries = NULL;
     commit_file_segment_t commit_segment = {0};
+    fsmonitor_result_t fsmonitor_result = {0};
+
+    TRACE_BEGIN("commit");
 
     temp_commit_name = malloc(strnlen(object_dir_path, BUFFER_SIZE) + strlen("temp") + 2);
     if(NULL == temp_commit_name){
@@ -819,48 +612,38 @@ error_code_t commit(IN char * message){
 
     sprintf(temp_commit_name, "%s/temp", object_dir_path);
 
-    index_fd = open(index_file_path, O_RDWR);
-    if(-1 == index_fd){
-        perror("COMMIT: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+    TRACE_BEGIN("fsmonitor_query");
+    return_value = fsmonitor_query(&fsmonitor_result);
+    TRACE_END("fsmonitor_query");
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    head_fd = open(HEAD_file_path, O_RDWR);
-    if(-1 == head_fd){
-        perror("COMMIT: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+    TRACE_BEGIN("refresh_index");
+    return_value = refresh_index(&fsmonitor_result);
+    TRACE_END("refresh_index");
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    while(true){
-        if(NULL != file_segment.name){
-            free(file_segment.name);
-            file_segment.name = NULL;
-        }
-        return_value = get_next_index_segment(index_fd, &file_segment);
-        if(ERROR_CODE_EOF == return_value){
-            break;
-        }
-        else if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
+    return_value = index_cache_entries(&entries, &num_of_entries);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
 
-        if(NULL != file_hash){
-            free(file_hash);
-            file_hash = NULL;
-        }
-        error_check = get_hash(file_segment.name, &file_hash);
-        if(-1 == error_check){
-            return_value = ERROR_CODE_COULDNT_GET_HASH;
-            goto cleanup;
+    TRACE_BEGIN("check_index");
+    for(j=0; j<num_of_entries; j++){
+        /* Paths outside the sparse checkout aren't in the working directory, their staged version is kept */
+        if(!sparse_contains(entries[j].name, entries[j].name_len)){
+            continue;
         }
 
-        difference = strncmp(file_hash, file_segment.stage_sha, SHA_DIGEST_LENGTH);
-        if(0 != difference){
-            printf("\e[38;2;200;100;0m%s is not up to date\e[0m Commit anyway? ([y]/n): ", file_segment.name);
+        difference = memcmp(entries[j].wdir_sha, entries[j].stage_sha, SHA_DIGEST_LENGTH);
+        if(0 != difference && !interactive){
+            printf("\e[38;2;200;100;0m%s is not up to date\e[0m, committing the added version\n", entries[j].name);
+        }
+        else if(0 != difference){
+            printf("\e[38;2;200;100;0m%s is not up to date\e[0m Commit anyway? ([y]/n): ", entries[j].name);
 
             input = getchar();
             if('y' != input){
@@ -868,15 +651,14 @@ error_code_t commit(IN char * message){
             }
         }
     }
+    TRACE_END("check_index");
 
-    error_check = lseek(index_fd, 0, SEEK_SET);
-    if(-1 == error_check){
-        perror("COMMIT: Lseek error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_LSEEK;
+    return_value = fsmonitor_save_token(&fsmonitor_result);
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
+    TRACE_BEGIN("write_commit");
     error_check = SHA1_Init(&sha_struct);
     if(0 == error_check){
         perror("COMMIT: SHA1_Init error");
@@ -885,22 +667,20 @@ error_code_t commit(IN char * message){
         goto cleanup;
     }
 
-    temp_fd = open(temp_commit_name, O_RDWR | O_CREAT, 0666);
+    temp_fd = openat(work_tree_fd(), temp_commit_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
     if(-1 == temp_fd){
-        perror("COMMIT: Open error");
+        perror("COMMIT: Openat error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_OPEN;
         goto cleanup;
     }
 
-    return_value = get_head(head_fd, head_hash);
+    return_value = index_cache_head(head_hash, &head_exists);
     if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
-    for(i=0; i<SHA_DIGEST_LENGTH; i++){
-        if(head_hash[i] != 0){
-            num_of_parents = 1;
-        }
+    if(head_exists){
+        num_of_parents = 1;
     }
 
     error_check = write(temp_fd, &num_of_parents, sizeof(num_of_parents));
@@ -937,45 +717,12 @@ error_code_t commit(IN char * message){
         }
     }
 
-    while(true){
-        error_check = lseek(index_fd, 0, SEEK_CUR);
-        if(-1 == error_check){
-            perror("COMMIT: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        if(NULL != file_segment.name){
-            free(file_segment.name);
-            file_segment.name = NULL;
-        }
-        return_value = get_next_index_segment(index_fd, &file_segment);
-        if(ERROR_CODE_EOF == return_value){
-            break;
-        }
-        else if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
-
-        commit_segment.mode = file_segment.mode;
-        commit_segment.name = file_segment.name;
-        commit_segment.name_len = file_segment.name_len;
-        memcpy(commit_segment.sha, file_segment.stage_sha, SHA_DIGEST_LENGTH);
-        memcpy(file_segment.repo_sha, file_segment.stage_sha, SHA_DIGEST_LENGTH);
-        
-        error_check = lseek(index_fd, error_check, SEEK_SET);
-        if(-1 == error_check){
-            perror("COMMIT: Lseek error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_LSEEK;
-            goto cleanup;
-        }
-
-        return_value = write_index_segment(index_fd, file_segment);
-        if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
+    /* The cached index is sorted by path, so the entries are streamed in the order commits store them */
+    for(j=0; j<num_of_entries; j++){
+        commit_segment.mode = entries[j].mode;
+        commit_segment.name = entries[j].name;
+        commit_segment.name_len = entries[j].name_len;
+        memcpy(commit_segment.sha, entries[j].stage_sha, SHA_DIGEST_LENGTH);
 
         error_check = SHA1_Update(&sha_struct, &commit_segment, SHA_DIGEST_LENGTH + 2 * sizeof(int));
         if(0 == error_check){
@@ -1017,71 +764,71 @@ error_code_t commit(IN char * message){
         return_value = ERROR_CODE_COULDNT_GET_HASH;
         goto cleanup;
     }
+    TRACE_END("write_commit");
 
-    return_value = get_blob_path(hash, &blob_path, &blob_parent);
+    TRACE_BEGIN("store_commit_object");
+    return_value = object_index_contains(hash, &blob_exists);
     if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    return_value = make_dir(blob_parent);
-    if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_ALREADY_EXISTS != return_value){
-        goto cleanup;
+    if(!blob_exists){
+        return_value = open_object(hash, O_RDWR | O_EXCL | O_CREAT, OBJECT_FILE_MODE, &blob_fd);
+        if(ERROR_CODE_ALREADY_EXISTS == return_value){
+            blob_exists = true;
+        }
+        else if(ERROR_CODE_SUCCESS != return_value){
+            perror("COMMIT: Open error");
+            printf("(Errno: %i)\n", errno);
+            goto cleanup;
+        }
     }
-    blob_fd = open(blob_path, O_RDWR | O_EXCL | O_CREAT, 0666);
-    if(-1 == blob_fd && EEXIST != errno){
-        perror("COMMIT: Open error");
+
+    error_check = fstatat(work_tree_fd(), temp_commit_name, &statbuf, 0);
+    if(-1 == error_check){
+        perror("COMMIT: Fstatat error");
         printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
         goto cleanup;
     }
 
-    if(EEXIST != errno){
-        error_check = stat(temp_commit_name, &statbuf);
-        if(-1 == error_check){
-            perror("COMMIT: Stat error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_GET_STAT;
-            goto cleanup;
-        }
-
+    if(!blob_exists){
         error_check = copy_file_range(temp_fd, 0, blob_fd, 0, statbuf.st_size);
         if(-1 == error_check){
             return_value = ERROR_CODE_COULDNT_WRITE;
             goto cleanup;
         }
 
-        error_check = fchmod(blob_fd, 0444);
-        if(-1 == error_check){
-            perror("COMMIT: Write error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_CHMOD;
+        return_value = sync_new_object(blob_fd, hash);
+        if(ERROR_CODE_SUCCESS != return_value){
             goto cleanup;
         }
     }
 
-    remove(temp_commit_name);
-
-    error_check = ftruncate(head_fd, 0);
-    if(-1 == error_check){
-        perror("COMMIT: Ftruncate error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_TRUNCATE;
+    return_value = object_index_add(hash);
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    error_check = lseek(head_fd, 0, SEEK_SET);
-    if(-1 == error_check){
-        perror("COMMIT: Lseek error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_LSEEK;
+    unlinkat(work_tree_fd(), temp_commit_name, 0);
+    PROBE3(commit__write, hash, statbuf.st_size, num_of_parents);
+    TRACE_END("store_commit_object");
+
+    /* The index and HEAD are only changed once the commit object exists */
+    for(j=0; j<num_of_entries; j++){
+        memcpy(entries[j].repo_sha, entries[j].stage_sha, SHA_DIGEST_LENGTH);
+    }
+    index_cache_changed();
+    index_cache_set_head(hash);
+
+    /* Objects, then the index, then HEAD, so HEAD never points at data that didn't reach the disk */
+    return_value = index_cache_write();
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    error_check = write(head_fd, hash, SHA_DIGEST_LENGTH);
-    if(-1 == error_check){
-        perror("COMMIT: Write error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_WRITE;
+    return_value = object_path(hash, blob_path);
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
@@ -1090,68 +837,22 @@ error_code_t commit(IN char * message){
     return_value = ERROR_CODE_SUCCESS;
 
 cleanup:
-    if(NULL != file_segment.name){
-        free(file_segment.name);
-    }
-    if(NULL != file_hash){
-        free(file_hash);
-    }
-    if(NULL != blob_parent){
-        free(blob_path);
-    }
-    if(NULL != blob_parent){
-        free(blob_parent);
-    }
     if(NULL != temp_commit_name){
         free(temp_commit_name);
     }
 
-    if(-1 != index_fd){
-        close(index_fd);
-    }
     if(-1 != blob_fd){
         close(blob_fd);
     }
-    if(-1 != head_fd){
-        close(head_fd);
+    if(-1 != temp_fd){
+        close(temp_fd);
     }
+    fsmonitor_free_result(&fsmonitor_result);
+    TRACE_END("commit");
 
     return return_value;
 }
 
-/**
- * @brief: Gets the hash stored in HEAD
- * @param[IN] head_fd: The file descriptor of HEAD
- * @param[OUT] hash: The hash to fill out
- * 
- * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
- */
-error_code_t get_head(IN int head_fd, OUT unsigned char hash[SHA_DIGEST_LENGTH]){
-    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
-    int error_check = 0;
-
-    error_check = lseek(head_fd, 0, SEEK_SET);
-    if(-1 == error_check){
-        perror("GET_HEAD: Lseek error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_LSEEK;
-        goto cleanup;
-    }
-
-    error_check = read(head_fd, (void *)hash, SHA_DIGEST_LENGTH);
-    if(-1 == error_check){
-        perror("GET_HEAD: Lseek error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_READ;
-        goto cleanup;
-    }
-
-    return_value = ERROR_CODE_SUCCESS;
-
-cleanup:
-    return return_value;
-}
-
 /**
  * @brief: Writes an index segment structure to the index file
  * @param[IN] fd: The file descriptor of the index file
@@ -1210,6 +911,7 @@ error_code_t write_index_segment(int fd, index_file_segement_t index_segment){
         return_value = ERROR_CODE_COULDNT_WRITE;
         goto cleanup;
     }
+    PROBE3(index__write, index_segment.name, INDEX_SEGMENT_HEADER_SIZE + index_segment.name_len, index_segment.wdir_sha);
 
     return_value = ERROR_CODE_SUCCESS;
 
@@ -0,0 +1,26 @@
+#include "trace.h"
+
+/*
+ * The allocation functions are wrapped at link time (-Wl,--wrap=malloc...) so --trace can count allocations.
+ * This file isn't part of libslap, it is only linked into the programs that are linked with WRAP_ALLOC
+ * (slap and bench/micro), so clients of the library never see a reference to __real_malloc.
+ */
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t num_of_members, size_t size);
+void * __real_realloc(void * pointer, size_t size);
+
+void * __wrap_malloc(size_t size){
+    __atomic_fetch_add(&trace_allocations, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t num_of_members, size_t size){
+    __atomic_fetch_add(&trace_allocations, 1, __ATOMIC_RELAXED);
+    return __real_calloc(num_of_members, size);
+}
+
+void * __wrap_realloc(void * pointer, size_t size){
+    __atomic_fetch_add(&trace_allocations, 1, __ATOMIC_RELAXED);
+    return __real_realloc(pointer, size);
+}
@@ -0,0 +1,598 @@
+#include "slap_commands.h"
+
+#include <sys/sendfile.h>
+
+/**
+ * @brief: Writes a whole buffer to a file descriptor
+ * @param[IN] fd: The file descriptor
+ * @param[IN] data: The data
+ * @param[IN] length: The length of the data
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t archive_write_fd(IN int fd, IN const unsigned char * data, IN size_t length){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes_written = 0;
+    size_t offset = 0;
+
+    for(offset=0; offset<length; offset+=bytes_written){
+        bytes_written = write(fd, data + offset, length - offset);
+        if(-1 == bytes_written && EINTR == errno){
+            bytes_written = 0;
+            continue;
+        }
+        if(-1 == bytes_written){
+            perror("ARCHIVE_WRITE_FD: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes the output buffer, deflating it first when gzipping
+ * @param[IN OUT] output: The output
+ * @param[IN] finish: Also end the gzip stream
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t archive_flush(IN OUT archive_output_t * output, IN bool finish){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    if(!output->gzip){
+        return_value = archive_write_fd(output->fd, output->buffer, output->length);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        output->length = 0;
+        goto cleanup;
+    }
+
+    output->stream.next_in = output->buffer;
+    output->stream.avail_in = output->length;
+    do{
+        output->stream.next_out = output->compressed;
+        output->stream.avail_out = ARCHIVE_BUFFER_SIZE;
+
+        error_check = deflate(&output->stream, finish ? Z_FINISH : Z_NO_FLUSH);
+        if(Z_STREAM_ERROR == error_check){
+            printf("\e[31mCouldn't compress the archive.\e[0m\n");
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+
+        return_value = archive_write_fd(output->fd, output->compressed, ARCHIVE_BUFFER_SIZE - output->stream.avail_out);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }while(0 == output->stream.avail_out || (finish && Z_STREAM_END != error_check));
+
+    output->length = 0;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Appends to the output buffer
+ * @param[IN OUT] output: The output
+ * @param[IN] data: The data, NULL for zeros
+ * @param[IN] length: The length of the data (at most ARCHIVE_BUFFER_SIZE)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t archive_append(IN OUT archive_output_t * output, IN const void * data, IN size_t length){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(output->length + length > ARCHIVE_BUFFER_SIZE){
+        return_value = archive_flush(output, false);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    if(NULL == data){
+        memset(output->buffer + output->length, 0, length);
+    }
+    else{
+        memcpy(output->buffer + output->length, data, length);
+    }
+    output->length += length;
+    output->num_of_bytes += length;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Fills in the checksum of a ustar header and appends it
+ * @param[IN OUT] output: The output
+ * @param[IN OUT] header: The header, every other field already filled in
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t archive_append_header(IN OUT archive_output_t * output, IN OUT archive_header_t * header){
+    unsigned int checksum = 0;
+    size_t i = 0;
+    const unsigned char * bytes = (const unsigned char *)header;
+
+    memcpy(header->magic, "ustar", sizeof(header->magic));
+    memcpy(header->version, "00", sizeof(header->version));
+    memset(header->checksum, ' ', sizeof(header->checksum));
+    for(i=0; i<sizeof(*header); i++){
+        checksum += bytes[i];
+    }
+    snprintf(header->checksum, sizeof(header->checksum), "%06o", checksum);
+
+    return archive_append(output, header, sizeof(*header));
+}
+
+/**
+ * @brief: Appends a pax record to a buffer
+ * @param[OUT] records: The buffer
+ * @param[IN OUT] records_len: The length of the records already in the buffer
+ * @param[IN] key: The key of the record
+ * @param[IN] value: The value of the record
+ * @param[IN] value_len: The length of the value
+ *
+ * @notes: A record is "<length> <key>=<value>\n", where the length counts its own digits
+ */
+static void archive_pax_record(OUT char * records, IN OUT size_t * records_len, IN const char * key, IN const char * value, IN size_t value_len){
+    size_t length = 0;
+    size_t digits = 1;
+    int prefix_len = 0;
+
+    length = strlen(key) + value_len + 3;
+    while(snprintf(NULL, 0, "%zu", length + digits) > (int)digits){
+        digits++;
+    }
+    length += digits;
+
+    prefix_len = sprintf(records + *records_len, "%zu %s=", length, key);
+    memcpy(records + *records_len + prefix_len, value, value_len);
+    records[*records_len + prefix_len + value_len] = '\n';
+    *records_len += length;
+}
+
+/**
+ * @brief: Appends the header of a file, preceded by a pax header if the path or the size don't fit ustar
+ * @param[IN OUT] output: The output
+ * @param[IN] name: The path of the file
+ * @param[IN] name_len: The length of the path
+ * @param[IN] mode: The mode of the file
+ * @param[IN] size: The size of the file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Paths longer than 100 bytes are split between the prefix and name fields at a '/' when they can be
+ */
+static error_code_t archive_file_header(IN OUT archive_output_t * output, IN const char * name, IN int name_len, IN mode_t mode, IN unsigned long long size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int split = -1;
+    int i = 0;
+    size_t records_len = 0;
+    char size_value[32] = {0};
+    char * records = NULL;
+    archive_header_t header = {0};
+    archive_header_t pax_header = {0};
+
+    if(name_len <= (int)sizeof(header.name)){
+        memcpy(header.name, name, name_len);
+    }
+    else{
+        for(i=max(name_len - (int)sizeof(header.name) - 1, 1); i<=min(name_len - 2, (int)sizeof(header.prefix)); i++){
+            if('/' == name[i]){
+                split = i;
+                break;
+            }
+        }
+        if(-1 != split){
+            memcpy(header.prefix, name, split);
+            memcpy(header.name, name + split + 1, name_len - split - 1);
+        }
+        else{
+            /* The pax header has the real path, this one is only for readers that don't know pax */
+            memcpy(header.name, name, sizeof(header.name));
+        }
+    }
+
+    if((-1 == split && name_len > (int)sizeof(header.name)) || size > ARCHIVE_USTAR_MAX_SIZE){
+        records = malloc(name_len + 2 * sizeof(size_value) + 32);
+        if(NULL == records){
+            perror("ARCHIVE_FILE_HEADER: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        if(-1 == split && name_len > (int)sizeof(header.name)){
+            archive_pax_record(records, &records_len, "path", name, name_len);
+        }
+        if(size > ARCHIVE_USTAR_MAX_SIZE){
+            archive_pax_record(records, &records_len, "size", size_value, sprintf(size_value, "%llu", size));
+        }
+
+        snprintf(pax_header.name, sizeof(pax_header.name), "././@PaxHeader");
+        snprintf(pax_header.mode, sizeof(pax_header.mode), "%07o", 0644);
+        snprintf(pax_header.uid, sizeof(pax_header.uid), "%07o", 0);
+        snprintf(pax_header.gid, sizeof(pax_header.gid), "%07o", 0);
+        snprintf(pax_header.size, sizeof(pax_header.size), "%011zo", records_len);
+        snprintf(pax_header.mtime, sizeof(pax_header.mtime), "%011o", 0);
+        pax_header.type = 'x';
+
+        return_value = archive_append_header(output, &pax_header);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        for(i=0; i<(int)records_len; i+=ARCHIVE_BLOCK_SIZE){
+            return_value = archive_append(output, records + i, min(records_len - i, (size_t)ARCHIVE_BLOCK_SIZE));
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+        return_value = archive_append(output, NULL, (ARCHIVE_BLOCK_SIZE - records_len % ARCHIVE_BLOCK_SIZE) % ARCHIVE_BLOCK_SIZE);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    snprintf(header.mode, sizeof(header.mode), "%07o", mode & 07777);
+    snprintf(header.uid, sizeof(header.uid), "%07o", 0);
+    snprintf(header.gid, sizeof(header.gid), "%07o", 0);
+    snprintf(header.size, sizeof(header.size), "%011llo", min(size, ARCHIVE_USTAR_MAX_SIZE));
+    snprintf(header.mtime, sizeof(header.mtime), "%011o", 0);
+    header.type = '0';
+
+    return_value = archive_append_header(output, &header);
+
+cleanup:
+    if(NULL != records){
+        free(records);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Copies the contents of a blob to the output, padded to a whole block
+ * @param[IN OUT] output: The output
+ * @param[IN] blob_fd: The blob
+ * @param[IN] size: The size of the blob
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Small blobs are read straight into the output buffer. Big ones are sent from the page cache with
+ *         sendfile after the buffer is flushed, unless gzipping, falling back to pread if the output doesn't
+ *         support it.
+ */
+static error_code_t archive_copy(IN OUT archive_output_t * output, IN int blob_fd, IN off_t size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes = 0;
+    off_t offset = 0;
+    bool use_sendfile = false;
+
+    use_sendfile = (!output->gzip && size >= ARCHIVE_SENDFILE_MIN);
+    if(use_sendfile){
+        return_value = archive_flush(output, false);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    while(offset < size){
+        if(use_sendfile){
+            bytes = sendfile(output->fd, blob_fd, &offset, size - offset);
+            if(-1 == bytes && (EINVAL == errno || ENOSYS == errno) && 0 == offset){
+                errno = 0;
+                use_sendfile = false;
+                continue;
+            }
+            if(-1 == bytes && EINTR == errno){
+                continue;
+            }
+            if(-1 == bytes){
+                perror("ARCHIVE_COPY: Sendfile error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_WRITE;
+                goto cleanup;
+            }
+            if(0 == bytes){
+                break;
+            }
+            output->num_of_bytes += bytes;
+            continue;
+        }
+
+        if(ARCHIVE_BUFFER_SIZE == output->length){
+            return_value = archive_flush(output, false);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+
+        bytes = pread(blob_fd, output->buffer + output->length, min((size_t)(size - offset), ARCHIVE_BUFFER_SIZE - output->length), offset);
+        if(-1 == bytes && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes){
+            perror("ARCHIVE_COPY: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes){
+            break;
+        }
+        output->length += bytes;
+        output->num_of_bytes += bytes;
+        offset += bytes;
+    }
+
+    if(offset < size){
+        printf("\e[31mA blob was truncated while it was read.\e[0m\n");
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    return_value = archive_append(output, NULL, (ARCHIVE_BLOCK_SIZE - size % ARCHIVE_BLOCK_SIZE) % ARCHIVE_BLOCK_SIZE);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes a tar archive of the files of a commit
+ * @param[IN] commit: The commit, HEAD or a (possibly abbreviated) sha
+ * @param[IN] path: The path of the archive, or - for the standard output
+ * @param[IN] gzip: Compress the archive with gzip
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The segments of the commit are read with get_next_commit_segment and every blob is streamed into
+ *         the archive as it is reached, so nothing is written anywhere else. The files keep the permission
+ *         bits of their commit segment; owners and times are zero so an archive of a commit is always the
+ *         same. Directories don't get entries of their own.
+ */
+error_code_t archive_commit(IN const char * commit, IN const char * path, IN bool gzip){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int commit_fd = -1;
+    int blob_fd = -1;
+    int num_of_parents = 0;
+    int name_len = 0;
+    size_t num_of_files = 0;
+    bool to_stdout = false;
+    bool deflating = false;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    const char * name = NULL;
+    struct stat statbuf = {0};
+    commit_file_segment_t segment = {0};
+    archive_output_t output = {0};
+
+    output.fd = -1;
+    output.gzip = gzip;
+    to_stdout = (0 == strcmp(path, "-"));
+
+    /* The archive owns the standard output, everything printed goes to the standard error */
+    if(to_stdout){
+        return_value = redirect_stdout(&output.fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = resolve_commit(commit, hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = open_object(hash, O_RDONLY, 0, &commit_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        perror("ARCHIVE_COMMIT: Open error");
+        printf("(Errno: %i)\n", errno);
+        goto cleanup;
+    }
+
+    error_check = read(commit_fd, &num_of_parents, sizeof(num_of_parents));
+    if(-1 == error_check){
+        perror("ARCHIVE_COMMIT: Read error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    error_check = lseek(commit_fd, num_of_parents * SHA_DIGEST_LENGTH, SEEK_CUR);
+    if(-1 == error_check){
+        perror("ARCHIVE_COMMIT: Lseek error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_LSEEK;
+        goto cleanup;
+    }
+
+    output.buffer = malloc(ARCHIVE_BUFFER_SIZE);
+    if(gzip && NULL != output.buffer){
+        output.compressed = malloc(ARCHIVE_BUFFER_SIZE);
+    }
+    if(NULL == output.buffer || (gzip && NULL == output.compressed)){
+        perror("ARCHIVE_COMMIT: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    if(gzip){
+        /* 16 + MAX_WBITS asks for a gzip wrapper instead of a zlib one */
+        error_check = deflateInit2(&output.stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        if(Z_OK != error_check){
+            printf("\e[31mCouldn't start compressing the archive.\e[0m\n");
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        deflating = true;
+    }
+
+    if(!to_stdout){
+        output.fd = openat(work_tree_fd(), path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if(-1 == output.fd){
+            perror("ARCHIVE_COMMIT: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+    }
+
+    TRACE_BEGIN("write_archive");
+    while(true){
+        return_value = get_next_commit_segment(commit_fd, &segment);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+
+        return_value = open_object(segment.sha, O_RDONLY, 0, &blob_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            sha_to_hex(segment.sha, hex);
+            printf("\e[31mThe blob %s of %s is missing, run slap fsck.\e[0m\n", hex, segment.name);
+            break;
+        }
+
+        error_check = fstat(blob_fd, &statbuf);
+        if(-1 == error_check){
+            perror("ARCHIVE_COMMIT: Fstat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            break;
+        }
+
+        /* Paths added as ./path are archived as path */
+        name = segment.name;
+        name_len = segment.name_len;
+        while(name_len > 2 && '.' == name[0] && '/' == name[1]){
+            name += 2;
+            name_len -= 2;
+        }
+
+        return_value = archive_file_header(&output, name, name_len, segment.mode, statbuf.st_size);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+
+        return_value = archive_copy(&output, blob_fd, statbuf.st_size);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+
+        close(blob_fd);
+        blob_fd = -1;
+        free(segment.name);
+        segment.name = NULL;
+        num_of_files++;
+    }
+    TRACE_END("write_archive");
+    if(ERROR_CODE_EOF != return_value){
+        goto cleanup;
+    }
+
+    /* A tar archive ends with two zero blocks */
+    return_value = archive_append(&output, NULL, 2 * ARCHIVE_BLOCK_SIZE);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = archive_flush(&output, true);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("Archived %zu files (%llu bytes before compression).\n", num_of_files, output.num_of_bytes);
+
+cleanup:
+    if(NULL != segment.name){
+        free(segment.name);
+    }
+    if(-1 != blob_fd){
+        close(blob_fd);
+    }
+    if(-1 != commit_fd){
+        close(commit_fd);
+    }
+    if(to_stdout){
+        restore_stdout(output.fd);
+    }
+    else if(-1 != output.fd){
+        close(output.fd);
+    }
+    if(deflating){
+        deflateEnd(&output.stream);
+    }
+    if(NULL != output.compressed){
+        free(output.compressed);
+    }
+    if(NULL != output.buffer){
+        free(output.buffer);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the archive command
+ * @param[IN] argc: The number of arguments (after archive)
+ * @param[IN] argv: The arguments: <commit> [-o <file|->] [--gzip]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The archive goes to the standard output by default, and then messages go to the standard error.
+ *         It is gzipped with --gzip, or when the file name ends with .tar.gz or .tgz.
+ */
+error_code_t archive_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    size_t path_len = 0;
+    bool gzip = false;
+    char * commit = NULL;
+    char * path = "-";
+
+    for(i=0; i<argc; i++){
+        if(0 == valid_strncmp(argv[i], "-o")){
+            if(i + 1 >= argc){
+                commit = NULL;
+                break;
+            }
+            path = argv[++i];
+        }
+        else if(0 == valid_strncmp(argv[i], "--gzip")){
+            gzip = true;
+        }
+        else if(NULL == commit){
+            commit = argv[i];
+        }
+        else{
+            commit = NULL;
+            break;
+        }
+    }
+
+    if(NULL == commit){
+        printf("USAGE: slap archive <commit> [-o <file|->] [--gzip]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    path_len = strlen(path);
+    if((path_len > strlen(".tar.gz") && 0 == strcmp(path + path_len - strlen(".tar.gz"), ".tar.gz")) ||
+       (path_len > strlen(".tgz") && 0 == strcmp(path + path_len - strlen(".tgz"), ".tgz"))){
+        gzip = true;
+    }
+
+    return_value = archive_commit(commit, path, gzip);
+
+cleanup:
+    return return_value;
+}
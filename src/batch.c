@@ -0,0 +1,202 @@
+#include "slap_commands.h"
+
+/**
+ * @brief: Adds the paths queued by the add commands since the last flush point, in one add_files
+ * @param[IN OUT] state: The state of the batch
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t batch_add_pending(IN OUT batch_state_t * state){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+
+    if(0 == state->num_of_pending){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = add_files(state->num_of_pending, state->pending_paths);
+
+cleanup:
+    for(i=0; i<state->num_of_pending; i++){
+        free(state->pending_paths[i]);
+        state->pending_paths[i] = NULL;
+    }
+    state->num_of_pending = 0;
+
+    return return_value;
+}
+
+/**
+ * @brief: Queues a path to be added at the next flush point
+ * @param[IN OUT] state: The state of the batch
+ * @param[IN] path: The path
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t batch_queue_path(IN OUT batch_state_t * state, IN const char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int new_capacity = 0;
+    char ** new_paths = NULL;
+
+    if(state->num_of_pending == state->pending_capacity){
+        new_capacity = max(state->pending_capacity * 2, 64);
+        new_paths = realloc(state->pending_paths, new_capacity * sizeof(*new_paths));
+        if(NULL == new_paths){
+            perror("BATCH_QUEUE_PATH: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        state->pending_paths = new_paths;
+        state->pending_capacity = new_capacity;
+    }
+
+    state->pending_paths[state->num_of_pending] = strdup(path);
+    if(NULL == state->pending_paths[state->num_of_pending]){
+        perror("BATCH_QUEUE_PATH: Strdup error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    state->num_of_pending++;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs a single command of the batch
+ * @param[IN OUT] state: The state of the batch
+ * @param[IN] line: The command, without its delimiter
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t batch_run_line(IN OUT batch_state_t * state, IN char * line){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(0 == strncmp(line, "add ", strlen("add ")) && '\0' != line[strlen("add ")]){
+        return_value = batch_queue_path(state, line + strlen("add "));
+        goto cleanup;
+    }
+
+    /* Every other command is a flush point */
+    return_value = batch_add_pending(state);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(0 == strcmp(line, "commit")){
+        return_value = commit(NULL, false);
+    }
+    else if(0 == strncmp(line, "checkout ", strlen("checkout ")) && '\0' != line[strlen("checkout ")]){
+        return_value = checkout(line + strlen("checkout "));
+    }
+    else if(0 == strcmp(line, "flush")){
+        return_value = index_cache_flush();
+    }
+    else{
+        printf("\e[31mUnknown batch command %s\e[0m\n", line);
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs the commands read from the standard input in this process
+ * @param[IN] delimiter: The character that ends every command ('\n' or '\0')
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else the error code of the command that failed
+ * @notes: The commands are "add <path>", "commit", "checkout <commit>" and "flush". The paths of
+ *         consecutive adds are queued and added together (one bulk hash and one pass over the index)
+ *         when the next other command or the end of the input is reached. All the commands work on the
+ *         index and HEAD cached in memory, which are only written (after the objects are synced) by
+ *         flush and at the end of the input. The batch stops at the first command that fails, and what
+ *         the commands before it did is written.
+ */
+error_code_t batch(IN char delimiter){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t line_len = 0;
+    size_t line_capacity = 0;
+    char * line = NULL;
+    batch_state_t state = {0};
+
+    TRACE_BEGIN("batch");
+
+    index_cache_defer(true);
+
+    while(-1 != (line_len = getdelim(&line, &line_capacity, delimiter, stdin))){
+        if(line_len > 0 && delimiter == line[line_len - 1]){
+            line[--line_len] = '\0';
+        }
+        if(0 == line_len){
+            continue;
+        }
+
+        state.num_of_commands++;
+        return_value = batch_run_line(&state, line);
+        if(ERROR_CODE_SUCCESS != return_value){
+            printf("\e[31mBatch stopped at command %lu.\e[0m\n", state.num_of_commands);
+            goto cleanup;
+        }
+    }
+    if(ferror(stdin)){
+        perror("BATCH: Getdelim error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    return_value = batch_add_pending(&state);
+
+cleanup:
+    index_cache_defer(false);
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = index_cache_flush();
+    }
+    else{
+        index_cache_flush();
+    }
+
+    while(state.num_of_pending > 0){
+        free(state.pending_paths[--state.num_of_pending]);
+    }
+    if(NULL != state.pending_paths){
+        free(state.pending_paths);
+    }
+    if(NULL != line){
+        free(line);
+    }
+    TRACE_END("batch");
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the batch command
+ * @param[IN] argc: The number of arguments (after batch)
+ * @param[IN] argv: The arguments: [-z]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: With -z the commands are NUL terminated instead of newline terminated
+ */
+error_code_t batch_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(0 == argc){
+        return_value = batch('\n');
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "-z")){
+        return_value = batch('\0');
+    }
+    else{
+        printf("USAGE: batch: [-z]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+    return return_value;
+}
@@ -0,0 +1,1361 @@
+#include "slap_commands.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+const char * bitmap_file_name = "bitmaps";
+
+/* A set of shas, kept in the order they were added */
+typedef struct sha_set_s{
+    unsigned char * shas;
+    size_t count;
+    size_t capacity;
+    unsigned int * slots;
+    size_t num_of_slots;
+}sha_set_t;
+
+typedef struct bitmap_builder_s{
+    sha_set_t ordering;
+    unsigned long long * words;
+    size_t num_of_words;
+    unsigned char * commits;
+    size_t num_of_commits;
+    size_t commits_capacity;
+    bool has_base;
+    size_t base;
+    bitmap_entry_t * entries;
+    size_t num_of_entries;
+    size_t entries_capacity;
+    unsigned long long * data;
+    size_t data_len;
+    size_t data_capacity;
+}bitmap_builder_t;
+
+typedef struct bitmap_lookup_record_s{
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    unsigned int position;
+}bitmap_lookup_record_t;
+
+typedef struct reachability_context_s{
+    reachability_t * reachability;
+    sha_set_t extra;
+    pthread_mutex_t lock;
+    unsigned char * commits;
+    size_t num_of_commits;
+    size_t commits_capacity;
+    size_t next;
+    error_code_t error;
+}reachability_context_t;
+
+/**
+ * @brief: Compares two shas, or two records that start with a sha (for qsort and bsearch)
+ */
+static int bitmap_compare(IN const void * sha1, IN const void * sha2){
+    return memcmp(sha1, sha2, SHA_DIGEST_LENGTH);
+}
+
+/**
+ * @brief: Appends a sha to a growing array of shas
+ * @param[IN OUT] shas: The array
+ * @param[IN OUT] count: The number of shas in the array
+ * @param[IN OUT] capacity: The number of shas the array can hold
+ * @param[IN] hash: The sha to append
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bitmap_append_sha(IN OUT unsigned char ** shas, IN OUT size_t * count, IN OUT size_t * capacity, IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned char * new_shas = NULL;
+
+    if(*count == *capacity){
+        new_shas = realloc(*shas, max(*capacity * 2, 64) * SHA_DIGEST_LENGTH);
+        if(NULL == new_shas){
+            perror("BITMAP_APPEND_SHA: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        *shas = new_shas;
+        *capacity = max(*capacity * 2, 64);
+    }
+
+    memcpy(*shas + *count * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH);
+    (*count)++;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the slot of a sha in a set
+ * @param[IN] set: The set
+ * @param[IN] hash: The sha to look for
+ *
+ * @returns: The slot holding the sha, or the empty slot where it would be inserted
+ * @notes: Shas are uniformly distributed, so their first bytes are used as the hash
+ */
+static size_t sha_set_slot(IN const sha_set_t * set, IN const unsigned char * hash){
+    size_t slot = 0;
+
+    memcpy(&slot, hash, sizeof(slot));
+    slot &= set->num_of_slots - 1;
+
+    while(0 != set->slots[slot] &&
+          0 != memcmp(set->shas + (size_t)(set->slots[slot] - 1) * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH)){
+        slot = (slot + 1) & (set->num_of_slots - 1);
+    }
+
+    return slot;
+}
+
+/**
+ * @brief: Adds a sha to a set
+ * @param[IN OUT] set: The set
+ * @param[IN] hash: The sha to add
+ * @param[OUT] position: The order in which the sha was first added (optional)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sha_set_add(IN OUT sha_set_t * set, IN const unsigned char * hash, OUT size_t * position){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t slot = 0;
+    size_t i = 0;
+    size_t new_num_of_slots = 0;
+    unsigned int * new_slots = NULL;
+
+    if((set->count + 1) * 2 > set->num_of_slots){
+        new_num_of_slots = max(set->num_of_slots * 2, 1024);
+        new_slots = calloc(new_num_of_slots, sizeof(*new_slots));
+        if(NULL == new_slots){
+            perror("SHA_SET_ADD: Calloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        free(set->slots);
+        set->slots = new_slots;
+        set->num_of_slots = new_num_of_slots;
+
+        for(i=0; i<set->count; i++){
+            set->slots[sha_set_slot(set, set->shas + i * SHA_DIGEST_LENGTH)] = i + 1;
+        }
+    }
+
+    slot = sha_set_slot(set, hash);
+    if(0 == set->slots[slot]){
+        return_value = bitmap_append_sha(&set->shas, &set->count, &set->capacity, hash);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        set->slots[slot] = set->count;
+    }
+
+    if(NULL != position){
+        *position = set->slots[slot] - 1;
+    }
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Frees a set
+ */
+static void sha_set_free(IN sha_set_t * set){
+    if(NULL != set->shas){
+        free(set->shas);
+    }
+    if(NULL != set->slots){
+        free(set->slots);
+    }
+    memset(set, 0, sizeof(*set));
+}
+
+/**
+ * @brief: Compresses a bitmap with EWAH
+ * @param[IN] words: The bitmap
+ * @param[IN] num_of_words: The number of words in the bitmap
+ * @param[OUT] compressed: The compressed words (to be freed by the caller)
+ * @param[OUT] num_of_compressed: The number of compressed words
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The compressed bitmap is a sequence of marker words, each followed by its literal words.
+ *         A marker stands for a run of all-zero or all-one words and then a number of literal words
+ *         (see EWAH_RUN_BITS), so the long runs a prefix-heavy bitmap has take a single word.
+ */
+error_code_t ewah_compress(IN const unsigned long long * words, IN size_t num_of_words, OUT unsigned long long ** compressed, OUT size_t * num_of_compressed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t marker = 0;
+    size_t count = 0;
+    unsigned long long fill = 0;
+    unsigned long long run = 0;
+    unsigned long long literals = 0;
+    unsigned long long * output = NULL;
+
+    /* Every marker covers at least one word, so the output is never more than twice the input */
+    output = malloc((num_of_words * 2 + 1) * sizeof(*output));
+    if(NULL == output){
+        perror("EWAH_COMPRESS: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    while(i < num_of_words){
+        marker = count++;
+        fill = (~0ULL == words[i]) ? ~0ULL : 0;
+
+        for(run=0; i < num_of_words && fill == words[i] && run < EWAH_MAX_RUN; run++){
+            i++;
+        }
+        for(literals=0; i < num_of_words && 0 != words[i] && ~0ULL != words[i] && literals < EWAH_MAX_LITERALS; literals++){
+            output[count++] = words[i++];
+        }
+
+        output[marker] = (fill & 1) | (run << 1) | (literals << (EWAH_RUN_BITS + 1));
+    }
+
+    *compressed = output;
+    *num_of_compressed = count;
+    output = NULL;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != output){
+        free(output);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: ORs an EWAH compressed bitmap into a bitmap
+ * @param[IN] compressed: The compressed words
+ * @param[IN] num_of_compressed: The number of compressed words
+ * @param[IN OUT] words: The bitmap
+ * @param[IN] num_of_words: The number of words in the bitmap
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_INVALID_INPUT if the compressed bitmap is
+ *           malformed or longer than the bitmap
+ */
+error_code_t ewah_or(IN const unsigned long long * compressed, IN size_t num_of_compressed, IN OUT unsigned long long * words, IN size_t num_of_words){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t position = 0;
+    unsigned long long marker = 0;
+    unsigned long long run = 0;
+    unsigned long long literals = 0;
+    unsigned long long k = 0;
+
+    while(i < num_of_compressed){
+        marker = compressed[i++];
+        run = (marker >> 1) & EWAH_MAX_RUN;
+        literals = marker >> (EWAH_RUN_BITS + 1);
+        if(run + literals > num_of_words - position || literals > num_of_compressed - i){
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+
+        if(marker & 1){
+            for(k=0; k<run; k++){
+                words[position + k] = ~0ULL;
+            }
+        }
+        position += run;
+
+        for(k=0; k<literals; k++){
+            words[position++] |= compressed[i++];
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Unmaps the bitmap file
+ */
+static void bitmap_unmap(){
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    if(NULL != cache->map){
+        munmap(cache->map, cache->map_len);
+    }
+    cache->map = NULL;
+    cache->map_len = 0;
+    cache->header = NULL;
+    cache->shas = NULL;
+    cache->lookup = NULL;
+    cache->entries = NULL;
+    cache->data = NULL;
+    cache->data_len = 0;
+}
+
+/**
+ * @brief: Maps the bitmap file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A missing or invalid bitmap file is treated as having no bitmaps, bitmap_write replaces it
+ */
+static error_code_t bitmap_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int bitmap_fd = -1;
+    size_t i = 0;
+    size_t tables_len = 0;
+    struct stat statbuf = {0};
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    if(cache->loaded){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    bitmap_fd = openat(dir_fd, bitmap_file_name, O_RDONLY | O_CLOEXEC);
+    if(-1 == bitmap_fd && ENOENT == errno){
+        errno = 0;
+        cache->loaded = true;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(-1 == bitmap_fd){
+        perror("BITMAP_LOAD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(bitmap_fd, &statbuf);
+    if(-1 == error_check){
+        perror("BITMAP_LOAD: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    cache->loaded = true;
+    return_value = ERROR_CODE_SUCCESS;
+    if(statbuf.st_size < sizeof(bitmap_header_t)){
+        goto cleanup;
+    }
+
+    cache->map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, bitmap_fd, 0);
+    if(MAP_FAILED == cache->map){
+        cache->map = NULL;
+        perror("BITMAP_LOAD: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        cache->loaded = false;
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    cache->map_len = statbuf.st_size;
+    cache->header = cache->map;
+
+    tables_len = sizeof(bitmap_header_t) + (size_t)cache->header->num_of_objects * (SHA_DIGEST_LENGTH + sizeof(unsigned int)) +
+                 (size_t)cache->header->num_of_bitmaps * sizeof(bitmap_entry_t);
+    if(BITMAP_MAGIC != cache->header->magic || BITMAP_VERSION != cache->header->version ||
+       tables_len > cache->map_len || 0 != (cache->map_len - tables_len) % sizeof(unsigned long long)){
+        bitmap_unmap();
+        goto cleanup;
+    }
+
+    cache->shas = (const unsigned char *)cache->map + sizeof(bitmap_header_t);
+    cache->lookup = (const unsigned int *)(cache->shas + (size_t)cache->header->num_of_objects * SHA_DIGEST_LENGTH);
+    cache->entries = (const bitmap_entry_t *)(cache->lookup + cache->header->num_of_objects);
+    cache->data = (const unsigned long long *)(cache->entries + cache->header->num_of_bitmaps);
+    cache->data_len = (cache->map_len - tables_len) / sizeof(unsigned long long);
+
+    for(i=0; i<cache->header->num_of_objects; i++){
+        if(cache->lookup[i] >= cache->header->num_of_objects){
+            bitmap_unmap();
+            goto cleanup;
+        }
+    }
+    for(i=0; i<cache->header->num_of_bitmaps; i++){
+        if(cache->entries[i].offset > cache->data_len || cache->entries[i].num_of_words > cache->data_len - cache->entries[i].offset){
+            bitmap_unmap();
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    if(-1 != bitmap_fd){
+        close(bitmap_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Finds the bitmap of a commit
+ * @param[IN] commit: The sha of the commit
+ *
+ * @returns: The entry of the bitmap, or NULL if the commit has none
+ */
+static const bitmap_entry_t * bitmap_find(IN const unsigned char * commit){
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    if(NULL == cache->header){
+        return NULL;
+    }
+
+    return bsearch(commit, cache->entries, cache->header->num_of_bitmaps, sizeof(bitmap_entry_t), bitmap_compare);
+}
+
+/**
+ * @brief: Gets the position of an object in the bitmap ordering
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] position: The position
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if the object isn't in the ordering
+ */
+static error_code_t bitmap_position(IN const unsigned char * hash, OUT size_t * position){
+    error_code_t return_value = ERROR_CODE_NOT_FOUND;
+    size_t low = 0;
+    size_t high = 0;
+    size_t middle = 0;
+    int compare = 0;
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    if(NULL == cache->header){
+        goto cleanup;
+    }
+
+    high = cache->header->num_of_objects;
+    while(low < high){
+        middle = low + (high - low) / 2;
+        compare = memcmp(cache->shas + (size_t)cache->lookup[middle] * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH);
+        if(0 == compare){
+            *position = cache->lookup[middle];
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        if(compare < 0){
+            low = middle + 1;
+        }
+        else{
+            high = middle;
+        }
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the bitmap ordering, the objects the bits of every bitmap stand for
+ * @param[OUT] shas: The shas, in order (valid until the bitmaps are written or closed)
+ * @param[OUT] count: The number of shas, 0 if there are no bitmaps
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t bitmap_ordering(OUT const unsigned char ** shas, OUT size_t * count){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    *shas = NULL;
+    *count = 0;
+
+    return_value = bitmap_load();
+    if(ERROR_CODE_SUCCESS != return_value || NULL == cache->header){
+        goto cleanup;
+    }
+
+    *shas = cache->shas;
+    *count = cache->header->num_of_objects;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: ORs the objects reachable from a commit into a bitmap, if the commit has a bitmap
+ * @param[IN] commit: The sha of the commit
+ * @param[IN OUT] words: A bitmap over the bitmap ordering, of at least BITMAP_WORDS(count) words
+ * @param[OUT] found: Set to true if the commit has a bitmap
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t bitmap_or(IN const unsigned char * commit, IN OUT unsigned long long * words, OUT bool * found){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    const bitmap_entry_t * entry = NULL;
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    *found = false;
+
+    return_value = bitmap_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    entry = bitmap_find(commit);
+    if(NULL == entry){
+        goto cleanup;
+    }
+
+    return_value = ewah_or(cache->data + entry->offset, entry->num_of_words, words, BITMAP_WORDS(cache->header->num_of_objects));
+    *found = (ERROR_CODE_SUCCESS == return_value);
+    if(ERROR_CODE_INVALID_INPUT == return_value){
+        /* A corrupt bitmap is skipped, the commit is then walked like one without a bitmap */
+        return_value = ERROR_CODE_SUCCESS;
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Collects the commits of the history (a history_walk callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The newest commit that already has a bitmap is the base the new bitmaps build on
+ */
+static error_code_t bitmap_collect_commit(IN const unsigned char * hash, IN void * context, OUT bool * descend){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bitmap_builder_t * builder = context;
+
+    return_value = bitmap_append_sha(&builder->commits, &builder->num_of_commits, &builder->commits_capacity, hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(!builder->has_base && NULL != bitmap_find(hash)){
+        builder->has_base = true;
+        builder->base = builder->num_of_commits - 1;
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Adds an object to the ordering and sets its bit in the current bitmap
+ * @param[IN OUT] builder: The builder
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bitmap_builder_add(IN OUT bitmap_builder_t * builder, IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t position = 0;
+    size_t new_num_of_words = 0;
+    unsigned long long * new_words = NULL;
+
+    return_value = sha_set_add(&builder->ordering, hash, &position);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(position / 64 >= builder->num_of_words){
+        new_num_of_words = max(builder->num_of_words * 2, position / 64 + 1);
+        new_words = realloc(builder->words, new_num_of_words * sizeof(*new_words));
+        if(NULL == new_words){
+            perror("BITMAP_BUILDER_ADD: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        memset(new_words + builder->num_of_words, 0, (new_num_of_words - builder->num_of_words) * sizeof(*new_words));
+        builder->words = new_words;
+        builder->num_of_words = new_num_of_words;
+    }
+
+    builder->words[position / 64] |= 1ULL << (position % 64);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Adds a commit and the blobs it references to the current bitmap
+ * @param[IN OUT] builder: The builder
+ * @param[IN] commit_hash: The sha of the commit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bitmap_builder_add_commit(IN OUT bitmap_builder_t * builder, IN const unsigned char * commit_hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int num_of_parents = 0;
+    size_t size = 0;
+    size_t offset = 0;
+    unsigned char * data = NULL;
+    const unsigned char * parents = NULL;
+    char commit_hex[OBJECT_HEX_LEN + 1] = {0};
+    commit_entry_t entry = {0};
+
+    return_value = read_object(commit_hash, &data, &size);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = commit_parents(data, size, &num_of_parents, &parents);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = bitmap_builder_add(builder, commit_hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+    while(ERROR_CODE_SUCCESS == (return_value = commit_next_entry(data, size, &offset, &entry))){
+        return_value = bitmap_builder_add(builder, entry.sha);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+    if(ERROR_CODE_EOF == return_value){
+        return_value = ERROR_CODE_SUCCESS;
+    }
+
+cleanup:
+    if(ERROR_CODE_NOT_FOUND == return_value || ERROR_CODE_INVALID_INPUT == return_value){
+        sha_to_hex(commit_hash, commit_hex);
+        printf("\e[31mCan't read commit %s.\e[0m\n", commit_hex);
+    }
+    if(NULL != data){
+        free(data);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Adds a bitmap to the builder
+ * @param[IN OUT] builder: The builder
+ * @param[IN] commit: The sha of the commit
+ * @param[IN] compressed: The EWAH compressed bitmap of the commit
+ * @param[IN] num_of_compressed: The number of compressed words
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bitmap_builder_add_entry(IN OUT bitmap_builder_t * builder, IN const unsigned char * commit, IN const unsigned long long * compressed, IN size_t num_of_compressed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t new_capacity = 0;
+    bitmap_entry_t * new_entries = NULL;
+    unsigned long long * new_data = NULL;
+
+    if(builder->num_of_entries == builder->entries_capacity){
+        new_capacity = max(builder->entries_capacity * 2, 16);
+        new_entries = realloc(builder->entries, new_capacity * sizeof(*new_entries));
+        if(NULL == new_entries){
+            perror("BITMAP_BUILDER_ADD_ENTRY: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        builder->entries = new_entries;
+        builder->entries_capacity = new_capacity;
+    }
+
+    if(builder->data_len + num_of_compressed > builder->data_capacity){
+        new_capacity = max(builder->data_capacity * 2, builder->data_len + num_of_compressed);
+        new_data = realloc(builder->data, new_capacity * sizeof(*new_data));
+        if(NULL == new_data){
+            perror("BITMAP_BUILDER_ADD_ENTRY: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        builder->data = new_data;
+        builder->data_capacity = new_capacity;
+    }
+
+    memset(&builder->entries[builder->num_of_entries], 0, sizeof(bitmap_entry_t));
+    memcpy(builder->entries[builder->num_of_entries].sha, commit, SHA_DIGEST_LENGTH);
+    builder->entries[builder->num_of_entries].num_of_words = num_of_compressed;
+    builder->entries[builder->num_of_entries].offset = builder->data_len;
+    builder->num_of_entries++;
+
+    memcpy(builder->data + builder->data_len, compressed, num_of_compressed * sizeof(*compressed));
+    builder->data_len += num_of_compressed;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes a whole buffer to a file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bitmap_write_buffer(IN int fd, IN const void * buffer, IN size_t length){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes_written = 0;
+    size_t offset = 0;
+
+    for(offset=0; offset<length; offset+=bytes_written){
+        bytes_written = write(fd, (const unsigned char *)buffer + offset, length - offset);
+        if(-1 == bytes_written){
+            perror("BITMAP_WRITE_BUFFER: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes the bitmap file from a builder
+ * @param[IN OUT] builder: The builder (its entries are sorted)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The file is written to a lock file which is then renamed over the bitmap file, like the object index
+ */
+static error_code_t bitmap_builder_write(IN OUT bitmap_builder_t * builder){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int lock_fd = -1;
+    size_t i = 0;
+    unsigned int * lookup = NULL;
+    bitmap_lookup_record_t * records = NULL;
+    char lock_name[NAME_MAX] = {0};
+    bitmap_header_t header = {0};
+
+    records = malloc(max(builder->ordering.count, 1) * sizeof(*records));
+    lookup = malloc(max(builder->ordering.count, 1) * sizeof(*lookup));
+    if(NULL == records || NULL == lookup){
+        perror("BITMAP_BUILDER_WRITE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<builder->ordering.count; i++){
+        memcpy(records[i].sha, builder->ordering.shas + i * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        records[i].position = i;
+    }
+    qsort(records, builder->ordering.count, sizeof(*records), bitmap_compare);
+    for(i=0; i<builder->ordering.count; i++){
+        lookup[i] = records[i].position;
+    }
+    qsort(builder->entries, builder->num_of_entries, sizeof(bitmap_entry_t), bitmap_compare);
+
+    header.magic = BITMAP_MAGIC;
+    header.version = BITMAP_VERSION;
+    header.num_of_objects = builder->ordering.count;
+    header.num_of_bitmaps = builder->num_of_entries;
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    snprintf(lock_name, sizeof(lock_name), "%s.lock", bitmap_file_name);
+    lock_fd = openat(dir_fd, lock_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == lock_fd){
+        perror("BITMAP_BUILDER_WRITE: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = bitmap_write_buffer(lock_fd, &header, sizeof(header));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = bitmap_write_buffer(lock_fd, builder->ordering.shas, builder->ordering.count * SHA_DIGEST_LENGTH);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = bitmap_write_buffer(lock_fd, lookup, builder->ordering.count * sizeof(*lookup));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = bitmap_write_buffer(lock_fd, builder->entries, builder->num_of_entries * sizeof(bitmap_entry_t));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = bitmap_write_buffer(lock_fd, builder->data, builder->data_len * sizeof(*builder->data));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = renameat(dir_fd, lock_name, dir_fd, bitmap_file_name);
+    if(-1 == error_check){
+        perror("BITMAP_BUILDER_WRITE: Renameat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_RENAME;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != lock_fd){
+        close(lock_fd);
+    }
+    if(NULL != records){
+        free(records);
+    }
+    if(NULL != lookup){
+        free(lookup);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes the reachability bitmaps of the history of HEAD
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Objects are numbered in the order they first appear when the history is replayed from the
+ *         root commit, so the objects reachable from a commit are mostly a prefix of the ordering and
+ *         compress to a few words. HEAD and every BITMAP_SPACING-th commit (counting from the root) get a
+ *         bitmap. The ordering and the bitmaps of the history are kept, so only the commits newer than
+ *         the newest commit that has a bitmap are read. Slap only writes commits with at most one parent,
+ *         so the running bitmap of the replay is exactly what each commit reaches.
+ */
+error_code_t bitmap_write(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    bool exists = false;
+    bool found = false;
+    size_t i = 0;
+    size_t start = 0;
+    size_t depth = 0;
+    size_t num_of_compressed = 0;
+    const bitmap_entry_t * entry = NULL;
+    unsigned long long * compressed = NULL;
+    unsigned char head[SHA_DIGEST_LENGTH] = {0};
+    bitmap_builder_t builder = {0};
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    TRACE_BEGIN("bitmap_write");
+
+    return_value = bitmap_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = read_head(head, &exists);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(!exists){
+        return_value = object_dir_fd(&dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = unlinkat(dir_fd, bitmap_file_name, 0);
+        if(-1 == error_check && ENOENT != errno){
+            perror("BITMAP_WRITE: Unlinkat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        errno = 0;
+        bitmap_close();
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = history_walk(head, bitmap_collect_commit, &builder);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    /* Keep the old ordering, so the bitmaps that are kept stay valid */
+    if(NULL != cache->header){
+        for(i=0; i<cache->header->num_of_objects; i++){
+            return_value = bitmap_builder_add(&builder, cache->shas + i * SHA_DIGEST_LENGTH);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+        memset(builder.words, 0, builder.num_of_words * sizeof(*builder.words));
+    }
+
+    start = builder.num_of_commits;
+    if(builder.has_base){
+        start = builder.base;
+        return_value = bitmap_or(builder.commits + start * SHA_DIGEST_LENGTH, builder.words, &found);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(!found){
+            start = builder.num_of_commits;
+            memset(builder.words, 0, builder.num_of_words * sizeof(*builder.words));
+        }
+    }
+
+    /* The base keeps its bitmap so the next write can start from it, older commits only at the spacing */
+    for(i=start; i<builder.num_of_commits; i++){
+        depth = builder.num_of_commits - 1 - i;
+        entry = bitmap_find(builder.commits + i * SHA_DIGEST_LENGTH);
+        if(NULL == entry || (i != start && 0 != depth % BITMAP_SPACING)){
+            continue;
+        }
+
+        return_value = bitmap_builder_add_entry(&builder, entry->sha, cache->data + entry->offset, entry->num_of_words);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    for(i=start; i-- > 0;){
+        return_value = bitmap_builder_add_commit(&builder, builder.commits + i * SHA_DIGEST_LENGTH);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        depth = builder.num_of_commits - 1 - i;
+        if(0 != i && 0 != depth % BITMAP_SPACING){
+            continue;
+        }
+
+        return_value = ewah_compress(builder.words, BITMAP_WORDS(builder.ordering.count), &compressed, &num_of_compressed);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        return_value = bitmap_builder_add_entry(&builder, builder.commits + i * SHA_DIGEST_LENGTH, compressed, num_of_compressed);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        free(compressed);
+        compressed = NULL;
+    }
+
+    return_value = bitmap_builder_write(&builder);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    bitmap_close();
+
+cleanup:
+    if(NULL != compressed){
+        free(compressed);
+    }
+    sha_set_free(&builder.ordering);
+    if(NULL != builder.words){
+        free(builder.words);
+    }
+    if(NULL != builder.commits){
+        free(builder.commits);
+    }
+    if(NULL != builder.entries){
+        free(builder.entries);
+    }
+    if(NULL != builder.data){
+        free(builder.data);
+    }
+    TRACE_END("bitmap_write");
+
+    return return_value;
+}
+
+/**
+ * @brief: Unmaps the bitmap file, it is mapped again on its next use
+ */
+void bitmap_close(){
+    bitmap_cache_t * cache = &repository_state()->bitmap;
+
+    bitmap_unmap();
+    cache->loaded = false;
+}
+
+/**
+ * @brief: Records an object as reachable
+ * @param[IN] context: The context of the computation
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Safe to call from the worker threads
+ */
+static error_code_t reachability_add(IN reachability_context_t * context, IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t position = 0;
+
+    return_value = bitmap_position(hash, &position);
+    if(ERROR_CODE_SUCCESS == return_value){
+        __atomic_fetch_or(&context->reachability->words[position / 64], 1ULL << (position % 64), __ATOMIC_RELAXED);
+        goto cleanup;
+    }
+
+    pthread_mutex_lock(&context->lock);
+    return_value = sha_set_add(&context->extra, hash, NULL);
+    pthread_mutex_unlock(&context->lock);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Uses the bitmap of a commit, or collects the commit to be read by the workers (a history_walk callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t reachability_visit(IN const unsigned char * hash, IN void * context, OUT bool * descend){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bool found = false;
+    reachability_context_t * reachability_context = context;
+
+    return_value = bitmap_or(hash, reachability_context->reachability->words, &found);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    if(found){
+        *descend = false;
+        goto cleanup;
+    }
+
+    return_value = bitmap_append_sha(&reachability_context->commits, &reachability_context->num_of_commits,
+                                     &reachability_context->commits_capacity, hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = reachability_add(reachability_context, hash);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Records the blobs of a commit as reachable
+ * @param[IN] context: The context of the computation
+ * @param[IN] commit_hash: The sha of the commit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t reachability_add_commit(IN reachability_context_t * context, IN const unsigned char * commit_hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int num_of_parents = 0;
+    size_t size = 0;
+    size_t offset = 0;
+    unsigned char * data = NULL;
+    const unsigned char * parents = NULL;
+    char commit_hex[OBJECT_HEX_LEN + 1] = {0};
+    commit_entry_t entry = {0};
+
+    return_value = read_object(commit_hash, &data, &size);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = commit_parents(data, size, &num_of_parents, &parents);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+    while(ERROR_CODE_SUCCESS == (return_value = commit_next_entry(data, size, &offset, &entry))){
+        return_value = reachability_add(context, entry.sha);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+    if(ERROR_CODE_EOF == return_value){
+        return_value = ERROR_CODE_SUCCESS;
+    }
+
+cleanup:
+    if(ERROR_CODE_NOT_FOUND == return_value || ERROR_CODE_INVALID_INPUT == return_value){
+        sha_to_hex(commit_hash, commit_hex);
+        printf("\e[31mCan't read commit %s.\e[0m\n", commit_hex);
+    }
+    if(NULL != data){
+        free(data);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Reads the collected commits, BITMAP_BATCH commits at a time, until there are none left
+ * @param[IN] argument: The context of the computation
+ *
+ * @returns: NULL
+ * @notes: This is the body of every thread of the pool (see run_workers). The first failure is kept
+ *         in context->error and stops the other workers.
+ */
+static void * reachability_worker(IN void * argument){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    reachability_context_t * context = argument;
+    size_t start = 0;
+    size_t i = 0;
+
+    while(ERROR_CODE_SUCCESS == __atomic_load_n(&context->error, __ATOMIC_RELAXED)){
+        start = __atomic_fetch_add(&context->next, BITMAP_BATCH, __ATOMIC_RELAXED);
+        if(start >= context->num_of_commits){
+            break;
+        }
+
+        for(i=start; i<min(start + BITMAP_BATCH, context->num_of_commits); i++){
+            return_value = reachability_add_commit(context, context->commits + i * SHA_DIGEST_LENGTH);
+            if(ERROR_CODE_SUCCESS != return_value){
+                __atomic_store_n(&context->error, return_value, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief: Computes the objects reachable from a commit (the commits of its history and their blobs)
+ * @param[IN] commit: The sha of the commit
+ * @param[OUT] reachability: The reachable objects (to be freed with reachability_free)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The history is walked until a commit that has a bitmap, whose bitmap is ORed in instead of
+ *         walking further. The commits before it are read on a pool of threads, and the objects that
+ *         aren't in the bitmap ordering are kept as a sorted list of shas. The result refers to the
+ *         bitmap ordering, so it is valid until the bitmaps are written or closed.
+ */
+error_code_t reachability_compute(IN const unsigned char * commit, OUT reachability_t * reachability){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    reachability_context_t context = {0};
+
+    memset(reachability, 0, sizeof(*reachability));
+    context.reachability = reachability;
+    context.error = ERROR_CODE_SUCCESS;
+    pthread_mutex_init(&context.lock, NULL);
+
+    TRACE_BEGIN("reachability");
+
+    return_value = bitmap_ordering(&reachability->ordering, &reachability->num_of_objects);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    reachability->words = calloc(BITMAP_WORDS(reachability->num_of_objects) + 1, sizeof(*reachability->words));
+    if(NULL == reachability->words){
+        perror("REACHABILITY_COMPUTE: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    return_value = history_walk(commit, reachability_visit, &context);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    run_workers(reachability_worker, &context, context.num_of_commits, BITMAP_BATCH);
+    return_value = context.error;
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    qsort(context.extra.shas, context.extra.count, SHA_DIGEST_LENGTH, bitmap_compare);
+    reachability->extra = context.extra.shas;
+    reachability->num_of_extra = context.extra.count;
+    reachability->extra_capacity = context.extra.capacity;
+    context.extra.shas = NULL;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        reachability_free(reachability);
+    }
+    sha_set_free(&context.extra);
+    if(NULL != context.commits){
+        free(context.commits);
+    }
+    pthread_mutex_destroy(&context.lock);
+    TRACE_END("reachability");
+
+    return return_value;
+}
+
+/**
+ * @brief: Removes the objects that are reachable from another commit
+ * @param[IN OUT] reachability: The objects to remove from
+ * @param[IN] other: The objects to remove (computed with the same bitmaps)
+ */
+void reachability_andnot(IN OUT reachability_t * reachability, IN const reachability_t * other){
+    size_t i = 0;
+    size_t count = 0;
+
+    for(i=0; i<BITMAP_WORDS(reachability->num_of_objects); i++){
+        reachability->words[i] &= ~other->words[i];
+    }
+
+    for(i=0; i<reachability->num_of_extra; i++){
+        if(NULL != bsearch(reachability->extra + i * SHA_DIGEST_LENGTH, other->extra, other->num_of_extra, SHA_DIGEST_LENGTH, bitmap_compare)){
+            continue;
+        }
+        memmove(reachability->extra + count * SHA_DIGEST_LENGTH, reachability->extra + i * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        count++;
+    }
+    reachability->num_of_extra = count;
+}
+
+/**
+ * @brief: Counts the reachable objects
+ *
+ * @returns: The number of objects
+ */
+size_t reachability_count(IN const reachability_t * reachability){
+    size_t i = 0;
+    size_t count = reachability->num_of_extra;
+
+    for(i=0; i<BITMAP_WORDS(reachability->num_of_objects); i++){
+        count += __builtin_popcountll(reachability->words[i]);
+    }
+
+    return count;
+}
+
+/**
+ * @brief: Calls a callback for every reachable object
+ * @param[IN] reachability: The reachable objects
+ * @param[IN] callback: Called with the sha of every object
+ * @param[IN] context: Passed to the callback
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else the first error the callback returned
+ */
+error_code_t reachability_for_each(IN const reachability_t * reachability, IN sha_callback_t callback, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    unsigned long long word = 0;
+
+    for(i=0; i<BITMAP_WORDS(reachability->num_of_objects); i++){
+        for(word=reachability->words[i]; 0 != word; word&=word - 1){
+            return_value = callback(reachability->ordering + (i * 64 + __builtin_ctzll(word)) * SHA_DIGEST_LENGTH, context);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+    }
+
+    for(i=0; i<reachability->num_of_extra; i++){
+        return_value = callback(reachability->extra + i * SHA_DIGEST_LENGTH, context);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Frees the reachable objects
+ */
+void reachability_free(IN reachability_t * reachability){
+    if(NULL != reachability->words){
+        free(reachability->words);
+    }
+    if(NULL != reachability->extra){
+        free(reachability->extra);
+    }
+    memset(reachability, 0, sizeof(*reachability));
+}
+
+/**
+ * @brief: Prints the sha of an object (a reachability_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS
+ */
+static error_code_t bitmap_print_sha(IN const unsigned char * hash, IN void * context){
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+
+    sha_to_hex(hash, hex);
+    printf("%s\n", hex);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Runs the bitmap command
+ * @param[IN] argc: The number of arguments (after bitmap)
+ * @param[IN] argv: The arguments: write | count <commit> [<base>] | list <commit> [<base>]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: count and list report the objects reachable from commit and not from base
+ */
+error_code_t bitmap_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t count = 0;
+    const unsigned char * ordering = NULL;
+    unsigned char commit[SHA_DIGEST_LENGTH] = {0};
+    unsigned char base[SHA_DIGEST_LENGTH] = {0};
+    reachability_t reachability = {0};
+    reachability_t base_reachability = {0};
+
+    if(1 == argc && 0 == valid_strncmp(argv[0], "write")){
+        return_value = bitmap_write();
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        return_value = bitmap_ordering(&ordering, &count);
+        if(ERROR_CODE_SUCCESS == return_value){
+            printf("Bitmaps cover %zu objects.\n", count);
+        }
+        goto cleanup;
+    }
+
+    if((2 != argc && 3 != argc) || (0 != valid_strncmp(argv[0], "count") && 0 != valid_strncmp(argv[0], "list"))){
+        printf("USAGE: bitmap: write | count <commit> [<base>] | list <commit> [<base>]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    return_value = resolve_commit(argv[1], commit);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    if(3 == argc){
+        return_value = resolve_commit(argv[2], base);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = reachability_compute(commit, &reachability);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(3 == argc){
+        return_value = reachability_compute(base, &base_reachability);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        reachability_andnot(&reachability, &base_reachability);
+    }
+
+    if(0 == valid_strncmp(argv[0], "count")){
+        printf("%zu objects\n", reachability_count(&reachability));
+        return_value = ERROR_CODE_SUCCESS;
+    }
+    else{
+        return_value = reachability_for_each(&reachability, bitmap_print_sha, NULL);
+    }
+
+cleanup:
+    reachability_free(&reachability);
+    reachability_free(&base_reachability);
+
+    return return_value;
+}
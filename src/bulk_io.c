@@ -0,0 +1,690 @@
+#include "slap_commands.h"
+
+typedef enum bulk_state_e{
+    BULK_STATE_IDLE = 0,
+    BULK_STATE_OPEN_SRC,
+    BULK_STATE_OPEN_DST,
+    BULK_STATE_READ,
+    BULK_STATE_WRITE,
+    BULK_STATE_FSYNC_DST,
+    BULK_STATE_CLOSE_SRC,
+    BULK_STATE_CLOSE_DST
+}bulk_state_t;
+
+typedef struct bulk_slot_s{
+    bulk_state_t state;
+    bulk_job_t * job;
+    int src_fd;
+    int dst_fd;
+    off_t offset;
+    unsigned int length;
+    unsigned int written;
+    char * buffer;
+    SHA_CTX sha_struct;
+}bulk_slot_t;
+
+/**
+ * @brief: Gets the I/O backend to use for bulk operations
+ *
+ * @returns: The I/O backend
+ * @notes: The SLAP_IO environment variable overrides the core.io setting. Both accept sync (the default)
+ *         and uring. If io_uring turns out to be unavailable the synchronous backend is used anyway.
+ */
+io_backend_t get_io_backend(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char value[CONFIG_LINE_MAX] = {0};
+    char * environment_value = NULL;
+    io_backend_cache_t * cache = &repository_state()->io_backend;
+
+    if(cache->loaded){
+        goto cleanup;
+    }
+    cache->loaded = true;
+
+    environment_value = getenv("SLAP_IO");
+    if(NULL != environment_value){
+        snprintf(value, sizeof(value), "%s", environment_value);
+    }
+    else{
+        return_value = config_get("core.io", value, sizeof(value));
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    if(0 == valid_strncmp(value, "uring")){
+        cache->backend = IO_BACKEND_URING;
+    }
+    else if(0 != valid_strncmp(value, "sync")){
+        printf("\e[38;2;255;150;0mUnknown I/O backend %s, using sync.\e[0m\n", value);
+    }
+
+cleanup:
+    return cache->backend;
+}
+
+/**
+ * @brief: Forgets the I/O backend, so core.io is read again on its next use
+ */
+void reset_io_backend(){
+    io_backend_cache_t * cache = &repository_state()->io_backend;
+
+    cache->loaded = false;
+    cache->backend = IO_BACKEND_SYNC;
+}
+
+/**
+ * @brief: Runs bulk jobs one after another with blocking system calls
+ * @param[IN] jobs: The jobs
+ * @param[IN] num_of_jobs: The number of jobs
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bulk_run_sync(IN bulk_job_t * jobs, IN int num_of_jobs){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int i = 0;
+    int src_fd = -1;
+    int dst_fd = -1;
+    ssize_t bytes_read = 0;
+    ssize_t bytes_written = 0;
+    ssize_t offset = 0;
+    char * buffer = NULL;
+    SHA_CTX sha_struct = {0};
+
+    buffer = malloc(BULK_IO_BUFFER_SIZE);
+    if(NULL == buffer){
+        perror("BULK_RUN_SYNC: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_jobs; i++){
+        jobs[i].skipped = false;
+        jobs[i].missing = false;
+        jobs[i].size = 0;
+
+        src_fd = openat(jobs[i].src_dir_fd, jobs[i].src_name, O_RDONLY | O_CLOEXEC);
+        if(-1 == src_fd && ENOENT == errno && jobs[i].allow_missing){
+            errno = 0;
+            jobs[i].missing = true;
+            continue;
+        }
+        else if(-1 == src_fd){
+            perror("BULK_RUN_SYNC: Openat error");
+            printf("(Errno: %i) (%s)\n", errno, jobs[i].src_name);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+        TRACE_COUNT_OPEN();
+
+        if(NULL != jobs[i].dst_name){
+            dst_fd = openat(jobs[i].dst_dir_fd, jobs[i].dst_name, jobs[i].dst_flags | O_CLOEXEC, jobs[i].dst_mode);
+            if(-1 == dst_fd && EEXIST == errno && (jobs[i].dst_flags & O_EXCL)){
+                errno = 0;
+                jobs[i].skipped = true;
+            }
+            else if(-1 == dst_fd){
+                perror("BULK_RUN_SYNC: Openat error");
+                printf("(Errno: %i) (%s)\n", errno, jobs[i].dst_name);
+                return_value = ERROR_CODE_COULDNT_OPEN;
+                goto cleanup;
+            }
+            else{
+                TRACE_COUNT_OPEN();
+            }
+        }
+
+        if(NULL != jobs[i].hash){
+            PROBE1(hash__start, jobs[i].src_name);
+            SHA1_Init(&sha_struct);
+        }
+
+        while(NULL != jobs[i].hash || -1 != dst_fd){
+            bytes_read = read(src_fd, buffer, BULK_IO_BUFFER_SIZE);
+            if(-1 == bytes_read){
+                perror("BULK_RUN_SYNC: Read error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_READ;
+                goto cleanup;
+            }
+            TRACE_COUNT_READ(bytes_read);
+            if(0 == bytes_read){
+                break;
+            }
+            jobs[i].size += bytes_read;
+
+            if(NULL != jobs[i].hash){
+                SHA1_Update(&sha_struct, buffer, bytes_read);
+                TRACE_COUNT_HASHED(bytes_read);
+            }
+
+            for(offset=0; -1 != dst_fd && offset<bytes_read; offset+=bytes_written){
+                bytes_written = write(dst_fd, buffer + offset, bytes_read - offset);
+                if(-1 == bytes_written){
+                    perror("BULK_RUN_SYNC: Write error");
+                    printf("(Errno: %i)\n", errno);
+                    return_value = ERROR_CODE_COULDNT_WRITE;
+                    goto cleanup;
+                }
+                TRACE_COUNT_WRITE(bytes_written);
+            }
+        }
+
+        if(NULL != jobs[i].hash){
+            SHA1_Final(jobs[i].hash, &sha_struct);
+            PROBE3(hash__done, jobs[i].src_name, jobs[i].size, jobs[i].hash);
+        }
+
+        if(-1 != dst_fd && jobs[i].sync_dst){
+            error_check = fsync(dst_fd);
+            if(-1 == error_check){
+                perror("BULK_RUN_SYNC: Fsync error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_WRITE;
+                goto cleanup;
+            }
+            TRACE_COUNT_SYNC();
+        }
+
+        close(src_fd);
+        src_fd = -1;
+        TRACE_COUNT_CLOSE();
+        if(-1 != dst_fd){
+            close(dst_fd);
+            dst_fd = -1;
+            TRACE_COUNT_CLOSE();
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != src_fd){
+        close(src_fd);
+    }
+    if(-1 != dst_fd){
+        close(dst_fd);
+    }
+    if(NULL != buffer){
+        free(buffer);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Queues the next operation of a slot according to its state
+ * @param[IN] ring: The ring
+ * @param[IN] slot: The slot
+ * @param[IN] slot_index: The index of the slot (also the index of its registered buffer)
+ */
+static void bulk_queue(IN uring_t * ring, IN bulk_slot_t * slot, IN int slot_index){
+    struct io_uring_sqe * sqe = NULL;
+
+    /* Each slot has at most one operation in flight and the ring has an entry per slot */
+    sqe = uring_get_sqe(ring);
+    sqe->user_data = slot_index;
+
+    switch(slot->state){
+    case BULK_STATE_OPEN_SRC:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = slot->job->src_dir_fd;
+        sqe->addr = (unsigned long)slot->job->src_name;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        break;
+
+    case BULK_STATE_OPEN_DST:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = slot->job->dst_dir_fd;
+        sqe->addr = (unsigned long)slot->job->dst_name;
+        sqe->len = slot->job->dst_mode;
+        sqe->open_flags = slot->job->dst_flags | O_CLOEXEC;
+        break;
+
+    case BULK_STATE_READ:
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = slot->src_fd;
+        sqe->addr = (unsigned long)slot->buffer;
+        sqe->len = BULK_IO_BUFFER_SIZE;
+        sqe->off = slot->offset;
+        sqe->buf_index = slot_index;
+        break;
+
+    case BULK_STATE_WRITE:
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = slot->dst_fd;
+        sqe->addr = (unsigned long)(slot->buffer + slot->written);
+        sqe->len = slot->length - slot->written;
+        sqe->off = slot->offset - slot->length + slot->written;
+        sqe->buf_index = slot_index;
+        break;
+
+    case BULK_STATE_FSYNC_DST:
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = slot->dst_fd;
+        break;
+
+    case BULK_STATE_CLOSE_SRC:
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot->src_fd;
+        break;
+
+    case BULK_STATE_CLOSE_DST:
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot->dst_fd;
+        break;
+
+    default:
+        sqe->opcode = IORING_OP_NOP;
+        break;
+    }
+}
+
+/**
+ * @brief: Moves a slot to its next state after one of its operations completed
+ * @param[IN] slot: The slot
+ * @param[IN] result: The result of the completed operation
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: When the job is done the slot goes back to BULK_STATE_IDLE
+ */
+static error_code_t bulk_advance(IN bulk_slot_t * slot, IN int result){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(BULK_STATE_OPEN_SRC == slot->state && -ENOENT == result && slot->job->allow_missing){
+        slot->job->missing = true;
+        slot->state = BULK_STATE_IDLE;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    if(result < 0 && !(BULK_STATE_OPEN_DST == slot->state && -EEXIST == result && (slot->job->dst_flags & O_EXCL))){
+        errno = -result;
+        perror("BULK_ADVANCE: Io_uring error");
+        printf("(Errno: %i) (%s)\n", errno, slot->job->src_name);
+        return_value = (BULK_STATE_OPEN_SRC == slot->state || BULK_STATE_OPEN_DST == slot->state) ? ERROR_CODE_COULDNT_OPEN : ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    switch(slot->state){
+    case BULK_STATE_OPEN_SRC:
+        TRACE_COUNT_OPEN();
+        slot->src_fd = result;
+        slot->state = (NULL != slot->job->dst_name) ? BULK_STATE_OPEN_DST : BULK_STATE_READ;
+        if(BULK_STATE_READ == slot->state && NULL == slot->job->hash){
+            slot->state = BULK_STATE_CLOSE_SRC;
+        }
+        break;
+
+    case BULK_STATE_OPEN_DST:
+        if(result < 0){
+            slot->job->skipped = true;
+            slot->state = (NULL != slot->job->hash) ? BULK_STATE_READ : BULK_STATE_CLOSE_SRC;
+            break;
+        }
+        TRACE_COUNT_OPEN();
+        slot->dst_fd = result;
+        slot->state = BULK_STATE_READ;
+        break;
+
+    case BULK_STATE_READ:
+        TRACE_COUNT_READ(result);
+        if(0 == result){
+            slot->job->size = slot->offset;
+            if(NULL != slot->job->hash){
+                SHA1_Final(slot->job->hash, &slot->sha_struct);
+                PROBE3(hash__done, slot->job->src_name, slot->job->size, slot->job->hash);
+            }
+            slot->state = (-1 != slot->dst_fd && slot->job->sync_dst) ? BULK_STATE_FSYNC_DST : BULK_STATE_CLOSE_SRC;
+            break;
+        }
+
+        if(NULL != slot->job->hash){
+            SHA1_Update(&slot->sha_struct, slot->buffer, result);
+            TRACE_COUNT_HASHED(result);
+        }
+        slot->offset += result;
+        slot->length = result;
+        slot->written = 0;
+        slot->state = (-1 != slot->dst_fd) ? BULK_STATE_WRITE : BULK_STATE_READ;
+        break;
+
+    case BULK_STATE_WRITE:
+        TRACE_COUNT_WRITE(result);
+        slot->written += result;
+        if(slot->written == slot->length){
+            slot->state = BULK_STATE_READ;
+        }
+        break;
+
+    case BULK_STATE_FSYNC_DST:
+        TRACE_COUNT_SYNC();
+        slot->state = BULK_STATE_CLOSE_SRC;
+        break;
+
+    case BULK_STATE_CLOSE_SRC:
+        TRACE_COUNT_CLOSE();
+        slot->src_fd = -1;
+        slot->state = (-1 != slot->dst_fd) ? BULK_STATE_CLOSE_DST : BULK_STATE_IDLE;
+        break;
+
+    case BULK_STATE_CLOSE_DST:
+        TRACE_COUNT_CLOSE();
+        slot->dst_fd = -1;
+        slot->state = BULK_STATE_IDLE;
+        break;
+
+    default:
+        break;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs bulk jobs with io_uring, keeping BULK_IO_SLOTS files in flight
+ * @param[IN] ring: A ring with BULK_IO_SLOTS registered buffers
+ * @param[IN] buffers: The registered buffers (BULK_IO_SLOTS * BULK_IO_BUFFER_SIZE bytes)
+ * @param[IN] jobs: The jobs
+ * @param[IN] num_of_jobs: The number of jobs
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: After a failure no new jobs are started, and the file descriptors of the jobs in flight are closed
+ */
+static error_code_t bulk_run_uring(IN uring_t * ring, IN char * buffers, IN bulk_job_t * jobs, IN int num_of_jobs){
+    error_code_t return_value = ERROR_CODE_SUCCESS;
+    error_code_t slot_result = ERROR_CODE_UNINITIALIZED;
+    int next_job = 0;
+    int active = 0;
+    int i = 0;
+    bulk_slot_t slots[BULK_IO_SLOTS] = {0};
+    bulk_slot_t * slot = NULL;
+    struct io_uring_cqe cqe = {0};
+
+    for(i=0; i<BULK_IO_SLOTS; i++){
+        slots[i].state = BULK_STATE_IDLE;
+        slots[i].src_fd = -1;
+        slots[i].dst_fd = -1;
+        slots[i].buffer = buffers + (size_t)i * BULK_IO_BUFFER_SIZE;
+    }
+
+    while(active > 0 || (ERROR_CODE_SUCCESS == return_value && next_job < num_of_jobs)){
+        for(i=0; i<BULK_IO_SLOTS && ERROR_CODE_SUCCESS == return_value && next_job < num_of_jobs; i++){
+            if(BULK_STATE_IDLE != slots[i].state){
+                continue;
+            }
+
+            slots[i].job = &jobs[next_job++];
+            slots[i].job->skipped = false;
+            slots[i].job->missing = false;
+            slots[i].job->size = 0;
+            slots[i].offset = 0;
+            slots[i].state = BULK_STATE_OPEN_SRC;
+            if(NULL != slots[i].job->hash){
+                PROBE1(hash__start, slots[i].job->src_name);
+                SHA1_Init(&slots[i].sha_struct);
+            }
+            bulk_queue(ring, &slots[i], i);
+            active++;
+        }
+
+        slot_result = uring_submit_and_wait(ring, 1);
+        if(ERROR_CODE_SUCCESS != slot_result){
+            return_value = slot_result;
+            goto cleanup;
+        }
+
+        while(uring_next_cqe(ring, &cqe)){
+            slot = &slots[cqe.user_data];
+
+            slot_result = bulk_advance(slot, cqe.res);
+            if(ERROR_CODE_SUCCESS != slot_result){
+                return_value = slot_result;
+                slot->state = BULK_STATE_IDLE;
+            }
+            else if(ERROR_CODE_SUCCESS != return_value && BULK_STATE_IDLE != slot->state){
+                /* Abandon the job, the descriptors are closed synchronously below */
+                slot->state = BULK_STATE_IDLE;
+            }
+
+            if(BULK_STATE_IDLE == slot->state){
+                if(-1 != slot->src_fd){
+                    close(slot->src_fd);
+                    slot->src_fd = -1;
+                    TRACE_COUNT_CLOSE();
+                }
+                if(-1 != slot->dst_fd){
+                    close(slot->dst_fd);
+                    slot->dst_fd = -1;
+                    TRACE_COUNT_CLOSE();
+                }
+                active--;
+            }
+            else{
+                bulk_queue(ring, slot, cqe.user_data);
+            }
+        }
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs many file jobs (hashing a file, copying it, or both)
+ * @param[IN] jobs: The jobs. Each job opens src_name relative to src_dir_fd, hashes it into hash (if not NULL),
+ *                  and copies it to dst_name relative to dst_dir_fd (if not NULL)
+ * @param[IN] num_of_jobs: The number of jobs
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: If the destination is opened with O_EXCL and already exists, the job is marked as skipped
+ *         instead of failing. Likewise a job with allow_missing whose source doesn't exist is marked as
+ *         missing. With the uring backend many files are in flight at once and reads and writes go
+ *         through registered buffers; if io_uring is unavailable the synchronous backend is used.
+ */
+error_code_t bulk_run(IN bulk_job_t * jobs, IN int num_of_jobs){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    bool ring_ready = false;
+    char * buffers = NULL;
+    struct iovec iovecs[BULK_IO_SLOTS] = {0};
+    uring_t ring = {0};
+
+    ring.ring_fd = -1;
+
+    if(IO_BACKEND_URING != get_io_backend() || num_of_jobs <= 1){
+        return_value = bulk_run_sync(jobs, num_of_jobs);
+        goto cleanup;
+    }
+
+    return_value = uring_init(&ring, BULK_IO_SLOTS * 2);
+    if(ERROR_CODE_SUCCESS == return_value){
+        buffers = aligned_alloc(4096, (size_t)BULK_IO_SLOTS * BULK_IO_BUFFER_SIZE);
+        if(NULL == buffers){
+            perror("BULK_RUN: Aligned_alloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        for(i=0; i<BULK_IO_SLOTS; i++){
+            iovecs[i].iov_base = buffers + (size_t)i * BULK_IO_BUFFER_SIZE;
+            iovecs[i].iov_len = BULK_IO_BUFFER_SIZE;
+        }
+
+        return_value = uring_register_buffers(&ring, iovecs, BULK_IO_SLOTS);
+        ring_ready = (ERROR_CODE_SUCCESS == return_value);
+    }
+
+    if(!ring_ready){
+        return_value = bulk_run_sync(jobs, num_of_jobs);
+        goto cleanup;
+    }
+
+    return_value = bulk_run_uring(&ring, buffers, jobs, num_of_jobs);
+
+cleanup:
+    uring_close(&ring);
+    if(NULL != buffers){
+        free(buffers);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Hashes many files
+ * @param[IN] paths: The paths of the files
+ * @param[IN] num_of_paths: The number of paths
+ * @param[IN] allow_missing: Whether files that don't exist are allowed
+ * @param[OUT] hashes: The hashes (num_of_paths * SHA_DIGEST_LENGTH bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The hash of a file that doesn't exist (if allowed) is all zeros
+ */
+error_code_t bulk_hash_files(IN char ** paths, IN int num_of_paths, IN bool allow_missing, OUT unsigned char * hashes){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    bulk_job_t * jobs = NULL;
+
+    if(0 == num_of_paths){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    jobs = calloc(num_of_paths, sizeof(*jobs));
+    if(NULL == jobs){
+        perror("BULK_HASH_FILES: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_paths; i++){
+        jobs[i].src_dir_fd = work_tree_fd();
+        jobs[i].src_name = paths[i];
+        jobs[i].hash = hashes + (size_t)i * SHA_DIGEST_LENGTH;
+        jobs[i].allow_missing = allow_missing;
+    }
+
+    return_value = bulk_run(jobs, num_of_paths);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_paths; i++){
+        if(jobs[i].missing){
+            memset(jobs[i].hash, 0, SHA_DIGEST_LENGTH);
+        }
+    }
+
+cleanup:
+    if(NULL != jobs){
+        free(jobs);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Hashes many files and writes the blobs of the ones that aren't in the repository yet
+ * @param[IN] paths: The paths of the files
+ * @param[IN] num_of_paths: The number of paths
+ * @param[OUT] hashes: The hashes (num_of_paths * SHA_DIGEST_LENGTH bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The new objects are handed to sync_new_object and object_index_add, so they become durable
+ *         and indexed by the next sync_objects. In full durability mode each blob is fsynced as it is written.
+ */
+error_code_t bulk_write_objects(IN char ** paths, IN int num_of_paths, OUT unsigned char * hashes){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int num_of_jobs = 0;
+    bool blob_exists = false;
+    int * sources = NULL;
+    bulk_job_t * jobs = NULL;
+
+    TRACE_BEGIN("hash_files");
+    return_value = bulk_hash_files(paths, num_of_paths, false, hashes);
+    TRACE_END("hash_files");
+    if(ERROR_CODE_SUCCESS != return_value || 0 == num_of_paths){
+        goto cleanup;
+    }
+
+    jobs = calloc(num_of_paths, sizeof(*jobs));
+    sources = calloc(num_of_paths, sizeof(*sources));
+    if(NULL == jobs || NULL == sources){
+        perror("BULK_WRITE_OBJECTS: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_paths; i++){
+        return_value = object_index_contains(hashes + (size_t)i * SHA_DIGEST_LENGTH, &blob_exists);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(blob_exists){
+            continue;
+        }
+
+        return_value = object_fanout_fd(hashes[(size_t)i * SHA_DIGEST_LENGTH], true, &jobs[num_of_jobs].dst_dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        object_name(hashes + (size_t)i * SHA_DIGEST_LENGTH, jobs[num_of_jobs].name_buffer);
+        jobs[num_of_jobs].src_dir_fd = work_tree_fd();
+        jobs[num_of_jobs].src_name = paths[i];
+        jobs[num_of_jobs].dst_name = jobs[num_of_jobs].name_buffer;
+        jobs[num_of_jobs].dst_flags = O_WRONLY | O_CREAT | O_EXCL;
+        jobs[num_of_jobs].dst_mode = OBJECT_FILE_MODE;
+        jobs[num_of_jobs].sync_dst = (FSYNC_MODE_FULL == get_fsync_mode());
+        jobs[num_of_jobs].hash = NULL;
+        sources[num_of_jobs] = i;
+        num_of_jobs++;
+
+        /* Identical files in the same batch only need one blob */
+        return_value = object_index_add(hashes + (size_t)i * SHA_DIGEST_LENGTH);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    TRACE_BEGIN("copy_blobs");
+    return_value = bulk_run(jobs, num_of_jobs);
+    TRACE_END("copy_blobs");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_jobs; i++){
+        if(jobs[i].skipped){
+            continue;
+        }
+        PROBE3(object__create, jobs[i].src_name, jobs[i].size, hashes + (size_t)sources[i] * SHA_DIGEST_LENGTH);
+
+        return_value = sync_new_object(-1, hashes + (size_t)sources[i] * SHA_DIGEST_LENGTH);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != jobs){
+        free(jobs);
+    }
+    if(NULL != sources){
+        free(sources);
+    }
+
+    return return_value;
+}
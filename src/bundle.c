@@ -0,0 +1,753 @@
+#include "slap_commands.h"
+
+/**
+ * @brief: Writes everything buffered in a bundle stream
+ * @param[IN OUT] stream: The stream
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bundle_flush(IN OUT bundle_stream_t * stream){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes_written = 0;
+
+    while(stream->start < stream->end){
+        bytes_written = write(stream->fd, stream->buffer + stream->start, stream->end - stream->start);
+        if(-1 == bytes_written && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes_written){
+            perror("BUNDLE_FLUSH: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        stream->start += bytes_written;
+    }
+
+    stream->start = 0;
+    stream->end = 0;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes to a bundle stream through its buffer
+ * @param[IN OUT] stream: The stream
+ * @param[IN] data: The data
+ * @param[IN] length: The length of the data
+ * @param[IN] checksummed: If the data is covered by the checksum of the bundle
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t bundle_write(IN OUT bundle_stream_t * stream, IN const void * data, IN size_t length, IN bool checksummed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t chunk = 0;
+
+    if(checksummed){
+        SHA1_Update(&stream->checksum, data, length);
+    }
+    stream->bytes += length;
+
+    while(length > 0){
+        if(BUNDLE_BUFFER_SIZE == stream->end){
+            return_value = bundle_flush(stream);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+
+        chunk = min(length, BUNDLE_BUFFER_SIZE - stream->end);
+        memcpy(stream->buffer + stream->end, data, chunk);
+        stream->end += chunk;
+        data = (const char *)data + chunk;
+        length -= chunk;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Reads exactly length bytes from a bundle stream
+ * @param[IN OUT] stream: The stream
+ * @param[OUT] data: The buffer to read into
+ * @param[IN] length: The number of bytes to read
+ * @param[IN] checksummed: If the data is covered by the checksum of the bundle
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_INVALID_INPUT if the bundle ends first,
+ *           else an indicative error code
+ * @notes: Reads that are larger than the buffer go straight into data
+ */
+static error_code_t bundle_read(IN OUT bundle_stream_t * stream, OUT void * data, IN size_t length, IN bool checksummed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t chunk = 0;
+    ssize_t bytes_read = 0;
+    unsigned char * position = data;
+
+    while(length > 0){
+        if(stream->start < stream->end){
+            chunk = min(length, stream->end - stream->start);
+            memcpy(position, stream->buffer + stream->start, chunk);
+            stream->start += chunk;
+        }
+        else{
+            if(length >= BUNDLE_BUFFER_SIZE){
+                bytes_read = read(stream->fd, position, length);
+            }
+            else{
+                bytes_read = read(stream->fd, stream->buffer, BUNDLE_BUFFER_SIZE);
+            }
+            if(-1 == bytes_read && EINTR == errno){
+                continue;
+            }
+            if(-1 == bytes_read){
+                perror("BUNDLE_READ: Read error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_READ;
+                goto cleanup;
+            }
+            if(0 == bytes_read){
+                printf("\e[31mThe bundle is truncated.\e[0m\n");
+                return_value = ERROR_CODE_INVALID_INPUT;
+                goto cleanup;
+            }
+
+            if(length >= BUNDLE_BUFFER_SIZE){
+                chunk = bytes_read;
+            }
+            else{
+                stream->start = 0;
+                stream->end = bytes_read;
+                continue;
+            }
+        }
+
+        if(checksummed){
+            SHA1_Update(&stream->checksum, position, chunk);
+        }
+        stream->bytes += chunk;
+        position += chunk;
+        length -= chunk;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes an object to a bundle (a reachability_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The contents are read straight into the buffer of the stream
+ */
+static error_code_t bundle_write_object(IN const unsigned char * hash, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    unsigned long long size = 0;
+    unsigned long long offset = 0;
+    ssize_t bytes_read = 0;
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    struct stat statbuf = {0};
+    bundle_stream_t * stream = context;
+
+    return_value = open_object(hash, O_RDONLY, 0, &fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        sha_to_hex(hash, hex);
+        printf("\e[31mObject %s is missing, run slap fsck.\e[0m\n", hex);
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("BUNDLE_WRITE_OBJECT: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+    size = statbuf.st_size;
+
+    return_value = bundle_write(stream, hash, SHA_DIGEST_LENGTH, true);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = bundle_write(stream, &size, sizeof(size), true);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(offset=0; offset<size; offset+=bytes_read){
+        if(BUNDLE_BUFFER_SIZE == stream->end){
+            return_value = bundle_flush(stream);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+
+        bytes_read = pread(fd, stream->buffer + stream->end, min(size - offset, BUNDLE_BUFFER_SIZE - stream->end), offset);
+        if(-1 == bytes_read){
+            perror("BUNDLE_WRITE_OBJECT: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            sha_to_hex(hash, hex);
+            printf("\e[31mObject %s shrank while it was bundled.\e[0m\n", hex);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        stream->end += bytes_read;
+        stream->bytes += bytes_read;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes a bundle of every object reachable from HEAD, and HEAD itself
+ * @param[IN] path: The path of the bundle, or - for the standard output
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects are found with reachability_compute, so the history is only walked back to the newest
+ *         commit that has a bitmap. Everything goes through one BUNDLE_BUFFER_SIZE buffer.
+ */
+error_code_t bundle_create(IN const char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bool exists = false;
+    bool to_stdout = false;
+    unsigned int name_len = 0;
+    unsigned char head[SHA_DIGEST_LENGTH] = {0};
+    unsigned char checksum[SHA_DIGEST_LENGTH] = {0};
+    bundle_header_t header = {0};
+    bundle_stream_t stream = {0};
+    reachability_t reachability = {0};
+
+    stream.fd = -1;
+    to_stdout = (0 == strcmp(path, "-"));
+
+    /* The bundle owns the standard output, everything printed goes to the standard error */
+    if(to_stdout){
+        return_value = redirect_stdout(&stream.fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = read_head(head, &exists);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    if(!exists){
+        printf("\e[31mNothing was committed yet.\e[0m\n");
+        return_value = ERROR_CODE_NOT_FOUND;
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("reachability");
+    return_value = reachability_compute(head, &reachability);
+    TRACE_END("reachability");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    stream.buffer = malloc(BUNDLE_BUFFER_SIZE);
+    if(NULL == stream.buffer){
+        perror("BUNDLE_CREATE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    SHA1_Init(&stream.checksum);
+
+    if(!to_stdout){
+        stream.fd = openat(work_tree_fd(), path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if(-1 == stream.fd){
+            perror("BUNDLE_CREATE: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+    }
+
+    header.magic = BUNDLE_MAGIC;
+    header.version = BUNDLE_VERSION;
+    header.num_of_refs = 1;
+    header.num_of_objects = reachability_count(&reachability);
+
+    return_value = bundle_write(&stream, &header, sizeof(header), true);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    name_len = strlen("HEAD");
+    return_value = bundle_write(&stream, head, SHA_DIGEST_LENGTH, true);
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = bundle_write(&stream, &name_len, sizeof(name_len), true);
+    }
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = bundle_write(&stream, "HEAD", name_len, true);
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("write_objects");
+    return_value = reachability_for_each(&reachability, bundle_write_object, &stream);
+    TRACE_END("write_objects");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    SHA1_Final(checksum, &stream.checksum);
+    return_value = bundle_write(&stream, checksum, SHA_DIGEST_LENGTH, false);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = bundle_flush(&stream);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(!to_stdout){
+        return_value = sync_file(stream.fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+    printf("Bundled %llu objects (%llu bytes).\n", header.num_of_objects, stream.bytes);
+
+cleanup:
+    if(to_stdout){
+        restore_stdout(stream.fd);
+    }
+    else if(-1 != stream.fd){
+        close(stream.fd);
+    }
+    if(NULL != stream.buffer){
+        free(stream.buffer);
+    }
+    reachability_free(&reachability);
+
+    return return_value;
+}
+
+/**
+ * @brief: Verifies the objects of a batch and writes the new ones, BUNDLE_WORKER_BATCH at a time
+ * @param[IN] argument: The batch
+ *
+ * @returns: NULL
+ * @notes: This is the body of every thread of the pool (see run_workers). The fanout directories were
+ *         opened beforehand, since their cache isn't thread safe. Each entry records its own result.
+ */
+static void * bundle_worker(IN void * argument){
+    bundle_batch_t * batch = argument;
+    bundle_entry_t * entry = NULL;
+    int fd = -1;
+    size_t start = 0;
+    size_t i = 0;
+    size_t offset = 0;
+    ssize_t bytes_written = 0;
+    unsigned char actual[SHA_DIGEST_LENGTH] = {0};
+    char name[OBJECT_NAME_LEN + 1] = {0};
+
+    while(true){
+        start = __atomic_fetch_add(&batch->next, BUNDLE_WORKER_BATCH, __ATOMIC_RELAXED);
+        if(start >= batch->num_of_entries){
+            break;
+        }
+
+        for(i=start; i<min(start + BUNDLE_WORKER_BATCH, batch->num_of_entries); i++){
+            entry = &batch->entries[i];
+            entry->result = ERROR_CODE_SUCCESS;
+
+            SHA1(batch->data + entry->offset, entry->size, actual);
+            TRACE_COUNT_HASHED(entry->size);
+            if(0 != memcmp(actual, entry->sha, SHA_DIGEST_LENGTH)){
+                entry->corrupt = true;
+                continue;
+            }
+            if(entry->exists){
+                continue;
+            }
+
+            object_name(entry->sha, name);
+            fd = openat(entry->dir_fd, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, OBJECT_FILE_MODE);
+            if(-1 == fd && EEXIST == errno){
+                entry->exists = true;
+                continue;
+            }
+            if(-1 == fd){
+                entry->error_number = errno;
+                entry->result = ERROR_CODE_COULDNT_OPEN;
+                continue;
+            }
+
+            for(offset=0; offset<entry->size; offset+=bytes_written){
+                bytes_written = write(fd, batch->data + entry->offset + offset, entry->size - offset);
+                if(-1 == bytes_written){
+                    entry->error_number = errno;
+                    entry->result = ERROR_CODE_COULDNT_WRITE;
+                    break;
+                }
+            }
+            if(ERROR_CODE_SUCCESS == entry->result && batch->sync){
+                if(-1 == fsync(fd)){
+                    entry->error_number = errno;
+                    entry->result = ERROR_CODE_COULDNT_WRITE;
+                }
+                else{
+                    TRACE_COUNT_SYNC();
+                }
+            }
+            close(fd);
+
+            /* A partial object would claim a sha it doesn't have */
+            if(ERROR_CODE_SUCCESS != entry->result){
+                unlinkat(entry->dir_fd, name, 0);
+                continue;
+            }
+            entry->written = true;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief: Verifies and writes the collected objects, then empties the batch
+ * @param[IN OUT] batch: The batch
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_INVALID_INPUT if an object doesn't match its sha,
+ *           else an indicative error code
+ */
+static error_code_t bundle_process_batch(IN OUT bundle_batch_t * batch){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    bundle_entry_t * entry = NULL;
+
+    for(i=0; i<batch->num_of_entries; i++){
+        if(batch->entries[i].exists){
+            continue;
+        }
+        return_value = object_fanout_fd(batch->entries[i].sha[0], true, &batch->entries[i].dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    batch->next = 0;
+    batch->sync = (FSYNC_MODE_FULL == get_fsync_mode());
+    run_workers(bundle_worker, batch, batch->num_of_entries, BUNDLE_WORKER_BATCH);
+
+    for(i=0; i<batch->num_of_entries; i++){
+        entry = &batch->entries[i];
+        if(entry->corrupt){
+            sha_to_hex(entry->sha, hex);
+            printf("\e[31mObject %s in the bundle doesn't match its sha.\e[0m\n", hex);
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+        if(ERROR_CODE_SUCCESS != entry->result){
+            errno = entry->error_number;
+            perror("BUNDLE_PROCESS_BATCH: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = entry->result;
+            goto cleanup;
+        }
+    }
+
+    for(i=0; i<batch->num_of_entries; i++){
+        if(!batch->entries[i].written){
+            continue;
+        }
+
+        return_value = object_index_add(batch->entries[i].sha);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        return_value = sync_new_object(-1, batch->entries[i].sha);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        batch->num_of_written++;
+    }
+
+    batch->num_of_entries = 0;
+    batch->data_len = 0;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Reads a bundle into the objects directory
+ * @param[IN] path: The path of the bundle, or - for the standard input
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The bundle is read sequentially with BUNDLE_BUFFER_SIZE reads. Its objects are collected into
+ *         batches of about BUNDLE_BATCH_SIZE bytes, which are hashed and written on a thread pool, so
+ *         every object is verified before it is stored. HEAD is only set if nothing was committed yet,
+ *         otherwise the bundle's HEAD is printed.
+ */
+error_code_t bundle_unbundle(IN const char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned int i = 0;
+    unsigned int name_len = 0;
+    unsigned long long object = 0;
+    unsigned long long size = 0;
+    bool exists = false;
+    bool from_stdin = false;
+    int stdout_fd = -1;
+    bool has_head = false;
+    size_t new_capacity = 0;
+    unsigned char sha[SHA_DIGEST_LENGTH] = {0};
+    unsigned char bundle_head[SHA_DIGEST_LENGTH] = {0};
+    unsigned char head[SHA_DIGEST_LENGTH] = {0};
+    unsigned char checksum[SHA_DIGEST_LENGTH] = {0};
+    unsigned char expected[SHA_DIGEST_LENGTH] = {0};
+    char name[PATH_MAX] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    void * new_data = NULL;
+    bundle_header_t header = {0};
+    bundle_stream_t stream = {0};
+    bundle_batch_t batch = {0};
+    bundle_entry_t * entry = NULL;
+
+    stream.fd = -1;
+    from_stdin = (0 == strcmp(path, "-"));
+
+    /* Keep the messages out of a pipeline that reads the bundle from the standard input */
+    if(from_stdin){
+        return_value = redirect_stdout(&stdout_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    stream.buffer = malloc(BUNDLE_BUFFER_SIZE);
+    if(NULL == stream.buffer){
+        perror("BUNDLE_UNBUNDLE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    SHA1_Init(&stream.checksum);
+
+    stream.fd = from_stdin ? STDIN_FILENO : openat(work_tree_fd(), path, O_RDONLY | O_CLOEXEC);
+    if(-1 == stream.fd){
+        perror("BUNDLE_UNBUNDLE: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = bundle_read(&stream, &header, sizeof(header), true);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    if(BUNDLE_MAGIC != header.magic || BUNDLE_VERSION != header.version){
+        printf("\e[31m%s is not a bundle.\e[0m\n", path);
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    for(i=0; i<header.num_of_refs; i++){
+        return_value = bundle_read(&stream, sha, SHA_DIGEST_LENGTH, true);
+        if(ERROR_CODE_SUCCESS == return_value){
+            return_value = bundle_read(&stream, &name_len, sizeof(name_len), true);
+        }
+        if(ERROR_CODE_SUCCESS == return_value && name_len >= PATH_MAX){
+            printf("\e[31mThe bundle is corrupt.\e[0m\n");
+            return_value = ERROR_CODE_INVALID_INPUT;
+        }
+        if(ERROR_CODE_SUCCESS == return_value){
+            return_value = bundle_read(&stream, name, name_len, true);
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        name[name_len] = '\0';
+
+        if(0 == strcmp(name, "HEAD")){
+            memcpy(bundle_head, sha, SHA_DIGEST_LENGTH);
+            has_head = true;
+        }
+    }
+
+    TRACE_BEGIN("read_objects");
+    for(object=0; object<header.num_of_objects; object++){
+        return_value = bundle_read(&stream, sha, SHA_DIGEST_LENGTH, true);
+        if(ERROR_CODE_SUCCESS == return_value){
+            return_value = bundle_read(&stream, &size, sizeof(size), true);
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+
+        /* The size isn't covered by the checksum yet, so it mustn't overflow the batch arithmetic */
+        if(size > BUNDLE_MAX_OBJECT_SIZE || size > SIZE_MAX - batch.data_len){
+            sha_to_hex(sha, hex);
+            printf("\e[31mThe bundle is corrupt, object %s claims %llu bytes.\e[0m\n", hex, size);
+            return_value = ERROR_CODE_INVALID_INPUT;
+            break;
+        }
+
+        if(0 != batch.num_of_entries && batch.data_len + size > BUNDLE_BATCH_SIZE){
+            return_value = bundle_process_batch(&batch);
+            if(ERROR_CODE_SUCCESS != return_value){
+                break;
+            }
+        }
+
+        if(batch.data_len + size > batch.data_capacity){
+            new_capacity = max(batch.data_len + size, BUNDLE_BATCH_SIZE);
+            new_data = realloc(batch.data, max(new_capacity, 1));
+            if(NULL == new_data){
+                perror("BUNDLE_UNBUNDLE: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                break;
+            }
+            batch.data = new_data;
+            batch.data_capacity = new_capacity;
+        }
+        if(batch.num_of_entries == batch.entries_capacity){
+            new_capacity = max(2 * batch.entries_capacity, 1024);
+            new_data = realloc(batch.entries, new_capacity * sizeof(*batch.entries));
+            if(NULL == new_data){
+                perror("BUNDLE_UNBUNDLE: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                break;
+            }
+            batch.entries = new_data;
+            batch.entries_capacity = new_capacity;
+        }
+
+        entry = &batch.entries[batch.num_of_entries];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->sha, sha, SHA_DIGEST_LENGTH);
+        entry->offset = batch.data_len;
+        entry->size = size;
+        entry->dir_fd = -1;
+
+        return_value = object_index_contains(sha, &entry->exists);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+
+        return_value = bundle_read(&stream, batch.data + batch.data_len, size, false);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+        batch.data_len += size;
+        batch.num_of_entries++;
+    }
+    if(ERROR_CODE_SUCCESS == return_value && 0 != batch.num_of_entries){
+        return_value = bundle_process_batch(&batch);
+    }
+    TRACE_END("read_objects");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    SHA1_Final(expected, &stream.checksum);
+    return_value = bundle_read(&stream, checksum, SHA_DIGEST_LENGTH, false);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    if(0 != memcmp(expected, checksum, SHA_DIGEST_LENGTH)){
+        printf("\e[31mThe checksum of the bundle doesn't match, HEAD wasn't updated.\e[0m\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    /* The objects have to be durable before HEAD can point at them */
+    return_value = sync_objects();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("Unbundled %llu objects, %zu of them new.\n", header.num_of_objects, batch.num_of_written);
+
+    if(!has_head){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = read_head(head, &exists);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    sha_to_hex(bundle_head, hex);
+    if(exists){
+        printf("The bundle's HEAD is %s\n", hex);
+        goto cleanup;
+    }
+
+    return_value = replace_file(HEAD_file_path, bundle_head, SHA_DIGEST_LENGTH);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    printf("HEAD is now %s, check it out with slap checkout %s\n", hex, hex);
+
+cleanup:
+    if(-1 != stream.fd && !from_stdin){
+        close(stream.fd);
+    }
+    restore_stdout(stdout_fd);
+    if(NULL != stream.buffer){
+        free(stream.buffer);
+    }
+    if(NULL != batch.data){
+        free(batch.data);
+    }
+    if(NULL != batch.entries){
+        free(batch.entries);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the bundle command
+ * @param[IN] argc: The number of arguments (after bundle)
+ * @param[IN] argv: The arguments: create|unbundle <file|->
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t bundle_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(2 == argc && 0 == valid_strncmp(argv[0], "create")){
+        return_value = bundle_create(argv[1]);
+    }
+    else if(2 == argc && 0 == valid_strncmp(argv[0], "unbundle")){
+        return_value = bundle_unbundle(argv[1]);
+    }
+    else{
+        printf("USAGE: slap bundle: create|unbundle <file|->\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+    return return_value;
+}
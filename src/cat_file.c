@@ -0,0 +1,402 @@
+#include "slap_commands.h"
+
+#include <poll.h>
+#include <sys/sendfile.h>
+
+/**
+ * @brief: Writes the output buffer to the output file descriptor
+ * @param[IN OUT] output: The output buffer
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t cat_file_flush(IN OUT cat_file_output_t * output){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes_written = 0;
+    size_t offset = 0;
+
+    for(offset=0; offset<output->length; offset+=bytes_written){
+        bytes_written = write(output->fd, output->buffer + offset, output->length - offset);
+        if(-1 == bytes_written && EINTR == errno){
+            bytes_written = 0;
+            continue;
+        }
+        if(-1 == bytes_written){
+            perror("CAT_FILE_FLUSH: Write error");
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    output->length = 0;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Makes room in the output buffer
+ * @param[IN OUT] output: The output buffer
+ * @param[IN] length: The number of bytes needed (at most CAT_FILE_BUFFER_SIZE)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t cat_file_reserve(IN OUT cat_file_output_t * output, IN size_t length){
+    if(output->length + length > CAT_FILE_BUFFER_SIZE){
+        return cat_file_flush(output);
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Resolves the name of an object
+ * @param[IN] name: The sha of the object in hex, or an abbreviation of it
+ * @param[OUT] hash: The sha
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND or ERROR_CODE_AMBIGUOUS if the name
+ *           doesn't name a single object, else an indicative error code
+ * @notes: A full sha is parsed without looking at the object index
+ */
+static error_code_t cat_file_resolve(IN char * name, OUT unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int high = 0;
+    int low = 0;
+
+    if(OBJECT_HEX_LEN != strlen(name)){
+        return_value = object_index_resolve(name, hash);
+        if(ERROR_CODE_INVALID_INPUT == return_value){
+            return_value = ERROR_CODE_NOT_FOUND;
+        }
+        goto cleanup;
+    }
+
+    for(i=0; i<SHA_DIGEST_LENGTH; i++){
+        high = hex_value(name[i * 2]);
+        low = hex_value(name[i * 2 + 1]);
+        if(-1 == high || -1 == low){
+            return_value = ERROR_CODE_NOT_FOUND;
+            goto cleanup;
+        }
+        hash[i] = (high << 4) | low;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Copies the contents of an object to the output
+ * @param[IN OUT] output: The output buffer
+ * @param[IN] object_fd: The object
+ * @param[IN] size: The size of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Small objects are read straight into the output buffer. Big ones are sent from the page
+ *         cache with sendfile after the buffer is flushed, falling back to read and write if the
+ *         standard output doesn't support it.
+ */
+static error_code_t cat_file_copy(IN OUT cat_file_output_t * output, IN int object_fd, IN off_t size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes = 0;
+    off_t offset = 0;
+    bool use_sendfile = false;
+
+    use_sendfile = (size >= CAT_FILE_SENDFILE_MIN);
+    if(use_sendfile){
+        return_value = cat_file_flush(output);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    while(offset < size){
+        if(use_sendfile){
+            bytes = sendfile(output->fd, object_fd, &offset, size - offset);
+            if(-1 == bytes && (EINVAL == errno || ENOSYS == errno) && 0 == offset){
+                errno = 0;
+                use_sendfile = false;
+                continue;
+            }
+            if(-1 == bytes && EINTR == errno){
+                continue;
+            }
+            if(-1 == bytes){
+                perror("CAT_FILE_COPY: Sendfile error");
+                return_value = ERROR_CODE_COULDNT_WRITE;
+                goto cleanup;
+            }
+            if(0 == bytes){
+                break;
+            }
+            continue;
+        }
+
+        return_value = cat_file_reserve(output, min((size_t)(size - offset), CAT_FILE_BUFFER_SIZE));
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        bytes = pread(object_fd, output->buffer + output->length, min((size_t)(size - offset), CAT_FILE_BUFFER_SIZE - output->length), offset);
+        if(-1 == bytes && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes){
+            perror("CAT_FILE_COPY: Pread error");
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes){
+            break;
+        }
+        output->length += bytes;
+        offset += bytes;
+    }
+
+    if(offset < size){
+        printf("\e[31mAn object was truncated while it was read.\e[0m\n");
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes an object to the output, with a "<sha> <size>" header line in batch mode
+ * @param[IN OUT] output: The output buffer
+ * @param[IN] name: The name of the object as it was given
+ * @param[IN] header: Write the header line, and a newline after the contents
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success (a missing object is reported in the output in batch mode,
+ *           ERROR_CODE_NOT_FOUND otherwise), else an indicative error code
+ */
+static error_code_t cat_file_object(IN OUT cat_file_output_t * output, IN char * name, IN bool header){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int object_fd = -1;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    char * status = NULL;
+    struct stat statbuf = {0};
+
+    return_value = cat_file_resolve(name, hash);
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = open_object(hash, O_RDONLY, 0, &object_fd);
+        if(ERROR_CODE_COULDNT_OPEN == return_value && ENOENT == errno){
+            errno = 0;
+            return_value = ERROR_CODE_NOT_FOUND;
+        }
+    }
+    if((ERROR_CODE_NOT_FOUND == return_value || ERROR_CODE_AMBIGUOUS == return_value) && header){
+        status = (ERROR_CODE_NOT_FOUND == return_value) ? "missing" : "ambiguous";
+        return_value = cat_file_reserve(output, strnlen(name, PATH_MAX) + sizeof(" ambiguous\n"));
+        if(ERROR_CODE_SUCCESS == return_value){
+            output->length += snprintf(output->buffer + output->length, CAT_FILE_BUFFER_SIZE - output->length, "%.*s %s\n",
+                                       PATH_MAX, name, status);
+        }
+        goto cleanup;
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = fstat(object_fd, &statbuf);
+    if(-1 == error_check){
+        perror("CAT_FILE_OBJECT: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(header){
+        sha_to_hex(hash, hex);
+        return_value = cat_file_reserve(output, OBJECT_HEX_LEN + 24);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        output->length += snprintf(output->buffer + output->length, CAT_FILE_BUFFER_SIZE - output->length, "%s %lld\n",
+                                   hex, (long long)statbuf.st_size);
+    }
+
+    return_value = cat_file_copy(output, object_fd, statbuf.st_size);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(header){
+        return_value = cat_file_reserve(output, 1);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        output->buffer[output->length++] = '\n';
+    }
+
+cleanup:
+    if(-1 != object_fd){
+        close(object_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks if the standard input has nothing more to read right now
+ *
+ * @returns: true if a read from the standard input would block
+ * @notes: The output is flushed then, so a client that waits for each answer before asking for
+ *         the next object doesn't deadlock
+ */
+static bool cat_file_input_idle(){
+    struct pollfd poll_fd = {0};
+
+    poll_fd.fd = STDIN_FILENO;
+    poll_fd.events = POLLIN;
+
+    return (0 == poll(&poll_fd, 1, 0));
+}
+
+/**
+ * @brief: Writes the objects named on the standard input (one sha per line) to the standard output
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Every object is written as "<sha> <size>\n", its raw contents and "\n". An unknown name is
+ *         answered with "<name> missing\n", and an ambiguous abbreviation with "<name> ambiguous\n".
+ *         The output goes through one CAT_FILE_BUFFER_SIZE buffer, which is flushed when it fills up
+ *         or the input runs dry. Errors are printed to the standard error, so they can't corrupt the stream.
+ */
+error_code_t cat_file_batch(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t line_len = 0;
+    size_t line_capacity = 0;
+    char * line = NULL;
+    cat_file_output_t output = {0};
+
+    TRACE_BEGIN("cat_file_batch");
+
+    /* The objects own the standard output, everything printed goes to the standard error */
+    output.fd = -1;
+    return_value = redirect_stdout(&output.fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    output.buffer = malloc(CAT_FILE_BUFFER_SIZE);
+    if(NULL == output.buffer){
+        perror("CAT_FILE_BATCH: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    while(-1 != (line_len = getline(&line, &line_capacity, stdin))){
+        if(line_len > 0 && '\n' == line[line_len - 1]){
+            line[--line_len] = '\0';
+        }
+
+        return_value = cat_file_object(&output, line, true);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        if(cat_file_input_idle()){
+            return_value = cat_file_flush(&output);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+    }
+
+    return_value = cat_file_flush(&output);
+
+cleanup:
+    restore_stdout(output.fd);
+    if(NULL != output.buffer){
+        free(output.buffer);
+    }
+    if(NULL != line){
+        free(line);
+    }
+    TRACE_END("cat_file_batch");
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes the raw contents of an object to the standard output
+ * @param[IN] object: The sha of the object in hex, or an abbreviation of it
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Like in batch mode, errors are printed to the standard error
+ */
+error_code_t cat_file(IN char * object){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    cat_file_output_t output = {0};
+
+    output.fd = -1;
+    return_value = redirect_stdout(&output.fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    output.buffer = malloc(CAT_FILE_BUFFER_SIZE);
+    if(NULL == output.buffer){
+        perror("CAT_FILE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    return_value = cat_file_object(&output, object, false);
+    if(ERROR_CODE_NOT_FOUND == return_value){
+        printf("\e[31mUnknown object %s.\e[0m\n", object);
+        goto cleanup;
+    }
+    if(ERROR_CODE_AMBIGUOUS == return_value){
+        printf("\e[31mThe sha %s is ambiguous.\e[0m\n", object);
+        goto cleanup;
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = cat_file_flush(&output);
+
+cleanup:
+    restore_stdout(output.fd);
+    if(NULL != output.buffer){
+        free(output.buffer);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the cat-file command
+ * @param[IN] argc: The number of arguments (after cat-file)
+ * @param[IN] argv: The arguments: --batch | <object>
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t cat_file_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(1 == argc && 0 == valid_strncmp(argv[0], "--batch")){
+        return_value = cat_file_batch();
+    }
+    else if(1 == argc){
+        return_value = cat_file(argv[0]);
+    }
+    else{
+        printf("USAGE: cat-file: --batch | <object>\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+    return return_value;
+}
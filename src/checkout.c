@@ -2,48 +2,157 @@
 
 /**
  * @brief: Checks if all files in the index are up-to-date
- * @param[IN] index_fd: The file descriptor of the index file
  * 
  * @returns: 1 if index file is up-to-date, 0 if it isn't, and -1 on error
  */
-int can_checkout(IN int index_fd){
+int can_checkout(){
     int checkout_is_valid = 1;
-    int error_check = 0;
     int difference = 0;
-    unsigned char * file_hash = NULL;
-    index_file_segement_t index_segment = {0};
+    size_t i = 0;
+    size_t num_of_entries = 0;
+    index_file_segement_t * entries = NULL;
 
-    while(true){
-        error_check = get_next_index_segment(index_fd, &index_segment);
-        if(ERROR_CODE_SUCCESS != error_check && ERROR_CODE_EOF != error_check){
-            checkout_is_valid = -1;
-            goto cleanup;
-        }
-        
-        if(ERROR_CODE_EOF == error_check){
-            break;
+    if(ERROR_CODE_SUCCESS != index_cache_entries(&entries, &num_of_entries)){
+        checkout_is_valid = -1;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_entries; i++){
+        if(!sparse_contains(entries[i].name, entries[i].name_len)){
+            continue;
         }
 
-        difference = strncmp(index_segment.repo_sha, index_segment.wdir_sha, SHA_DIGEST_LENGTH);
+        difference = memcmp(entries[i].repo_sha, entries[i].wdir_sha, SHA_DIGEST_LENGTH);
         if(0 != difference){
-            printf("\e[31mThe repository's version of \e[1m%s\e[0m\e[31m is not up to date.\e[0m\n", index_segment.name);
+            printf("\e[31mThe repository's version of \e[1m%s\e[0m\e[31m is not up to date.\e[0m\n", entries[i].name);
             checkout_is_valid = 0;
         }
     }
 
 cleanup:
-    if(NULL != file_hash){
-        free(file_hash);
+    return checkout_is_valid;
+}
+
+/**
+ * @brief: Opens a commit object
+ * @param[IN] commit: The (possibly abbreviated) sha of the commit in hex, or the path to the commit object
+ * @param[OUT] commit_fd: The file descriptor of the commit object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Abbreviated shas are resolved with the object index, so the objects directory isn't scanned
+ */
+error_code_t open_commit(IN char * commit, OUT int * commit_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+
+    *commit_fd = -1;
+
+    return_value = object_index_resolve(commit, hash);
+    if(ERROR_CODE_SUCCESS == return_value){
+        return_value = open_object(hash, O_RDONLY, 0, commit_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            perror("OPEN_COMMIT: Open error");
+            printf("(Errno: %i)\n", errno);
+        }
+        goto cleanup;
+    }
+    if(ERROR_CODE_AMBIGUOUS == return_value){
+        printf("\e[31mThe sha %s is ambiguous.\e[0m\n", commit);
+        goto cleanup;
+    }
+    if(ERROR_CODE_NOT_FOUND != return_value && ERROR_CODE_INVALID_INPUT != return_value){
+        goto cleanup;
     }
 
-    return checkout_is_valid;
+    *commit_fd = open(commit, O_RDONLY);
+    if(-1 == *commit_fd){
+        perror("OPEN_COMMIT: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Creates the directories a checked out file is in
+ * @param[IN] name: The path of the file
+ * @param[IN OUT] last_dir: The directory of the previous file, which is known to exist (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Commits list their entries sorted by path, so most files are in the directory of the previous one
+ *         and nothing is created. Otherwise the whole directory is created first, and its parents only if
+ *         that fails with ENOENT.
+ */
+static error_code_t checkout_make_parents(IN const char * name, IN OUT char * last_dir){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    size_t dir_len = 0;
+    size_t i = 0;
+    const char * slash = NULL;
+    char path[PATH_MAX] = {0};
+
+    slash = strrchr(name, '/');
+    if(NULL == slash){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    dir_len = slash - name;
+    if(dir_len >= PATH_MAX){
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+    if(dir_len == strnlen(last_dir, PATH_MAX) && 0 == memcmp(last_dir, name, dir_len)){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    memcpy(path, name, dir_len);
+    path[dir_len] = '\0';
+
+    error_check = mkdirat(work_tree_fd(), path, 0775);
+    if(-1 == error_check && ENOENT == errno){
+        for(i=1; i<=dir_len; i++){
+            if('/' != path[i] && '\0' != path[i]){
+                continue;
+            }
+
+            path[i] = '\0';
+            error_check = mkdirat(work_tree_fd(), path, 0775);
+            if(i < dir_len){
+                path[i] = '/';
+            }
+            if(-1 == error_check && EEXIST != errno){
+                break;
+            }
+        }
+    }
+    if(-1 == error_check && EEXIST != errno){
+        perror("CHECKOUT_MAKE_PARENTS: Mkdir error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+    errno = 0;
+
+    memcpy(last_dir, path, dir_len + 1);
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
 }
 
 /**
  * @brief: Checks out a commit
- * @param[IN] path: The path to the commit object
+ * @param[IN] path: The sha of the commit (which may be abbreviated), or the path to the commit object
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The files are written BULK_IO_CHUNK at a time with bulk_run
  */
 error_code_t checkout(IN char * path){
     error_code_t return_value = ERROR_CODE_UNINITIALIZED;
@@ -51,31 +160,34 @@ error_code_t checkout(IN char * path){
     int error_check = 0;
     int num_of_parents = 0;
     int commit_fd = -1;
-    int index_fd = -1;
-    int file_fd = -1;
-    int blob_fd = -1;
+    int i = 0;
+    int num_of_segments = 0;
     int up_to_date = 0;
-    char * blob_path = NULL;
-    commit_file_segment_t commit_segment = {0};
+    int alternate = -1;
+    bool reached_eof = false;
+    char blob_path[PATH_MAX] = {0};
+    char last_dir[PATH_MAX] = {0};
+    commit_file_segment_t * segments = NULL;
+    bulk_job_t * jobs = NULL;
 
-    printf("COMMIT PATH: %s\n", path);
-    commit_fd = open(path, O_RDONLY);
-    if(-1 == commit_fd){
-        perror("CHECKOUT: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+    TRACE_BEGIN("checkout");
+
+    return_value = sparse_load();
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    index_fd = open(index_file_path, O_RDONLY);
-    if(-1 == index_fd){
-        perror("CHECKOUT: Open error");
-        printf("(Errno: %i)\n", errno);
-        return_value = ERROR_CODE_COULDNT_OPEN;
+    printf("COMMIT PATH: %s\n", path);
+    TRACE_BEGIN("open_commit");
+    return_value = open_commit(path, &commit_fd);
+    TRACE_END("open_commit");
+    if(ERROR_CODE_SUCCESS != return_value){
         goto cleanup;
     }
 
-    up_to_date = can_checkout(index_fd);
+    TRACE_BEGIN("can_checkout");
+    up_to_date = can_checkout();
+    TRACE_END("can_checkout");
     if(-1 == up_to_date){
         goto cleanup;
     }
@@ -86,6 +198,15 @@ error_code_t checkout(IN char * path){
         goto cleanup;
     }
 
+    segments = calloc(BULK_IO_CHUNK, sizeof(*segments));
+    jobs = calloc(BULK_IO_CHUNK, sizeof(*jobs));
+    if(NULL == segments || NULL == jobs){
+        perror("CHECKOUT: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
     error_check = read(commit_fd, &num_of_parents, sizeof(num_of_parents));
     if(-1 == error_check){
         perror("CHECKOUT: Read error");
@@ -102,76 +223,101 @@ error_code_t checkout(IN char * path){
         goto cleanup;
     }
 
-    while(true){
-        if(-1 != blob_fd){
-            close(blob_fd);
-        }
-        if(-1 != file_fd){
-            close(file_fd);
-        }
+    while(!reached_eof){
+        TRACE_BEGIN("read_commit");
+        for(num_of_segments=0; num_of_segments<BULK_IO_CHUNK; num_of_segments++){
+            return_value = get_next_commit_segment(commit_fd, &segments[num_of_segments]);
+            if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_EOF != return_value){
+                goto cleanup;
+            }
 
-        return_value = get_next_commit_segment(commit_fd, &commit_segment);
-        if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_EOF != return_value){
-            goto cleanup;
-        }
+            if(ERROR_CODE_EOF == return_value){
+                reached_eof = true;
+                break;
+            }
 
-        if(ERROR_CODE_EOF == return_value){
-            break;
-        }
+            /* Paths outside the sparse checkout are never written, the slot is reused for the next segment */
+            if(!sparse_contains(segments[num_of_segments].name, segments[num_of_segments].name_len)){
+                free(segments[num_of_segments].name);
+                segments[num_of_segments].name = NULL;
+                num_of_segments--;
+                continue;
+            }
 
-        if(NULL != blob_path){
-            free(blob_path);
-        }
-        return_value = get_blob_path(commit_segment.sha, &blob_path, NULL);
-        if(ERROR_CODE_SUCCESS != return_value){
-            goto cleanup;
-        }
+            return_value = checkout_make_parents(segments[num_of_segments].name, last_dir);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
 
-        printf("BLOB NAME: %s\n", blob_path);
-        blob_fd = open(blob_path, O_RDONLY);
-        if(-1 == blob_fd){
-            perror("CHECKOUT: Open error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_OPEN;
-            goto cleanup;
-        }
+            return_value = object_path(segments[num_of_segments].sha, blob_path);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
 
-        printf("FILE NAME: %s\n", commit_segment.name);
-        file_fd = open(commit_segment.name, O_WRONLY | O_CREAT, 0666);
-        if(-1 == file_fd){
-            perror("CHECKOUT: Open error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_OPEN;
-            goto cleanup;
-        }
+            printf("BLOB NAME: %s\n", blob_path);
+            printf("FILE NAME: %s\n", segments[num_of_segments].name);
 
-        error_check = ftruncate(file_fd, 0);
-        if(-1 == error_check){
-            perror("CHECKOUT: Ftruncate error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_TRUNCATE;
-            goto cleanup;
+            return_value = object_locate(segments[num_of_segments].sha, &jobs[num_of_segments].src_dir_fd, &alternate);
+            if(ERROR_CODE_SUCCESS != return_value){
+                perror("CHECKOUT: Open error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_OPEN;
+                goto cleanup;
+            }
+
+            object_name(segments[num_of_segments].sha, jobs[num_of_segments].name_buffer);
+            jobs[num_of_segments].src_name = jobs[num_of_segments].name_buffer;
+            jobs[num_of_segments].dst_dir_fd = work_tree_fd();
+            jobs[num_of_segments].dst_name = segments[num_of_segments].name;
+            jobs[num_of_segments].dst_flags = O_WRONLY | O_CREAT | O_TRUNC;
+            jobs[num_of_segments].dst_mode = 0666;
         }
 
-        error_check = copy_file_range(blob_fd, 0, file_fd, 0, -1);
-        if(-1 == error_check){
+        TRACE_END("read_commit");
+
+        TRACE_BEGIN("write_files");
+        return_value = bulk_run(jobs, num_of_segments);
+        TRACE_END("write_files");
+        if(ERROR_CODE_SUCCESS != return_value){
             return_value = ERROR_CODE_COULDNT_WRITE;
             goto cleanup;
         }
 
-        error_check = fchmod(file_fd, commit_segment.mode);
-        if(-1 == error_check){
-            perror("CHECKOUT: Fchmod error");
-            printf("(Errno: %i)\n", errno);
-            return_value = ERROR_CODE_COULDNT_CHMOD;
-            goto cleanup;
+        TRACE_BEGIN("set_modes");
+        for(i=0; i<num_of_segments; i++){
+            error_check = fchmodat(work_tree_fd(), segments[i].name, segments[i].mode, 0);
+            if(-1 == error_check){
+                perror("CHECKOUT: Fchmodat error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_CHMOD;
+                goto cleanup;
+            }
+            PROBE3(checkout__file, segments[i].name, jobs[i].size, segments[i].sha);
+
+            free(segments[i].name);
+            segments[i].name = NULL;
         }
+        TRACE_END("set_modes");
     }
 
+    return_value = ERROR_CODE_SUCCESS;
+
 cleanup:
     if(-1 != commit_fd){
         close(commit_fd);
     }
+    if(NULL != segments){
+        for(i=0; i<BULK_IO_CHUNK; i++){
+            if(NULL != segments[i].name){
+                free(segments[i].name);
+            }
+        }
+        free(segments);
+    }
+    if(NULL != jobs){
+        free(jobs);
+    }
+    TRACE_END("checkout");
 
     return return_value;
 }
\ No newline at end of file
@@ -0,0 +1,450 @@
+#include "slap_commands.h"
+
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+/**
+ * @brief: Copies an object that couldn't be hardlinked, reflinking it when the file system supports it
+ * @param[IN] src_dir_fd: The fanout directory of the source
+ * @param[IN] dst_dir_fd: The fanout directory of the destination
+ * @param[IN] name: The name of the object in both
+ * @param[IN OUT] stats: The counts of the clone
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t clone_copy_object(IN int src_dir_fd, IN int dst_dir_fd, IN const char * name, IN OUT clone_stats_t * stats){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int src_fd = -1;
+    int dst_fd = -1;
+    off_t copied = 0;
+    struct stat statbuf = {0};
+
+    src_fd = openat(src_dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if(-1 == src_fd){
+        perror("CLONE_COPY_OBJECT: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    dst_fd = openat(dst_dir_fd, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, OBJECT_FILE_MODE);
+    if(-1 == dst_fd){
+        perror("CLONE_COPY_OBJECT: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    if(!stats->no_reflink){
+        error_check = ioctl(dst_fd, FICLONE, src_fd);
+        if(0 == error_check){
+            stats->reflinked++;
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        stats->no_reflink = true;
+        errno = 0;
+    }
+
+    error_check = fstat(src_fd, &statbuf);
+    if(-1 == error_check){
+        perror("CLONE_COPY_OBJECT: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    /* copy_file_range may copy less than asked for (and takes an int length), so copy until the whole object is in */
+    for(copied=0; copied<statbuf.st_size; copied+=error_check){
+        error_check = copy_file_range(src_fd, copied, dst_fd, copied, min(statbuf.st_size - copied, INT_MAX));
+        if(-1 == error_check){
+            perror("CLONE_COPY_OBJECT: Copy_file_range error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        if(0 == error_check){
+            printf("\e[31mThe object %s was truncated while it was copied.\e[0m\n", name);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+    }
+    stats->copied++;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != dst_fd){
+        close(dst_fd);
+    }
+    if(-1 != src_fd){
+        close(src_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Hardlinks (or reflinks, or copies) every object of a fanout directory into the local objects directory
+ * @param[IN] src_objects_fd: The source objects directory
+ * @param[IN] fanout: The first byte of the shas in the directory
+ * @param[IN OUT] stats: The counts of the clone
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Objects never change after they are written, so both repositories can share their inodes
+ */
+static error_code_t clone_fanout(IN int src_objects_fd, IN int fanout, IN OUT clone_stats_t * stats){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int src_dir_fd = -1;
+    int dst_dir_fd = -1;
+    char name[3] = {0};
+    DIR * dir = NULL;
+    struct dirent * entry = NULL;
+
+    snprintf(name, sizeof(name), "%02x", fanout);
+
+    src_dir_fd = openat(src_objects_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == src_dir_fd && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(-1 == src_dir_fd){
+        perror("CLONE_FANOUT: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = object_fanout_fd(fanout, true, &dst_dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    dir = fdopendir(src_dir_fd);
+    if(NULL == dir){
+        perror("CLONE_FANOUT: Fdopendir error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(NULL != (entry = readdir(dir))){
+        if(OBJECT_NAME_LEN != strnlen(entry->d_name, OBJECT_NAME_LEN + 1)){
+            continue;
+        }
+
+        if(!stats->cross_device){
+            error_check = linkat(src_dir_fd, entry->d_name, dst_dir_fd, entry->d_name, 0);
+            if(0 == error_check){
+                stats->linked++;
+                continue;
+            }
+            if(EEXIST == errno){
+                errno = 0;
+                continue;
+            }
+            if(EXDEV != errno){
+                perror("CLONE_FANOUT: Linkat error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_CREATE;
+                goto cleanup;
+            }
+            stats->cross_device = true;
+            errno = 0;
+        }
+
+        return_value = clone_copy_object(src_dir_fd, dst_dir_fd, entry->d_name, stats);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    if(FSYNC_MODE_NONE != get_fsync_mode()){
+        return_value = sync_file(dst_dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != dir){
+        closedir(dir);
+    }
+    else if(-1 != src_dir_fd){
+        close(src_dir_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes the alternates of the source repository into the local one, with absolute paths
+ * @param[IN] src_repo_dir: The repository directory (.slap) of the source
+ * @param[IN] src_objects: The absolute path of the source objects directory
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects the source reads from its alternates aren't cloned, so the clone has to read them too.
+ *         Relative alternates are relative to the source objects directory, which the clone doesn't share.
+ */
+static error_code_t clone_alternates(IN const char * src_repo_dir, IN const char * src_objects){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    size_t length = 0;
+    char path[PATH_MAX] = {0};
+    char line[PATH_MAX + 1] = {0};
+    char * data = NULL;
+    char * new_data = NULL;
+    FILE * file = NULL;
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", src_repo_dir, alternates_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    file = fopen(path, "r");
+    if(NULL == file && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(NULL == file){
+        perror("CLONE_ALTERNATES: Fopen error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(NULL != fgets(line, sizeof(line), file)){
+        line[strcspn(line, "\n")] = '\0';
+        if('\0' == line[0] || '#' == line[0]){
+            continue;
+        }
+
+        new_data = realloc(data, length + strlen(src_objects) + strlen(line) + 3);
+        if(NULL == new_data){
+            perror("CLONE_ALTERNATES: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        data = new_data;
+
+        if('/' == line[0]){
+            length += sprintf(data + length, "%s\n", line);
+        }
+        else{
+            length += sprintf(data + length, "%s/%s\n", src_objects, line);
+        }
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", repo_dir_name, alternates_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = replace_file(path, data, length);
+
+cleanup:
+    if(NULL != data){
+        free(data);
+    }
+    if(NULL != file){
+        fclose(file);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Clones a local repository
+ * @param[IN] source: The work tree of the repository to clone
+ * @param[IN] destination: The work tree of the new repository (created if it doesn't exist)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Objects are hardlinked, or reflinked (FICLONE) when the destination is on another file system, and
+ *         copied only when neither works. The index is written from the source's HEAD, so the checkout that
+ *         follows is the only step that reads object contents. The new repository gets a state of its own,
+ *         so the caches of the repository that was open are left alone.
+ */
+error_code_t clone_repository(IN const char * source, IN const char * destination){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int i = 0;
+    int src_objects_fd = -1;
+    int dst_fd = -1;
+    bool exists = false;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    char src_repo_dir[PATH_MAX] = {0};
+    char path[PATH_MAX] = {0};
+    char * src_work_tree = NULL;
+    char * src_objects = NULL;
+    clone_stats_t stats = {0};
+    repository_state_t * dst_state = NULL;
+    repository_state_t * previous = NULL;
+
+    src_work_tree = realpathat(work_tree_fd(), source);
+    if(NULL == src_work_tree){
+        perror("CLONE_REPOSITORY: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    error_check = snprintf(src_repo_dir, PATH_MAX, "%s/%s", src_work_tree, repo_dir_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    /* Realpath, since the objects directory of a work tree added with slap worktree is a symlink */
+    error_check = snprintf(path, PATH_MAX, "%s/objects", src_repo_dir);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    src_objects = realpath(path, NULL);
+    if(NULL == src_objects){
+        printf("\e[31m%s is not a repository.\e[0m\n", source);
+        return_value = ERROR_CODE_NOT_FOUND;
+        goto cleanup;
+    }
+
+    src_objects_fd = open(src_objects, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == src_objects_fd){
+        perror("CLONE_REPOSITORY: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/HEAD", src_repo_dir);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = read_head_file(path, hash, &exists);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = make_dir(destination);
+    if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_ALREADY_EXISTS != return_value){
+        goto cleanup;
+    }
+
+    dst_fd = openat(work_tree_fd(), destination, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == dst_fd){
+        perror("CLONE_REPOSITORY: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = repository_state_create(dst_fd, &dst_state);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    previous = repository_state_switch(dst_state);
+
+    error_check = faccessat(work_tree_fd(), repo_dir_name, F_OK, 0);
+    if(0 == error_check){
+        printf("\e[31m%s already has a repository.\e[0m\n", destination);
+        return_value = ERROR_CODE_ALREADY_EXISTS;
+        goto cleanup;
+    }
+    errno = 0;
+
+    return_value = init();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("link_objects");
+    for(i=0; i<OBJECT_FANOUT; i++){
+        return_value = clone_fanout(src_objects_fd, i, &stats);
+        if(ERROR_CODE_SUCCESS != return_value){
+            break;
+        }
+    }
+    TRACE_END("link_objects");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = clone_alternates(src_repo_dir, src_objects);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = object_index_rebuild();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("Linked %zu objects, reflinked %zu and copied %zu.\n", stats.linked, stats.reflinked, stats.copied);
+
+    if(!exists){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = worktree_write_index(hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = replace_file(HEAD_file_path, hash, SHA_DIGEST_LENGTH);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    sha_to_hex(hash, hex);
+    return_value = checkout(hex);
+
+cleanup:
+    if(NULL != dst_state){
+        repository_state_switch(previous);
+        repository_state_destroy(dst_state);
+    }
+    if(-1 != dst_fd){
+        close(dst_fd);
+    }
+    if(-1 != src_objects_fd){
+        close(src_objects_fd);
+    }
+    if(NULL != src_objects){
+        free(src_objects);
+    }
+    if(NULL != src_work_tree){
+        free(src_work_tree);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the clone command
+ * @param[IN] argc: The number of arguments (after clone)
+ * @param[IN] argv: The arguments: <source> <destination>
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t clone_command(IN int argc, IN char ** argv){
+    if(2 != argc){
+        printf("USAGE: slap clone: <source> <destination>\n");
+        return ERROR_CODE_INVALID_INPUT;
+    }
+
+    return clone_repository(argv[0], argv[1]);
+}
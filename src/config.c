@@ -0,0 +1,224 @@
+#include "slap_commands.h"
+
+const char * config_file_name = "config";
+
+/**
+ * @brief: Splits a config line into its key and value
+ * @param[IN] line: The line (modified in place)
+ * @param[OUT] key: Set to the start of the key
+ * @param[OUT] value: Set to the start of the value
+ *
+ * @returns: true if the line holds a setting, false for blank lines and comments
+ * @notes: Lines look like "key = value". Whitespace around the key and the value is ignored.
+ */
+static bool config_parse_line(IN char * line, OUT char ** key, OUT char ** value){
+    char * separator = NULL;
+    char * end = NULL;
+
+    line[strcspn(line, "\n")] = '\0';
+    while(' ' == *line || '\t' == *line){
+        line++;
+    }
+    if('\0' == *line || '#' == *line){
+        return false;
+    }
+
+    separator = strchr(line, '=');
+    if(NULL == separator){
+        return false;
+    }
+
+    for(end = separator; end > line && (' ' == end[-1] || '\t' == end[-1]); end--);
+    *end = '\0';
+
+    for(separator++; ' ' == *separator || '\t' == *separator; separator++);
+    for(end = separator + strlen(separator); end > separator && (' ' == end[-1] || '\t' == end[-1]); end--);
+    *end = '\0';
+
+    *key = line;
+    *value = separator;
+
+    return true;
+}
+
+/**
+ * @brief: Gets the path of the config file
+ * @param[OUT] path: The buffer to write into (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t config_path(OUT char * path){
+    int error_check = 0;
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", repo_dir_name, config_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Gets the value of a setting from the repository's config file
+ * @param[IN] key: The name of the setting (for example core.fsync)
+ * @param[OUT] value: The buffer to write the value into
+ * @param[IN] value_len: The size of value
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if the setting isn't set,
+ *           else an indicative error code
+ */
+error_code_t config_get(IN const char * key, OUT char * value, IN size_t value_len){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char path[PATH_MAX] = {0};
+    char line[CONFIG_LINE_MAX] = {0};
+    char * line_key = NULL;
+    char * line_value = NULL;
+    FILE * file = NULL;
+
+    return_value = config_path(path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    file = fopenat(work_tree_fd(), path, "r");
+    if(NULL == file){
+        errno = 0;
+        return_value = ERROR_CODE_NOT_FOUND;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_NOT_FOUND;
+    while(NULL != fgets(line, sizeof(line), file)){
+        if(config_parse_line(line, &line_key, &line_value) && 0 == strcmp(line_key, key)){
+            snprintf(value, value_len, "%s", line_value);
+            return_value = ERROR_CODE_SUCCESS;
+        }
+    }
+
+cleanup:
+    if(NULL != file){
+        fclose(file);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Sets a setting in the repository's config file
+ * @param[IN] key: The name of the setting
+ * @param[IN] value: The new value
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The config file is rewritten to a lock file which is then renamed over it
+ */
+error_code_t config_set(IN const char * key, IN const char * value){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    bool replaced = false;
+    char path[PATH_MAX] = {0};
+    char lock_path[PATH_MAX] = {0};
+    char line[CONFIG_LINE_MAX] = {0};
+    char parsed_line[CONFIG_LINE_MAX] = {0};
+    char * line_key = NULL;
+    char * line_value = NULL;
+    FILE * file = NULL;
+    FILE * lock_file = NULL;
+
+    return_value = config_path(path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    if(error_check < 0 || error_check >= sizeof(lock_path)){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    lock_file = fopenat(work_tree_fd(), lock_path, "w");
+    if(NULL == lock_file){
+        perror("CONFIG_SET: Fopenat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    file = fopenat(work_tree_fd(), path, "r");
+    errno = 0;
+    while(NULL != file && NULL != fgets(line, sizeof(line), file)){
+        memcpy(parsed_line, line, sizeof(line));
+        if(config_parse_line(parsed_line, &line_key, &line_value) && 0 == strcmp(line_key, key)){
+            if(!replaced){
+                fprintf(lock_file, "%s = %s\n", key, value);
+                replaced = true;
+            }
+            continue;
+        }
+        fputs(line, lock_file);
+    }
+
+    if(!replaced){
+        fprintf(lock_file, "%s = %s\n", key, value);
+    }
+
+    error_check = fclose(lock_file);
+    lock_file = NULL;
+    if(0 != error_check){
+        perror("CONFIG_SET: Fclose error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    error_check = renameat(work_tree_fd(), lock_path, work_tree_fd(), path);
+    if(-1 == error_check){
+        perror("CONFIG_SET: Renameat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_RENAME;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != file){
+        fclose(file);
+    }
+    if(NULL != lock_file){
+        fclose(lock_file);
+        unlinkat(work_tree_fd(), lock_path, 0);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints or sets a setting
+ * @param[IN] argc: The number of arguments
+ * @param[IN] argv: The key, and optionally the new value
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t config_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char value[CONFIG_LINE_MAX] = {0};
+
+    if(argc < 1){
+        printf("USAGE: config: <key> [value]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    if(argc >= 2){
+        return_value = config_set(argv[0], argv[1]);
+        goto cleanup;
+    }
+
+    return_value = config_get(argv[0], value, sizeof(value));
+    if(ERROR_CODE_SUCCESS == return_value){
+        printf("%s\n", value);
+    }
+
+cleanup:
+    return return_value;
+}
@@ -0,0 +1,1470 @@
+#include "slap_commands.h"
+
+#include <sys/mman.h>
+
+#define DIFF_COLOR(colors, code) ((colors) ? (code) : "")
+
+static const unsigned char diff_null_sha[SHA_DIGEST_LENGTH] = {0};
+
+/**
+ * @brief: Maps a file for reading
+ * @param[IN] fd: The file, or -1 for an empty side
+ * @param[OUT] side: The side to map the file into
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_map(IN int fd, OUT diff_side_t * side){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    void * data = NULL;
+    struct stat statbuf = {0};
+
+    if(-1 == fd){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("DIFF_MAP: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+    if(0 == statbuf.st_size){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == data){
+        perror("DIFF_MAP: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+
+    side->data = data;
+    side->size = statbuf.st_size;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Checks if a side looks binary
+ * @param[IN] side: The side
+ *
+ * @returns: true if there is a NUL in the first DIFF_BINARY_CHECK bytes
+ */
+static bool diff_is_binary(IN diff_side_t * side){
+    if(NULL == side->data){
+        return false;
+    }
+
+    return (NULL != memchr(side->data, '\0', min(side->size, (size_t)DIFF_BINARY_CHECK)));
+}
+
+/**
+ * @brief: Splits a side into lines
+ * @param[IN OUT] side: The mapped side
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Lines keep their newline, so a last line without one differs from the same line with one
+ */
+static error_code_t diff_split_lines(IN OUT diff_side_t * side){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    const char * position = NULL;
+    const char * end = NULL;
+
+    end = side->data + side->size;
+    for(position=side->data; position<end; position++){
+        position = memchr(position, '\n', end - position);
+        if(NULL == position){
+            position = end;
+        }
+        side->num_of_lines++;
+    }
+
+    side->lines = malloc((side->num_of_lines + 1) * sizeof(*side->lines));
+    side->ids = malloc((side->num_of_lines + 1) * sizeof(*side->ids));
+    side->changed = calloc(side->num_of_lines + 1, sizeof(*side->changed));
+    if(NULL == side->lines || NULL == side->ids || NULL == side->changed){
+        perror("DIFF_SPLIT_LINES: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0, position=side->data; position<end; i++, position++){
+        side->lines[i] = position;
+        position = memchr(position, '\n', end - position);
+        if(NULL == position){
+            position = end;
+        }
+    }
+    side->lines[side->num_of_lines] = end;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Numbers the distinct lines of both sides, so lines are compared by their number
+ * @param[IN OUT] a: The old side
+ * @param[IN OUT] b: The new side
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_classify(IN OUT diff_side_t * a, IN OUT diff_side_t * b){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    size_t length = 0;
+    size_t table_size = 1;
+    size_t mask = 0;
+    unsigned int hash = 0;
+    int next_id = 1;
+    diff_side_t * sides[2] = {a, b};
+    diff_class_t * table = NULL;
+
+    while(table_size < 2 * (a->num_of_lines + b->num_of_lines) + 1){
+        table_size <<= 1;
+    }
+    mask = table_size - 1;
+
+    table = calloc(table_size, sizeof(*table));
+    if(NULL == table){
+        perror("DIFF_CLASSIFY: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(k=0; k<2; k++){
+        for(i=0; i<sides[k]->num_of_lines; i++){
+            length = sides[k]->lines[i + 1] - sides[k]->lines[i];
+
+            /* FNV-1a */
+            hash = 2166136261u;
+            for(j=0; j<length; j++){
+                hash = (hash ^ (unsigned char)sides[k]->lines[i][j]) * 16777619u;
+            }
+
+            for(j=hash & mask; 0 != table[j].id; j=(j + 1) & mask){
+                if(table[j].hash == hash && table[j].length == length && 0 == memcmp(table[j].start, sides[k]->lines[i], length)){
+                    break;
+                }
+            }
+            if(0 == table[j].id){
+                table[j].start = sides[k]->lines[i];
+                table[j].length = length;
+                table[j].hash = hash;
+                table[j].id = next_id++;
+            }
+            sides[k]->ids[i] = table[j].id;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != table){
+        free(table);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Finds where a shortest edit script of a[xoff, xlim) into b[yoff, ylim) crosses its middle diagonal
+ * @param[IN] search: The lines and the diagonal vectors
+ * @param[IN] xoff: The first line of a
+ * @param[IN] xlim: The line after the last line of a
+ * @param[IN] yoff: The first line of b
+ * @param[IN] ylim: The line after the last line of b
+ * @param[OUT] xmid: The line of a to split at
+ * @param[OUT] ymid: The line of b to split at
+ *
+ * @notes: Myers' linear space middle snake, searching forward and backward at once. After
+ *         search->too_expensive steps the furthest reaching forward path is used as the split,
+ *         which bounds the cost on very different inputs at the price of a longer script.
+ */
+static void diff_middle_snake(IN diff_search_t * search, IN long xoff, IN long xlim, IN long yoff, IN long ylim,
+                              OUT long * xmid, OUT long * ymid){
+    long * forward = search->forward;
+    long * backward = search->backward;
+    long dmin = xoff - ylim;
+    long dmax = xlim - yoff;
+    long fmid = xoff - yoff;
+    long bmid = xlim - ylim;
+    long fmin = fmid;
+    long fmax = fmid;
+    long bmin = bmid;
+    long bmax = bmid;
+    long cost = 0;
+    long d = 0;
+    long x = 0;
+    long y = 0;
+    long best = 0;
+    bool odd = false;
+
+    odd = (0 != ((fmid - bmid) & 1));
+    forward[fmid] = xoff;
+    backward[bmid] = xlim;
+
+    for(cost=1; ; cost++){
+        if(fmin > dmin){
+            forward[--fmin - 1] = -1;
+        }
+        else{
+            fmin++;
+        }
+        if(fmax < dmax){
+            forward[++fmax + 1] = -1;
+        }
+        else{
+            fmax--;
+        }
+        for(d=fmax; d>=fmin; d-=2){
+            x = (forward[d - 1] >= forward[d + 1]) ? forward[d - 1] + 1 : forward[d + 1];
+            y = x - d;
+            while(x < xlim && y < ylim && search->a[x] == search->b[y]){
+                x++;
+                y++;
+            }
+            forward[d] = x;
+            if(odd && bmin <= d && d <= bmax && backward[d] <= x){
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        if(bmin > dmin){
+            backward[--bmin - 1] = LONG_MAX;
+        }
+        else{
+            bmin++;
+        }
+        if(bmax < dmax){
+            backward[++bmax + 1] = LONG_MAX;
+        }
+        else{
+            bmax--;
+        }
+        for(d=bmax; d>=bmin; d-=2){
+            x = (backward[d - 1] < backward[d + 1]) ? backward[d - 1] : backward[d + 1] - 1;
+            y = x - d;
+            while(x > xoff && y > yoff && search->a[x - 1] == search->b[y - 1]){
+                x--;
+                y--;
+            }
+            backward[d] = x;
+            if(!odd && fmin <= d && d <= fmax && x <= forward[d]){
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        if(cost >= search->too_expensive){
+            best = -1;
+            for(d=fmax; d>=fmin; d-=2){
+                x = min(forward[d], xlim);
+                y = x - d;
+                if(y > ylim){
+                    x = ylim + d;
+                    y = ylim;
+                }
+                if(x + y > best){
+                    best = x + y;
+                    *xmid = x;
+                    *ymid = y;
+                }
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * @brief: Marks the lines that a shortest edit script of a[xoff, xlim) into b[yoff, ylim) changes
+ * @param[IN] search: The lines, the diagonal vectors and the changed flags to set
+ * @param[IN] xoff: The first line of a
+ * @param[IN] xlim: The line after the last line of a
+ * @param[IN] yoff: The first line of b
+ * @param[IN] ylim: The line after the last line of b
+ */
+static void diff_compare(IN diff_search_t * search, IN long xoff, IN long xlim, IN long yoff, IN long ylim){
+    long xmid = 0;
+    long ymid = 0;
+
+    while(xoff < xlim && yoff < ylim && search->a[xoff] == search->b[yoff]){
+        xoff++;
+        yoff++;
+    }
+    while(xlim > xoff && ylim > yoff && search->a[xlim - 1] == search->b[ylim - 1]){
+        xlim--;
+        ylim--;
+    }
+
+    if(xoff == xlim){
+        memset(search->b_changed + yoff, 1, ylim - yoff);
+        return;
+    }
+    if(yoff == ylim){
+        memset(search->a_changed + xoff, 1, xlim - xoff);
+        return;
+    }
+
+    diff_middle_snake(search, xoff, xlim, yoff, ylim, &xmid, &ymid);
+    if((xmid == xoff && ymid == yoff) || (xmid == xlim && ymid == ylim)){
+        memset(search->a_changed + xoff, 1, xlim - xoff);
+        memset(search->b_changed + yoff, 1, ylim - yoff);
+        return;
+    }
+    diff_compare(search, xoff, xmid, yoff, ymid);
+    diff_compare(search, xmid, xlim, ymid, ylim);
+}
+
+/**
+ * @brief: Prints a line of a hunk
+ * @param[IN] side: The side the line is from
+ * @param[IN] line: The line
+ * @param[IN] prefix: ' ', '-' or '+'
+ * @param[IN] colors: Color the line
+ */
+static void diff_print_line(IN diff_side_t * side, IN size_t line, IN char prefix, IN bool colors){
+    size_t length = side->lines[line + 1] - side->lines[line];
+    const char * color = "";
+
+    if('-' == prefix){
+        color = DIFF_COLOR(colors, "\e[31m");
+    }
+    else if('+' == prefix){
+        color = DIFF_COLOR(colors, "\e[32m");
+    }
+
+    fputs(color, stdout);
+    putchar(prefix);
+    fwrite(side->lines[line], 1, length, stdout);
+    if(0 == length || '\n' != side->lines[line][length - 1]){
+        printf("\n\\ No newline at end of file\n");
+    }
+    if(' ' != prefix){
+        fputs(DIFF_COLOR(colors, "\e[0m"), stdout);
+    }
+}
+
+/**
+ * @brief: Prints the changed lines in unified hunks, with DIFF_CONTEXT lines of context
+ * @param[IN] a: The old side, with its changed lines marked
+ * @param[IN] b: The new side, with its changed lines marked
+ * @param[IN] colors: Color the output
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_print_hunks(IN diff_side_t * a, IN diff_side_t * b, IN bool colors){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t j = 0;
+    size_t line = 0;
+    size_t first = 0;
+    size_t last = 0;
+    size_t before = 0;
+    size_t after = 0;
+    size_t a_start = 0;
+    size_t b_start = 0;
+    size_t a_count = 0;
+    size_t b_count = 0;
+    size_t num_of_blocks = 0;
+    diff_block_t * blocks = NULL;
+
+    blocks = malloc((min(a->num_of_lines, b->num_of_lines) + 1) * sizeof(*blocks));
+    if(NULL == blocks){
+        perror("DIFF_PRINT_HUNKS: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    /* Unchanged lines of both sides pair up in order, so the changes are the runs between them */
+    while(i < a->num_of_lines || j < b->num_of_lines){
+        if((i < a->num_of_lines && a->changed[i]) || (j < b->num_of_lines && b->changed[j]) ||
+           i == a->num_of_lines || j == b->num_of_lines){
+            blocks[num_of_blocks].a_start = i;
+            blocks[num_of_blocks].b_start = j;
+            while(i < a->num_of_lines && (a->changed[i] || j == b->num_of_lines)){
+                i++;
+            }
+            while(j < b->num_of_lines && (b->changed[j] || i == a->num_of_lines)){
+                j++;
+            }
+            blocks[num_of_blocks].a_end = i;
+            blocks[num_of_blocks].b_end = j;
+            num_of_blocks++;
+            continue;
+        }
+        i++;
+        j++;
+    }
+
+    for(first=0; first<num_of_blocks; first=last + 1){
+        for(last=first; last + 1<num_of_blocks; last++){
+            if(blocks[last + 1].a_start - blocks[last].a_end > 2 * DIFF_CONTEXT){
+                break;
+            }
+        }
+
+        before = min(blocks[first].a_start - ((0 == first) ? 0 : blocks[first - 1].a_end), (size_t)DIFF_CONTEXT);
+        after = min(((last + 1 == num_of_blocks) ? a->num_of_lines : blocks[last + 1].a_start) - blocks[last].a_end, (size_t)DIFF_CONTEXT);
+        a_start = blocks[first].a_start - before;
+        b_start = blocks[first].b_start - before;
+        a_count = blocks[last].a_end + after - a_start;
+        b_count = blocks[last].b_end + after - b_start;
+
+        printf("%s@@ -%zu,%zu +%zu,%zu @@%s\n", DIFF_COLOR(colors, "\e[36m"),
+               (0 == a_count) ? a_start : a_start + 1, a_count,
+               (0 == b_count) ? b_start : b_start + 1, b_count, DIFF_COLOR(colors, "\e[0m"));
+
+        for(line=a_start; line<blocks[first].a_start; line++){
+            diff_print_line(a, line, ' ', colors);
+        }
+        for(i=first; i<=last; i++){
+            for(line=blocks[i].a_start; line<blocks[i].a_end; line++){
+                diff_print_line(a, line, '-', colors);
+            }
+            for(line=blocks[i].b_start; line<blocks[i].b_end; line++){
+                diff_print_line(b, line, '+', colors);
+            }
+            for(line=blocks[i].a_end; line<((i == last) ? blocks[i].a_end + after : blocks[i + 1].a_start); line++){
+                diff_print_line(a, line, ' ', colors);
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != blocks){
+        free(blocks);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints the differences between two versions of a file as a unified diff
+ * @param[IN] old_name: The path of the old version
+ * @param[IN] old_fd: The old version, or -1 if the file was added
+ * @param[IN] old_mode: The mode of the old version
+ * @param[IN] new_name: The path of the new version
+ * @param[IN] new_fd: The new version, or -1 if the file was removed
+ * @param[IN] new_mode: The mode of the new version
+ * @param[IN] extended: Header lines to print after the first one (for renames), or NULL
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Both versions are mapped rather than read, split into lines with memchr, and compared with
+ *         Myers' algorithm on line numbers. A version with a NUL in its first DIFF_BINARY_CHECK bytes
+ *         is only reported as binary.
+ */
+error_code_t diff_files(IN const char * old_name, IN int old_fd, IN mode_t old_mode,
+                        IN const char * new_name, IN int new_fd, IN mode_t new_mode, IN const char * extended){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    long num_of_diagonals = 0;
+    long i = 0;
+    bool colors = false;
+    long * diagonals = NULL;
+    diff_side_t a = {0};
+    diff_side_t b = {0};
+    diff_search_t search = {0};
+
+    colors = isatty(STDOUT_FILENO);
+
+    return_value = diff_map(old_fd, &a);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = diff_map(new_fd, &b);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("%sdiff --slap a/%s b/%s\n", DIFF_COLOR(colors, "\e[1m"), old_name, new_name);
+    if(NULL != extended){
+        fputs(extended, stdout);
+    }
+    if(-1 == old_fd){
+        printf("new file mode %o\n", new_mode);
+    }
+    else if(-1 == new_fd){
+        printf("deleted file mode %o\n", old_mode);
+    }
+    else if(old_mode != new_mode){
+        printf("old mode %o\nnew mode %o\n", old_mode, new_mode);
+    }
+
+    if(diff_is_binary(&a) || diff_is_binary(&b)){
+        printf("%sBinary files %s%s and %s%s differ\n", DIFF_COLOR(colors, "\e[0m"),
+               (-1 == old_fd) ? "/dev/null" : "a/", (-1 == old_fd) ? "" : old_name,
+               (-1 == new_fd) ? "/dev/null" : "b/", (-1 == new_fd) ? "" : new_name);
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = diff_split_lines(&a);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = diff_split_lines(&b);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = diff_classify(&a, &b);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    /* Diagonals run from -(lines of b) - 1 to (lines of a) + 1 */
+    num_of_diagonals = a.num_of_lines + b.num_of_lines + 3;
+    diagonals = malloc(2 * num_of_diagonals * sizeof(*diagonals));
+    if(NULL == diagonals){
+        perror("DIFF_FILES: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    search.a = a.ids;
+    search.b = b.ids;
+    search.a_changed = a.changed;
+    search.b_changed = b.changed;
+    search.forward = diagonals + b.num_of_lines + 1;
+    search.backward = diagonals + num_of_diagonals + b.num_of_lines + 1;
+    search.too_expensive = 1;
+    for(i=num_of_diagonals; 0 != i; i>>=2){
+        search.too_expensive <<= 1;
+    }
+    search.too_expensive = max(search.too_expensive, DIFF_MIN_COST);
+
+    diff_compare(&search, 0, a.num_of_lines, 0, b.num_of_lines);
+
+    /* Only the mode changed */
+    if(NULL == memchr(a.changed, 1, a.num_of_lines) && NULL == memchr(b.changed, 1, b.num_of_lines)){
+        fputs(DIFF_COLOR(colors, "\e[0m"), stdout);
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    printf("--- %s%s\n+++ %s%s%s\n",
+           (-1 == old_fd) ? "/dev/null" : "a/", (-1 == old_fd) ? "" : old_name,
+           (-1 == new_fd) ? "/dev/null" : "b/", (-1 == new_fd) ? "" : new_name, DIFF_COLOR(colors, "\e[0m"));
+
+    return_value = diff_print_hunks(&a, &b, colors);
+
+cleanup:
+    if(NULL != diagonals){
+        free(diagonals);
+    }
+    if(NULL != a.data){
+        munmap((void *)a.data, a.size);
+    }
+    if(NULL != b.data){
+        munmap((void *)b.data, b.size);
+    }
+    free(a.lines);
+    free(a.ids);
+    free(a.changed);
+    free(b.lines);
+    free(b.ids);
+    free(b.changed);
+
+    return return_value;
+}
+
+/**
+ * @brief: Opens an object for diffing
+ * @param[IN] hash: The sha of the object, all zeros for none
+ * @param[OUT] fd: The object, or -1 if there is none
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_open_object(IN const unsigned char * hash, OUT int * fd){
+    *fd = -1;
+
+    if(0 == memcmp(hash, diff_null_sha, SHA_DIGEST_LENGTH)){
+        return ERROR_CODE_SUCCESS;
+    }
+
+    return open_object(hash, O_RDONLY, 0, fd);
+}
+
+/**
+ * @brief: Prints the differences between two objects
+ * @param[IN] old_name: The path of the old version
+ * @param[IN] old_hash: The sha of the old version, all zeros if the file was added
+ * @param[IN] old_mode: The mode of the old version
+ * @param[IN] new_name: The path of the new version
+ * @param[IN] new_hash: The sha of the new version, all zeros if the file was removed
+ * @param[IN] new_mode: The mode of the new version
+ * @param[IN] extended: Header lines to print after the first one (for renames), or NULL
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_objects(IN const char * old_name, IN const unsigned char * old_hash, IN mode_t old_mode,
+                                 IN const char * new_name, IN const unsigned char * new_hash, IN mode_t new_mode,
+                                 IN const char * extended){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int old_fd = -1;
+    int new_fd = -1;
+
+    return_value = diff_open_object(old_hash, &old_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = diff_open_object(new_hash, &new_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = diff_files(old_name, old_fd, old_mode, new_name, new_fd, new_mode, extended);
+
+cleanup:
+    if(-1 != old_fd){
+        close(old_fd);
+    }
+    if(-1 != new_fd){
+        close(new_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints the differences between the staged files and the working directory
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The index is refreshed first, like in status, and only files whose working directory sha
+ *         differs from the staged one are read. Deleted files are printed as a deletion hunk.
+ */
+error_code_t diff_worktree(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int old_fd = -1;
+    int new_fd = -1;
+    int difference = 0;
+    size_t i = 0;
+    size_t num_of_entries = 0;
+    unsigned char deleted_sha[SHA_DIGEST_LENGTH] = {0};
+    struct stat statbuf = {0};
+    index_file_segement_t * entries = NULL;
+    fsmonitor_result_t fsmonitor_result = {0};
+
+    TRACE_BEGIN("diff_worktree");
+
+    return_value = fsmonitor_query(&fsmonitor_result);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = refresh_index(&fsmonitor_result);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = index_cache_entries(&entries, &num_of_entries);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_entries; i++){
+        difference = memcmp(entries[i].wdir_sha, entries[i].stage_sha, SHA_DIGEST_LENGTH);
+        if(0 == difference){
+            continue;
+        }
+
+        return_value = diff_open_object(entries[i].stage_sha, &old_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        /* refresh_index zeroes the working directory sha of deleted files, they are diffed against /dev/null */
+        statbuf.st_mode = entries[i].mode;
+        errno = ENOENT;
+        if(0 != memcmp(entries[i].wdir_sha, deleted_sha, SHA_DIGEST_LENGTH)){
+            new_fd = openat(work_tree_fd(), entries[i].name, O_RDONLY);
+        }
+        if(-1 == new_fd && ENOENT != errno){
+            perror("DIFF_WORKTREE: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+        if(-1 != new_fd && -1 == fstat(new_fd, &statbuf)){
+            perror("DIFF_WORKTREE: Fstat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            goto cleanup;
+        }
+        errno = 0;
+
+        return_value = diff_files(entries[i].name, old_fd, entries[i].mode, entries[i].name, new_fd, statbuf.st_mode, NULL);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        if(-1 != old_fd){
+            close(old_fd);
+            old_fd = -1;
+        }
+        if(-1 != new_fd){
+            close(new_fd);
+            new_fd = -1;
+        }
+    }
+
+    return_value = fsmonitor_save_token(&fsmonitor_result);
+
+cleanup:
+    if(-1 != old_fd){
+        close(old_fd);
+    }
+    if(-1 != new_fd){
+        close(new_fd);
+    }
+    fsmonitor_free_result(&fsmonitor_result);
+    TRACE_END("diff_worktree");
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints the differences between the last commit and the staged files
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only the index is read, and only files whose staged sha differs from the committed one are diffed
+ */
+error_code_t diff_cached(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int difference = 0;
+    size_t i = 0;
+    size_t num_of_entries = 0;
+    index_file_segement_t * entries = NULL;
+
+    TRACE_BEGIN("diff_cached");
+
+    return_value = index_cache_entries(&entries, &num_of_entries);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_entries; i++){
+        difference = memcmp(entries[i].stage_sha, entries[i].repo_sha, SHA_DIGEST_LENGTH);
+        if(0 == difference){
+            continue;
+        }
+
+        return_value = diff_objects(entries[i].name, entries[i].repo_sha, entries[i].mode,
+                                    entries[i].name, entries[i].stage_sha, entries[i].mode, NULL);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    TRACE_END("diff_cached");
+
+    return return_value;
+}
+
+/**
+ * @brief: Orders commit entries by path
+ */
+static int diff_entry_compare(IN const void * first, IN const void * second){
+    const commit_entry_t * a = first;
+    const commit_entry_t * b = second;
+    int difference = 0;
+
+    difference = memcmp(a->name, b->name, min(a->name_len, b->name_len));
+    if(0 != difference){
+        return difference;
+    }
+
+    return a->name_len - b->name_len;
+}
+
+/**
+ * @brief: Opens a commit for reading its entries in path order
+ * @param[IN] commit: The commit, as given to resolve_commit
+ * @param[OUT] tree: The commit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The commit object is mapped, and its entries are checked to be in order in one pass. commit
+ *         writes them sorted, so only commits made before that are sorted here, in memory.
+ */
+static error_code_t diff_tree_open(IN const char * commit, OUT diff_tree_t * tree){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    int num_of_parents = 0;
+    size_t offset = 0;
+    size_t num_of_entries = 0;
+    bool sorted = true;
+    void * data = NULL;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    const unsigned char * parents = NULL;
+    struct stat statbuf = {0};
+    commit_entry_t previous = {0};
+    commit_entry_t entry = {0};
+
+    return_value = resolve_commit(commit, hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = open_object(hash, O_RDONLY, 0, &fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("DIFF_TREE_OPEN: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(statbuf.st_size > 0){
+        data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED == data){
+            perror("DIFF_TREE_OPEN: Mmap error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        tree->data = data;
+        tree->size = statbuf.st_size;
+    }
+
+    return_value = commit_parents(tree->data, tree->size, &num_of_parents, &parents);
+    if(ERROR_CODE_SUCCESS != return_value){
+        printf("\e[31m%s is not a commit.\e[0m\n", commit);
+        goto cleanup;
+    }
+    tree->offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+
+    offset = tree->offset;
+    while(ERROR_CODE_SUCCESS == (return_value = commit_next_entry(tree->data, tree->size, &offset, &entry))){
+        if(0 != num_of_entries && diff_entry_compare(&previous, &entry) > 0){
+            sorted = false;
+        }
+        previous = entry;
+        num_of_entries++;
+    }
+    if(ERROR_CODE_EOF != return_value){
+        printf("\e[31m%s is not a commit.\e[0m\n", commit);
+        goto cleanup;
+    }
+
+    if(!sorted){
+        tree->sorted = malloc(num_of_entries * sizeof(*tree->sorted));
+        if(NULL == tree->sorted){
+            perror("DIFF_TREE_OPEN: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        offset = tree->offset;
+        while(ERROR_CODE_SUCCESS == commit_next_entry(tree->data, tree->size, &offset, &tree->sorted[tree->num_of_sorted])){
+            tree->num_of_sorted++;
+        }
+        qsort(tree->sorted, tree->num_of_sorted, sizeof(*tree->sorted), diff_entry_compare);
+    }
+    else{
+        madvise(data, tree->size, MADV_SEQUENTIAL);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets the next entry of a commit in path order
+ * @param[IN OUT] tree: The commit
+ * @param[OUT] entry: The entry
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_EOF after the last entry
+ */
+static error_code_t diff_tree_next(IN OUT diff_tree_t * tree, OUT commit_entry_t * entry){
+    if(NULL != tree->sorted){
+        if(tree->position == tree->num_of_sorted){
+            return ERROR_CODE_EOF;
+        }
+        *entry = tree->sorted[tree->position++];
+        return ERROR_CODE_SUCCESS;
+    }
+
+    return commit_next_entry(tree->data, tree->size, &tree->offset, entry);
+}
+
+/**
+ * @brief: Closes a commit opened with diff_tree_open
+ * @param[IN OUT] tree: The commit
+ */
+static void diff_tree_close(IN OUT diff_tree_t * tree){
+    if(NULL != tree->data){
+        munmap(tree->data, tree->size);
+        tree->data = NULL;
+    }
+    if(NULL != tree->sorted){
+        free(tree->sorted);
+        tree->sorted = NULL;
+    }
+}
+
+/**
+ * @brief: Orders changes by the path they are reported under
+ */
+static int diff_change_compare(IN const void * first, IN const void * second){
+    const diff_change_t * a = first;
+    const diff_change_t * b = second;
+
+    return diff_entry_compare((NULL == a->new_entry.sha) ? &a->old_entry : &a->new_entry,
+                              (NULL == b->new_entry.sha) ? &b->old_entry : &b->new_entry);
+}
+
+/**
+ * @brief: Orders rename sources by sha, removed paths first
+ */
+static int diff_source_compare(IN const void * first, IN const void * second){
+    const diff_source_t * a = first;
+    const diff_source_t * b = second;
+    int difference = 0;
+
+    difference = memcmp(a->sha, b->sha, SHA_DIGEST_LENGTH);
+    if(0 != difference){
+        return difference;
+    }
+
+    return b->removed - a->removed;
+}
+
+/**
+ * @brief: Orders LSH band entries by key
+ */
+static int diff_band_compare(IN const void * first, IN const void * second){
+    const diff_band_t * a = first;
+    const diff_band_t * b = second;
+
+    return (a->key > b->key) - (a->key < b->key);
+}
+
+/**
+ * @brief: Orders rename candidates by similarity, best first
+ */
+static int diff_candidate_compare(IN const void * first, IN const void * second){
+    const diff_candidate_t * a = first;
+    const diff_candidate_t * b = second;
+
+    if(a->score != b->score){
+        return b->score - a->score;
+    }
+    if(a->target != b->target){
+        return (a->target > b->target) - (a->target < b->target);
+    }
+
+    return (a->source > b->source) - (a->source < b->source);
+}
+
+/**
+ * @brief: Turns an added path into a rename or a copy of a source
+ * @param[IN OUT] changes: The changes
+ * @param[IN] target: The change of the added path
+ * @param[IN] source: The change whose old version it came from
+ * @param[IN OUT] claimed: Set for removed paths that were renamed
+ * @param[IN] copies: Allow copies
+ * @param[IN] score: The similarity, in percent
+ *
+ * @returns: true if the target was paired
+ * @notes: A removed path is renamed to the first target paired with it, later targets copy it
+ */
+static bool diff_pair(IN OUT diff_change_t * changes, IN size_t target, IN size_t source, IN OUT char * claimed,
+                      IN bool copies, IN int score){
+    if('D' == changes[source].status && !claimed[source]){
+        claimed[source] = true;
+        changes[target].status = 'R';
+    }
+    else if(copies){
+        changes[target].status = 'C';
+    }
+    else{
+        return false;
+    }
+
+    changes[target].old_entry = changes[source].old_entry;
+    changes[target].score = score;
+
+    return true;
+}
+
+/**
+ * @brief: Finds the added paths that are renames or copies of other paths
+ * @param[IN OUT] changes: The changes between two commits
+ * @param[IN OUT] num_of_changes: The number of changes, less the removed paths that turned out to be renamed
+ * @param[IN] copies: Also find copies of paths that were modified or already renamed
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Identical shas are paired first by sorting the sources by sha, without reading any blob.
+ *         The rest are compared through their MinHash sketches (see sketch.h): every source is put in
+ *         SKETCH_BANDS buckets by the hashes of the bands of its sketch, and a target is only compared
+ *         with the sources that share a bucket with it. The candidates at least DIFF_RENAME_THRESHOLD
+ *         percent similar are paired best first.
+ */
+static error_code_t diff_find_renames(IN OUT diff_change_t * changes, IN OUT size_t * num_of_changes, IN bool copies){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int band = 0;
+    int score = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t low = 0;
+    size_t high = 0;
+    size_t middle = 0;
+    size_t num_of_sources = 0;
+    size_t num_of_targets = 0;
+    size_t num_of_bands = 0;
+    size_t num_of_candidates = 0;
+    size_t candidates_capacity = 0;
+    uint64_t key = 0;
+    char * claimed = NULL;
+    size_t * targets = NULL;
+    size_t * seen = NULL;
+    diff_source_t * sources = NULL;
+    sketch_t * source_sketches = NULL;
+    sketch_t * target_sketches = NULL;
+    diff_band_t * bands = NULL;
+    diff_candidate_t * candidates = NULL;
+    diff_candidate_t * new_candidates = NULL;
+
+    claimed = calloc(*num_of_changes + 1, sizeof(*claimed));
+    sources = malloc((*num_of_changes + 1) * sizeof(*sources));
+    targets = malloc((*num_of_changes + 1) * sizeof(*targets));
+    if(NULL == claimed || NULL == sources || NULL == targets){
+        perror("DIFF_FIND_RENAMES: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<*num_of_changes; i++){
+        if('A' == changes[i].status){
+            continue;
+        }
+        if('D' != changes[i].status && !copies){
+            continue;
+        }
+        sources[num_of_sources].sha = changes[i].old_entry.sha;
+        sources[num_of_sources].change = i;
+        sources[num_of_sources].removed = ('D' == changes[i].status);
+        num_of_sources++;
+    }
+    qsort(sources, num_of_sources, sizeof(*sources), diff_source_compare);
+
+    /* Identical shas */
+    for(i=0; i<*num_of_changes; i++){
+        if('A' != changes[i].status){
+            continue;
+        }
+
+        for(low=0, high=num_of_sources; low<high; ){
+            middle = low + (high - low) / 2;
+            if(memcmp(sources[middle].sha, changes[i].new_entry.sha, SHA_DIGEST_LENGTH) < 0){
+                low = middle + 1;
+            }
+            else{
+                high = middle;
+            }
+        }
+
+        for(j=low; j<num_of_sources && 0 == memcmp(sources[j].sha, changes[i].new_entry.sha, SHA_DIGEST_LENGTH); j++){
+            if(sources[j].removed && !claimed[sources[j].change]){
+                diff_pair(changes, i, sources[j].change, claimed, copies, 100);
+                break;
+            }
+        }
+        if('A' == changes[i].status && copies && low < num_of_sources &&
+           0 == memcmp(sources[low].sha, changes[i].new_entry.sha, SHA_DIGEST_LENGTH)){
+            diff_pair(changes, i, sources[low].change, claimed, copies, 100);
+        }
+        if('A' == changes[i].status){
+            targets[num_of_targets++] = i;
+        }
+    }
+
+    if(0 == num_of_targets || 0 == num_of_sources){
+        goto compact;
+    }
+
+    /* Similar contents */
+    source_sketches = malloc(num_of_sources * sizeof(*source_sketches));
+    target_sketches = malloc(num_of_targets * sizeof(*target_sketches));
+    bands = malloc(num_of_sources * SKETCH_BANDS * sizeof(*bands));
+    seen = calloc(num_of_sources, sizeof(*seen));
+    if(NULL == source_sketches || NULL == target_sketches || NULL == bands || NULL == seen){
+        perror("DIFF_FIND_RENAMES: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_sources; i++){
+        if(sources[i].removed && claimed[sources[i].change] && !copies){
+            continue;
+        }
+
+        return_value = sketch_get(sources[i].sha, &source_sketches[i]);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(sketch_is_empty(&source_sketches[i])){
+            continue;
+        }
+
+        for(band=0; band<SKETCH_BANDS; band++){
+            bands[num_of_bands].key = sketch_band(&source_sketches[i], band);
+            bands[num_of_bands].source = i;
+            num_of_bands++;
+        }
+    }
+    qsort(bands, num_of_bands, sizeof(*bands), diff_band_compare);
+
+    for(i=0; i<num_of_targets; i++){
+        return_value = sketch_get(changes[targets[i]].new_entry.sha, &target_sketches[i]);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(sketch_is_empty(&target_sketches[i])){
+            continue;
+        }
+
+        for(band=0; band<SKETCH_BANDS; band++){
+            key = sketch_band(&target_sketches[i], band);
+            for(low=0, high=num_of_bands; low<high; ){
+                middle = low + (high - low) / 2;
+                if(bands[middle].key < key){
+                    low = middle + 1;
+                }
+                else{
+                    high = middle;
+                }
+            }
+
+            for(j=low; j<num_of_bands && bands[j].key == key; j++){
+                if(seen[bands[j].source] == i + 1){
+                    continue;
+                }
+                seen[bands[j].source] = i + 1;
+
+                score = sketch_similarity(&source_sketches[bands[j].source], &target_sketches[i]);
+                if(score < DIFF_RENAME_THRESHOLD){
+                    continue;
+                }
+
+                if(num_of_candidates == candidates_capacity){
+                    candidates_capacity = max(2 * candidates_capacity, 256);
+                    new_candidates = realloc(candidates, candidates_capacity * sizeof(*candidates));
+                    if(NULL == new_candidates){
+                        perror("DIFF_FIND_RENAMES: Realloc error");
+                        printf("(Errno: %i)\n", errno);
+                        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                        goto cleanup;
+                    }
+                    candidates = new_candidates;
+                }
+                candidates[num_of_candidates].score = score;
+                candidates[num_of_candidates].target = targets[i];
+                candidates[num_of_candidates].source = sources[bands[j].source].change;
+                num_of_candidates++;
+            }
+        }
+    }
+
+    qsort(candidates, num_of_candidates, sizeof(*candidates), diff_candidate_compare);
+    for(i=0; i<num_of_candidates; i++){
+        if('A' != changes[candidates[i].target].status){
+            continue;
+        }
+        /* Only identical shas are 100% similar */
+        diff_pair(changes, candidates[i].target, candidates[i].source, claimed, copies, min(candidates[i].score, 99));
+    }
+
+compact:
+    for(i=0, j=0; i<*num_of_changes; i++){
+        if('D' == changes[i].status && claimed[i]){
+            continue;
+        }
+        changes[j++] = changes[i];
+    }
+    *num_of_changes = j;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    free(claimed);
+    free(sources);
+    free(targets);
+    free(seen);
+    free(source_sketches);
+    free(target_sketches);
+    free(bands);
+    free(candidates);
+
+    return return_value;
+}
+
+/**
+ * @brief: Reports one path of a comparison between two commits
+ * @param[IN] change: The change
+ * @param[IN] name_status: Only print the path with A (added), D (removed), M (modified), T (mode changed),
+ *                         or R (renamed) and C (copied) followed by the similarity and the old path
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t diff_report(IN diff_change_t * change, IN bool name_status){
+    int error_check = 0;
+    char old_name[PATH_MAX] = {0};
+    char new_name[PATH_MAX] = {0};
+    char extended[3 * PATH_MAX] = {0};
+    const commit_entry_t * old_entry = &change->old_entry;
+    const commit_entry_t * new_entry = &change->new_entry;
+
+    if(NULL == old_entry->sha){
+        old_entry = new_entry;
+    }
+    if(NULL == new_entry->sha){
+        new_entry = old_entry;
+    }
+
+    if(name_status && ('R' == change->status || 'C' == change->status)){
+        printf("%c%03d\t%.*s\t%.*s\n", change->status, change->score, old_entry->name_len, old_entry->name,
+               new_entry->name_len, new_entry->name);
+        return ERROR_CODE_SUCCESS;
+    }
+    if(name_status){
+        printf("%c\t%.*s\n", change->status, new_entry->name_len, new_entry->name);
+        return ERROR_CODE_SUCCESS;
+    }
+
+    memcpy(old_name, old_entry->name, old_entry->name_len);
+    old_name[old_entry->name_len] = '\0';
+    memcpy(new_name, new_entry->name, new_entry->name_len);
+    new_name[new_entry->name_len] = '\0';
+
+    if('R' == change->status || 'C' == change->status){
+        error_check = snprintf(extended, sizeof(extended), "similarity index %d%%\n%s from %s\n%s to %s\n", change->score,
+                               ('R' == change->status) ? "rename" : "copy", old_name,
+                               ('R' == change->status) ? "rename" : "copy", new_name);
+        if(error_check < 0 || (size_t)error_check >= sizeof(extended)){
+            return ERROR_CODE_COULDNT_SPRINTF;
+        }
+    }
+
+    return diff_objects(old_name, (NULL == change->old_entry.sha) ? diff_null_sha : change->old_entry.sha, change->old_entry.mode,
+                        new_name, (NULL == change->new_entry.sha) ? diff_null_sha : change->new_entry.sha, change->new_entry.mode,
+                        ('\0' == extended[0]) ? NULL : extended);
+}
+
+/**
+ * @brief: Prints the differences between two commits
+ * @param[IN] old_commit: The old commit, as given to resolve_commit
+ * @param[IN] new_commit: The new commit, as given to resolve_commit
+ * @param[IN] name_status: Only print the changed paths and how they changed
+ * @param[IN] renames: Whether to find renames, or renames and copies
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The entries of both commits are merge joined in path order, holding one entry of each at a
+ *         time. Entries with the same sha and mode are skipped without reading them, and with
+ *         name_status no blob is read at all. To find renames the changes are kept until the join
+ *         ends, and then reported sorted by path.
+ */
+error_code_t diff_commits(IN const char * old_commit, IN const char * new_commit, IN bool name_status, IN diff_renames_t renames){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    error_code_t old_result = ERROR_CODE_UNINITIALIZED;
+    error_code_t new_result = ERROR_CODE_UNINITIALIZED;
+    int difference = 0;
+    size_t i = 0;
+    size_t num_of_changes = 0;
+    size_t changes_capacity = 0;
+    commit_entry_t old_entry = {0};
+    commit_entry_t new_entry = {0};
+    diff_change_t change = {0};
+    diff_change_t * changes = NULL;
+    diff_change_t * new_changes = NULL;
+    diff_tree_t old_tree = {0};
+    diff_tree_t new_tree = {0};
+
+    TRACE_BEGIN("diff_commits");
+
+    return_value = diff_tree_open(old_commit, &old_tree);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    return_value = diff_tree_open(new_commit, &new_tree);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    old_result = diff_tree_next(&old_tree, &old_entry);
+    new_result = diff_tree_next(&new_tree, &new_entry);
+    while(ERROR_CODE_SUCCESS == old_result || ERROR_CODE_SUCCESS == new_result){
+        if(ERROR_CODE_SUCCESS != old_result){
+            difference = 1;
+        }
+        else if(ERROR_CODE_SUCCESS != new_result){
+            difference = -1;
+        }
+        else{
+            difference = diff_entry_compare(&old_entry, &new_entry);
+        }
+
+        memset(&change, 0, sizeof(change));
+        if(difference < 0){
+            change.old_entry = old_entry;
+            change.status = 'D';
+            old_result = diff_tree_next(&old_tree, &old_entry);
+        }
+        else if(difference > 0){
+            change.new_entry = new_entry;
+            change.status = 'A';
+            new_result = diff_tree_next(&new_tree, &new_entry);
+        }
+        else{
+            if(0 != memcmp(old_entry.sha, new_entry.sha, SHA_DIGEST_LENGTH)){
+                change.status = 'M';
+            }
+            else if(old_entry.mode != new_entry.mode){
+                change.status = 'T';
+            }
+            change.old_entry = old_entry;
+            change.new_entry = new_entry;
+            old_result = diff_tree_next(&old_tree, &old_entry);
+            new_result = diff_tree_next(&new_tree, &new_entry);
+        }
+        if(0 == change.status){
+            continue;
+        }
+
+        if(DIFF_RENAMES_NONE == renames){
+            return_value = diff_report(&change, name_status);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+            continue;
+        }
+
+        if(num_of_changes == changes_capacity){
+            changes_capacity = max(2 * changes_capacity, 64);
+            new_changes = realloc(changes, changes_capacity * sizeof(*changes));
+            if(NULL == new_changes){
+                perror("DIFF_COMMITS: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                goto cleanup;
+            }
+            changes = new_changes;
+        }
+        changes[num_of_changes++] = change;
+    }
+
+    if(DIFF_RENAMES_NONE != renames){
+        return_value = diff_find_renames(changes, &num_of_changes, DIFF_RENAMES_COPIES == renames);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        qsort(changes, num_of_changes, sizeof(*changes), diff_change_compare);
+        for(i=0; i<num_of_changes; i++){
+            return_value = diff_report(&changes[i], name_status);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != changes){
+        free(changes);
+    }
+    diff_tree_close(&old_tree);
+    diff_tree_close(&new_tree);
+    TRACE_END("diff_commits");
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the diff command
+ * @param[IN] argc: The number of arguments (after diff)
+ * @param[IN] argv: The arguments: nothing | --cached | [--name-status] [-M|-C] <commit> <commit>
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t diff_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    bool name_status = false;
+    diff_renames_t renames = DIFF_RENAMES_NONE;
+
+    for(i=0; i<argc && '-' == argv[i][0]; i++){
+        if(0 == valid_strncmp(argv[i], "--name-status")){
+            name_status = true;
+        }
+        else if(0 == valid_strncmp(argv[i], "-M")){
+            renames = max(renames, DIFF_RENAMES_RENAMES);
+        }
+        else if(0 == valid_strncmp(argv[i], "-C")){
+            renames = DIFF_RENAMES_COPIES;
+        }
+        else if(0 == valid_strncmp(argv[i], "--cached") && 1 == argc){
+            return_value = diff_cached();
+            goto cleanup;
+        }
+        else{
+            break;
+        }
+    }
+
+    if(0 == argc){
+        return_value = diff_worktree();
+    }
+    else if(2 == argc - i){
+        return_value = diff_commits(argv[i], argv[i + 1], name_status, renames);
+    }
+    else{
+        printf("USAGE: diff: [--cached | [--name-status] [-M|-C] <commit> <commit>]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+cleanup:
+    fflush(stdout);
+
+    return return_value;
+}
@@ -0,0 +1,271 @@
+#include "slap_commands.h"
+
+#include <libgen.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief: Gets the durability mode of the repository (core.fsync)
+ *
+ * @returns: The durability mode
+ * @notes: none never syncs, batch (the default) syncs every new object with one syncfs before the
+ *         index and HEAD are synced, and full syncs every object as it is written.
+ */
+fsync_mode_t get_fsync_mode(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char value[CONFIG_LINE_MAX] = {0};
+    durability_cache_t * cache = &repository_state()->durability;
+
+    if(cache->fsync_mode_loaded){
+        goto cleanup;
+    }
+    cache->fsync_mode_loaded = true;
+
+    return_value = config_get("core.fsync", value, sizeof(value));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(0 == valid_strncmp(value, "none")){
+        cache->fsync_mode = FSYNC_MODE_NONE;
+    }
+    else if(0 == valid_strncmp(value, "batch")){
+        cache->fsync_mode = FSYNC_MODE_BATCH;
+    }
+    else if(0 == valid_strncmp(value, "full")){
+        cache->fsync_mode = FSYNC_MODE_FULL;
+    }
+    else{
+        printf("\e[38;2;255;150;0mUnknown core.fsync mode %s, using batch.\e[0m\n", value);
+    }
+
+cleanup:
+    return cache->fsync_mode;
+}
+
+/**
+ * @brief: Forgets the durability mode, so core.fsync is read again on its next use
+ */
+void reset_fsync_mode(){
+    durability_cache_t * cache = &repository_state()->durability;
+
+    cache->fsync_mode_loaded = false;
+    cache->fsync_mode = FSYNC_MODE_BATCH;
+}
+
+/**
+ * @brief: Makes a newly written object durable according to the durability mode
+ * @param[IN] object_fd: The file descriptor of the object, or -1 if its contents were already synced
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: In batch mode nothing is synced here, the object is synced by the next sync_objects
+ */
+error_code_t sync_new_object(IN int object_fd, IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    durability_cache_t * cache = &repository_state()->durability;
+
+    switch(get_fsync_mode()){
+    case FSYNC_MODE_NONE:
+        break;
+
+    case FSYNC_MODE_BATCH:
+        cache->objects_pending = true;
+        break;
+
+    case FSYNC_MODE_FULL:
+        if(-1 != object_fd){
+            error_check = fsync(object_fd);
+            if(-1 == error_check){
+                perror("SYNC_NEW_OBJECT: Fsync error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_WRITE;
+                goto cleanup;
+            }
+            TRACE_COUNT_SYNC();
+        }
+
+        return_value = object_fanout_fd(hash[0], false, &dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = fsync(dir_fd);
+        if(-1 == error_check){
+            perror("SYNC_NEW_OBJECT: Fsync error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        TRACE_COUNT_SYNC();
+
+        return_value = object_dir_fd(&dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = fsync(dir_fd);
+        if(-1 == error_check){
+            perror("SYNC_NEW_OBJECT: Fsync error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        TRACE_COUNT_SYNC();
+        break;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Makes every object written since the last call durable, then records them in the object index
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: In batch mode a single syncfs on the objects directory replaces an fsync per object
+ */
+error_code_t sync_objects(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    durability_cache_t * cache = &repository_state()->durability;
+
+    if(cache->objects_pending){
+        return_value = object_dir_fd(&dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = syscall(SYS_syncfs, dir_fd);
+        if(-1 == error_check){
+            perror("SYNC_OBJECTS: Syncfs error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        TRACE_COUNT_SYNC();
+
+        cache->objects_pending = false;
+    }
+
+    return_value = object_index_flush();
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Syncs a file (such as the index) unless the durability mode is none
+ * @param[IN] fd: The file descriptor of the file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t sync_file(IN int fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    if(FSYNC_MODE_NONE != get_fsync_mode()){
+        error_check = fsync(fd);
+        if(-1 == error_check){
+            perror("SYNC_FILE: Fsync error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+        TRACE_COUNT_SYNC();
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Atomically replaces the contents of a file (such as HEAD)
+ * @param[IN] path: The path to the file
+ * @param[IN] data: The new contents
+ * @param[IN] length: The length of the new contents
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The contents are written to a lock file, synced, and renamed over the file, after which
+ *         the parent directory is synced. After a crash the file holds either the old or the new contents.
+ */
+error_code_t replace_file(IN const char * path, IN const void * data, IN size_t length){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int lock_fd = -1;
+    int dir_fd = -1;
+    char lock_path[PATH_MAX] = {0};
+    char dir_path[PATH_MAX] = {0};
+
+    error_check = snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    if(error_check < 0 || error_check >= sizeof(lock_path)){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    lock_fd = openat(work_tree_fd(), lock_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == lock_fd){
+        perror("REPLACE_FILE: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = write(lock_fd, data, length);
+    if(length != error_check){
+        perror("REPLACE_FILE: Write error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = sync_file(lock_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = renameat(work_tree_fd(), lock_path, work_tree_fd(), path);
+    if(-1 == error_check){
+        perror("REPLACE_FILE: Renameat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_RENAME;
+        goto cleanup;
+    }
+
+    if(FSYNC_MODE_NONE != get_fsync_mode()){
+        snprintf(dir_path, sizeof(dir_path), "%s", path);
+        dir_fd = openat(work_tree_fd(), dirname(dir_path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(-1 == dir_fd){
+            perror("REPLACE_FILE: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+
+        return_value = sync_file(dir_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != lock_fd){
+        close(lock_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            unlinkat(work_tree_fd(), lock_path, 0);
+        }
+    }
+    if(-1 != dir_fd){
+        close(dir_fd);
+    }
+
+    return return_value;
+}
@@ -0,0 +1,550 @@
+#include "slap_commands.h"
+
+#include <pthread.h>
+#include <time.h>
+
+typedef struct fsck_context_s{
+    unsigned char * shas;
+    size_t num_of_shas;
+    size_t capacity;
+    size_t sample;
+    size_t seen;
+    unsigned long long random_state;
+    size_t next;
+    size_t problems;
+    pthread_mutex_t output_lock;
+}fsck_context_t;
+
+static const unsigned char null_sha[SHA_DIGEST_LENGTH] = {0};
+
+/**
+ * @brief: Reports a problem
+ * @param[IN] context: The context of the check
+ * @param[IN] problem: What is wrong
+ * @param[IN] hash: The sha of the object the problem is about
+ * @param[IN] detail: More information (a path or a sha), or NULL
+ *
+ * @notes: Safe to call from the worker threads
+ */
+static void fsck_report(IN fsck_context_t * context, IN const char * problem, IN const unsigned char * hash, IN const char * detail){
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+
+    sha_to_hex(hash, hex);
+
+    pthread_mutex_lock(&context->output_lock);
+    if(NULL != detail){
+        printf("\e[31m%s %s (%s)\e[0m\n", problem, hex, detail);
+    }
+    else{
+        printf("\e[31m%s %s\e[0m\n", problem, hex);
+    }
+    context->problems++;
+    pthread_mutex_unlock(&context->output_lock);
+}
+
+/**
+ * @brief: Gets the next pseudo random number of the context (xorshift64*)
+ * @param[IN] context: The context of the check
+ *
+ * @returns: The number
+ */
+static unsigned long long fsck_random(IN fsck_context_t * context){
+    context->random_state ^= context->random_state >> 12;
+    context->random_state ^= context->random_state << 25;
+    context->random_state ^= context->random_state >> 27;
+
+    return context->random_state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief: Collects the sha of an object to rehash (an object_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: In sample mode this is a reservoir sample, so every object has the same chance of being
+ *         picked while at most context->sample shas are held
+ */
+static error_code_t fsck_collect(IN const unsigned char * hash, IN int fanout_fd, IN const char * name, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    fsck_context_t * fsck_context = context;
+    unsigned char * new_shas = NULL;
+    size_t slot = 0;
+
+    fsck_context->seen++;
+    slot = fsck_context->num_of_shas;
+
+    if(0 != fsck_context->sample && fsck_context->num_of_shas == fsck_context->sample){
+        slot = fsck_random(fsck_context) % fsck_context->seen;
+        if(slot >= fsck_context->sample){
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+    }
+
+    if(slot == fsck_context->capacity){
+        fsck_context->capacity = max(fsck_context->capacity * 2, 1024);
+        new_shas = realloc(fsck_context->shas, fsck_context->capacity * SHA_DIGEST_LENGTH);
+        if(NULL == new_shas){
+            perror("FSCK_COLLECT: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        fsck_context->shas = new_shas;
+    }
+
+    memcpy(fsck_context->shas + slot * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH);
+    if(slot == fsck_context->num_of_shas){
+        fsck_context->num_of_shas++;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Rehashes an object and reports it if it doesn't match its name
+ * @param[IN] context: The context of the check
+ * @param[IN] hash: The sha of the object
+ * @param[IN] buffer: A buffer of FSCK_BUFFER_SIZE bytes
+ */
+static void fsck_rehash(IN fsck_context_t * context, IN const unsigned char * hash, IN char * buffer){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int fd = -1;
+    ssize_t bytes_read = 0;
+    unsigned char actual_hash[SHA_DIGEST_LENGTH] = {0};
+    char actual_hex[OBJECT_HEX_LEN + 1] = {0};
+    SHA_CTX sha_struct = {0};
+
+    return_value = open_object(hash, O_RDONLY, 0, &fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        fsck_report(context, "unreadable object", hash, strerror(errno));
+        goto cleanup;
+    }
+
+    SHA1_Init(&sha_struct);
+    do{
+        bytes_read = read(fd, buffer, FSCK_BUFFER_SIZE);
+        if(-1 == bytes_read){
+            fsck_report(context, "unreadable object", hash, strerror(errno));
+            goto cleanup;
+        }
+        SHA1_Update(&sha_struct, buffer, bytes_read);
+        TRACE_COUNT_HASHED(bytes_read);
+    }while(0 != bytes_read);
+    SHA1_Final(actual_hash, &sha_struct);
+
+    if(0 != memcmp(hash, actual_hash, SHA_DIGEST_LENGTH)){
+        sha_to_hex(actual_hash, actual_hex);
+        fsck_report(context, "corrupt object", hash, actual_hex);
+    }
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+}
+
+/**
+ * @brief: Rehashes the collected objects, FSCK_BATCH at a time, until there are none left
+ * @param[IN] argument: The context of the check
+ *
+ * @returns: NULL
+ * @notes: This is the body of every thread of the pool (see run_workers)
+ */
+static void * fsck_worker(IN void * argument){
+    fsck_context_t * context = argument;
+    size_t start = 0;
+    size_t i = 0;
+    char * buffer = NULL;
+
+    buffer = malloc(FSCK_BUFFER_SIZE);
+    if(NULL == buffer){
+        perror("FSCK_WORKER: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        goto cleanup;
+    }
+
+    while(true){
+        start = __atomic_fetch_add(&context->next, FSCK_BATCH, __ATOMIC_RELAXED);
+        if(start >= context->num_of_shas){
+            break;
+        }
+
+        for(i=start; i<min(start + FSCK_BATCH, context->num_of_shas); i++){
+            fsck_rehash(context, context->shas + i * SHA_DIGEST_LENGTH, buffer);
+        }
+    }
+
+cleanup:
+    if(NULL != buffer){
+        free(buffer);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief: Checks if an object exists in the objects directory or one of the alternates
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: true if it exists, else false
+ */
+static bool fsck_object_exists(IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = -1;
+    int fanout_fd = -1;
+    char name[OBJECT_NAME_LEN + 1] = {0};
+
+    return_value = object_fanout_fd(hash[0], false, &fanout_fd);
+    if(ERROR_CODE_SUCCESS == return_value){
+        object_name(hash, name);
+        error_check = faccessat(fanout_fd, name, F_OK, 0);
+    }
+    errno = 0;
+
+    return 0 == error_check || object_alternate_exists(hash);
+}
+
+/**
+ * @brief: Checks the history of HEAD: that every commit and every blob and parent it references exists
+ * @param[IN] context: The context of the check
+ * @param[OUT] num_of_commits: The number of commits checked
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The commits are parsed with commit_next_entry, so a corrupt commit is reported instead of
+ *         crashing the check
+ */
+static error_code_t fsck_check_history(IN fsck_context_t * context, OUT size_t * num_of_commits){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int head_fd = -1;
+    int num_of_parents = 0;
+    int i = 0;
+    size_t offset = 0;
+    size_t size = 0;
+    size_t num_of_pending = 0;
+    size_t pending_capacity = 0;
+    unsigned char * pending = NULL;
+    unsigned char * new_pending = NULL;
+    unsigned char * data = NULL;
+    const unsigned char * parents = NULL;
+    unsigned char commit_hash[SHA_DIGEST_LENGTH] = {0};
+    char commit_hex[OBJECT_HEX_LEN + 1] = {0};
+    char name[PATH_MAX] = {0};
+    ssize_t bytes_read = 0;
+    commit_entry_t entry = {0};
+
+    *num_of_commits = 0;
+
+    head_fd = openat(work_tree_fd(), HEAD_file_path, O_RDONLY);
+    if(-1 == head_fd){
+        perror("FSCK_CHECK_HISTORY: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    bytes_read = read(head_fd, commit_hash, SHA_DIGEST_LENGTH);
+    if(-1 == bytes_read){
+        perror("FSCK_CHECK_HISTORY: Read error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    if(0 == bytes_read){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(SHA_DIGEST_LENGTH != bytes_read){
+        printf("\e[31mtruncated HEAD\e[0m\n");
+        context->problems++;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    /* Slap only writes commits with at most one parent, so the history is walked without a visited set */
+    pending = malloc(SHA_DIGEST_LENGTH);
+    if(NULL == pending){
+        perror("FSCK_CHECK_HISTORY: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    memcpy(pending, commit_hash, SHA_DIGEST_LENGTH);
+    num_of_pending = 1;
+    pending_capacity = 1;
+
+    while(num_of_pending > 0){
+        num_of_pending--;
+        memcpy(commit_hash, pending + num_of_pending * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        sha_to_hex(commit_hash, commit_hex);
+
+        if(NULL != data){
+            free(data);
+            data = NULL;
+        }
+        return_value = read_object(commit_hash, &data, &size);
+        if(ERROR_CODE_NOT_FOUND == return_value){
+            fsck_report(context, "missing commit", commit_hash, NULL);
+            continue;
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        (*num_of_commits)++;
+
+        return_value = commit_parents(data, size, &num_of_parents, &parents);
+        if(ERROR_CODE_SUCCESS != return_value){
+            fsck_report(context, "malformed commit", commit_hash, "bad parent count");
+            continue;
+        }
+
+        if(num_of_pending + num_of_parents > pending_capacity){
+            pending_capacity = num_of_pending + num_of_parents;
+            new_pending = realloc(pending, pending_capacity * SHA_DIGEST_LENGTH);
+            if(NULL == new_pending){
+                perror("FSCK_CHECK_HISTORY: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                goto cleanup;
+            }
+            pending = new_pending;
+        }
+
+        for(i=0; i<num_of_parents; i++){
+            if(!fsck_object_exists(parents + i * SHA_DIGEST_LENGTH)){
+                fsck_report(context, "missing parent", parents + i * SHA_DIGEST_LENGTH, commit_hex);
+                continue;
+            }
+            memcpy(pending + num_of_pending * SHA_DIGEST_LENGTH, parents + i * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+            num_of_pending++;
+        }
+
+        offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+        while(ERROR_CODE_SUCCESS == (return_value = commit_next_entry(data, size, &offset, &entry))){
+            if(!fsck_object_exists(entry.sha)){
+                memcpy(name, entry.name, entry.name_len);
+                name[entry.name_len] = '\0';
+                fsck_report(context, "missing blob", entry.sha, name);
+            }
+        }
+        if(ERROR_CODE_INVALID_INPUT == return_value){
+            fsck_report(context, "malformed commit", commit_hash, "bad file entry");
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != head_fd){
+        close(head_fd);
+    }
+    if(NULL != data){
+        free(data);
+    }
+    if(NULL != pending){
+        free(pending);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks the index: that every entry is well formed and that its staged and committed blobs exist
+ * @param[IN] context: The context of the check
+ * @param[OUT] num_of_entries: The number of index entries checked
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The working directory sha isn't checked, it is the sha of a file that may not have been added
+ */
+static error_code_t fsck_check_index(IN fsck_context_t * context, OUT size_t * num_of_entries){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int index_fd = -1;
+    int name_len = 0;
+    off_t offset = 0;
+    ssize_t bytes_read = 0;
+    struct stat statbuf = {0};
+    mode_t mode = 0;
+    unsigned char entry[3 * SHA_DIGEST_LENGTH + sizeof(mode_t) + sizeof(int)] = {0};
+    unsigned char * stage_sha = entry + SHA_DIGEST_LENGTH;
+    unsigned char * repo_sha = entry + 2 * SHA_DIGEST_LENGTH;
+    char name[PATH_MAX] = {0};
+
+    *num_of_entries = 0;
+
+    index_fd = openat(work_tree_fd(), index_file_path, O_RDONLY);
+    if(-1 == index_fd){
+        perror("FSCK_CHECK_INDEX: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(index_fd, &statbuf);
+    if(-1 == error_check){
+        perror("FSCK_CHECK_INDEX: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    /* The fixed part of an entry (the shas, the mode and the name length) is read first, then the name */
+    while(offset < statbuf.st_size){
+        bytes_read = pread(index_fd, entry, sizeof(entry), offset);
+        if(-1 == bytes_read){
+            perror("FSCK_CHECK_INDEX: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(sizeof(entry) != bytes_read){
+            printf("\e[31mtruncated index entry at offset %li\e[0m\n", (long)offset);
+            context->problems++;
+            break;
+        }
+        offset += bytes_read;
+        memcpy(&mode, entry + 3 * SHA_DIGEST_LENGTH, sizeof(mode));
+        memcpy(&name_len, entry + 3 * SHA_DIGEST_LENGTH + sizeof(mode), sizeof(name_len));
+
+        if(name_len <= 0 || name_len >= PATH_MAX || statbuf.st_size - offset < name_len){
+            printf("\e[31mbad name length in index entry at offset %li\e[0m\n", (long)(offset - bytes_read));
+            context->problems++;
+            break;
+        }
+
+        bytes_read = pread(index_fd, name, name_len, offset);
+        if(name_len != bytes_read){
+            perror("FSCK_CHECK_INDEX: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        name[name_len] = '\0';
+        offset += name_len;
+        (*num_of_entries)++;
+
+        if(!S_ISREG(mode)){
+            printf("\e[31mbad mode %o in index entry %s\e[0m\n", mode, name);
+            context->problems++;
+        }
+        if(0 != memcmp(stage_sha, null_sha, SHA_DIGEST_LENGTH) && !fsck_object_exists(stage_sha)){
+            fsck_report(context, "missing staged blob", stage_sha, name);
+        }
+        if(0 != memcmp(repo_sha, null_sha, SHA_DIGEST_LENGTH) && !fsck_object_exists(repo_sha)){
+            fsck_report(context, "missing committed blob", repo_sha, name);
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != index_fd){
+        close(index_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Verifies the integrity of the repository
+ * @param[IN] sample: The number of randomly chosen objects to rehash, 0 to rehash every object
+ *
+ * @returns: ERROR_CODE_SUCCESS if the check ran (even if it found problems), else an indicative error code
+ * @notes: Every object is rehashed on a thread pool and compared to its name. Then the history of HEAD
+ *         is walked to check that the commits, their parents and their blobs exist, and the index is
+ *         checked for malformed entries and missing blobs. Every problem is printed as it is found.
+ */
+error_code_t fsck(IN size_t sample){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t num_of_commits = 0;
+    size_t num_of_entries = 0;
+    fsck_context_t context = {0};
+
+    context.sample = sample;
+    context.random_state = ((unsigned long long)time(NULL) << 20) ^ getpid() ^ 0x9E3779B97F4A7C15ULL;
+    pthread_mutex_init(&context.output_lock, NULL);
+
+    TRACE_BEGIN("fsck");
+
+    TRACE_BEGIN("collect_objects");
+    return_value = object_for_each(fsck_collect, &context);
+    TRACE_END("collect_objects");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("rehash_objects");
+    run_workers(fsck_worker, &context, context.num_of_shas, FSCK_BATCH);
+    TRACE_END("rehash_objects");
+
+    TRACE_BEGIN("check_history");
+    return_value = fsck_check_history(&context, &num_of_commits);
+    TRACE_END("check_history");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("check_index");
+    return_value = fsck_check_index(&context, &num_of_entries);
+    TRACE_END("check_index");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("Rehashed %zu of %zu objects, checked %zu commits and %zu index entries: ", context.num_of_shas, context.seen, num_of_commits, num_of_entries);
+    if(0 == context.problems){
+        printf("\e[32mno problems\e[0m\n");
+    }
+    else{
+        printf("\e[31m%zu problem(s)\e[0m\n", context.problems);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != context.shas){
+        free(context.shas);
+    }
+    pthread_mutex_destroy(&context.output_lock);
+    TRACE_END("fsck");
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the fsck command
+ * @param[IN] argc: The number of arguments (after fsck)
+ * @param[IN] argv: The arguments: [--sample <count>]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t fsck_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    long long sample = 0;
+    char * end = NULL;
+
+    if(0 == argc){
+        return_value = fsck(0);
+        goto cleanup;
+    }
+
+    if(2 != argc || 0 != valid_strncmp(argv[0], "--sample")){
+        printf("USAGE: fsck: [--sample <count>]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    sample = strtoll(argv[1], &end, 10);
+    if(end == argv[1] || '\0' != *end || sample <= 0){
+        printf("USAGE: fsck: [--sample <count>]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    return_value = fsck(sample);
+
+cleanup:
+    return return_value;
+}
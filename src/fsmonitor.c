@@ -0,0 +1,1134 @@
+#include "slap_commands.h"
+
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define FSMONITOR_WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)
+
+const char * fsmonitor_socket_name = "fsmonitor.sock";
+const char * fsmonitor_token_name = "fsmonitor_token";
+const char * fsmonitor_cookie_name = "fsmonitor_cookie";
+
+typedef struct fsmonitor_entry_s{
+    char * path;
+    unsigned long seq;
+}fsmonitor_entry_t;
+
+typedef struct fsmonitor_state_s{
+    int inotify_fd;
+    int listen_fd;
+    int slap_wd;
+    char ** watch_paths;
+    int watch_paths_len;
+    fsmonitor_entry_t * dirty_table;
+    size_t dirty_capacity;
+    size_t dirty_count;
+    unsigned long seq;
+    unsigned long overflows;
+    long start_time;
+    bool running;
+}fsmonitor_state_t;
+
+/**
+ * @brief: Builds the path of a file inside the repository directory
+ * @param[IN] name: The name of the file inside the repository directory
+ * @param[OUT] path: The buffer to write the path into (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_repo_path(IN const char * name, OUT char * path){
+    int error_check = 0;
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", repo_dir_name, name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        printf("FSMONITOR_REPO_PATH: Path too long\n");
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Builds the address of the socket of the fsmonitor daemon of the repository
+ * @param[OUT] address: The address, which resolves against the work tree
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_address(OUT struct sockaddr_un * address){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char path[PATH_MAX] = {0};
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+
+    return_value = fsmonitor_repo_path(fsmonitor_socket_name, path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = path_at(work_tree_fd(), path, address->sun_path, sizeof(address->sun_path));
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Connects to the fsmonitor daemon of the repository
+ * @param[OUT] socket_fd: The connected socket
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: No error is printed if the daemon is not running, since that is the common case
+ */
+static error_code_t fsmonitor_connect(OUT int * socket_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct sockaddr_un address = {0};
+
+    *socket_fd = -1;
+
+    return_value = fsmonitor_address(&address);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    *socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(-1 == *socket_fd){
+        perror("FSMONITOR_CONNECT: Socket error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = connect(*socket_fd, (struct sockaddr *)&address, sizeof(address));
+    if(-1 == error_check){
+        close(*socket_fd);
+        *socket_fd = -1;
+        errno = 0;
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Hashes a path for the dirty path table (FNV-1a)
+ * @param[IN] path: The path to hash
+ *
+ * @returns: The hash of the path
+ */
+static size_t fsmonitor_hash_path(IN const char * path){
+    size_t hash = 14695981039346656037UL;
+
+    for(; '\0' != *path; path++){
+        hash ^= (unsigned char)*path;
+        hash *= 1099511628211UL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief: Frees all entries of the dirty path table
+ * @param[IN] state: The daemon's state
+ */
+static void fsmonitor_clear_dirty(IN fsmonitor_state_t * state){
+    size_t i = 0;
+
+    for(i=0; i<state->dirty_capacity; i++){
+        if(NULL != state->dirty_table[i].path){
+            free(state->dirty_table[i].path);
+            state->dirty_table[i].path = NULL;
+        }
+    }
+    state->dirty_count = 0;
+}
+
+/**
+ * @brief: Records an overflow, invalidating every token handed out so far
+ * @param[IN] state: The daemon's state
+ */
+static void fsmonitor_overflow(IN fsmonitor_state_t * state){
+    state->overflows++;
+    fsmonitor_clear_dirty(state);
+}
+
+/**
+ * @brief: Marks a path as changed
+ * @param[IN] state: The daemon's state
+ * @param[IN] path: The path (relative to the working directory) that changed
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_mark_dirty(IN fsmonitor_state_t * state, IN const char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    fsmonitor_entry_t * new_table = NULL;
+    size_t new_capacity = 0;
+    size_t i = 0;
+    size_t slot = 0;
+
+    state->seq++;
+
+    if(state->dirty_count >= FSMONITOR_MAX_DIRTY){
+        fsmonitor_overflow(state);
+    }
+
+    if((state->dirty_count + 1) * 2 > state->dirty_capacity){
+        new_capacity = max(state->dirty_capacity * 2, 1024);
+        new_table = calloc(new_capacity, sizeof(*new_table));
+        if(NULL == new_table){
+            perror("FSMONITOR_MARK_DIRTY: Calloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        for(i=0; i<state->dirty_capacity; i++){
+            if(NULL == state->dirty_table[i].path){
+                continue;
+            }
+            slot = fsmonitor_hash_path(state->dirty_table[i].path) & (new_capacity - 1);
+            while(NULL != new_table[slot].path){
+                slot = (slot + 1) & (new_capacity - 1);
+            }
+            new_table[slot] = state->dirty_table[i];
+        }
+
+        free(state->dirty_table);
+        state->dirty_table = new_table;
+        state->dirty_capacity = new_capacity;
+    }
+
+    slot = fsmonitor_hash_path(path) & (state->dirty_capacity - 1);
+    while(NULL != state->dirty_table[slot].path){
+        if(0 == strcmp(state->dirty_table[slot].path, path)){
+            state->dirty_table[slot].seq = state->seq;
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        slot = (slot + 1) & (state->dirty_capacity - 1);
+    }
+
+    state->dirty_table[slot].path = strdup(path);
+    if(NULL == state->dirty_table[slot].path){
+        perror("FSMONITOR_MARK_DIRTY: Strdup error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    state->dirty_table[slot].seq = state->seq;
+    state->dirty_count++;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Joins a directory path and a file name
+ * @param[IN] dir: The directory ("." for the working directory)
+ * @param[IN] name: The file name
+ * @param[OUT] path: The buffer to write into (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_join(IN const char * dir, IN const char * name, OUT char * path){
+    int error_check = 0;
+
+    if(0 == strcmp(dir, ".")){
+        error_check = snprintf(path, PATH_MAX, "%s", name);
+    }
+    else{
+        error_check = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+    }
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Watches a directory and all of its subdirectories
+ * @param[IN] state: The daemon's state
+ * @param[IN] dir_path: The path of the directory to watch
+ * @param[IN] mark: If every file found should also be marked as dirty (used for directories created after startup)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The repository directory is never watched recursively
+ */
+static error_code_t fsmonitor_watch_tree(IN fsmonitor_state_t * state, IN const char * dir_path, IN bool mark){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int wd = -1;
+    int error_check = 0;
+    char ** new_watch_paths = NULL;
+    char child_path[PATH_MAX] = {0};
+    char watch_path[PATH_MAX] = {0};
+    int dir_fd = -1;
+    bool is_dir = false;
+    DIR * dir = NULL;
+    struct dirent * entry = NULL;
+    struct stat statbuf = {0};
+
+    return_value = path_at(work_tree_fd(), dir_path, watch_path, sizeof(watch_path));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    wd = inotify_add_watch(state->inotify_fd, watch_path, FSMONITOR_WATCH_MASK | IN_ONLYDIR);
+    if(-1 == wd){
+        if(ENOENT == errno || ENOTDIR == errno){
+            errno = 0;
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        perror("FSMONITOR_WATCH_TREE: Inotify_add_watch error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    if(wd >= state->watch_paths_len){
+        new_watch_paths = realloc(state->watch_paths, (wd + 1) * 2 * sizeof(char *));
+        if(NULL == new_watch_paths){
+            perror("FSMONITOR_WATCH_TREE: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        memset(new_watch_paths + state->watch_paths_len, 0, ((wd + 1) * 2 - state->watch_paths_len) * sizeof(char *));
+        state->watch_paths = new_watch_paths;
+        state->watch_paths_len = (wd + 1) * 2;
+    }
+    if(NULL != state->watch_paths[wd]){
+        free(state->watch_paths[wd]);
+    }
+    state->watch_paths[wd] = strdup(dir_path);
+    if(NULL == state->watch_paths[wd]){
+        perror("FSMONITOR_WATCH_TREE: Strdup error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    dir_fd = openat(work_tree_fd(), dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == dir_fd){
+        if(ENOENT == errno){
+            errno = 0;
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        perror("FSMONITOR_WATCH_TREE: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    dir = fdopendir(dir_fd);
+    if(NULL == dir){
+        perror("FSMONITOR_WATCH_TREE: Fdopendir error");
+        printf("(Errno: %i)\n", errno);
+        close(dir_fd);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(NULL != (entry = readdir(dir))){
+        if(0 == strcmp(entry->d_name, ".") || 0 == strcmp(entry->d_name, "..")){
+            continue;
+        }
+        if(0 == strcmp(dir_path, ".") && 0 == strcmp(entry->d_name, repo_dir_name)){
+            continue;
+        }
+
+        return_value = fsmonitor_join(dir_path, entry->d_name, child_path);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        is_dir = (DT_DIR == entry->d_type);
+        if(DT_UNKNOWN == entry->d_type){
+            error_check = fstatat(work_tree_fd(), child_path, &statbuf, AT_SYMLINK_NOFOLLOW);
+            is_dir = (0 == error_check && S_ISDIR(statbuf.st_mode));
+        }
+
+        if(is_dir){
+            return_value = fsmonitor_watch_tree(state, child_path, mark);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+        else if(mark){
+            return_value = fsmonitor_mark_dirty(state, child_path);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != dir){
+        closedir(dir);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Reads and applies all pending inotify events
+ * @param[IN] state: The daemon's state
+ * @param[IN] cookie_seen: If not NULL, set to true once the creation of the sync cookie is read
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_read_events(IN fsmonitor_state_t * state, OUT bool * cookie_seen){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char buffer[BUFFER_SIZE * 64] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[PATH_MAX] = {0};
+    ssize_t bytes_read = 0;
+    char * position = NULL;
+    struct inotify_event * event = NULL;
+
+    while(true){
+        bytes_read = read(state->inotify_fd, buffer, sizeof(buffer));
+        if(-1 == bytes_read && EAGAIN == errno){
+            errno = 0;
+            break;
+        }
+        if(-1 == bytes_read){
+            perror("FSMONITOR_READ_EVENTS: Read error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+
+        for(position = buffer; position < buffer + bytes_read; position += sizeof(struct inotify_event) + event->len){
+            event = (struct inotify_event *)position;
+
+            if(event->mask & IN_Q_OVERFLOW){
+                fsmonitor_overflow(state);
+                continue;
+            }
+
+            if(event->wd == state->slap_wd){
+                if(NULL != cookie_seen && event->len > 0 && 0 == strcmp(event->name, fsmonitor_cookie_name)){
+                    *cookie_seen = true;
+                }
+                continue;
+            }
+
+            if(event->wd < 0 || event->wd >= state->watch_paths_len || NULL == state->watch_paths[event->wd]){
+                continue;
+            }
+
+            if(event->mask & IN_IGNORED){
+                free(state->watch_paths[event->wd]);
+                state->watch_paths[event->wd] = NULL;
+                continue;
+            }
+
+            /* A moved directory leaves stale paths for its whole subtree, so the cheapest correct answer is a full scan */
+            if((event->mask & IN_MOVE_SELF) || ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM))){
+                fsmonitor_overflow(state);
+                continue;
+            }
+
+            if(0 == event->len){
+                continue;
+            }
+
+            return_value = fsmonitor_join(state->watch_paths[event->wd], event->name, path);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+
+            return_value = fsmonitor_mark_dirty(state, path);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+
+            if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))){
+                return_value = fsmonitor_watch_tree(state, path, true);
+                if(ERROR_CODE_SUCCESS != return_value){
+                    goto cleanup;
+                }
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Makes sure every change made before now has been read from inotify
+ * @param[IN] state: The daemon's state
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A cookie file is created in the repository directory; inotify preserves event order,
+ *         so once its creation is read every earlier change has been recorded.
+ */
+static error_code_t fsmonitor_sync(IN fsmonitor_state_t * state){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int cookie_fd = -1;
+    bool cookie_seen = false;
+    char cookie_path[PATH_MAX] = {0};
+    struct pollfd poll_fd = {0};
+
+    return_value = fsmonitor_repo_path(fsmonitor_cookie_name, cookie_path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    cookie_fd = openat(work_tree_fd(), cookie_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == cookie_fd){
+        perror("FSMONITOR_SYNC: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    poll_fd.fd = state->inotify_fd;
+    poll_fd.events = POLLIN;
+
+    while(!cookie_seen){
+        return_value = fsmonitor_read_events(state, &cookie_seen);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(cookie_seen){
+            break;
+        }
+
+        error_check = poll(&poll_fd, 1, FSMONITOR_SYNC_TIMEOUT);
+        if(-1 == error_check){
+            perror("FSMONITOR_SYNC: Poll error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == error_check){
+            return_value = ERROR_CODE_UNKNOWN;
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != cookie_fd){
+        close(cookie_fd);
+        unlinkat(work_tree_fd(), cookie_path, 0);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes the current token of the daemon
+ * @param[IN] state: The daemon's state
+ * @param[OUT] token: The buffer to write the token into (FSMONITOR_TOKEN_LEN bytes)
+ */
+static void fsmonitor_current_token(IN fsmonitor_state_t * state, OUT char * token){
+    snprintf(token, FSMONITOR_TOKEN_LEN, "%i.%li.%lu:%lu", getpid(), state->start_time, state->overflows, state->seq);
+}
+
+/**
+ * @brief: Writes a buffer to a socket completely
+ * @param[IN] fd: The socket
+ * @param[IN] buffer: The data to write
+ * @param[IN] length: The length of the data
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_write_all(IN int fd, IN const void * buffer, IN size_t length){
+    ssize_t bytes_written = 0;
+
+    while(length > 0){
+        bytes_written = write(fd, buffer, length);
+        if(-1 == bytes_written && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes_written){
+            return ERROR_CODE_COULDNT_WRITE;
+        }
+        buffer = (const char *)buffer + bytes_written;
+        length -= bytes_written;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Answers a single client request
+ * @param[IN] state: The daemon's state
+ * @param[IN] client_fd: The client's socket
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Requests are "query <token>" and "stop". A query is answered with the new token,
+ *         then "F" if the client must check every path, or "P" followed by the changed paths.
+ *         Every field is NUL terminated. The socket has a FSMONITOR_CLIENT_TIMEOUT timeout, so a client
+ *         that stops talking fails the read or write and is dropped instead of stalling the daemon.
+ */
+static error_code_t fsmonitor_handle_client(IN fsmonitor_state_t * state, IN int client_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char request[FSMONITOR_TOKEN_LEN + 16] = {0};
+    char current_token[FSMONITOR_TOKEN_LEN] = {0};
+    char * separator = NULL;
+    ssize_t bytes_read = 0;
+    size_t request_len = 0;
+    size_t epoch_len = 0;
+    unsigned long since = 0;
+    bool full_scan = true;
+    size_t i = 0;
+
+    while(request_len < sizeof(request) - 1){
+        bytes_read = read(client_fd, request + request_len, sizeof(request) - 1 - request_len);
+        if(-1 == bytes_read && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes_read){
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            break;
+        }
+        request_len += bytes_read;
+        if(NULL != memchr(request, '\n', request_len)){
+            break;
+        }
+    }
+    request[strcspn(request, "\n")] = '\0';
+
+    if(0 == strcmp(request, "stop")){
+        state->running = false;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    if(0 != strncmp(request, "query ", strlen("query "))){
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_sync(state);
+    if(ERROR_CODE_SUCCESS != return_value){
+        /* Couldn't guarantee every change was seen, so this answer can only be a full scan */
+        fsmonitor_overflow(state);
+    }
+
+    fsmonitor_current_token(state, current_token);
+
+    separator = strrchr(current_token, ':');
+    epoch_len = separator - current_token;
+    separator = strrchr(request, ':');
+    if(NULL != separator && separator - (request + strlen("query ")) == epoch_len &&
+       0 == strncmp(request + strlen("query "), current_token, epoch_len)){
+        since = strtoul(separator + 1, NULL, 10);
+        full_scan = false;
+    }
+
+    return_value = fsmonitor_write_all(client_fd, current_token, strlen(current_token) + 1);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_write_all(client_fd, full_scan ? "F" : "P", 2);
+    if(ERROR_CODE_SUCCESS != return_value || full_scan){
+        goto cleanup;
+    }
+
+    for(i=0; i<state->dirty_capacity; i++){
+        if(NULL != state->dirty_table[i].path && state->dirty_table[i].seq > since){
+            return_value = fsmonitor_write_all(client_fd, state->dirty_table[i].path, strlen(state->dirty_table[i].path) + 1);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: The main loop of the fsmonitor daemon
+ * @param[IN] state: The daemon's state (with inotify_fd and listen_fd already set up)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t fsmonitor_run(IN fsmonitor_state_t * state){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int client_fd = -1;
+    struct pollfd poll_fds[2] = {0};
+
+    poll_fds[0].fd = state->inotify_fd;
+    poll_fds[0].events = POLLIN;
+    poll_fds[1].fd = state->listen_fd;
+    poll_fds[1].events = POLLIN;
+
+    while(state->running){
+        error_check = poll(poll_fds, 2, -1);
+        if(-1 == error_check && EINTR == errno){
+            continue;
+        }
+        if(-1 == error_check){
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+
+        if(poll_fds[0].revents & POLLIN){
+            return_value = fsmonitor_read_events(state, NULL);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+
+        if(poll_fds[1].revents & POLLIN){
+            client_fd = accept(state->listen_fd, NULL, NULL);
+            if(-1 == client_fd){
+                continue;
+            }
+            if(ERROR_CODE_SUCCESS == set_socket_timeout(client_fd, FSMONITOR_CLIENT_TIMEOUT)){
+                fsmonitor_handle_client(state, client_fd);
+            }
+            close(client_fd);
+            client_fd = -1;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Starts the fsmonitor daemon for the current repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The daemon forks into the background and only returns control once it is watching
+ *         the whole working directory and accepting queries.
+ */
+error_code_t fsmonitor_start(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int socket_fd = -1;
+    int ready_pipe[2] = {-1, -1};
+    int null_fd = -1;
+    pid_t pid = 0;
+    char ready = 0;
+    char path[PATH_MAX] = {0};
+    char slap_dir[PATH_MAX] = {0};
+    struct sockaddr_un address = {0};
+    fsmonitor_state_t state = {0};
+
+    return_value = fsmonitor_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS == return_value){
+        printf("fsmonitor is already running\n");
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_address(&address);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    unlink(address.sun_path);
+    errno = 0;
+
+    error_check = pipe(ready_pipe);
+    if(-1 == error_check){
+        perror("FSMONITOR_START: Pipe error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if(-1 == pid){
+        perror("FSMONITOR_START: Fork error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    if(0 != pid){
+        close(ready_pipe[1]);
+        ready_pipe[1] = -1;
+
+        error_check = read(ready_pipe[0], &ready, 1);
+        if(1 != error_check){
+            printf("fsmonitor failed to start\n");
+            return_value = ERROR_CODE_COULDNT_CREATE;
+            goto cleanup;
+        }
+
+        printf("fsmonitor started (pid %i)\n", pid);
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    /* Daemon */
+    close(ready_pipe[0]);
+    ready_pipe[0] = -1;
+    setsid();
+    signal(SIGPIPE, SIG_IGN);
+
+    state.running = true;
+    state.start_time = time(NULL);
+    state.slap_wd = -1;
+
+    state.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(-1 == state.inotify_fd){
+        perror("FSMONITOR_START: Inotify_init1 error");
+        printf("(Errno: %i)\n", errno);
+        exit(ERROR_CODE_COULDNT_OPEN);
+    }
+
+    return_value = fsmonitor_repo_path("", path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        exit(return_value);
+    }
+
+    return_value = path_at(work_tree_fd(), path, slap_dir, sizeof(slap_dir));
+    if(ERROR_CODE_SUCCESS != return_value){
+        exit(return_value);
+    }
+
+    state.slap_wd = inotify_add_watch(state.inotify_fd, slap_dir, IN_CREATE | IN_ONLYDIR);
+    if(-1 == state.slap_wd){
+        perror("FSMONITOR_START: Inotify_add_watch error");
+        printf("(Errno: %i)\n", errno);
+        exit(ERROR_CODE_COULDNT_OPEN);
+    }
+
+    return_value = fsmonitor_watch_tree(&state, ".", false);
+    if(ERROR_CODE_SUCCESS != return_value){
+        exit(return_value);
+    }
+
+    state.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(-1 == state.listen_fd){
+        perror("FSMONITOR_START: Socket error");
+        printf("(Errno: %i)\n", errno);
+        exit(ERROR_CODE_COULDNT_OPEN);
+    }
+
+    error_check = bind(state.listen_fd, (struct sockaddr *)&address, sizeof(address));
+    if(-1 == error_check){
+        perror("FSMONITOR_START: Bind error");
+        printf("(Errno: %i)\n", errno);
+        exit(ERROR_CODE_COULDNT_CREATE);
+    }
+
+    error_check = listen(state.listen_fd, 16);
+    if(-1 == error_check){
+        perror("FSMONITOR_START: Listen error");
+        printf("(Errno: %i)\n", errno);
+        exit(ERROR_CODE_COULDNT_CREATE);
+    }
+
+    null_fd = open("/dev/null", O_RDWR);
+    if(-1 != null_fd){
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+
+    write(ready_pipe[1], &ready, 1);
+    close(ready_pipe[1]);
+
+    return_value = fsmonitor_run(&state);
+
+    unlink(address.sun_path);
+    exit(return_value);
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+    if(-1 != ready_pipe[0]){
+        close(ready_pipe[0]);
+    }
+    if(-1 != ready_pipe[1]){
+        close(ready_pipe[1]);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Stops the fsmonitor daemon of the current repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t fsmonitor_stop(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int socket_fd = -1;
+
+    return_value = fsmonitor_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        printf("fsmonitor is not running\n");
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_write_all(socket_fd, "stop\n", strlen("stop\n"));
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("fsmonitor stopped\n");
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Compares two strings through pointers to them (for qsort and bsearch)
+ */
+static int fsmonitor_compare_paths(IN const void * p1, IN const void * p2){
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+/**
+ * @brief: Asks the fsmonitor daemon which paths changed since the saved token
+ * @param[OUT] result: The result to fill out
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: If the daemon isn't running result->available is false and result->full_scan is true,
+ *         this is not an error. Neither is a daemon that doesn't answer within FSMONITOR_QUERY_TIMEOUT,
+ *         which is treated the same way. The result must be freed with fsmonitor_free_result.
+ */
+error_code_t fsmonitor_query(OUT fsmonitor_result_t * result){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int socket_fd = -1;
+    int token_fd = -1;
+    int i = 0;
+    ssize_t bytes_read = 0;
+    size_t buffer_len = 0;
+    size_t buffer_capacity = 0;
+    char * new_buffer = NULL;
+    char * position = NULL;
+    char token_path[PATH_MAX] = {0};
+    char saved_token[FSMONITOR_TOKEN_LEN] = {0};
+    char request[FSMONITOR_TOKEN_LEN + 16] = {0};
+
+    memset(result, 0, sizeof(*result));
+    result->full_scan = true;
+
+    return_value = fsmonitor_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = set_socket_timeout(socket_fd, FSMONITOR_QUERY_TIMEOUT);
+    if(ERROR_CODE_SUCCESS != return_value){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_repo_path(fsmonitor_token_name, token_path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    token_fd = openat(work_tree_fd(), token_path, O_RDONLY | O_CLOEXEC);
+    if(-1 != token_fd){
+        bytes_read = read(token_fd, saved_token, sizeof(saved_token) - 1);
+        if(bytes_read < 0){
+            bytes_read = 0;
+        }
+        saved_token[bytes_read] = '\0';
+    }
+    errno = 0;
+
+    snprintf(request, sizeof(request), "query %s\n", saved_token);
+    return_value = fsmonitor_write_all(socket_fd, request, strlen(request));
+    if(ERROR_CODE_SUCCESS != return_value){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    while(true){
+        if(buffer_len == buffer_capacity){
+            buffer_capacity = max(buffer_capacity * 2, BUFFER_SIZE * 16);
+            new_buffer = realloc(result->path_buffer, buffer_capacity + 1);
+            if(NULL == new_buffer){
+                perror("FSMONITOR_QUERY: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                goto cleanup;
+            }
+            result->path_buffer = new_buffer;
+        }
+
+        bytes_read = read(socket_fd, result->path_buffer + buffer_len, buffer_capacity - buffer_len);
+        if(-1 == bytes_read && EINTR == errno){
+            continue;
+        }
+        if(-1 == bytes_read){
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            break;
+        }
+        buffer_len += bytes_read;
+    }
+    result->path_buffer[buffer_len] = '\0';
+
+    /* Token, mode, then the paths */
+    position = result->path_buffer;
+    if(NULL == memchr(position, '\0', buffer_len) || strlen(position) >= FSMONITOR_TOKEN_LEN){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    strcpy(result->token, position);
+    position += strlen(position) + 1;
+    if(position >= result->path_buffer + buffer_len){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    result->available = true;
+    result->full_scan = ('P' != *position);
+    position += strlen(position) + 1;
+
+    for(new_buffer = position; new_buffer < result->path_buffer + buffer_len; new_buffer += strlen(new_buffer) + 1){
+        result->num_of_paths++;
+    }
+
+    result->paths = malloc(max(result->num_of_paths, 1) * sizeof(char *));
+    if(NULL == result->paths){
+        perror("FSMONITOR_QUERY: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<result->num_of_paths; i++){
+        result->paths[i] = position;
+        position += strlen(position) + 1;
+    }
+    qsort(result->paths, result->num_of_paths, sizeof(char *), fsmonitor_compare_paths);
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+    if(-1 != token_fd){
+        close(token_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Saves the token of a query, so the next query only reports changes made after it
+ * @param[IN] result: The result of the query
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only call this once every path reported by the query has been brought up to date in the index
+ */
+error_code_t fsmonitor_save_token(IN fsmonitor_result_t * result){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int token_fd = -1;
+    char token_path[PATH_MAX] = {0};
+
+    if(!result->available){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = fsmonitor_repo_path(fsmonitor_token_name, token_path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    token_fd = openat(work_tree_fd(), token_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == token_fd){
+        perror("FSMONITOR_SAVE_TOKEN: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = write(token_fd, result->token, strlen(result->token));
+    if(-1 == error_check){
+        perror("FSMONITOR_SAVE_TOKEN: Write error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != token_fd){
+        close(token_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks if a path may have changed since the saved token
+ * @param[IN] result: The result of fsmonitor_query
+ * @param[IN] path: The path to check (as stored in the index)
+ *
+ * @returns: true if the path has to be checked, false if it is known to be unchanged
+ */
+bool fsmonitor_is_dirty(IN fsmonitor_result_t * result, IN char * path){
+    if(!result->available || result->full_scan){
+        return true;
+    }
+
+    while('.' == path[0] && '/' == path[1]){
+        path += 2;
+    }
+
+    return NULL != bsearch(&path, result->paths, result->num_of_paths, sizeof(char *), fsmonitor_compare_paths);
+}
+
+/**
+ * @brief: Frees a result of fsmonitor_query
+ * @param[IN] result: The result to free
+ */
+void fsmonitor_free_result(IN fsmonitor_result_t * result){
+    if(NULL != result->paths){
+        free(result->paths);
+    }
+    if(NULL != result->path_buffer){
+        free(result->path_buffer);
+    }
+    memset(result, 0, sizeof(*result));
+}
@@ -0,0 +1,406 @@
+#include "slap_commands.h"
+
+typedef struct gc_context_s{
+    size_t num_of_objects;
+    unsigned char * marks;
+    unsigned char * removed;
+    time_t cutoff;
+    size_t num_of_removed;
+    size_t num_of_kept;
+    unsigned long long bytes_removed;
+}gc_context_t;
+
+/**
+ * @brief: Marks an object as reachable
+ * @param[IN] context: The context of the collection
+ * @param[IN] hash: The sha of the object
+ *
+ * @notes: Safe to call from the worker threads. Shas that aren't objects are ignored.
+ */
+static void gc_mark(IN gc_context_t * context, IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t position = 0;
+
+    return_value = object_index_position(hash, &position);
+    if(ERROR_CODE_SUCCESS != return_value){
+        return;
+    }
+
+    __atomic_fetch_or(&context->marks[position / 8], 1 << (position % 8), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief: Marks an object as reachable (a reachability_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS
+ */
+static error_code_t gc_mark_reachable(IN const unsigned char * hash, IN void * context){
+    gc_mark(context, hash);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Marks the objects reachable from the history of a HEAD
+ * @param[IN] context: The context of the collection
+ * @param[IN] head_path: The path of the HEAD file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A missing or malformed commit fails the collection, since whatever it references can't be
+ *         told apart from garbage
+ */
+static error_code_t gc_mark_history(IN gc_context_t * context, IN const char * head_path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bool exists = false;
+    unsigned char head[SHA_DIGEST_LENGTH] = {0};
+    reachability_t reachability = {0};
+
+    return_value = read_head_file(head_path, head, &exists);
+    if(ERROR_CODE_SUCCESS != return_value || !exists){
+        goto cleanup;
+    }
+
+    return_value = reachability_compute(head, &reachability);
+    if(ERROR_CODE_NOT_FOUND == return_value || ERROR_CODE_INVALID_INPUT == return_value){
+        printf("\e[31mRun slap fsck. Nothing was removed.\e[0m\n");
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = reachability_for_each(&reachability, gc_mark_reachable, context);
+
+cleanup:
+    reachability_free(&reachability);
+
+    return return_value;
+}
+
+/**
+ * @brief: Marks the blobs an index references (working directory, staged and committed)
+ * @param[IN] context: The context of the collection
+ * @param[IN] index_path: The path of the index file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t gc_mark_index(IN gc_context_t * context, IN const char * index_path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int index_fd = -1;
+    index_file_segement_t segment = {0};
+
+    index_fd = openat(work_tree_fd(), index_path, O_RDONLY);
+    if(-1 == index_fd){
+        perror("GC_MARK_INDEX: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(true){
+        return_value = get_next_index_segment(index_fd, &segment);
+        if(ERROR_CODE_EOF == return_value){
+            break;
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        gc_mark(context, segment.wdir_sha);
+        gc_mark(context, segment.stage_sha);
+        gc_mark(context, segment.repo_sha);
+
+        free(segment.name);
+        segment.name = NULL;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != segment.name){
+        free(segment.name);
+    }
+    if(-1 != index_fd){
+        close(index_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Marks the objects another work tree that shares the objects directory uses (a worktree_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t gc_mark_worktree(IN const char * repo_dir, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    char path[PATH_MAX] = {0};
+
+    error_check = snprintf(path, PATH_MAX, "%s/HEAD", repo_dir);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = gc_mark_history(context, path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/index", repo_dir);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = gc_mark_index(context, path);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Removes an object if it is unreachable and older than the grace period (an object_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Objects that aren't in the object index were written after the marking started, so they are kept
+ */
+static error_code_t gc_sweep(IN const unsigned char * hash, IN int fanout_fd, IN const char * name, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    size_t position = 0;
+    struct stat statbuf = {0};
+    gc_context_t * gc_context = context;
+
+    return_value = object_index_position(hash, &position);
+    if(ERROR_CODE_NOT_FOUND == return_value || (ERROR_CODE_SUCCESS == return_value && (gc_context->marks[position / 8] & (1 << (position % 8))))){
+        gc_context->num_of_kept++;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = fstatat(fanout_fd, name, &statbuf, AT_SYMLINK_NOFOLLOW);
+    if(-1 == error_check){
+        perror("GC_SWEEP: Fstatat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(statbuf.st_mtime > gc_context->cutoff){
+        gc_context->num_of_kept++;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = unlinkat(fanout_fd, name, 0);
+    if(-1 == error_check){
+        perror("GC_SWEEP: Unlinkat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    gc_context->removed[position / 8] |= 1 << (position % 8);
+    gc_context->num_of_removed++;
+    gc_context->bytes_removed += statbuf.st_size;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Removes the temporary commit object an aborted commit left behind
+ * @param[IN] context: The context of the collection
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: It is only removed if it is older than the grace period, since a commit may be running
+ */
+static error_code_t gc_remove_temp(IN gc_context_t * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    struct stat statbuf = {0};
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = fstatat(dir_fd, "temp", &statbuf, AT_SYMLINK_NOFOLLOW);
+    if(-1 == error_check || statbuf.st_mtime > context->cutoff){
+        errno = 0;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = unlinkat(dir_fd, "temp", 0);
+    if(-1 == error_check){
+        perror("GC_REMOVE_TEMP: Unlinkat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    context->num_of_removed++;
+    context->bytes_removed += statbuf.st_size;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Removes the objects that are unreachable from the history of HEAD and from the index, in this work
+ *         tree and in every other one that shares the objects directory
+ * @param[IN] grace: Unreachable objects modified less than this many seconds ago are kept
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The object index is rebuilt first, so every object has a position in its sorted table and
+ *         the marks are a bitmap over those positions (one bit per object). The history is marked with
+ *         reachability_compute, which stops at the first commit that has a reachability bitmap and reads
+ *         the newer commits on a pool of threads. The sweep streams over the objects directory with
+ *         object_for_each, the removed objects are pruned from the object index and the bitmaps are
+ *         brought up to date. The grace period protects objects that are being added while gc runs.
+ */
+error_code_t gc(IN time_t grace){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    const unsigned char * table = NULL;
+    gc_context_t context = {0};
+
+    context.cutoff = time(NULL) - grace;
+
+    TRACE_BEGIN("gc");
+
+    TRACE_BEGIN("rebuild_object_index");
+    return_value = object_index_rebuild();
+    TRACE_END("rebuild_object_index");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = object_index_table(&table, &context.num_of_objects);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    context.marks = calloc(context.num_of_objects / 8 + 1, 1);
+    context.removed = calloc(context.num_of_objects / 8 + 1, 1);
+    if(NULL == context.marks || NULL == context.removed){
+        perror("GC: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    TRACE_BEGIN("mark");
+    return_value = gc_mark_history(&context, HEAD_file_path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = gc_mark_index(&context, index_file_path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = worktree_for_each(gc_mark_worktree, &context);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    TRACE_END("mark");
+
+    TRACE_BEGIN("sweep");
+    return_value = object_for_each(gc_sweep, &context);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = gc_remove_temp(&context);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    TRACE_END("sweep");
+
+    if(context.num_of_removed > 0){
+        TRACE_BEGIN("prune_object_index");
+        return_value = object_index_prune(context.removed);
+        TRACE_END("prune_object_index");
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = bitmap_write();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    printf("Removed %zu unreachable objects (%llu bytes), kept %zu.\n", context.num_of_removed, context.bytes_removed, context.num_of_kept);
+
+cleanup:
+    if(NULL != context.marks){
+        free(context.marks);
+    }
+    if(NULL != context.removed){
+        free(context.removed);
+    }
+    TRACE_END("gc");
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the gc command
+ * @param[IN] argc: The number of arguments (after gc)
+ * @param[IN] argv: The arguments: [--grace <seconds>]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Without --grace the gc.grace setting is used, and without it GC_DEFAULT_GRACE (two weeks)
+ */
+error_code_t gc_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    long long grace = GC_DEFAULT_GRACE;
+    char value[CONFIG_LINE_MAX] = {0};
+    char * grace_string = NULL;
+    char * end = NULL;
+
+    if(0 != argc && (2 != argc || 0 != valid_strncmp(argv[0], "--grace"))){
+        printf("USAGE: gc: [--grace <seconds>]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    if(2 == argc){
+        grace_string = argv[1];
+    }
+    else{
+        return_value = config_get("gc.grace", value, sizeof(value));
+        if(ERROR_CODE_SUCCESS == return_value){
+            grace_string = value;
+        }
+        else if(ERROR_CODE_NOT_FOUND != return_value){
+            goto cleanup;
+        }
+    }
+
+    if(NULL != grace_string){
+        grace = strtoll(grace_string, &end, 10);
+        if(end == grace_string || '\0' != *end || grace < 0){
+            printf("Invalid grace period %s\n", grace_string);
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+    }
+
+    return_value = gc(grace);
+
+cleanup:
+    return return_value;
+}
@@ -1,8 +1,8 @@
-#include "hash.h"
+#include "slap_commands.h"
 
 /**
  * @brief: Gets the hash of a file using the SHA1 functions provided by the openssl library
- * @param[IN] path: The path to the file
+ * @param[IN] path: The path to the file, relative to the work tree
  * @param[OUT] hash: A pointer to teh array of bytes to return the hash into
  * 
  * @returns: 0 on success, else -1
@@ -13,14 +13,17 @@ int get_hash(IN char * path, OUT unsigned char ** hash){
 	FILE * file = NULL;
 	int bytes_read = 0;
     int error_check = 0;
+    long total_bytes = 0;
 
-	file = fopen(path, "r");
+	file = fopenat(work_tree_fd(), path, "r");
     if(NULL == file){
-        perror("GET_HASH: Fopen error");
+        perror("GET_HASH: Fopenat error");
         printf("(Errno %i)\n", errno);
         error_check = -1;
         goto cleanup;
     }
+    TRACE_COUNT_OPEN();
+    PROBE1(hash__start, path);
 
 	error_check = SHA1_Init(&sha_struct);
     if(0 == error_check){
@@ -31,8 +34,11 @@ int get_hash(IN char * path, OUT unsigned char ** hash){
 
 	do{
 		bytes_read = fread(buffer, 1, BUFFER_SIZE, file);
+        TRACE_COUNT_READ(bytes_read);
 		if(bytes_read != 0){
 			error_check = SHA1_Update(&sha_struct, buffer, bytes_read);
+            TRACE_COUNT_HASHED(bytes_read);
+            total_bytes += bytes_read;
             if(0 == error_check){
                 perror("GET_HASH: SHA1_Update error");
                 printf("(Errno %i)\n", errno);
@@ -64,10 +70,12 @@ int get_hash(IN char * path, OUT unsigned char ** hash){
         printf("(Errno %i)\n", errno);
         error_check = -1;
     }
+    PROBE3(hash__done, path, total_bytes, *hash);
 
 cleanup:
     if(NULL != file){
         fclose(file);
+        TRACE_COUNT_CLOSE();
     }
     return error_check;
 }
@@ -0,0 +1,189 @@
+#include "slap_commands.h"
+
+/**
+ * @brief: Reads the sha a HEAD file points to
+ * @param[IN] path: The path of the HEAD file
+ * @param[OUT] hash: The sha
+ * @param[OUT] exists: false if nothing was committed yet
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t read_head_file(IN const char * path, OUT unsigned char * hash, OUT bool * exists){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int head_fd = -1;
+    ssize_t bytes_read = 0;
+
+    *exists = false;
+
+    head_fd = openat(work_tree_fd(), path, O_RDONLY);
+    if(-1 == head_fd){
+        perror("READ_HEAD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    bytes_read = read(head_fd, hash, SHA_DIGEST_LENGTH);
+    if(-1 == bytes_read){
+        perror("READ_HEAD: Read error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    if(0 != bytes_read && SHA_DIGEST_LENGTH != bytes_read){
+        printf("\e[31m%s is truncated.\e[0m\n", path);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    *exists = (SHA_DIGEST_LENGTH == bytes_read);
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != head_fd){
+        close(head_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Reads the sha HEAD points to
+ * @param[OUT] hash: The sha
+ * @param[OUT] exists: false if nothing was committed yet
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: HEAD is cached by the index cache, and only read again if it changed on disk
+ */
+error_code_t read_head(OUT unsigned char * hash, OUT bool * exists){
+    return index_cache_head(hash, exists);
+}
+
+/**
+ * @brief: Resolves the name of a commit to its sha
+ * @param[IN] commit: HEAD, or the (possibly abbreviated) sha of the commit in hex
+ * @param[OUT] hash: The sha
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code (after printing why)
+ */
+error_code_t resolve_commit(IN const char * commit, OUT unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bool exists = false;
+
+    if(0 == strcmp(commit, "HEAD")){
+        return_value = read_head(hash, &exists);
+        if(ERROR_CODE_SUCCESS == return_value && !exists){
+            printf("\e[31mNothing was committed yet.\e[0m\n");
+            return_value = ERROR_CODE_NOT_FOUND;
+        }
+        goto cleanup;
+    }
+
+    return_value = object_index_resolve(commit, hash);
+    if(ERROR_CODE_AMBIGUOUS == return_value){
+        printf("\e[31mThe sha %s is ambiguous.\e[0m\n", commit);
+    }
+    else if(ERROR_CODE_NOT_FOUND == return_value || ERROR_CODE_INVALID_INPUT == return_value){
+        printf("\e[31mUnknown commit %s.\e[0m\n", commit);
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Walks the history of a commit, newest commit first
+ * @param[IN] start: The sha of the commit to start from
+ * @param[IN] callback: Called for every commit
+ * @param[IN] context: Passed to the callback
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only the header of each commit (the parents) is read. A missing or malformed commit fails
+ *         the walk. Slap only writes commits with at most one parent, so there is no visited set.
+ */
+error_code_t history_walk(IN const unsigned char * start, IN history_callback_t callback, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int commit_fd = -1;
+    int num_of_parents = 0;
+    size_t num_of_pending = 0;
+    size_t pending_capacity = 0;
+    ssize_t bytes_read = 0;
+    bool descend = true;
+    unsigned char * pending = NULL;
+    unsigned char * new_pending = NULL;
+    unsigned char commit_hash[SHA_DIGEST_LENGTH] = {0};
+    char commit_hex[OBJECT_HEX_LEN + 1] = {0};
+
+    pending = malloc(SHA_DIGEST_LENGTH);
+    if(NULL == pending){
+        perror("HISTORY_WALK: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    memcpy(pending, start, SHA_DIGEST_LENGTH);
+    num_of_pending = 1;
+    pending_capacity = 1;
+
+    while(num_of_pending > 0){
+        num_of_pending--;
+        memcpy(commit_hash, pending + num_of_pending * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        sha_to_hex(commit_hash, commit_hex);
+
+        return_value = open_object(commit_hash, O_RDONLY, 0, &commit_fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            printf("\e[31mCan't read commit %s.\e[0m\n", commit_hex);
+            return_value = ERROR_CODE_NOT_FOUND;
+            goto cleanup;
+        }
+
+        bytes_read = read(commit_fd, &num_of_parents, sizeof(num_of_parents));
+        if(sizeof(num_of_parents) != bytes_read || num_of_parents < 0){
+            printf("\e[31mMalformed commit %s.\e[0m\n", commit_hex);
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+
+        if(num_of_pending + num_of_parents > pending_capacity){
+            pending_capacity = num_of_pending + num_of_parents;
+            new_pending = realloc(pending, pending_capacity * SHA_DIGEST_LENGTH);
+            if(NULL == new_pending){
+                perror("HISTORY_WALK: Realloc error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                goto cleanup;
+            }
+            pending = new_pending;
+        }
+
+        bytes_read = read(commit_fd, pending + num_of_pending * SHA_DIGEST_LENGTH, (size_t)num_of_parents * SHA_DIGEST_LENGTH);
+        if((size_t)num_of_parents * SHA_DIGEST_LENGTH != bytes_read){
+            printf("\e[31mMalformed commit %s.\e[0m\n", commit_hex);
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+        close(commit_fd);
+        commit_fd = -1;
+
+        descend = true;
+        return_value = callback(commit_hash, context, &descend);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(descend){
+            num_of_pending += num_of_parents;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != commit_fd){
+        close(commit_fd);
+    }
+    if(NULL != pending){
+        free(pending);
+    }
+
+    return return_value;
+}
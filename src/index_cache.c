@@ -0,0 +1,922 @@
+#include "slap_commands.h"
+
+#include <sys/mman.h>
+
+/**
+ * @brief: Initializes the index cache of a repository, with nothing loaded yet
+ * @param[OUT] cache: The cache
+ */
+void index_cache_init(OUT index_cache_t * cache){
+    memset(cache, 0, sizeof(*cache));
+    cache->sorted = true;
+}
+
+/**
+ * @brief: Checks if a file is the same one (with the same contents) as when it was stat'ed before
+ */
+static bool index_cache_same_file(IN const struct stat * before, IN const struct stat * after){
+    return before->st_dev == after->st_dev && before->st_ino == after->st_ino &&
+           before->st_size == after->st_size &&
+           before->st_mtim.tv_sec == after->st_mtim.tv_sec && before->st_mtim.tv_nsec == after->st_mtim.tv_nsec &&
+           before->st_ctim.tv_sec == after->st_ctim.tv_sec && before->st_ctim.tv_nsec == after->st_ctim.tv_nsec;
+}
+
+/**
+ * @brief: Checks that another process didn't replace a file the cache holds unwritten changes to
+ * @param[IN] path: The index or HEAD
+ * @param[IN] before: The stat of the file when the cache was loaded from it or last wrote it
+ *
+ * @returns: ERROR_CODE_SUCCESS if it is the same file, else an indicative error code
+ * @notes: The unwritten changes are newer than the file they were made to, but not than a file another
+ *         process wrote since, so they must not be written over it. A missing file has an all zero stat.
+ */
+static error_code_t index_cache_check_unchanged(IN const char * path, IN const struct stat * before){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct stat statbuf = {0};
+
+    error_check = fstatat(work_tree_fd(), path, &statbuf, 0);
+    if(-1 == error_check && ENOENT == errno){
+        memset(&statbuf, 0, sizeof(statbuf));
+        errno = 0;
+    }
+    else if(-1 == error_check){
+        perror("INDEX_CACHE_CHECK_UNCHANGED: Stat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(!index_cache_same_file(before, &statbuf)){
+        printf("\e[31m%s was changed by another process, the changes made to it here were dropped.\e[0m\n", path);
+        return_value = ERROR_CODE_CHANGED_ON_DISK;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Orders index entries by path
+ */
+static int index_cache_compare(IN const void * first, IN const void * second){
+    const index_file_segement_t * a = first;
+    const index_file_segement_t * b = second;
+    int difference = 0;
+
+    difference = memcmp(a->name, b->name, min(a->name_len, b->name_len));
+    if(0 != difference){
+        return difference;
+    }
+
+    return a->name_len - b->name_len;
+}
+
+/**
+ * @brief: Orders commit entries by path
+ */
+static int index_cache_commit_compare(IN const void * first, IN const void * second){
+    const commit_entry_t * a = first;
+    const commit_entry_t * b = second;
+    int difference = 0;
+
+    difference = memcmp(a->name, b->name, min(a->name_len, b->name_len));
+    if(0 != difference){
+        return difference;
+    }
+
+    return a->name_len - b->name_len;
+}
+
+/**
+ * @brief: Gets the slot of a path in the cache
+ * @param[IN] name: The path
+ * @param[IN] name_len: The length of the path
+ *
+ * @returns: The slot holding the path, or the empty slot where it would be inserted
+ * @notes: The path is hashed with FNV-1a
+ */
+static size_t index_cache_slot(IN const char * name, IN int name_len){
+    size_t slot = 2166136261u;
+    int i = 0;
+    const index_file_segement_t * entry = NULL;
+    index_cache_t * cache = &repository_state()->index;
+
+    for(i=0; i<name_len; i++){
+        slot = (slot ^ (unsigned char)name[i]) * 16777619u;
+    }
+    slot &= cache->num_of_slots - 1;
+
+    while(0 != cache->slots[slot]){
+        entry = &cache->entries[cache->slots[slot] - 1];
+        if(entry->name_len == name_len && 0 == memcmp(entry->name, name, name_len)){
+            break;
+        }
+        slot = (slot + 1) & (cache->num_of_slots - 1);
+    }
+
+    return slot;
+}
+
+/**
+ * @brief: Rebuilds the slots of the cache, so there are at least twice as many slots as entries
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t index_cache_rebuild_slots(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t new_num_of_slots = 64;
+    unsigned int * new_slots = NULL;
+    index_cache_t * cache = &repository_state()->index;
+
+    while(new_num_of_slots < 2 * (cache->count + 1)){
+        new_num_of_slots *= 2;
+    }
+
+    new_slots = calloc(new_num_of_slots, sizeof(*new_slots));
+    if(NULL == new_slots){
+        perror("INDEX_CACHE_REBUILD_SLOTS: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    if(NULL != cache->slots){
+        free(cache->slots);
+    }
+    cache->slots = new_slots;
+    cache->num_of_slots = new_num_of_slots;
+
+    for(i=0; i<cache->count; i++){
+        cache->slots[index_cache_slot(cache->entries[i].name, cache->entries[i].name_len)] = i + 1;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Makes room for one more entry in the cache
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t index_cache_reserve(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t new_capacity = 0;
+    index_file_segement_t * new_entries = NULL;
+    index_cache_t * cache = &repository_state()->index;
+
+    if(cache->count < cache->capacity){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    new_capacity = max(2 * cache->capacity, 64);
+    new_entries = realloc(cache->entries, new_capacity * sizeof(*cache->entries));
+    if(NULL == new_entries){
+        perror("INDEX_CACHE_RESERVE: Realloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    cache->entries = new_entries;
+    cache->capacity = new_capacity;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Frees the entries of the cache
+ */
+static void index_cache_free_entries(){
+    size_t i = 0;
+    index_cache_t * cache = &repository_state()->index;
+
+    if(NULL != cache->entries){
+        for(i=0; i<cache->count; i++){
+            free(cache->entries[i].name);
+        }
+        free(cache->entries);
+    }
+    if(NULL != cache->slots){
+        free(cache->slots);
+    }
+
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->slots = NULL;
+    cache->num_of_slots = 0;
+    cache->sorted = true;
+    cache->dirty = false;
+    cache->loaded = false;
+}
+
+/**
+ * @brief: Unmaps the commit HEAD points to
+ */
+static void index_cache_free_head_commit(){
+    index_cache_t * cache = &repository_state()->index;
+
+    if(NULL != cache->head_commit_data){
+        munmap(cache->head_commit_data, cache->head_commit_size);
+    }
+    if(NULL != cache->head_commit_entries){
+        free(cache->head_commit_entries);
+    }
+
+    cache->head_commit_data = NULL;
+    cache->head_commit_size = 0;
+    cache->head_commit_entries = NULL;
+    cache->head_commit_count = 0;
+    cache->head_commit_loaded = false;
+}
+
+/**
+ * @brief: Drops the cached index and HEAD, with the changes that weren't written
+ */
+static void index_cache_drop(){
+    index_cache_t * cache = &repository_state()->index;
+
+    index_cache_free_entries();
+    index_cache_free_head_commit();
+    cache->head_loaded = false;
+    cache->head_exists = false;
+    cache->head_dirty = false;
+}
+
+/**
+ * @brief: Parses the index file into the cache
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The whole file is mapped and parsed in one pass
+ */
+static error_code_t index_cache_read(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int index_fd = -1;
+    size_t offset = 0;
+    unsigned char * data = NULL;
+    index_file_segement_t * entry = NULL;
+    struct stat statbuf = {0};
+    index_cache_t * cache = &repository_state()->index;
+
+    index_fd = openat(work_tree_fd(), index_file_path, O_RDONLY);
+    if(-1 == index_fd){
+        perror("INDEX_CACHE_READ: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(index_fd, &statbuf);
+    if(-1 == error_check){
+        perror("INDEX_CACHE_READ: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(statbuf.st_size > 0){
+        data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, index_fd, 0);
+        if(MAP_FAILED == data){
+            data = NULL;
+            perror("INDEX_CACHE_READ: Mmap error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+    }
+
+    while(offset < (size_t)statbuf.st_size){
+        return_value = index_cache_reserve();
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        entry = &cache->entries[cache->count];
+        if((size_t)statbuf.st_size - offset < INDEX_SEGMENT_HEADER_SIZE){
+            printf("\e[31m%s is truncated.\e[0m\n", index_file_path);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+
+        memcpy(entry->wdir_sha, data + offset, SHA_DIGEST_LENGTH);
+        memcpy(entry->stage_sha, data + offset + SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        memcpy(entry->repo_sha, data + offset + 2 * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        memcpy(&entry->mode, data + offset + 3 * SHA_DIGEST_LENGTH, sizeof(entry->mode));
+        memcpy(&entry->name_len, data + offset + 3 * SHA_DIGEST_LENGTH + sizeof(entry->mode), sizeof(entry->name_len));
+        offset += INDEX_SEGMENT_HEADER_SIZE;
+
+        if(0 > entry->name_len || (size_t)statbuf.st_size - offset < (size_t)entry->name_len){
+            printf("\e[31m%s is truncated.\e[0m\n", index_file_path);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+
+        entry->name = malloc(entry->name_len + 1);
+        if(NULL == entry->name){
+            perror("INDEX_CACHE_READ: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        memcpy(entry->name, data + offset, entry->name_len);
+        entry->name[entry->name_len] = '\0';
+        offset += entry->name_len;
+        PROBE3(index__read, entry->name, INDEX_SEGMENT_HEADER_SIZE + entry->name_len, entry->wdir_sha);
+
+        if(0 != cache->count && 0 < index_cache_compare(&cache->entries[cache->count - 1], entry)){
+            cache->sorted = false;
+        }
+        cache->count++;
+    }
+
+    return_value = index_cache_rebuild_slots();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    cache->index_stat = statbuf;
+    cache->loaded = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        index_cache_free_entries();
+    }
+    if(NULL != data){
+        munmap(data, statbuf.st_size);
+    }
+    if(-1 != index_fd){
+        close(index_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Loads the index into the cache, unless the cached index is still the one on disk
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The index file is stat'ed and only parsed again if its inode, size, mtime or ctime changed (it is
+ *         always replaced with replace_file, so a new index is a new inode). Changes that weren't written yet
+ *         are newer than the file, so they are kept, index_cache_flush refuses to write them over an index
+ *         another process wrote in the meantime.
+ */
+error_code_t index_cache_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct stat statbuf = {0};
+    index_cache_t * cache = &repository_state()->index;
+
+    if(cache->loaded && cache->dirty){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = fstatat(work_tree_fd(), index_file_path, &statbuf, 0);
+    if(-1 == error_check){
+        perror("INDEX_CACHE_LOAD: Fstatat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(cache->loaded && index_cache_same_file(&cache->index_stat, &statbuf)){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    index_cache_free_entries();
+    TRACE_BEGIN("read_index");
+    return_value = index_cache_read();
+    TRACE_END("read_index");
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the entries of the index, sorted by path
+ * @param[OUT] entries: The entries, which belong to the cache
+ * @param[OUT] count: The number of entries
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Entries may be changed in place, followed by index_cache_changed. The pointer is valid until the
+ *         next index_cache_add, index_cache_load or index_cache_close.
+ */
+error_code_t index_cache_entries(OUT index_file_segement_t ** entries, OUT size_t * count){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    index_cache_t * cache = &repository_state()->index;
+
+    return_value = index_cache_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(!cache->sorted){
+        qsort(cache->entries, cache->count, sizeof(*cache->entries), index_cache_compare);
+        cache->sorted = true;
+
+        return_value = index_cache_rebuild_slots();
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    *entries = cache->entries;
+    *count = cache->count;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Finds the index entry of a path
+ * @param[IN] name: The path
+ * @param[IN] name_len: The length of the path
+ * @param[OUT] entry: The entry, which belongs to the cache, or NULL if the path isn't in the index
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t index_cache_find(IN const char * name, IN int name_len, OUT index_file_segement_t ** entry){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t slot = 0;
+    index_cache_t * cache = &repository_state()->index;
+
+    *entry = NULL;
+
+    return_value = index_cache_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    slot = index_cache_slot(name, name_len);
+    if(0 != cache->slots[slot]){
+        *entry = &cache->entries[cache->slots[slot] - 1];
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the sha of a path in the commit HEAD points to
+ * @param[IN] name: The path
+ * @param[IN] name_len: The length of the path
+ * @param[OUT] hash: The sha, all zeros if the path wasn't committed
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The commit is mapped and its entries sorted once, until HEAD changes
+ */
+static error_code_t index_cache_committed_sha(IN const char * name, IN int name_len, OUT unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    int num_of_parents = 0;
+    size_t offset = 0;
+    size_t capacity = 0;
+    bool exists = false;
+    bool sorted = true;
+    unsigned char commit_hash[SHA_DIGEST_LENGTH] = {0};
+    const unsigned char * parents = NULL;
+    commit_entry_t * new_entries = NULL;
+    commit_entry_t * found = NULL;
+    commit_entry_t key = {0};
+    struct stat statbuf = {0};
+    index_cache_t * cache = &repository_state()->index;
+
+    memset(hash, 0, SHA_DIGEST_LENGTH);
+
+    return_value = index_cache_head(commit_hash, &exists);
+    if(ERROR_CODE_SUCCESS != return_value || !exists){
+        goto cleanup;
+    }
+
+    if(!cache->head_commit_loaded){
+        return_value = open_object(commit_hash, O_RDONLY, 0, &fd);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = fstat(fd, &statbuf);
+        if(-1 == error_check){
+            perror("INDEX_CACHE_COMMITTED_SHA: Fstat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            goto cleanup;
+        }
+
+        if(statbuf.st_size > 0){
+            cache->head_commit_data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(MAP_FAILED == cache->head_commit_data){
+                cache->head_commit_data = NULL;
+                perror("INDEX_CACHE_COMMITTED_SHA: Mmap error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_READ;
+                goto cleanup;
+            }
+            cache->head_commit_size = statbuf.st_size;
+        }
+
+        return_value = commit_parents(cache->head_commit_data, cache->head_commit_size, &num_of_parents, &parents);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+        while(true){
+            if(cache->head_commit_count == capacity){
+                capacity = max(2 * capacity, 64);
+                new_entries = realloc(cache->head_commit_entries, capacity * sizeof(*cache->head_commit_entries));
+                if(NULL == new_entries){
+                    perror("INDEX_CACHE_COMMITTED_SHA: Realloc error");
+                    printf("(Errno: %i)\n", errno);
+                    return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+                    goto cleanup;
+                }
+                cache->head_commit_entries = new_entries;
+            }
+
+            return_value = commit_next_entry(cache->head_commit_data, cache->head_commit_size, &offset, &cache->head_commit_entries[cache->head_commit_count]);
+            if(ERROR_CODE_EOF == return_value){
+                break;
+            }
+            else if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+
+            if(0 != cache->head_commit_count &&
+               0 < index_cache_commit_compare(&cache->head_commit_entries[cache->head_commit_count - 1], &cache->head_commit_entries[cache->head_commit_count])){
+                sorted = false;
+            }
+            cache->head_commit_count++;
+        }
+
+        /* commit writes its entries sorted, only older commits are sorted here */
+        if(!sorted){
+            qsort(cache->head_commit_entries, cache->head_commit_count, sizeof(*cache->head_commit_entries), index_cache_commit_compare);
+        }
+        cache->head_commit_loaded = true;
+    }
+
+    key.name = name;
+    key.name_len = name_len;
+    found = bsearch(&key, cache->head_commit_entries, cache->head_commit_count, sizeof(*cache->head_commit_entries), index_cache_commit_compare);
+    if(NULL != found){
+        memcpy(hash, found->sha, SHA_DIGEST_LENGTH);
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        index_cache_free_head_commit();
+    }
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Adds a path to the index, if it isn't in it already
+ * @param[IN] name: The path
+ * @param[IN] name_len: The length of the path
+ * @param[OUT] entry: The entry of the path, which belongs to the cache
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A new entry has all zeros working directory and staged shas, and the committed sha of the path.
+ *         Pointers to other entries are invalidated.
+ */
+error_code_t index_cache_add(IN const char * name, IN int name_len, OUT index_file_segement_t ** entry){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t slot = 0;
+    index_file_segement_t * new_entry = NULL;
+    index_cache_t * cache = &repository_state()->index;
+
+    return_value = index_cache_find(name, name_len, entry);
+    if(ERROR_CODE_SUCCESS != return_value || NULL != *entry){
+        goto cleanup;
+    }
+
+    return_value = index_cache_reserve();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    new_entry = &cache->entries[cache->count];
+    memset(new_entry, 0, sizeof(*new_entry));
+
+    return_value = index_cache_committed_sha(name, name_len, new_entry->repo_sha);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    new_entry->name = malloc(name_len + 1);
+    if(NULL == new_entry->name){
+        perror("INDEX_CACHE_ADD: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    memcpy(new_entry->name, name, name_len);
+    new_entry->name[name_len] = '\0';
+    new_entry->name_len = name_len;
+
+    if(0 != cache->count && 0 < index_cache_compare(&cache->entries[cache->count - 1], new_entry)){
+        cache->sorted = false;
+    }
+    cache->count++;
+    cache->dirty = true;
+
+    if(2 * cache->count > cache->num_of_slots){
+        return_value = index_cache_rebuild_slots();
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+    else{
+        slot = index_cache_slot(name, name_len);
+        cache->slots[slot] = cache->count;
+    }
+
+    *entry = new_entry;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Marks the cached index as changed, so the next index_cache_write writes it
+ */
+void index_cache_changed(){
+    index_cache_t * cache = &repository_state()->index;
+
+    cache->dirty = true;
+}
+
+/**
+ * @brief: Reads the sha HEAD points to, unless the cached one is still the one on disk
+ * @param[OUT] hash: The sha
+ * @param[OUT] exists: false if nothing was committed yet
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: HEAD is validated by stat'ing it, like the index
+ */
+error_code_t index_cache_head(OUT unsigned char * hash, OUT bool * exists){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct stat statbuf = {0};
+    index_cache_t * cache = &repository_state()->index;
+
+    /* A HEAD that wasn't written yet is newer than the file */
+    if(!cache->head_loaded || !cache->head_dirty){
+        error_check = fstatat(work_tree_fd(), HEAD_file_path, &statbuf, 0);
+        if(-1 == error_check){
+            perror("INDEX_CACHE_HEAD: Fstatat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            goto cleanup;
+        }
+    }
+
+    if(!cache->head_loaded || (!cache->head_dirty && !index_cache_same_file(&cache->head_stat, &statbuf))){
+        cache->head_loaded = false;
+        index_cache_free_head_commit();
+
+        return_value = read_head_file(HEAD_file_path, cache->head_sha, &cache->head_exists);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        cache->head_stat = statbuf;
+        cache->head_loaded = true;
+    }
+
+    memcpy(hash, cache->head_sha, SHA_DIGEST_LENGTH);
+    *exists = cache->head_exists;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Points HEAD at a commit, the next index_cache_write writes it
+ * @param[IN] hash: The sha of the commit
+ */
+void index_cache_set_head(IN const unsigned char * hash){
+    int error_check = 0;
+    index_cache_t * cache = &repository_state()->index;
+
+    /* The HEAD this one replaces, for index_cache_flush to check that it wasn't changed meanwhile */
+    if(!cache->head_loaded){
+        error_check = fstatat(work_tree_fd(), HEAD_file_path, &cache->head_stat, 0);
+        if(-1 == error_check){
+            memset(&cache->head_stat, 0, sizeof(cache->head_stat));
+            errno = 0;
+        }
+    }
+
+    memcpy(cache->head_sha, hash, SHA_DIGEST_LENGTH);
+    index_cache_free_head_commit();
+    cache->head_exists = true;
+    cache->head_loaded = true;
+    cache->head_dirty = true;
+}
+
+/**
+ * @brief: Writes the changes to the index and HEAD, unless writing is deferred
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: While deferred (see index_cache_defer) the changes stay in memory until index_cache_flush
+ */
+error_code_t index_cache_write(){
+    index_cache_t * cache = &repository_state()->index;
+
+    if(cache->deferred){
+        return ERROR_CODE_SUCCESS;
+    }
+
+    return index_cache_flush();
+}
+
+/**
+ * @brief: Writes the changes to the index and HEAD
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects are synced first, then the index is written sorted by path, then HEAD, so neither
+ *         ever references data that didn't reach the disk. Both are written with replace_file. If another
+ *         process replaced either file since it was loaded, nothing is written and the changes are dropped.
+ */
+error_code_t index_cache_flush(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    size_t i = 0;
+    size_t length = 0;
+    size_t offset = 0;
+    size_t count = 0;
+    unsigned char * buffer = NULL;
+    index_file_segement_t * entries = NULL;
+    struct stat statbuf = {0};
+    index_cache_t * cache = &repository_state()->index;
+
+    TRACE_BEGIN("sync_objects");
+    return_value = sync_objects();
+    TRACE_END("sync_objects");
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = index_cache_validate();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(cache->loaded && cache->dirty){
+        return_value = index_cache_entries(&entries, &count);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        for(i=0; i<count; i++){
+            length += INDEX_SEGMENT_HEADER_SIZE + entries[i].name_len;
+        }
+
+        buffer = malloc(max(length, 1));
+        if(NULL == buffer){
+            perror("INDEX_CACHE_FLUSH: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        for(i=0; i<count; i++){
+            memcpy(buffer + offset, entries[i].wdir_sha, SHA_DIGEST_LENGTH);
+            memcpy(buffer + offset + SHA_DIGEST_LENGTH, entries[i].stage_sha, SHA_DIGEST_LENGTH);
+            memcpy(buffer + offset + 2 * SHA_DIGEST_LENGTH, entries[i].repo_sha, SHA_DIGEST_LENGTH);
+            memcpy(buffer + offset + 3 * SHA_DIGEST_LENGTH, &entries[i].mode, sizeof(entries[i].mode));
+            memcpy(buffer + offset + 3 * SHA_DIGEST_LENGTH + sizeof(entries[i].mode), &entries[i].name_len, sizeof(entries[i].name_len));
+            offset += INDEX_SEGMENT_HEADER_SIZE;
+            memcpy(buffer + offset, entries[i].name, entries[i].name_len);
+            offset += entries[i].name_len;
+            PROBE3(index__write, entries[i].name, INDEX_SEGMENT_HEADER_SIZE + entries[i].name_len, entries[i].wdir_sha);
+        }
+
+        TRACE_BEGIN("write_index");
+        return_value = replace_file(index_file_path, buffer, length);
+        TRACE_END("write_index");
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = fstatat(work_tree_fd(), index_file_path, &statbuf, 0);
+        if(-1 == error_check){
+            perror("INDEX_CACHE_FLUSH: Fstatat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            goto cleanup;
+        }
+        cache->index_stat = statbuf;
+        cache->dirty = false;
+    }
+
+    if(cache->head_dirty){
+        TRACE_BEGIN("update_head");
+        return_value = replace_file(HEAD_file_path, cache->head_sha, SHA_DIGEST_LENGTH);
+        TRACE_END("update_head");
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = fstatat(work_tree_fd(), HEAD_file_path, &statbuf, 0);
+        if(-1 == error_check){
+            perror("INDEX_CACHE_FLUSH: Fstatat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_STAT;
+            goto cleanup;
+        }
+        cache->head_stat = statbuf;
+        cache->head_dirty = false;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != buffer){
+        free(buffer);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks that the index and HEAD the unwritten changes were made to are still the ones on disk
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: If another process replaced either of them the changes are dropped, so they can't be written over
+ *         its changes later. Clean caches are stat'ed on their next use anyway, so they aren't checked.
+ */
+error_code_t index_cache_validate(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    index_cache_t * cache = &repository_state()->index;
+
+    if(cache->loaded && cache->dirty){
+        return_value = index_cache_check_unchanged(index_file_path, &cache->index_stat);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    if(cache->head_loaded && cache->head_dirty){
+        return_value = index_cache_check_unchanged(HEAD_file_path, &cache->head_stat);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_CHANGED_ON_DISK == return_value){
+        index_cache_drop();
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Defers writing the index and HEAD until index_cache_flush
+ * @param[IN] defer: true to defer, false to write on every index_cache_write again
+ */
+void index_cache_defer(IN bool defer){
+    index_cache_t * cache = &repository_state()->index;
+
+    cache->deferred = defer;
+}
+
+/**
+ * @brief: Frees the cached index and HEAD
+ *
+ * @notes: Changes that weren't flushed are dropped
+ */
+void index_cache_close(){
+    index_cache_t * cache = &repository_state()->index;
+
+    index_cache_drop();
+    cache->deferred = false;
+}
@@ -0,0 +1,976 @@
+#include "slap_commands.h"
+
+#include <sys/mman.h>
+#include <sys/file.h>
+
+const char * object_index_name = "object_index";
+const char * object_index_journal_name = "object_index_journal";
+
+/**
+ * @brief: Initializes the object index cache of a repository, with nothing loaded yet
+ * @param[OUT] cache: The cache
+ */
+void object_index_cache_init(OUT object_index_cache_t * cache){
+    memset(cache, 0, sizeof(*cache));
+    cache->journal_fd = -1;
+    cache->journal_lock_fd = -1;
+}
+
+/**
+ * @brief: Compares two shas (for qsort and bsearch)
+ */
+static int object_index_compare(IN const void * sha1, IN const void * sha2){
+    return memcmp(sha1, sha2, SHA_DIGEST_LENGTH);
+}
+
+/**
+ * @brief: Finds the first sha in the sorted table that isn't smaller than a given sha
+ * @param[IN] hash: The sha to search for
+ *
+ * @returns: The position of the sha in the sorted table
+ */
+static unsigned int object_index_lower_bound(IN const unsigned char * hash){
+    unsigned int low = 0;
+    unsigned int high = 0;
+    unsigned int middle = 0;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    low = (0 == hash[0]) ? 0 : cache->header->fanout[hash[0] - 1];
+    high = cache->header->fanout[hash[0]];
+
+    while(low < high){
+        middle = low + (high - low) / 2;
+        if(memcmp(cache->shas + (size_t)middle * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH) < 0){
+            low = middle + 1;
+        }
+        else{
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief: Unmaps the sorted table
+ */
+static void object_index_unmap(){
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    if(NULL != cache->map){
+        munmap(cache->map, cache->map_len);
+    }
+    cache->map = NULL;
+    cache->map_len = 0;
+    cache->header = NULL;
+    cache->shas = NULL;
+}
+
+/**
+ * @brief: Writes a sorted table of shas as the object index
+ * @param[IN] shas: The sorted, unique shas
+ * @param[IN] count: The number of shas
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The table is written to a lock file which is then renamed over the object index,
+ *         so readers never see a partially written index.
+ */
+static error_code_t object_index_write(IN const unsigned char * shas, IN size_t count){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int lock_fd = -1;
+    size_t i = 0;
+    char lock_name[NAME_MAX] = {0};
+    object_index_header_t header = {0};
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    header.magic = OBJECT_INDEX_MAGIC;
+    header.version = OBJECT_INDEX_VERSION;
+    header.num_of_objects = count;
+    for(i=0; i<count; i++){
+        header.fanout[shas[i * SHA_DIGEST_LENGTH]]++;
+    }
+    for(i=1; i<256; i++){
+        header.fanout[i] += header.fanout[i-1];
+    }
+
+    snprintf(lock_name, sizeof(lock_name), "%s.lock", object_index_name);
+    lock_fd = openat(dir_fd, lock_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == lock_fd){
+        perror("OBJECT_INDEX_WRITE: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = write(lock_fd, &header, sizeof(header));
+    if(sizeof(header) != error_check){
+        perror("OBJECT_INDEX_WRITE: Write error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    for(i=0; i<count * SHA_DIGEST_LENGTH; i+=error_check){
+        error_check = write(lock_fd, shas + i, count * SHA_DIGEST_LENGTH - i);
+        if(-1 == error_check){
+            perror("OBJECT_INDEX_WRITE: Write error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    error_check = renameat(dir_fd, lock_name, dir_fd, object_index_name);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_WRITE: Renameat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_RENAME;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != lock_fd){
+        close(lock_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Maps the sorted table and reads the journal of the object index
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A missing or invalid object index is rebuilt from the objects directory
+ */
+static error_code_t object_index_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int index_fd = -1;
+    ssize_t bytes_read = 0;
+    size_t offset = 0;
+    struct stat statbuf = {0};
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    if(cache->loaded){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    index_fd = openat(dir_fd, object_index_name, O_RDONLY | O_CLOEXEC);
+    if(-1 == index_fd && ENOENT == errno){
+        errno = 0;
+        return_value = object_index_rebuild();
+        goto cleanup;
+    }
+    if(-1 == index_fd){
+        perror("OBJECT_INDEX_LOAD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(index_fd, &statbuf);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_LOAD: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if(statbuf.st_size < sizeof(object_index_header_t)){
+        return_value = object_index_rebuild();
+        goto cleanup;
+    }
+
+    cache->map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, index_fd, 0);
+    if(MAP_FAILED == cache->map){
+        cache->map = NULL;
+        perror("OBJECT_INDEX_LOAD: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    cache->map_len = statbuf.st_size;
+    cache->header = cache->map;
+    cache->shas = (const unsigned char *)cache->map + sizeof(object_index_header_t);
+
+    if(OBJECT_INDEX_MAGIC != cache->header->magic || OBJECT_INDEX_VERSION != cache->header->version ||
+       cache->map_len != sizeof(object_index_header_t) + (size_t)cache->header->num_of_objects * SHA_DIGEST_LENGTH ||
+       cache->header->fanout[255] != cache->header->num_of_objects){
+        object_index_unmap();
+        return_value = object_index_rebuild();
+        goto cleanup;
+    }
+
+    cache->journal_fd = openat(dir_fd, object_index_journal_name, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if(-1 == cache->journal_fd){
+        perror("OBJECT_INDEX_LOAD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(cache->journal_fd, &statbuf);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_LOAD: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    cache->journal_count = statbuf.st_size / SHA_DIGEST_LENGTH;
+    cache->journal_capacity = max(cache->journal_count, OBJECT_INDEX_JOURNAL_MAX);
+    cache->journal_shas = malloc(cache->journal_capacity * SHA_DIGEST_LENGTH);
+    if(NULL == cache->journal_shas){
+        perror("OBJECT_INDEX_LOAD: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(offset=0; offset<cache->journal_count * SHA_DIGEST_LENGTH; offset+=bytes_read){
+        bytes_read = pread(cache->journal_fd, cache->journal_shas + offset, cache->journal_count * SHA_DIGEST_LENGTH - offset, offset);
+        if(-1 == bytes_read){
+            perror("OBJECT_INDEX_LOAD: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            cache->journal_count = offset / SHA_DIGEST_LENGTH;
+            break;
+        }
+    }
+    qsort(cache->journal_shas, cache->journal_count, SHA_DIGEST_LENGTH, object_index_compare);
+
+    cache->loaded = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != index_fd){
+        close(index_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Takes the exclusive lock of the journal, which keeps other processes from appending to it
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The lock may be taken again by the same process (a merge can rebuild the object index), it is
+ *         released when object_index_unlock_journal was called as many times
+ */
+static error_code_t object_index_lock_journal(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    if(cache->journal_lock_depth > 0){
+        cache->journal_lock_depth++;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    cache->journal_lock_fd = openat(dir_fd, object_index_journal_name, O_RDONLY | O_CREAT | O_CLOEXEC, 0666);
+    if(-1 == cache->journal_lock_fd){
+        perror("OBJECT_INDEX_LOCK_JOURNAL: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = flock(cache->journal_lock_fd, LOCK_EX);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_LOCK_JOURNAL: Flock error");
+        printf("(Errno: %i)\n", errno);
+        close(cache->journal_lock_fd);
+        cache->journal_lock_fd = -1;
+        return_value = ERROR_CODE_COULDNT_LOCK;
+        goto cleanup;
+    }
+
+    cache->journal_lock_depth = 1;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Releases the exclusive lock of the journal
+ */
+static void object_index_unlock_journal(){
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    if(cache->journal_lock_depth <= 0){
+        return;
+    }
+
+    cache->journal_lock_depth--;
+    if(0 == cache->journal_lock_depth){
+        close(cache->journal_lock_fd);
+        cache->journal_lock_fd = -1;
+    }
+}
+
+/**
+ * @brief: Merges the journal into the sorted table
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Other processes (like other worktrees) may append to the journal at the same time, so the merge
+ *         holds the exclusive lock of the journal and reloads the table and the journal under it first.
+ *         Appenders hold a shared lock while they write, so no sha is appended between the reload and
+ *         the truncation of the journal.
+ */
+static error_code_t object_index_merge(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    bool locked = false;
+    unsigned char * merged = NULL;
+    size_t merged_count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    int difference = 0;
+    const unsigned char * next = NULL;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    return_value = object_index_lock_journal();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    locked = true;
+
+    object_index_close();
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    /* Another process merged the journal in the meantime */
+    if(0 == cache->journal_count){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    merged = malloc(((size_t)cache->header->num_of_objects + cache->journal_count) * SHA_DIGEST_LENGTH);
+    if(NULL == merged){
+        perror("OBJECT_INDEX_MERGE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    while(i < cache->header->num_of_objects || j < cache->journal_count){
+        if(i >= cache->header->num_of_objects){
+            difference = 1;
+        }
+        else if(j >= cache->journal_count){
+            difference = -1;
+        }
+        else{
+            difference = memcmp(cache->shas + i * SHA_DIGEST_LENGTH, cache->journal_shas + j * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        }
+
+        if(difference <= 0){
+            next = cache->shas + i * SHA_DIGEST_LENGTH;
+            i++;
+            if(0 == difference){
+                j++;
+            }
+        }
+        else{
+            next = cache->journal_shas + j * SHA_DIGEST_LENGTH;
+            j++;
+        }
+
+        memcpy(merged + merged_count * SHA_DIGEST_LENGTH, next, SHA_DIGEST_LENGTH);
+        merged_count++;
+    }
+
+    return_value = object_index_write(merged, merged_count);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = ftruncate(cache->journal_fd, 0);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_MERGE: Ftruncate error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_TRUNCATE;
+        goto cleanup;
+    }
+
+    object_index_unlock_journal();
+    locked = false;
+
+    object_index_close();
+    return_value = object_index_load();
+
+cleanup:
+    if(locked){
+        object_index_unlock_journal();
+    }
+    if(NULL != merged){
+        free(merged);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets the slot of a sha in the pending set
+ * @param[IN] hash: The sha to look for
+ *
+ * @returns: The slot holding the sha, or the empty slot where it would be inserted
+ * @notes: Shas are uniformly distributed, so their first bytes are used as the hash
+ */
+static size_t object_index_pending_slot(IN const unsigned char * hash){
+    size_t slot = 0;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    memcpy(&slot, hash, sizeof(slot));
+    slot &= cache->pending_slot_capacity - 1;
+
+    while(0 != cache->pending_slots[slot] &&
+          0 != memcmp(cache->pending_shas + (size_t)(cache->pending_slots[slot] - 1) * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH)){
+        slot = (slot + 1) & (cache->pending_slot_capacity - 1);
+    }
+
+    return slot;
+}
+
+/**
+ * @brief: Checks if an object exists, without touching the objects directory
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] exists: Set to true if the object exists
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only objects missing from the index are looked up in the alternate objects directories
+ */
+error_code_t object_index_contains(IN const unsigned char * hash, OUT bool * exists){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    unsigned int position = 0;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    *exists = false;
+
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    position = object_index_lower_bound(hash);
+    if(position < cache->header->num_of_objects &&
+       0 == memcmp(cache->shas + (size_t)position * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH)){
+        *exists = true;
+        goto cleanup;
+    }
+
+    *exists = (NULL != bsearch(hash, cache->journal_shas, cache->journal_count, SHA_DIGEST_LENGTH, object_index_compare));
+    if(!*exists && cache->pending_count > 0){
+        *exists = (0 != cache->pending_slots[object_index_pending_slot(hash)]);
+    }
+    /* An object in an alternate objects directory doesn't have to be written again */
+    if(!*exists){
+        *exists = object_alternate_exists(hash);
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Records a new object in the object index
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The sha is only kept in memory until object_index_flush is called, which must happen
+ *         after the object itself is durable, so the index never claims an object that was lost.
+ */
+error_code_t object_index_add(IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    bool exists = false;
+    size_t i = 0;
+    size_t new_capacity = 0;
+    unsigned int * new_slots = NULL;
+    unsigned char * new_shas = NULL;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    return_value = object_index_contains(hash, &exists);
+    if(ERROR_CODE_SUCCESS != return_value || exists){
+        goto cleanup;
+    }
+
+    if((cache->pending_count + 1) * 2 > cache->pending_slot_capacity){
+        new_capacity = max(cache->pending_slot_capacity * 2, 1024);
+
+        new_shas = realloc(cache->pending_shas, new_capacity / 2 * SHA_DIGEST_LENGTH);
+        if(NULL == new_shas){
+            perror("OBJECT_INDEX_ADD: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        cache->pending_shas = new_shas;
+
+        new_slots = calloc(new_capacity, sizeof(*new_slots));
+        if(NULL == new_slots){
+            perror("OBJECT_INDEX_ADD: Calloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        free(cache->pending_slots);
+        cache->pending_slots = new_slots;
+        cache->pending_slot_capacity = new_capacity;
+
+        for(i=0; i<cache->pending_count; i++){
+            cache->pending_slots[object_index_pending_slot(cache->pending_shas + i * SHA_DIGEST_LENGTH)] = i + 1;
+        }
+    }
+
+    memcpy(cache->pending_shas + cache->pending_count * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH);
+    cache->pending_count++;
+    cache->pending_slots[object_index_pending_slot(hash)] = cache->pending_count;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Writes the shas recorded by object_index_add to the journal
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The journal is merged into the sorted table once it holds OBJECT_INDEX_JOURNAL_MAX shas
+ */
+error_code_t object_index_flush(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    ssize_t bytes_written = 0;
+    size_t offset = 0;
+    unsigned char * new_journal = NULL;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    if(!cache->loaded || 0 == cache->pending_count){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    /* A merge in another process can't truncate the journal while it is appended to */
+    error_check = flock(cache->journal_fd, LOCK_SH);
+    if(-1 == error_check){
+        perror("OBJECT_INDEX_FLUSH: Flock error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_LOCK;
+        goto cleanup;
+    }
+
+    for(offset=0; offset<cache->pending_count * SHA_DIGEST_LENGTH; offset+=bytes_written){
+        bytes_written = write(cache->journal_fd, cache->pending_shas + offset, cache->pending_count * SHA_DIGEST_LENGTH - offset);
+        if(-1 == bytes_written){
+            perror("OBJECT_INDEX_FLUSH: Write error");
+            printf("(Errno: %i)\n", errno);
+            flock(cache->journal_fd, LOCK_UN);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+    flock(cache->journal_fd, LOCK_UN);
+
+    if(cache->journal_count + cache->pending_count > cache->journal_capacity){
+        new_journal = realloc(cache->journal_shas, (cache->journal_count + cache->pending_count) * SHA_DIGEST_LENGTH);
+        if(NULL == new_journal){
+            perror("OBJECT_INDEX_FLUSH: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        cache->journal_shas = new_journal;
+        cache->journal_capacity = cache->journal_count + cache->pending_count;
+    }
+
+    memcpy(cache->journal_shas + cache->journal_count * SHA_DIGEST_LENGTH, cache->pending_shas, cache->pending_count * SHA_DIGEST_LENGTH);
+    cache->journal_count += cache->pending_count;
+    qsort(cache->journal_shas, cache->journal_count, SHA_DIGEST_LENGTH, object_index_compare);
+
+    cache->pending_count = 0;
+    memset(cache->pending_slots, 0, cache->pending_slot_capacity * sizeof(*cache->pending_slots));
+
+    if(cache->journal_count >= OBJECT_INDEX_JOURNAL_MAX){
+        return_value = object_index_merge();
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Resolves an abbreviated sha
+ * @param[IN] prefix: The abbreviated sha in hex (at least OBJECT_INDEX_MIN_PREFIX digits)
+ * @param[OUT] hash: The full sha
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if no object matches,
+ *           ERROR_CODE_AMBIGUOUS if more than one does, else an indicative error code
+ */
+error_code_t object_index_resolve(IN const char * prefix, OUT unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int prefix_len = 0;
+    int i = 0;
+    int value = 0;
+    unsigned int position = 0;
+    size_t j = 0;
+    bool found = false;
+    const unsigned char * candidate = NULL;
+    unsigned char low[SHA_DIGEST_LENGTH] = {0};
+    unsigned char high[SHA_DIGEST_LENGTH] = {0};
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    prefix_len = strnlen(prefix, OBJECT_HEX_LEN + 1);
+    if(prefix_len < OBJECT_INDEX_MIN_PREFIX || prefix_len > OBJECT_HEX_LEN){
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    memset(high, 0xff, SHA_DIGEST_LENGTH);
+    for(i=0; i<prefix_len; i++){
+        value = hex_value(prefix[i]);
+        if(-1 == value){
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+
+        if(0 == i % 2){
+            low[i/2] = value << 4;
+            high[i/2] = (value << 4) | 0xf;
+        }
+        else{
+            low[i/2] |= value;
+            high[i/2] = low[i/2];
+        }
+    }
+
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(position = object_index_lower_bound(low); position < cache->header->num_of_objects; position++){
+        candidate = cache->shas + (size_t)position * SHA_DIGEST_LENGTH;
+        if(memcmp(candidate, high, SHA_DIGEST_LENGTH) > 0){
+            break;
+        }
+        if(found && 0 != memcmp(candidate, hash, SHA_DIGEST_LENGTH)){
+            return_value = ERROR_CODE_AMBIGUOUS;
+            goto cleanup;
+        }
+        memcpy(hash, candidate, SHA_DIGEST_LENGTH);
+        found = true;
+    }
+
+    for(j=0; j<cache->journal_count + cache->pending_count; j++){
+        candidate = (j < cache->journal_count) ? cache->journal_shas + j * SHA_DIGEST_LENGTH : cache->pending_shas + (j - cache->journal_count) * SHA_DIGEST_LENGTH;
+        if(memcmp(candidate, low, SHA_DIGEST_LENGTH) < 0 || memcmp(candidate, high, SHA_DIGEST_LENGTH) > 0){
+            continue;
+        }
+        if(found && 0 != memcmp(candidate, hash, SHA_DIGEST_LENGTH)){
+            return_value = ERROR_CODE_AMBIGUOUS;
+            goto cleanup;
+        }
+        memcpy(hash, candidate, SHA_DIGEST_LENGTH);
+        found = true;
+    }
+
+    /* The alternates aren't indexed, so their objects can only be named by their full sha */
+    if(!found && OBJECT_HEX_LEN == prefix_len && object_alternate_exists(low)){
+        memcpy(hash, low, SHA_DIGEST_LENGTH);
+        found = true;
+    }
+
+    return_value = found ? ERROR_CODE_SUCCESS : ERROR_CODE_NOT_FOUND;
+
+cleanup:
+    return return_value;
+}
+
+typedef struct object_index_collection_s{
+    unsigned char * shas;
+    size_t count;
+    size_t capacity;
+}object_index_collection_t;
+
+/**
+ * @brief: Appends the sha of an object to a collection (an object_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t object_index_collect(IN const unsigned char * hash, IN int fanout_fd, IN const char * name, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    object_index_collection_t * collection = context;
+    unsigned char * new_shas = NULL;
+
+    if(collection->count == collection->capacity){
+        collection->capacity = max(collection->capacity * 2, 1024);
+        new_shas = realloc(collection->shas, collection->capacity * SHA_DIGEST_LENGTH);
+        if(NULL == new_shas){
+            perror("OBJECT_INDEX_COLLECT: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        collection->shas = new_shas;
+    }
+
+    memcpy(collection->shas + collection->count * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH);
+    collection->count++;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Rebuilds the object index by scanning every fanout directory
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t object_index_rebuild(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int dir_fd = -1;
+    int fd = -1;
+    size_t k = 0;
+    size_t count = 0;
+    size_t unique = 0;
+    unsigned char * shas = NULL;
+    bool locked = false;
+    object_index_collection_t collection = {0};
+
+    /* Shas appended to the journal while the objects are scanned would be lost by the truncation */
+    return_value = object_index_lock_journal();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    locked = true;
+
+    object_index_close();
+
+    return_value = object_for_each(object_index_collect, &collection);
+    shas = collection.shas;
+    count = collection.count;
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(count > 0){
+        qsort(shas, count, SHA_DIGEST_LENGTH, object_index_compare);
+        for(unique=1, k=1; k<count; k++){
+            if(0 != memcmp(shas + (unique - 1) * SHA_DIGEST_LENGTH, shas + (size_t)k * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH)){
+                memmove(shas + unique * SHA_DIGEST_LENGTH, shas + (size_t)k * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+                unique++;
+            }
+        }
+        count = unique;
+    }
+
+    return_value = object_index_write(shas, count);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    fd = openat(dir_fd, object_index_journal_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(-1 == fd){
+        perror("OBJECT_INDEX_REBUILD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+    close(fd);
+
+    object_index_unlock_journal();
+    locked = false;
+
+    return_value = object_index_load();
+
+cleanup:
+    if(locked){
+        object_index_unlock_journal();
+    }
+    if(NULL != shas){
+        free(shas);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets the sorted table of the object index
+ * @param[OUT] shas: The sorted shas (valid until the object index is rebuilt, pruned or closed)
+ * @param[OUT] count: The number of shas
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Shas that are still in the journal aren't in the table, call object_index_rebuild first to
+ *         get every object. The position of a sha in the table is a dense number for it, which is
+ *         what the marks of gc are indexed by.
+ */
+error_code_t object_index_table(OUT const unsigned char ** shas, OUT size_t * count){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    *shas = cache->shas;
+    *count = cache->header->num_of_objects;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the position of a sha in the sorted table of the object index
+ * @param[IN] hash: The sha
+ * @param[OUT] position: The position
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if the sha isn't in the table,
+ *           else an indicative error code
+ */
+error_code_t object_index_position(IN const unsigned char * hash, OUT size_t * position){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    *position = object_index_lower_bound(hash);
+    if(*position >= cache->header->num_of_objects ||
+       0 != memcmp(cache->shas + *position * SHA_DIGEST_LENGTH, hash, SHA_DIGEST_LENGTH)){
+        return_value = ERROR_CODE_NOT_FOUND;
+    }
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Removes shas from the sorted table of the object index
+ * @param[IN] removed: A bitmap over the positions in the table, the shas whose bit is set are removed
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The object index is closed afterwards and reloaded on its next use
+ */
+error_code_t object_index_prune(IN const unsigned char * removed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t count = 0;
+    unsigned char * shas = NULL;
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    return_value = object_index_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    shas = malloc(max((size_t)cache->header->num_of_objects, 1) * SHA_DIGEST_LENGTH);
+    if(NULL == shas){
+        perror("OBJECT_INDEX_PRUNE: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<cache->header->num_of_objects; i++){
+        if(removed[i / 8] & (1 << (i % 8))){
+            continue;
+        }
+        memcpy(shas + count * SHA_DIGEST_LENGTH, cache->shas + i * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        count++;
+    }
+
+    return_value = object_index_write(shas, count);
+    object_index_close();
+
+cleanup:
+    if(NULL != shas){
+        free(shas);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Creates an empty object index (for a new repository)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t object_index_create(){
+    return object_index_rebuild();
+}
+
+/**
+ * @brief: Unmaps the object index and frees the journal
+ * @notes: Shas that were added but not flushed are dropped
+ */
+void object_index_close(){
+    object_index_cache_t * cache = &repository_state()->object_index;
+
+    object_index_unmap();
+
+    if(-1 != cache->journal_fd){
+        close(cache->journal_fd);
+        cache->journal_fd = -1;
+    }
+    if(NULL != cache->journal_shas){
+        free(cache->journal_shas);
+        cache->journal_shas = NULL;
+    }
+    cache->journal_count = 0;
+    cache->journal_capacity = 0;
+
+    if(NULL != cache->pending_shas){
+        free(cache->pending_shas);
+        cache->pending_shas = NULL;
+    }
+    if(NULL != cache->pending_slots){
+        free(cache->pending_slots);
+        cache->pending_slots = NULL;
+    }
+    cache->pending_count = 0;
+    cache->pending_slot_capacity = 0;
+
+    cache->loaded = false;
+}
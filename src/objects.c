@@ -0,0 +1,825 @@
+#include "slap_commands.h"
+
+#include <dirent.h>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+const char * alternates_file_name = "alternates";
+
+/**
+ * @brief: Initializes the object directory cache of a repository, with no directory open yet
+ * @param[OUT] cache: The cache
+ */
+void objects_cache_init(OUT objects_cache_t * cache){
+    int i = 0;
+    int j = 0;
+
+    memset(cache, 0, sizeof(*cache));
+    cache->objects_fd = -1;
+    for(i=0; i<OBJECT_FANOUT; i++){
+        cache->fanout_fds[i] = -1;
+    }
+    for(i=0; i<OBJECT_MAX_ALTERNATES; i++){
+        for(j=0; j<OBJECT_FANOUT; j++){
+            cache->alternate_fanout_fds[i][j] = -1;
+        }
+    }
+}
+
+/**
+ * @brief: Gets the value of a hex digit
+ * @param[IN] digit: The digit
+ *
+ * @returns: The value of the digit, -1 if it isn't a hex digit
+ */
+int hex_value(IN char digit){
+    if('0' <= digit && digit <= '9'){
+        return digit - '0';
+    }
+    if('a' <= digit && digit <= 'f'){
+        return digit - 'a' + 10;
+    }
+    if('A' <= digit && digit <= 'F'){
+        return digit - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief: Converts a sha to its hex representation
+ * @param[IN] hash: The sha to convert
+ * @param[OUT] hex: The buffer to write into (at least OBJECT_HEX_LEN + 1 bytes)
+ *
+ * @notes: hex is NUL terminated
+ */
+void sha_to_hex(IN const unsigned char * hash, OUT char * hex){
+    int i = 0;
+
+    for(i=0; i<SHA_DIGEST_LENGTH; i++){
+        hex[i*2] = hex_digits[hash[i] >> 4];
+        hex[i*2 + 1] = hex_digits[hash[i] & 0xf];
+    }
+    hex[OBJECT_HEX_LEN] = '\0';
+}
+
+/**
+ * @brief: Gets the name of an object's file inside its fanout directory
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] name: The buffer to write into (at least OBJECT_NAME_LEN + 1 bytes)
+ *
+ * @notes: The name is the hex of every byte of the sha but the first. name is NUL terminated.
+ */
+void object_name(IN const unsigned char * hash, OUT char * name){
+    int i = 0;
+
+    for(i=1; i<SHA_DIGEST_LENGTH; i++){
+        name[(i-1)*2] = hex_digits[hash[i] >> 4];
+        name[(i-1)*2 + 1] = hex_digits[hash[i] & 0xf];
+    }
+    name[OBJECT_NAME_LEN] = '\0';
+}
+
+/**
+ * @brief: Gets a file descriptor of the objects directory
+ * @param[OUT] fd: The file descriptor
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The directory is opened once and cached until close_object_dirs is called
+ */
+error_code_t object_dir_fd(OUT int * fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    objects_cache_t * cache = &repository_state()->objects;
+
+    if(-1 == cache->objects_fd){
+        cache->objects_fd = openat(work_tree_fd(), object_dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(-1 == cache->objects_fd){
+            perror("OBJECT_DIR_FD: Openat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+    }
+
+    *fd = cache->objects_fd;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets a file descriptor of a fanout directory (objects/xx)
+ * @param[IN] fanout: The first byte of the shas in the directory
+ * @param[IN] create: If the directory should be created when it doesn't exist
+ * @param[OUT] fd: The file descriptor
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_EOF if the directory doesn't exist and
+ *           create is false, else an indicative error code
+ * @notes: Each directory is opened at most once and cached until close_object_dirs is called.
+ *         The directory is only chmod-ed when it is created.
+ */
+error_code_t object_fanout_fd(IN unsigned char fanout, IN bool create, OUT int * fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    char name[3] = {hex_digits[fanout >> 4], hex_digits[fanout & 0xf], '\0'};
+    objects_cache_t * cache = &repository_state()->objects;
+
+    if(-1 != cache->fanout_fds[fanout]){
+        *fd = cache->fanout_fds[fanout];
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    cache->fanout_fds[fanout] = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == cache->fanout_fds[fanout] && ENOENT == errno && create){
+        errno = 0;
+        error_check = mkdirat(dir_fd, name, 0775);
+        if(-1 == error_check && EEXIST != errno){
+            perror("OBJECT_FANOUT_FD: Mkdirat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_CREATE;
+            goto cleanup;
+        }
+
+        if(0 == error_check){
+            error_check = fchmodat(dir_fd, name, 0775, 0);
+            if(-1 == error_check){
+                perror("OBJECT_FANOUT_FD: Fchmodat error");
+                printf("(Errno: %i)\n", errno);
+                return_value = ERROR_CODE_COULDNT_CHMOD;
+                goto cleanup;
+            }
+        }
+        errno = 0;
+
+        cache->fanout_fds[fanout] = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    if(-1 == cache->fanout_fds[fanout] && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_EOF;
+        goto cleanup;
+    }
+    if(-1 == cache->fanout_fds[fanout]){
+        perror("OBJECT_FANOUT_FD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    *fd = cache->fanout_fds[fanout];
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Reads the list of alternate object directories
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The alternates file lists one objects directory per line. Relative paths are relative to the
+ *         local objects directory. The list is read once and kept until close_object_dirs is called.
+ */
+static error_code_t object_alternates_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    int line_len = 0;
+    ssize_t bytes_read = 0;
+    size_t offset = 0;
+    size_t path_len = 0;
+    char path[PATH_MAX] = {0};
+    char * data = NULL;
+    const char * line = NULL;
+    const char * line_end = NULL;
+    struct stat statbuf = {0};
+    objects_cache_t * cache = &repository_state()->objects;
+
+    if(cache->alternates_loaded){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", repo_dir_name, alternates_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    fd = openat(work_tree_fd(), path, O_RDONLY | O_CLOEXEC);
+    if(-1 == fd && ENOENT == errno){
+        errno = 0;
+        cache->alternates_loaded = true;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(-1 == fd){
+        perror("OBJECT_ALTERNATES_LOAD: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("OBJECT_ALTERNATES_LOAD: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    data = malloc(statbuf.st_size + 1);
+    if(NULL == data){
+        perror("OBJECT_ALTERNATES_LOAD: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(offset=0; offset<(size_t)statbuf.st_size; offset+=bytes_read){
+        bytes_read = read(fd, data + offset, statbuf.st_size - offset);
+        if(-1 == bytes_read){
+            perror("OBJECT_ALTERNATES_LOAD: Read error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            break;
+        }
+    }
+
+    for(line=data; line<data + offset; line=line_end + 1){
+        line_end = memchr(line, '\n', data + offset - line);
+        if(NULL == line_end){
+            line_end = data + offset;
+        }
+
+        line_len = line_end - line;
+        if(0 == line_len || '#' == line[0]){
+            continue;
+        }
+        if(OBJECT_MAX_ALTERNATES == cache->num_of_alternates){
+            printf("\e[38;2;200;100;0mOnly the first %i alternate object directories are used\e[0m\n", OBJECT_MAX_ALTERNATES);
+            break;
+        }
+
+        path_len = ('/' == line[0]) ? line_len : strlen(object_dir_path) + 1 + line_len;
+        cache->alternate_paths[cache->num_of_alternates] = malloc(path_len + 1);
+        if(NULL == cache->alternate_paths[cache->num_of_alternates]){
+            perror("OBJECT_ALTERNATES_LOAD: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        if('/' == line[0]){
+            sprintf(cache->alternate_paths[cache->num_of_alternates], "%.*s", line_len, line);
+        }
+        else{
+            sprintf(cache->alternate_paths[cache->num_of_alternates], "%s/%.*s", object_dir_path, line_len, line);
+        }
+        cache->num_of_alternates++;
+    }
+
+    cache->alternates_loaded = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        for(; cache->num_of_alternates>0; cache->num_of_alternates--){
+            free(cache->alternate_paths[cache->num_of_alternates - 1]);
+            cache->alternate_paths[cache->num_of_alternates - 1] = NULL;
+        }
+    }
+    if(NULL != data){
+        free(data);
+    }
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets a file descriptor of a fanout directory of an alternate objects directory
+ * @param[IN] alternate: The index of the alternate
+ * @param[IN] fanout: The first byte of the shas in the directory
+ * @param[OUT] fd: The file descriptor
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_EOF if the directory doesn't exist,
+ *           else an indicative error code
+ * @notes: Like the local ones, each directory is opened at most once and cached until close_object_dirs is called
+ */
+static error_code_t object_alternate_fanout_fd(IN int alternate, IN unsigned char fanout, OUT int * fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    char path[PATH_MAX] = {0};
+    objects_cache_t * cache = &repository_state()->objects;
+
+    if(-1 != cache->alternate_fanout_fds[alternate][fanout]){
+        *fd = cache->alternate_fanout_fds[alternate][fanout];
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/%c%c", cache->alternate_paths[alternate], hex_digits[fanout >> 4], hex_digits[fanout & 0xf]);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    cache->alternate_fanout_fds[alternate][fanout] = openat(work_tree_fd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == cache->alternate_fanout_fds[alternate][fanout] && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_EOF;
+        goto cleanup;
+    }
+    if(-1 == cache->alternate_fanout_fds[alternate][fanout]){
+        perror("OBJECT_ALTERNATE_FANOUT_FD: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    *fd = cache->alternate_fanout_fds[alternate][fanout];
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Finds the alternate objects directory that has an object
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] fd: The file descriptor of the fanout directory the object is in
+ * @param[OUT] alternate: The index of the alternate
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if no alternate has the object,
+ *           else an indicative error code
+ */
+static error_code_t object_find_alternate(IN const unsigned char * hash, OUT int * fd, OUT int * alternate){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int i = 0;
+    int dir_fd = -1;
+    char name[OBJECT_NAME_LEN + 1] = {0};
+    objects_cache_t * cache = &repository_state()->objects;
+
+    return_value = object_alternates_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    object_name(hash, name);
+
+    for(i=0; i<cache->num_of_alternates; i++){
+        return_value = object_alternate_fanout_fd(i, hash[0], &dir_fd);
+        if(ERROR_CODE_EOF == return_value){
+            continue;
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        error_check = faccessat(dir_fd, name, F_OK, 0);
+        if(0 == error_check){
+            *fd = dir_fd;
+            *alternate = i;
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+    }
+
+    errno = 0;
+    return_value = ERROR_CODE_NOT_FOUND;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets the fanout directory an object should be read from, searching the alternates
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] fd: The file descriptor of the fanout directory
+ * @param[OUT] alternate: The index of the alternate the object is in, -1 for the local objects directory
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if the object isn't found,
+ *           else an indicative error code
+ * @notes: Without alternates the local fanout directory is returned without checking for the object,
+ *         so a repository that doesn't use them pays nothing extra
+ */
+error_code_t object_locate(IN const unsigned char * hash, OUT int * fd, OUT int * alternate){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    char name[OBJECT_NAME_LEN + 1] = {0};
+    objects_cache_t * cache = &repository_state()->objects;
+
+    *alternate = -1;
+
+    return_value = object_alternates_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = object_fanout_fd(hash[0], false, &dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_EOF != return_value){
+        goto cleanup;
+    }
+
+    if(ERROR_CODE_SUCCESS == return_value){
+        if(0 == cache->num_of_alternates){
+            *fd = dir_fd;
+            goto cleanup;
+        }
+
+        object_name(hash, name);
+        error_check = faccessat(dir_fd, name, F_OK, 0);
+        if(0 == error_check){
+            *fd = dir_fd;
+            goto cleanup;
+        }
+    }
+
+    return_value = object_find_alternate(hash, fd, alternate);
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Checks if one of the alternate objects directories has an object
+ * @param[IN] hash: The sha of the object
+ *
+ * @returns: true if it does, else false
+ */
+bool object_alternate_exists(IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int dir_fd = -1;
+    int alternate = -1;
+
+    return_value = object_find_alternate(hash, &dir_fd, &alternate);
+    errno = 0;
+
+    return ERROR_CODE_SUCCESS == return_value;
+}
+
+/**
+ * @brief: Gets the path of an alternate objects directory
+ * @param[IN] alternate: The index of the alternate, -1 for the local objects directory
+ *
+ * @returns: The path
+ */
+const char * object_alternate_path(IN int alternate){
+    objects_cache_t * cache = &repository_state()->objects;
+
+    if(-1 == alternate){
+        return object_dir_path;
+    }
+
+    return cache->alternate_paths[alternate];
+}
+
+/**
+ * @brief: Opens an object in the objects directory
+ * @param[IN] hash: The sha of the object
+ * @param[IN] flags: The flags to pass to openat
+ * @param[IN] mode: The mode to create the object with (if O_CREAT is in flags)
+ * @param[OUT] fd: The file descriptor of the object, -1 on failure
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_ALREADY_EXISTS if O_EXCL was passed and
+ *           the object exists, else an indicative error code
+ * @notes: No path is built, the object is opened relative to its (cached) fanout directory
+ */
+error_code_t open_object(IN const unsigned char * hash, IN int flags, IN mode_t mode, OUT int * fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int dir_fd = -1;
+    int alternate = -1;
+    char name[OBJECT_NAME_LEN + 1] = {0};
+
+    *fd = -1;
+
+    object_name(hash, name);
+
+    return_value = object_fanout_fd(hash[0], 0 != (flags & O_CREAT), &dir_fd);
+    if(ERROR_CODE_SUCCESS == return_value){
+        *fd = openat(dir_fd, name, flags | O_CLOEXEC, mode);
+    }
+    else if(ERROR_CODE_EOF == return_value){
+        errno = ENOENT;
+    }
+    else{
+        goto cleanup;
+    }
+
+    /* Objects are only read from the alternates, new ones are always created in the local objects directory */
+    if(-1 == *fd && ENOENT == errno && 0 == (flags & O_CREAT) && O_RDONLY == (flags & O_ACCMODE)){
+        return_value = object_find_alternate(hash, &dir_fd, &alternate);
+        if(ERROR_CODE_SUCCESS == return_value){
+            *fd = openat(dir_fd, name, flags | O_CLOEXEC, mode);
+        }
+        else if(ERROR_CODE_NOT_FOUND == return_value){
+            errno = ENOENT;
+        }
+        else{
+            goto cleanup;
+        }
+    }
+
+    if(-1 == *fd && EEXIST == errno && (flags & O_EXCL)){
+        return_value = ERROR_CODE_ALREADY_EXISTS;
+        goto cleanup;
+    }
+    if(-1 == *fd){
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+    TRACE_COUNT_OPEN();
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Reads a whole object into memory
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] data: The contents of the object, to be freed by the caller (NULL for an empty object)
+ * @param[OUT] size: The size of the object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_NOT_FOUND if the object doesn't exist,
+ *           else an indicative error code
+ */
+error_code_t read_object(IN const unsigned char * hash, OUT unsigned char ** data, OUT size_t * size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    size_t offset = 0;
+    ssize_t bytes_read = 0;
+    struct stat statbuf = {0};
+
+    *data = NULL;
+    *size = 0;
+
+    return_value = open_object(hash, O_RDONLY, 0, &fd);
+    if(ERROR_CODE_SUCCESS != return_value && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_NOT_FOUND;
+        goto cleanup;
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        perror("READ_OBJECT: Open error");
+        printf("(Errno: %i)\n", errno);
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("READ_OBJECT: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+    TRACE_COUNT_STAT();
+
+    if(statbuf.st_size > 0){
+        *data = malloc(statbuf.st_size);
+        if(NULL == *data){
+            perror("READ_OBJECT: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+    }
+
+    for(offset=0; offset<(size_t)statbuf.st_size; offset+=bytes_read){
+        bytes_read = read(fd, *data + offset, statbuf.st_size - offset);
+        if(-1 == bytes_read){
+            perror("READ_OBJECT: Read error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        TRACE_COUNT_READ(bytes_read);
+        if(0 == bytes_read){
+            break;
+        }
+    }
+    *size = offset;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value && NULL != *data){
+        free(*data);
+        *data = NULL;
+    }
+    if(-1 != fd){
+        close(fd);
+        TRACE_COUNT_CLOSE();
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets the parents of a commit that was read into memory
+ * @param[IN] data: The contents of the commit
+ * @param[IN] size: The size of the commit
+ * @param[OUT] num_of_parents: The number of parents
+ * @param[OUT] parents: The shas of the parents, one after another (points into data)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_INVALID_INPUT if the commit is malformed
+ * @notes: The file entries start right after the parents, at sizeof(int) + num_of_parents * SHA_DIGEST_LENGTH
+ */
+error_code_t commit_parents(IN const unsigned char * data, IN size_t size, OUT int * num_of_parents, OUT const unsigned char ** parents){
+    if(size < sizeof(*num_of_parents)){
+        return ERROR_CODE_INVALID_INPUT;
+    }
+
+    memcpy(num_of_parents, data, sizeof(*num_of_parents));
+    if(*num_of_parents < 0 || (size - sizeof(*num_of_parents)) / SHA_DIGEST_LENGTH < (size_t)*num_of_parents){
+        return ERROR_CODE_INVALID_INPUT;
+    }
+
+    *parents = data + sizeof(*num_of_parents);
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Gets the next file entry of a commit that was read into memory
+ * @param[IN] data: The contents of the commit
+ * @param[IN] size: The size of the commit
+ * @param[IN/OUT] offset: The offset of the entry, advanced past it
+ * @param[OUT] entry: The entry. Its sha and name point into data, the name isn't NUL terminated
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, ERROR_CODE_EOF after the last entry,
+ *           ERROR_CODE_INVALID_INPUT if the entry is malformed
+ * @notes: Unlike get_next_commit_segment, every length is checked against the size of the commit
+ */
+error_code_t commit_next_entry(IN const unsigned char * data, IN size_t size, IN OUT size_t * offset, OUT commit_entry_t * entry){
+    size_t header_len = SHA_DIGEST_LENGTH + sizeof(entry->mode) + sizeof(entry->name_len);
+
+    if(*offset >= size){
+        return ERROR_CODE_EOF;
+    }
+    if(size - *offset < header_len){
+        return ERROR_CODE_INVALID_INPUT;
+    }
+
+    entry->sha = data + *offset;
+    memcpy(&entry->mode, data + *offset + SHA_DIGEST_LENGTH, sizeof(entry->mode));
+    memcpy(&entry->name_len, data + *offset + SHA_DIGEST_LENGTH + sizeof(entry->mode), sizeof(entry->name_len));
+    if(entry->name_len <= 0 || entry->name_len >= PATH_MAX || size - *offset - header_len < (size_t)entry->name_len){
+        return ERROR_CODE_INVALID_INPUT;
+    }
+    entry->name = (const char *)data + *offset + header_len;
+
+    *offset += header_len + entry->name_len;
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Builds the path of an object (for printing)
+ * @param[IN] hash: The sha of the object
+ * @param[OUT] path: The buffer to write into (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t object_path(IN const unsigned char * hash, OUT char * path){
+    int error_check = 0;
+    char name[OBJECT_NAME_LEN + 1] = {0};
+
+    object_name(hash, name);
+
+    error_check = snprintf(path, PATH_MAX, "%s/%c%c/%s", object_dir_path, hex_digits[hash[0] >> 4], hex_digits[hash[0] & 0xf], name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Calls a function for every object in the objects directory
+ * @param[IN] callback: The function. If it fails, the iteration stops and its error is returned
+ * @param[IN] context: Passed to the function
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects are streamed one fanout directory at a time, nothing is collected. Files whose
+ *         name isn't the hex of the rest of a sha are skipped. Every fanout directory that exists
+ *         is left open in the cache afterwards.
+ */
+error_code_t object_for_each(IN object_callback_t callback, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int fanout_fd = -1;
+    int i = 0;
+    int k = 0;
+    int high_nibble = 0;
+    int low_nibble = 0;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    DIR * dir = NULL;
+    struct dirent * entry = NULL;
+
+    for(i=0; i<OBJECT_FANOUT; i++){
+        return_value = object_fanout_fd(i, false, &fanout_fd);
+        if(ERROR_CODE_EOF == return_value){
+            continue;
+        }
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        /* fdopendir takes ownership of the fd, and the cached one has to stay open */
+        dir = fdopendir(dup(fanout_fd));
+        if(NULL == dir){
+            perror("OBJECT_FOR_EACH: Fdopendir error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+        rewinddir(dir);
+
+        while(NULL != (entry = readdir(dir))){
+            if(OBJECT_NAME_LEN != strnlen(entry->d_name, OBJECT_NAME_LEN + 1)){
+                continue;
+            }
+
+            hash[0] = i;
+            for(k=0; k<OBJECT_NAME_LEN; k+=2){
+                high_nibble = hex_value(entry->d_name[k]);
+                low_nibble = hex_value(entry->d_name[k+1]);
+                if(-1 == high_nibble || -1 == low_nibble){
+                    break;
+                }
+                hash[k/2 + 1] = (high_nibble << 4) | low_nibble;
+            }
+            if(k != OBJECT_NAME_LEN){
+                continue;
+            }
+
+            return_value = callback(hash, fanout_fd, entry->d_name, context);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+        }
+
+        closedir(dir);
+        dir = NULL;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != dir){
+        closedir(dir);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Closes the cached file descriptors of the objects directory and its fanout directories, and forgets
+ *         the alternates
+ */
+void close_object_dirs(){
+    int i = 0;
+    int j = 0;
+    objects_cache_t * cache = &repository_state()->objects;
+
+    for(i=0; i<cache->num_of_alternates; i++){
+        for(j=0; j<OBJECT_FANOUT; j++){
+            if(-1 != cache->alternate_fanout_fds[i][j]){
+                close(cache->alternate_fanout_fds[i][j]);
+                cache->alternate_fanout_fds[i][j] = -1;
+            }
+        }
+        free(cache->alternate_paths[i]);
+        cache->alternate_paths[i] = NULL;
+    }
+    cache->num_of_alternates = 0;
+    cache->alternates_loaded = false;
+
+    for(i=0; i<OBJECT_FANOUT; i++){
+        if(-1 != cache->fanout_fds[i]){
+            close(cache->fanout_fds[i]);
+            cache->fanout_fds[i] = -1;
+        }
+    }
+
+    if(-1 != cache->objects_fd){
+        close(cache->objects_fd);
+        cache->objects_fd = -1;
+    }
+}
@@ -0,0 +1,547 @@
+#include "slap_commands.h"
+
+#include <pthread.h>
+
+const char * repo_dir_name = ".slap";
+const char * delete_file_name = "del";
+char * object_dir_path = ".slap/objects";
+char * index_file_path = ".slap/index";
+char * HEAD_file_path = ".slap/HEAD";
+
+/* The state used by threads that didn't switch to a repository, for the working directory */
+static repository_state_t default_state;
+static pthread_once_t default_state_once = PTHREAD_ONCE_INIT;
+static __thread repository_state_t * current_state = NULL;
+
+/**
+ * @brief: Initializes the default state, with nothing loaded yet
+ */
+static void repository_state_init_default(){
+    default_state.work_tree_fd = AT_FDCWD;
+    objects_cache_init(&default_state.objects);
+    object_index_cache_init(&default_state.object_index);
+    index_cache_init(&default_state.index);
+    sketch_cache_init(&default_state.sketch);
+}
+
+/**
+ * @brief: Gets the state of the repository the calling thread works on
+ *
+ * @returns: The state, which is the default state (of the working directory) unless the thread switched
+ */
+repository_state_t * repository_state(){
+    if(NULL == current_state){
+        pthread_once(&default_state_once, repository_state_init_default);
+        current_state = &default_state;
+    }
+
+    return current_state;
+}
+
+/**
+ * @brief: Switches the repository the calling thread works on
+ * @param[IN] state: The new state (NULL for the default state)
+ *
+ * @returns: The previous state, to switch back to
+ */
+repository_state_t * repository_state_switch(IN repository_state_t * state){
+    repository_state_t * previous = current_state;
+
+    current_state = state;
+
+    return previous;
+}
+
+/**
+ * @brief: Creates the state of a repository, with nothing loaded yet
+ * @param[IN] dir_fd: The work tree of the repository, which stays owned by the caller
+ * @param[OUT] state: The state (to be destroyed with repository_state_destroy)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t repository_state_create(IN int dir_fd, OUT repository_state_t ** state){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * new_state = NULL;
+
+    new_state = calloc(1, sizeof(*new_state));
+    if(NULL == new_state){
+        perror("REPOSITORY_STATE_CREATE: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    new_state->work_tree_fd = dir_fd;
+    objects_cache_init(&new_state->objects);
+    object_index_cache_init(&new_state->object_index);
+    index_cache_init(&new_state->index);
+    sketch_cache_init(&new_state->sketch);
+
+    *state = new_state;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Destroys the state of a repository, releasing everything it caches
+ * @param[IN] state: The state (may be NULL)
+ *
+ * @notes: Changes to the index that weren't flushed are dropped
+ */
+void repository_state_destroy(IN repository_state_t * state){
+    repository_state_t * previous = NULL;
+
+    if(NULL == state){
+        return;
+    }
+
+    previous = repository_state_switch(state);
+    close_caches();
+    repository_state_switch(previous);
+
+    free(state);
+}
+
+/**
+ * @brief: Gets the work tree of the repository the calling thread works on
+ *
+ * @returns: An fd of the work tree, for the *at calls (AT_FDCWD for the working directory)
+ */
+int work_tree_fd(){
+    return repository_state()->work_tree_fd;
+}
+
+/**
+ * @brief: Switches the calling thread to the state of a repository for a single operation
+ * @param[IN] repository: The repository
+ *
+ * @returns: The previous state, to be restored with slap_leave
+ */
+static repository_state_t * slap_enter(IN slap_repository_t * repository){
+    return repository_state_switch(repository->state);
+}
+
+/**
+ * @brief: Switches back to the state from before slap_enter
+ * @param[IN] previous: The state slap_enter returned
+ */
+static void slap_leave(IN repository_state_t * previous){
+    repository_state_switch(previous);
+}
+
+/**
+ * @brief: Opens a repository
+ * @param[IN] path: The work tree of the repository (it doesn't have to be initialized yet)
+ * @param[OUT] repository: The handle of the repository (to be closed with slap_close)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The handle holds an fd of the work tree and the state of the repository. Every operation resolves its
+ *         paths against the fd and works on the state, so the working directory of the process is never changed
+ *         and any number of repositories can be open at a time.
+ */
+error_code_t slap_open(IN const char * path, OUT slap_repository_t ** repository){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    slap_repository_t * new_repository = NULL;
+
+    new_repository = calloc(1, sizeof(*new_repository));
+    if(NULL == new_repository){
+        perror("SLAP_OPEN: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    new_repository->work_tree_fd = -1;
+
+    new_repository->work_tree = realpath(path, NULL);
+    if(NULL == new_repository->work_tree){
+        perror("SLAP_OPEN: Realpath error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    new_repository->work_tree_fd = open(new_repository->work_tree, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == new_repository->work_tree_fd){
+        perror("SLAP_OPEN: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = repository_state_create(new_repository->work_tree_fd, &new_repository->state);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    *repository = new_repository;
+    new_repository = NULL;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != new_repository){
+        if(-1 != new_repository->work_tree_fd){
+            close(new_repository->work_tree_fd);
+        }
+        repository_state_destroy(new_repository->state);
+        free(new_repository->work_tree);
+        free(new_repository);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Initializes the repository
+ * @param[IN] repository: The repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_init(IN slap_repository_t * repository){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = init();
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Adds files to the repository
+ * @param[IN] repository: The repository
+ * @param[IN] num_of_files: The number of files
+ * @param[IN] files: The paths of the files, relative to the work tree
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_add(IN slap_repository_t * repository, IN int num_of_files, IN char ** files){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = add_files(num_of_files, files);
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Commits the index
+ * @param[IN] repository: The repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_commit(IN slap_repository_t * repository){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = commit(NULL, true);
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks out a commit
+ * @param[IN] repository: The repository
+ * @param[IN] commit: The (possibly abbreviated) sha of the commit, or the path to the commit object
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_checkout(IN slap_repository_t * repository, IN char * commit){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = checkout(commit);
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints the status of the work tree
+ * @param[IN] repository: The repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_status(IN slap_repository_t * repository){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = status();
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Verifies the repository (see fsck)
+ * @param[IN] repository: The repository
+ * @param[IN] sample: The number of objects to rehash, 0 for all of them
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_fsck(IN slap_repository_t * repository, IN size_t sample){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = fsck(sample);
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Removes the unreachable objects (see gc)
+ * @param[IN] repository: The repository
+ * @param[IN] grace: Unreachable objects modified less than this many seconds ago are kept
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_gc(IN slap_repository_t * repository, IN time_t grace){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = gc(grace);
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Makes the objects written so far durable and records them in the object index, then writes the
+ *         cached index and HEAD if they changed
+ * @param[IN] repository: The repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_flush(IN slap_repository_t * repository){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    return_value = index_cache_flush();
+
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs a slap command
+ * @param[IN] repository: The repository
+ * @param[IN] argc: The number of arguments
+ * @param[IN] argv: The command and its arguments, as given to slap
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t slap_run(IN slap_repository_t * repository, IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int difference = 0;
+    repository_state_t * previous = NULL;
+
+    previous = slap_enter(repository);
+
+    if(argc < 1){
+        printf("USAGE: slap: <command> [options]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "init");
+    if(0 == difference){
+        return_value = slap_init(repository);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "add");
+    if(0 == difference){
+        if(argc < 2){
+            printf("USAGE: slap add: <files>\n");
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+
+        return_value = slap_add(repository, argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "commit");
+    if(0 == difference){
+        return_value = slap_commit(repository);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "checkout");
+    if(0 == difference){
+        if(argc < 2){
+            printf("USAGE: slap checkout: <commit>\n");
+            return_value = ERROR_CODE_INVALID_INPUT;
+            goto cleanup;
+        }
+
+        return_value = slap_checkout(repository, argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "config");
+    if(0 == difference){
+        return_value = config_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "status");
+    if(0 == difference){
+        return_value = slap_status(repository);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "diff");
+    if(0 == difference){
+        return_value = diff_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "sparse");
+    if(0 == difference){
+        return_value = sparse_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "worktree");
+    if(0 == difference){
+        return_value = worktree_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "clone");
+    if(0 == difference){
+        return_value = clone_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "bundle");
+    if(0 == difference){
+        return_value = bundle_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "archive");
+    if(0 == difference){
+        return_value = archive_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "fsck");
+    if(0 == difference){
+        return_value = fsck_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "gc");
+    if(0 == difference){
+        return_value = gc_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "bitmap");
+    if(0 == difference){
+        return_value = bitmap_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "cat-file");
+    if(0 == difference){
+        return_value = cat_file_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "batch");
+    if(0 == difference){
+        return_value = batch_command(argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "serve");
+    if(0 == difference){
+        return_value = serve_command(repository, argc - 1, &argv[1]);
+        goto cleanup;
+    }
+
+    difference = valid_strncmp(argv[0], "fsmonitor");
+    if(0 == difference){
+        if(2 == argc && 0 == valid_strncmp(argv[1], "start")){
+            return_value = fsmonitor_start();
+        }
+        else if(2 == argc && 0 == valid_strncmp(argv[1], "stop")){
+            return_value = fsmonitor_stop();
+        }
+        else{
+            printf("USAGE: slap fsmonitor: start|stop\n");
+            return_value = ERROR_CODE_INVALID_INPUT;
+        }
+        goto cleanup;
+    }
+
+    printf("Unknown command %s\n", argv[0]);
+    return_value = ERROR_CODE_INVALID_INPUT;
+
+cleanup:
+    slap_leave(previous);
+
+    return return_value;
+}
+
+/**
+ * @brief: Drops everything the core caches about the current repository
+ *
+ * @notes: The caches are those of the current state, repository_state_destroy calls this before freeing it
+ */
+void close_caches(){
+    bitmap_close();
+    sketch_close();
+    sparse_close();
+    object_index_close();
+    index_cache_close();
+    close_object_dirs();
+    reset_fsync_mode();
+    reset_io_backend();
+}
+
+/**
+ * @brief: Closes a repository, releasing the object directory fds, the object index, the cached index and the bitmaps
+ * @param[IN] repository: The repository (may be NULL)
+ */
+void slap_close(IN slap_repository_t * repository){
+    if(NULL == repository){
+        return;
+    }
+
+    repository_state_destroy(repository->state);
+    close(repository->work_tree_fd);
+    free(repository->work_tree);
+    free(repository);
+}
@@ -0,0 +1,626 @@
+#include "slap_commands.h"
+
+#include <signal.h>
+#include <stdio_ext.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const char * serve_socket_name = "serve.sock";
+
+/**
+ * @brief: Builds the address of the server socket of the repository
+ * @param[OUT] address: The address, which resolves against the work tree
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t serve_address(OUT struct sockaddr_un * address){
+    int error_check = 0;
+    char path[PATH_MAX] = {0};
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    error_check = snprintf(path, sizeof(path), "%s/%s", repo_dir_name, serve_socket_name);
+    if(error_check < 0 || error_check >= sizeof(path)){
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return path_at(work_tree_fd(), path, address->sun_path, sizeof(address->sun_path));
+}
+
+/**
+ * @brief: Connects to the server of the repository
+ * @param[OUT] socket_fd: The connected socket
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: No error is printed if the server is not running, since that is the common case
+ */
+static error_code_t serve_connect(OUT int * socket_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct sockaddr_un address = {0};
+
+    *socket_fd = -1;
+
+    return_value = serve_address(&address);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    *socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(-1 == *socket_fd){
+        perror("SERVE_CONNECT: Socket error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = connect(*socket_fd, (struct sockaddr *)&address, sizeof(address));
+    if(-1 == error_check){
+        close(*socket_fd);
+        *socket_fd = -1;
+        errno = 0;
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Checks if a command may run inside the server
+ * @param[IN] command: The name of the command
+ *
+ * @returns: true if the command can be forwarded to the server
+ * @notes: Commands that start or stop daemons, and init, always run in their own process
+ */
+static bool serve_can_forward(IN char * command){
+    return (0 != valid_strncmp(command, "serve") && 0 != valid_strncmp(command, "fsmonitor") &&
+            0 != valid_strncmp(command, "init"));
+}
+
+/**
+ * @brief: Runs a command on the server of the repository in the working directory, if one is running
+ * @param[IN] argc: The number of arguments
+ * @param[IN] argv: The command and its arguments
+ * @param[OUT] forwarded: Set to true if the server ran the command
+ * @param[OUT] result: The error code the command returned on the server
+ *
+ * @returns: ERROR_CODE_SUCCESS if the command was forwarded or the caller should run it itself,
+ *           else an indicative error code
+ * @notes: The request is a single packet holding the NUL terminated arguments, with the standard
+ *         input, output and error of the client attached, so the server reads and writes them directly.
+ *         The answer is the error code of the command.
+ */
+error_code_t serve_forward(IN int argc, IN char ** argv, OUT bool * forwarded, OUT error_code_t * result){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int socket_fd = -1;
+    int i = 0;
+    int fds[SERVE_NUM_OF_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    size_t request_len = 0;
+    size_t arg_len = 0;
+    ssize_t bytes = 0;
+    char * request = NULL;
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    struct iovec iov = {0};
+    struct msghdr message = {0};
+    struct cmsghdr * control_message = NULL;
+
+    *forwarded = false;
+    *result = ERROR_CODE_UNINITIALIZED;
+
+    if(argc < 1 || argc > SERVE_MAX_ARGS || !serve_can_forward(argv[0])){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = serve_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    request = malloc(SERVE_MAX_REQUEST);
+    if(NULL == request){
+        perror("SERVE_FORWARD: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(i=0; i<argc; i++){
+        arg_len = strlen(argv[i]) + 1;
+        if(request_len + arg_len > SERVE_MAX_REQUEST){
+            /* Too long for a single packet, run it locally */
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+        memcpy(request + request_len, argv[i], arg_len);
+        request_len += arg_len;
+    }
+
+    iov.iov_base = request;
+    iov.iov_len = request_len;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    control_message = CMSG_FIRSTHDR(&message);
+    control_message->cmsg_level = SOL_SOCKET;
+    control_message->cmsg_type = SCM_RIGHTS;
+    control_message->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(control_message), fds, sizeof(fds));
+
+    fflush(stdout);
+    bytes = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    if(-1 == bytes){
+        perror("SERVE_FORWARD: Sendmsg error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    /* From here on the command may have run, so it is never retried locally */
+    *forwarded = true;
+
+    do{
+        bytes = recv(socket_fd, result, sizeof(*result), 0);
+    }while(-1 == bytes && EINTR == errno);
+    if(sizeof(*result) != bytes){
+        printf("\e[31mThe server stopped before answering.\e[0m\n");
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+    if(NULL != request){
+        free(request);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Takes a snapshot of the files the caches of the server are loaded from
+ * @param[OUT] snapshot: The snapshot
+ *
+ * @notes: A missing file has an all zero stat
+ */
+static void serve_take_snapshot(OUT serve_snapshot_t * snapshot){
+    int error_check = 0;
+    int i = 0;
+    char paths[SERVE_NUM_OF_WATCHED][PATH_MAX] = {{0}};
+
+    snprintf(paths[0], PATH_MAX, "%s", object_dir_path);
+    snprintf(paths[1], PATH_MAX, "%s/%s", object_dir_path, object_index_name);
+    snprintf(paths[2], PATH_MAX, "%s/%s", object_dir_path, object_index_journal_name);
+    snprintf(paths[3], PATH_MAX, "%s/%s", object_dir_path, bitmap_file_name);
+    snprintf(paths[4], PATH_MAX, "%s/%s", repo_dir_name, config_file_name);
+    snprintf(paths[5], PATH_MAX, "%s", index_file_path);
+    snprintf(paths[6], PATH_MAX, "%s", HEAD_file_path);
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    for(i=0; i<SERVE_NUM_OF_WATCHED; i++){
+        error_check = fstatat(work_tree_fd(), paths[i], &snapshot->stats[i], 0);
+        if(-1 == error_check){
+            memset(&snapshot->stats[i], 0, sizeof(snapshot->stats[i]));
+            errno = 0;
+        }
+    }
+}
+
+/**
+ * @brief: Drops the caches of the server that another process changed the files of
+ * @param[IN OUT] snapshot: The snapshot taken after the previous command
+ */
+static void serve_invalidate(IN OUT serve_snapshot_t * snapshot){
+    int i = 0;
+    bool changed[SERVE_NUM_OF_WATCHED] = {false};
+    serve_snapshot_t current = {0};
+
+    serve_take_snapshot(&current);
+    for(i=0; i<SERVE_NUM_OF_WATCHED; i++){
+        changed[i] = (snapshot->stats[i].st_dev != current.stats[i].st_dev ||
+                      snapshot->stats[i].st_ino != current.stats[i].st_ino ||
+                      snapshot->stats[i].st_size != current.stats[i].st_size ||
+                      snapshot->stats[i].st_mtim.tv_sec != current.stats[i].st_mtim.tv_sec ||
+                      snapshot->stats[i].st_mtim.tv_nsec != current.stats[i].st_mtim.tv_nsec);
+    }
+
+    /* The objects directory changes whenever a fanout directory is created, which doesn't make its fd stale */
+    if(snapshot->stats[0].st_ino != current.stats[0].st_ino || snapshot->stats[0].st_dev != current.stats[0].st_dev){
+        close_object_dirs();
+        sketch_close();
+    }
+    if(changed[1] || changed[2]){
+        object_index_close();
+    }
+    if(changed[3]){
+        bitmap_close();
+    }
+    if(changed[4]){
+        reset_fsync_mode();
+        reset_io_backend();
+    }
+    /* Clean index and HEAD caches reload themselves, but changes that weren't written must not overwrite these */
+    if(changed[5] || changed[6]){
+        index_cache_validate();
+    }
+}
+
+/**
+ * @brief: Runs a single client request
+ * @param[IN] repository: The repository
+ * @param[IN] client_fd: The client's socket
+ * @param[IN] null_fd: An fd of /dev/null, which the standard streams point to between requests
+ * @param[IN] request: A buffer of SERVE_MAX_REQUEST bytes
+ * @param[OUT] stop: Set to true if the request is "serve stop"
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t serve_handle_client(IN slap_repository_t * repository, IN int client_fd, IN int null_fd, IN char * request, OUT bool * stop){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    error_code_t result = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int argc = 0;
+    int fds[SERVE_NUM_OF_FDS] = {-1, -1, -1};
+    ssize_t bytes = 0;
+    size_t offset = 0;
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    char * argv[SERVE_MAX_ARGS] = {0};
+    struct iovec iov = {0};
+    struct msghdr message = {0};
+    struct cmsghdr * control_message = NULL;
+
+    iov.iov_base = request;
+    iov.iov_len = SERVE_MAX_REQUEST;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    do{
+        bytes = recvmsg(client_fd, &message, MSG_CMSG_CLOEXEC);
+    }while(-1 == bytes && EINTR == errno);
+    if(bytes <= 0){
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+
+    if(sizeof(SERVE_STOP_REQUEST) == bytes && 0 == memcmp(request, SERVE_STOP_REQUEST, bytes)){
+        *stop = true;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    control_message = CMSG_FIRSTHDR(&message);
+    if(NULL == control_message || SOL_SOCKET != control_message->cmsg_level || SCM_RIGHTS != control_message->cmsg_type ||
+       CMSG_LEN(sizeof(fds)) != control_message->cmsg_len){
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+    memcpy(fds, CMSG_DATA(control_message), sizeof(fds));
+
+    if('\0' != request[bytes - 1] || (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC))){
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+    for(offset=0; offset<bytes && argc<SERVE_MAX_ARGS; offset+=strlen(request + offset) + 1){
+        argv[argc++] = request + offset;
+    }
+
+    if(!serve_can_forward(argv[0])){
+        result = ERROR_CODE_INVALID_INPUT;
+    }
+    else{
+        /* Anything left in the stdio buffers belongs to the previous client */
+        __fpurge(stdin);
+        clearerr(stdin);
+        for(i=0; i<SERVE_NUM_OF_FDS; i++){
+            dup2(fds[i], i);
+        }
+
+        result = slap_run(repository, argc, argv);
+
+        fflush(stdout);
+        fflush(stderr);
+        __fpurge(stdin);
+        for(i=0; i<SERVE_NUM_OF_FDS; i++){
+            dup2(null_fd, i);
+        }
+    }
+
+    bytes = send(client_fd, &result, sizeof(result), MSG_NOSIGNAL);
+    if(sizeof(result) != bytes){
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    for(i=0; i<SERVE_NUM_OF_FDS; i++){
+        if(-1 != fds[i]){
+            close(fds[i]);
+        }
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: The main loop of the server
+ * @param[IN] repository: The repository
+ * @param[IN] listen_fd: The listening socket
+ * @param[IN] null_fd: An fd of /dev/null
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Clients are served one at a time, so commands never run concurrently inside the server.
+ *         Before every command the caches whose files another process changed are dropped. The parsed
+ *         index and HEAD stay loaded across commands too, the index cache stats their files on every use.
+ *         A client that doesn't send its request within SERVE_CLIENT_TIMEOUT is dropped, so it can't hold
+ *         up the clients behind it.
+ */
+static error_code_t serve_run(IN slap_repository_t * repository, IN int listen_fd, IN int null_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int client_fd = -1;
+    bool stop = false;
+    char * request = NULL;
+    serve_snapshot_t snapshot = {0};
+
+    request = malloc(SERVE_MAX_REQUEST);
+    if(NULL == request){
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    serve_take_snapshot(&snapshot);
+
+    while(!stop){
+        client_fd = accept(listen_fd, NULL, NULL);
+        if(-1 == client_fd && EINTR == errno){
+            continue;
+        }
+        if(-1 == client_fd){
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+
+        serve_invalidate(&snapshot);
+        if(ERROR_CODE_SUCCESS == set_socket_timeout(client_fd, SERVE_CLIENT_TIMEOUT)){
+            serve_handle_client(repository, client_fd, null_fd, request, &stop);
+        }
+        serve_take_snapshot(&snapshot);
+
+        close(client_fd);
+        client_fd = -1;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != client_fd){
+        close(client_fd);
+    }
+    if(NULL != request){
+        free(request);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Starts the server for the repository
+ * @param[IN] repository: The repository, whose caches the server keeps loaded between commands
+ * @param[IN] foreground: Run in the calling process instead of forking a daemon
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Like the fsmonitor daemon, a forked server only returns control once it is accepting clients
+ */
+error_code_t serve_start(IN slap_repository_t * repository, IN bool foreground){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int socket_fd = -1;
+    int listen_fd = -1;
+    int null_fd = -1;
+    int ready_pipe[2] = {-1, -1};
+    pid_t pid = 0;
+    char ready = 0;
+    struct sockaddr_un address = {0};
+
+    return_value = serve_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS == return_value){
+        printf("The server is already running\n");
+        goto cleanup;
+    }
+
+    return_value = serve_address(&address);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    unlink(address.sun_path);
+    errno = 0;
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(-1 == listen_fd){
+        perror("SERVE_START: Socket error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = bind(listen_fd, (struct sockaddr *)&address, sizeof(address));
+    if(-1 == error_check){
+        perror("SERVE_START: Bind error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    error_check = listen(listen_fd, 16);
+    if(-1 == error_check){
+        perror("SERVE_START: Listen error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if(-1 == null_fd){
+        perror("SERVE_START: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    if(!foreground){
+        error_check = pipe(ready_pipe);
+        if(-1 == error_check){
+            perror("SERVE_START: Pipe error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_CREATE;
+            goto cleanup;
+        }
+
+        fflush(stdout);
+        pid = fork();
+        if(-1 == pid){
+            perror("SERVE_START: Fork error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_CREATE;
+            goto cleanup;
+        }
+
+        if(0 != pid){
+            close(ready_pipe[1]);
+            ready_pipe[1] = -1;
+
+            error_check = read(ready_pipe[0], &ready, 1);
+            if(1 != error_check){
+                printf("The server failed to start\n");
+                return_value = ERROR_CODE_COULDNT_CREATE;
+                goto cleanup;
+            }
+
+            printf("Server started (pid %i)\n", pid);
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+
+        /* Daemon */
+        close(ready_pipe[0]);
+        ready_pipe[0] = -1;
+        setsid();
+    }
+    else{
+        printf("Serving on %s/%s/%s\n", repository->work_tree, repo_dir_name, serve_socket_name);
+        fflush(stdout);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+
+    if(!foreground){
+        write(ready_pipe[1], &ready, 1);
+        close(ready_pipe[1]);
+        ready_pipe[1] = -1;
+    }
+
+    return_value = serve_run(repository, listen_fd, null_fd);
+
+    unlink(address.sun_path);
+    if(!foreground){
+        slap_close(repository);
+        exit(return_value);
+    }
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+    if(-1 != listen_fd){
+        close(listen_fd);
+    }
+    if(-1 != null_fd){
+        close(null_fd);
+    }
+    if(-1 != ready_pipe[0]){
+        close(ready_pipe[0]);
+    }
+    if(-1 != ready_pipe[1]){
+        close(ready_pipe[1]);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Stops the server of the current repository
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The server finishes the command it is running first
+ */
+error_code_t serve_stop(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int socket_fd = -1;
+
+    return_value = serve_connect(&socket_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        printf("The server is not running\n");
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    if(sizeof(SERVE_STOP_REQUEST) != send(socket_fd, SERVE_STOP_REQUEST, sizeof(SERVE_STOP_REQUEST), MSG_NOSIGNAL)){
+        perror("SERVE_STOP: Send error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+    printf("Server stopped\n");
+
+cleanup:
+    if(-1 != socket_fd){
+        close(socket_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Runs the serve command
+ * @param[IN] repository: The repository
+ * @param[IN] argc: The number of arguments (after serve)
+ * @param[IN] argv: The arguments: [start|stop]
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Without arguments the server runs in the foreground
+ */
+error_code_t serve_command(IN slap_repository_t * repository, IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    if(0 == argc){
+        return_value = serve_start(repository, true);
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "start")){
+        return_value = serve_start(repository, false);
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "stop")){
+        return_value = serve_stop();
+    }
+    else{
+        printf("USAGE: serve: [start|stop]\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+    return return_value;
+}
@@ -0,0 +1,504 @@
+#include "slap_commands.h"
+
+#include <sys/mman.h>
+
+const char * sketch_file_name = "sketches";
+
+/**
+ * @brief: Initializes the sketch cache of a repository, with nothing loaded yet
+ * @param[OUT] cache: The cache
+ */
+void sketch_cache_init(OUT sketch_cache_t * cache){
+    memset(cache, 0, sizeof(*cache));
+    cache->fd = -1;
+}
+
+/**
+ * @brief: Mixes the bits of a 64 bit value (the splitmix64 finalizer)
+ */
+static uint64_t sketch_mix(IN uint64_t value){
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+
+    return value;
+}
+
+/**
+ * @brief: Gets the slot of a sha in the cache
+ * @param[IN] hash: The sha to look for
+ *
+ * @returns: The slot holding the sha, or the empty slot where it would be inserted
+ */
+static size_t sketch_slot(IN const unsigned char * hash){
+    size_t slot = 0;
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    memcpy(&slot, hash, sizeof(slot));
+    slot &= cache->num_of_slots - 1;
+
+    while(0 != cache->slots[slot] && 0 != memcmp(cache->sketches[cache->slots[slot] - 1].sha, hash, SHA_DIGEST_LENGTH)){
+        slot = (slot + 1) & (cache->num_of_slots - 1);
+    }
+
+    return slot;
+}
+
+/**
+ * @brief: Adds a sketch to the cache
+ * @param[IN] sketch: The sketch
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sketch_insert(IN const sketch_t * sketch){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    size_t i = 0;
+    size_t slot = 0;
+    size_t new_capacity = 0;
+    size_t new_num_of_slots = 0;
+    sketch_t * new_sketches = NULL;
+    unsigned int * new_slots = NULL;
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    if(cache->count == cache->capacity){
+        new_capacity = max(2 * cache->capacity, 256);
+        new_sketches = realloc(cache->sketches, new_capacity * sizeof(*cache->sketches));
+        if(NULL == new_sketches){
+            perror("SKETCH_INSERT: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        cache->sketches = new_sketches;
+        cache->capacity = new_capacity;
+    }
+
+    if((cache->count + 1) * 2 > cache->num_of_slots){
+        new_num_of_slots = max(cache->num_of_slots * 2, 1024);
+        new_slots = calloc(new_num_of_slots, sizeof(*new_slots));
+        if(NULL == new_slots){
+            perror("SKETCH_INSERT: Calloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        free(cache->slots);
+        cache->slots = new_slots;
+        cache->num_of_slots = new_num_of_slots;
+
+        for(i=0; i<cache->count; i++){
+            cache->slots[sketch_slot(cache->sketches[i].sha)] = i + 1;
+        }
+    }
+
+    slot = sketch_slot(sketch->sha);
+    if(0 == cache->slots[slot]){
+        cache->sketches[cache->count++] = *sketch;
+        cache->slots[slot] = cache->count;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Opens the sketch file for reading and reads the cached sketches
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Lookups never write, so a missing file is just an empty cache and a file with a bad header is
+ *         ignored until sketch_open_for_append starts it over. A record cut short by a crash is ignored
+ *         (and overwritten by the next append).
+ */
+static error_code_t sketch_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    size_t i = 0;
+    size_t num_of_records = 0;
+    size_t offset = 0;
+    ssize_t bytes_read = 0;
+    sketch_t * records = NULL;
+    sketch_header_t header = {0};
+    struct stat statbuf = {0};
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    if(cache->loaded){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    cache->fd = openat(dir_fd, sketch_file_name, O_RDONLY | O_CLOEXEC);
+    if(-1 == cache->fd && ENOENT == errno){
+        errno = 0;
+        cache->loaded = true;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(-1 == cache->fd){
+        perror("SKETCH_LOAD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(cache->fd, &statbuf);
+    if(-1 == error_check){
+        perror("SKETCH_LOAD: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    if((size_t)statbuf.st_size >= sizeof(header)){
+        bytes_read = pread(cache->fd, &header, sizeof(header), 0);
+    }
+    if(sizeof(header) != bytes_read || SKETCH_MAGIC != header.magic || SKETCH_VERSION != header.version || SKETCH_SIZE != header.size){
+        cache->loaded = true;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    num_of_records = (statbuf.st_size - sizeof(header)) / sizeof(*records);
+    if(0 != num_of_records){
+        records = malloc(num_of_records * sizeof(*records));
+        if(NULL == records){
+            perror("SKETCH_LOAD: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+    }
+
+    for(offset=0; offset<num_of_records * sizeof(*records); offset+=bytes_read){
+        bytes_read = pread(cache->fd, (char *)records + offset, num_of_records * sizeof(*records) - offset, sizeof(header) + offset);
+        if(0 >= bytes_read){
+            perror("SKETCH_LOAD: Pread error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+    }
+
+    for(i=0; i<num_of_records; i++){
+        return_value = sketch_insert(&records[i]);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    cache->loaded = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != records){
+        free(records);
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        sketch_close();
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Reopens the sketch file for writing, creating it if needed, so a new sketch can be appended
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Only done when a sketch is recorded. A file with a bad header is started over.
+ */
+static error_code_t sketch_open_for_append(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int new_fd = -1;
+    ssize_t bytes_read = 0;
+    sketch_header_t header = {0};
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    if(cache->writable){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    return_value = object_dir_fd(&dir_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    new_fd = openat(dir_fd, sketch_file_name, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if(-1 == new_fd){
+        perror("SKETCH_OPEN_FOR_APPEND: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    bytes_read = pread(new_fd, &header, sizeof(header), 0);
+    if(sizeof(header) != bytes_read || SKETCH_MAGIC != header.magic || SKETCH_VERSION != header.version || SKETCH_SIZE != header.size){
+        header.magic = SKETCH_MAGIC;
+        header.version = SKETCH_VERSION;
+        header.size = SKETCH_SIZE;
+
+        error_check = ftruncate(new_fd, 0);
+        if(-1 == error_check){
+            perror("SKETCH_OPEN_FOR_APPEND: Ftruncate error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_TRUNCATE;
+            goto cleanup;
+        }
+
+        error_check = pwrite(new_fd, &header, sizeof(header), 0);
+        if(sizeof(header) != error_check){
+            perror("SKETCH_OPEN_FOR_APPEND: Pwrite error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_WRITE;
+            goto cleanup;
+        }
+    }
+
+    if(-1 != cache->fd){
+        close(cache->fd);
+    }
+    cache->fd = new_fd;
+    new_fd = -1;
+    cache->writable = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(-1 != new_fd){
+        close(new_fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Computes the sketch of a blob
+ * @param[IN] hash: The sha of the blob
+ * @param[OUT] sketch: The sketch
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The shingles are the lines of the blob. Every line is hashed once (FNV-1a), and the
+ *         SKETCH_SIZE MinHash values come from mixing that hash with a different seed each.
+ */
+static error_code_t sketch_compute(IN const unsigned char * hash, OUT sketch_t * sketch){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    int i = 0;
+    uint32_t value = 0;
+    uint64_t line_hash = 0;
+    const char * data = NULL;
+    const char * position = NULL;
+    const char * line_end = NULL;
+    const char * end = NULL;
+    struct stat statbuf = {0};
+
+    memcpy(sketch->sha, hash, SHA_DIGEST_LENGTH);
+    memset(sketch->mins, 0xff, sizeof(sketch->mins));
+
+    return_value = open_object(hash, O_RDONLY, 0, &fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("SKETCH_COMPUTE: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+    if(0 == statbuf.st_size){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == data){
+        data = NULL;
+        perror("SKETCH_COMPUTE: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_READ;
+        goto cleanup;
+    }
+    madvise((void *)data, statbuf.st_size, MADV_SEQUENTIAL);
+
+    end = data + statbuf.st_size;
+    for(position=data; position<end; position=line_end + 1){
+        line_end = memchr(position, '\n', end - position);
+        if(NULL == line_end){
+            line_end = end;
+        }
+
+        line_hash = 14695981039346656037ULL;
+        for(; position<line_end; position++){
+            line_hash = (line_hash ^ (unsigned char)*position) * 1099511628211ULL;
+        }
+
+        for(i=0; i<SKETCH_SIZE; i++){
+            value = (uint32_t)sketch_mix(line_hash ^ ((uint64_t)(i + 1) * 0x9e3779b97f4a7c15ULL));
+            if(value < sketch->mins[i]){
+                sketch->mins[i] = value;
+            }
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != data){
+        munmap((void *)data, statbuf.st_size);
+    }
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Gets the sketch of a blob, from the cache in the objects directory or by computing it
+ * @param[IN] hash: The sha of the blob
+ * @param[OUT] sketch: The sketch
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Blobs never change, so a computed sketch is appended to the cache and kept for good. The cache
+ *         is only opened for writing (and created) when a sketch is appended.
+ */
+error_code_t sketch_get(IN const unsigned char * hash, OUT sketch_t * sketch){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    ssize_t bytes_written = 0;
+    size_t slot = 0;
+    off_t end = 0;
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    return_value = sketch_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(0 != cache->count){
+        slot = sketch_slot(hash);
+        if(0 != cache->slots[slot]){
+            *sketch = cache->sketches[cache->slots[slot] - 1];
+            return_value = ERROR_CODE_SUCCESS;
+            goto cleanup;
+        }
+    }
+
+    return_value = sketch_compute(hash, sketch);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = sketch_insert(sketch);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = sketch_open_for_append();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    /* Whole records only, so a record cut short by a crash is overwritten */
+    end = lseek(cache->fd, 0, SEEK_END);
+    if(-1 == end){
+        perror("SKETCH_GET: Lseek error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_LSEEK;
+        goto cleanup;
+    }
+    end = sizeof(sketch_header_t) + (end - sizeof(sketch_header_t)) / sizeof(*sketch) * sizeof(*sketch);
+
+    bytes_written = pwrite(cache->fd, sketch, sizeof(*sketch), end);
+    if(sizeof(*sketch) != bytes_written){
+        perror("SKETCH_GET: Pwrite error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Checks if a sketch is of a blob without lines
+ */
+bool sketch_is_empty(IN const sketch_t * sketch){
+    return (UINT32_MAX == sketch->mins[0]);
+}
+
+/**
+ * @brief: Estimates how similar two blobs are
+ * @param[IN] a: The sketch of one blob
+ * @param[IN] b: The sketch of the other blob
+ *
+ * @returns: The estimated Jaccard similarity of the lines of the blobs, in percent
+ */
+int sketch_similarity(IN const sketch_t * a, IN const sketch_t * b){
+    int i = 0;
+    int matches = 0;
+
+    for(i=0; i<SKETCH_SIZE; i++){
+        matches += (a->mins[i] == b->mins[i]);
+    }
+
+    return matches * 100 / SKETCH_SIZE;
+}
+
+/**
+ * @brief: Hashes a band of a sketch
+ * @param[IN] sketch: The sketch
+ * @param[IN] band: The band, from 0 to SKETCH_BANDS - 1
+ *
+ * @returns: The hash, which includes the band so equal hashes of different bands don't collide
+ */
+uint64_t sketch_band(IN const sketch_t * sketch, IN int band){
+    int i = 0;
+    uint64_t value = band;
+
+    for(i=0; i<SKETCH_ROWS; i++){
+        value = sketch_mix(value ^ sketch->mins[band * SKETCH_ROWS + i]) + i;
+    }
+
+    return value;
+}
+
+/**
+ * @brief: Closes the sketch file and drops the cached sketches
+ */
+void sketch_close(){
+    sketch_cache_t * cache = &repository_state()->sketch;
+
+    if(-1 != cache->fd){
+        close(cache->fd);
+        cache->fd = -1;
+    }
+    cache->writable = false;
+    if(NULL != cache->sketches){
+        free(cache->sketches);
+        cache->sketches = NULL;
+    }
+    if(NULL != cache->slots){
+        free(cache->slots);
+        cache->slots = NULL;
+    }
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->num_of_slots = 0;
+    cache->loaded = false;
+}
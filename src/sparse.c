@@ -0,0 +1,393 @@
+#include "slap_commands.h"
+
+const char * sparse_file_name = "sparse";
+
+/**
+ * @brief: Gets the path of the sparse checkout file
+ * @param[OUT] path: The buffer to write into (at least PATH_MAX bytes)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sparse_path(OUT char * path){
+    int error_check = 0;
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", repo_dir_name, sparse_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return ERROR_CODE_COULDNT_SPRINTF;
+    }
+
+    return ERROR_CODE_SUCCESS;
+}
+
+/**
+ * @brief: Strips "./", leading slashes and trailing slashes from a pattern
+ * @param[IN OUT] pattern: The pattern
+ * @param[IN OUT] pattern_len: Its length
+ */
+static void sparse_normalize(IN OUT const char ** pattern, IN OUT int * pattern_len){
+    while(0 < *pattern_len){
+        if('/' == (*pattern)[0]){
+            (*pattern)++;
+            (*pattern_len)--;
+        }
+        else if(2 <= *pattern_len && '.' == (*pattern)[0] && '/' == (*pattern)[1]){
+            (*pattern) += 2;
+            (*pattern_len) -= 2;
+        }
+        else{
+            break;
+        }
+    }
+    while(0 < *pattern_len && '/' == (*pattern)[*pattern_len - 1]){
+        (*pattern_len)--;
+    }
+}
+
+/**
+ * @brief: Adds a node to the trie
+ * @param[IN] byte: The byte of the node
+ * @param[OUT] node: The index of the node
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sparse_new_node(IN char byte, OUT int * node){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int new_capacity = 0;
+    sparse_node_t * new_nodes = NULL;
+    sparse_cache_t * cache = &repository_state()->sparse;
+
+    if(cache->num_of_nodes == cache->capacity){
+        new_capacity = max(2 * cache->capacity, 64);
+        new_nodes = realloc(cache->nodes, new_capacity * sizeof(*cache->nodes));
+        if(NULL == new_nodes){
+            perror("SPARSE_NEW_NODE: Realloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+        cache->nodes = new_nodes;
+        cache->capacity = new_capacity;
+    }
+
+    memset(&cache->nodes[cache->num_of_nodes], 0, sizeof(*cache->nodes));
+    cache->nodes[cache->num_of_nodes].byte = byte;
+    *node = cache->num_of_nodes++;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Adds a pattern to the trie
+ * @param[IN] pattern: The pattern, a path or a directory whose whole subtree is in the sparse checkout
+ * @param[IN] pattern_len: Its length
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sparse_insert(IN const char * pattern, IN int pattern_len){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int node = 0;
+    int child = 0;
+    sparse_cache_t * cache = &repository_state()->sparse;
+
+    for(i=0; i<pattern_len; i++){
+        for(child=cache->nodes[node].child; 0 != child && cache->nodes[child].byte != pattern[i]; child=cache->nodes[child].sibling);
+
+        if(0 == child){
+            return_value = sparse_new_node(pattern[i], &child);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+            cache->nodes[child].sibling = cache->nodes[node].child;
+            cache->nodes[node].child = child;
+        }
+        node = child;
+    }
+    cache->nodes[node].terminal = true;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Reads the sparse checkout file
+ * @param[IN] path: The path of the file
+ * @param[OUT] data: The contents, NUL terminated, NULL if there is no sparse checkout file
+ * @param[OUT] size: The size of the contents
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t sparse_read(IN const char * path, OUT char ** data, OUT size_t * size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int fd = -1;
+    ssize_t bytes_read = 0;
+    size_t offset = 0;
+    char * buffer = NULL;
+    struct stat statbuf = {0};
+
+    fd = openat(work_tree_fd(), path, O_RDONLY | O_CLOEXEC);
+    if(-1 == fd && ENOENT == errno){
+        errno = 0;
+        *data = NULL;
+        *size = 0;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(-1 == fd){
+        perror("SPARSE_READ: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = fstat(fd, &statbuf);
+    if(-1 == error_check){
+        perror("SPARSE_READ: Fstat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_STAT;
+        goto cleanup;
+    }
+
+    buffer = malloc(statbuf.st_size + 1);
+    if(NULL == buffer){
+        perror("SPARSE_READ: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(offset=0; offset<(size_t)statbuf.st_size; offset+=bytes_read){
+        bytes_read = read(fd, buffer + offset, statbuf.st_size - offset);
+        if(-1 == bytes_read){
+            perror("SPARSE_READ: Read error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_READ;
+            goto cleanup;
+        }
+        if(0 == bytes_read){
+            break;
+        }
+    }
+    buffer[offset] = '\0';
+
+    *data = buffer;
+    *size = offset;
+    buffer = NULL;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != buffer){
+        free(buffer);
+    }
+    if(-1 != fd){
+        close(fd);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Reads the sparse checkout patterns and compiles them into a trie
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Without a sparse checkout file every path is in the sparse checkout. The file is read again on
+ *         every call (it is small), so commands see patterns set by other processes.
+ */
+error_code_t sparse_load(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int root = 0;
+    int pattern_len = 0;
+    size_t size = 0;
+    char path[PATH_MAX] = {0};
+    char * data = NULL;
+    const char * line = NULL;
+    const char * line_end = NULL;
+    const char * pattern = NULL;
+    sparse_cache_t * cache = &repository_state()->sparse;
+
+    sparse_close();
+
+    return_value = sparse_path(path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = sparse_read(path, &data, &size);
+    if(ERROR_CODE_SUCCESS != return_value || NULL == data){
+        goto cleanup;
+    }
+
+    return_value = sparse_new_node('\0', &root);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(line=data; line<data + size; line=line_end + 1){
+        line_end = memchr(line, '\n', data + size - line);
+        if(NULL == line_end){
+            line_end = data + size;
+        }
+
+        pattern = line;
+        pattern_len = line_end - line;
+        if(0 == pattern_len || '#' == pattern[0]){
+            continue;
+        }
+        sparse_normalize(&pattern, &pattern_len);
+
+        return_value = sparse_insert(pattern, pattern_len);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    cache->enabled = true;
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        sparse_close();
+    }
+    if(NULL != data){
+        free(data);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Checks if a path is in the sparse checkout
+ * @param[IN] path: The path, relative to the work tree
+ * @param[IN] path_len: Its length
+ *
+ * @returns: true if there is no sparse checkout, or a pattern is the path or one of its directories
+ * @notes: The path is walked down the trie one byte at a time, so the cost doesn't depend on the number
+ *         of patterns
+ */
+bool sparse_contains(IN const char * path, IN int path_len){
+    int i = 0;
+    int node = 0;
+    sparse_cache_t * cache = &repository_state()->sparse;
+
+    if(!cache->enabled){
+        return true;
+    }
+
+    while(path_len >= 2 && '.' == path[0] && '/' == path[1]){
+        path += 2;
+        path_len -= 2;
+    }
+
+    if(cache->nodes[0].terminal){
+        return true;
+    }
+
+    for(i=0; i<path_len; i++){
+        for(node=cache->nodes[node].child; 0 != node && cache->nodes[node].byte != path[i]; node=cache->nodes[node].sibling);
+        if(0 == node){
+            return false;
+        }
+        if(cache->nodes[node].terminal && (i + 1 == path_len || '/' == path[i + 1])){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief: Drops the compiled patterns
+ */
+void sparse_close(){
+    sparse_cache_t * cache = &repository_state()->sparse;
+
+    if(NULL != cache->nodes){
+        free(cache->nodes);
+        cache->nodes = NULL;
+    }
+    cache->num_of_nodes = 0;
+    cache->capacity = 0;
+    cache->enabled = false;
+}
+
+/**
+ * @brief: Runs the sparse command
+ * @param[IN] argc: The number of arguments (after sparse)
+ * @param[IN] argv: The arguments: set <patterns> | list | disable
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t sparse_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int i = 0;
+    size_t length = 0;
+    char path[PATH_MAX] = {0};
+    char * data = NULL;
+
+    return_value = sparse_path(path);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(2 <= argc && 0 == valid_strncmp(argv[0], "set")){
+        for(i=1; i<argc; i++){
+            length += strlen(argv[i]) + 1;
+        }
+
+        data = malloc(length + 1);
+        if(NULL == data){
+            perror("SPARSE_COMMAND: Malloc error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+            goto cleanup;
+        }
+
+        for(i=1, length=0; i<argc; i++){
+            length += sprintf(data + length, "%s\n", argv[i]);
+        }
+
+        return_value = replace_file(path, data, length);
+        if(ERROR_CODE_SUCCESS == return_value){
+            printf("Only the paths under the patterns are checked out and tracked from now on.\n");
+        }
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "list")){
+        return_value = sparse_read(path, &data, &length);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+        if(NULL == data){
+            printf("There is no sparse checkout, every path is checked out.\n");
+            goto cleanup;
+        }
+        fwrite(data, 1, length, stdout);
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "disable")){
+        error_check = unlinkat(work_tree_fd(), path, 0);
+        if(-1 == error_check && ENOENT != errno){
+            perror("SPARSE_COMMAND: Unlinkat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_OPEN;
+            goto cleanup;
+        }
+        errno = 0;
+        return_value = ERROR_CODE_SUCCESS;
+    }
+    else{
+        printf("USAGE: sparse: set <patterns> | list | disable\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+cleanup:
+    if(NULL != data){
+        free(data);
+    }
+
+    return return_value;
+}
@@ -1,5 +1,8 @@
 #include "slap_commands.h"
 
+#include <sys/socket.h>
+#include <sys/time.h>
+
 /**
  * @brief: compares to strings
  * @param[IN] s1: String 1 to compare
@@ -18,7 +21,7 @@ int valid_strncmp(IN char * s1, IN char * s2){
 
 /**
  * @brief: creates a directory
- * @param[IN] path: The path to the directory
+ * @param[IN] path: The path to the directory, relative to the work tree
  * 
  * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
  * @notes: This calls mkdir on path and then chmod-s it to the normal directory mode
@@ -28,21 +31,21 @@ error_code_t make_dir(IN const char * path){
     int error_check = 0;
     bool already_exists = false;
 
-    error_check = mkdir(path, 0);
+    error_check = mkdirat(work_tree_fd(), path, 0);
     if(-1 == error_check && EEXIST == errno){
         already_exists = true;
         errno = 0;
     }
     else if(-1 == error_check){
-        perror("MAKE_DIR: Mkdir error");
+        perror("MAKE_DIR: Mkdirat error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_CREATE;
         goto cleanup;
     }
 
-    error_check = chmod(path, 0775);
+    error_check = fchmodat(work_tree_fd(), path, 0775, 0);
     if(-1 == error_check){
-        perror("MAKE_DIR: Chmod error");
+        perror("MAKE_DIR: Fchmodat error");
         printf("(Errno: %i)\n", errno);
         return_value = ERROR_CODE_COULDNT_CHMOD;
         goto cleanup;
@@ -211,7 +214,7 @@ int copy_file_range(IN int in_fd, IN loff_t in_offset, IN int out_fd, IN loff_t
         }
 
         if(in_offset + length - current_in_offset >= BUFFER_SIZE){
-            bytes_read = read(in_offset, buffer, BUFFER_SIZE);
+            bytes_read = read(in_fd, buffer, BUFFER_SIZE);
             if(-1 == bytes_read){
                 perror("COPY_FILE_RANGE: Read error");
                 printf("(Errno: %i)\n", errno);
@@ -231,7 +234,7 @@ int copy_file_range(IN int in_fd, IN loff_t in_offset, IN int out_fd, IN loff_t
 
         if(bytes_read != 0){
             error_check = write(out_fd, buffer, bytes_read);
-            if(-1 == bytes_read){
+            if(-1 == error_check){
                 perror("COPY_FILE_RANGE: Write error");
                 printf("(Errno: %i)\n", errno);
                 bytes_written = -1;
@@ -260,7 +263,7 @@ cleanup:
 int file_insertion(int in_fd, char * in_path, void * insertion, off_t offset, int length){
     int error_check = 0;
     int bytes_written = 0;
-    int new_fd = 0;
+    int new_fd = -1;
 
     error_check = rename(in_path, "del");
     if(-1 == error_check){
@@ -316,5 +319,209 @@ int file_insertion(int in_fd, char * in_path, void * insertion, off_t offset, in
     }
 
 cleanup:
+    if(-1 != new_fd){
+        close(new_fd);
+    }
+
     return bytes_written;
 }
+
+/**
+ * @brief: Points the standard output at the standard error, keeping a descriptor of the real one
+ * @param[OUT] stdout_fd: A duplicate of the real standard output
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Commands that stream data to the standard output call this first, so the messages printed
+ *         anywhere below them can't end up in the middle of the data
+ */
+error_code_t redirect_stdout(OUT int * stdout_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    fflush(stdout);
+
+    *stdout_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if(-1 == *stdout_fd){
+        perror("REDIRECT_STDOUT: Fcntl error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = dup2(STDERR_FILENO, STDOUT_FILENO);
+    if(-1 == error_check){
+        perror("REDIRECT_STDOUT: Dup2 error");
+        printf("(Errno: %i)\n", errno);
+        close(*stdout_fd);
+        *stdout_fd = -1;
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Undoes redirect_stdout
+ * @param[IN] stdout_fd: The descriptor redirect_stdout returned, -1 does nothing
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t restore_stdout(IN int stdout_fd){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    if(-1 == stdout_fd){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    fflush(stdout);
+
+    error_check = dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+    if(-1 == error_check){
+        perror("RESTORE_STDOUT: Dup2 error");
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Bounds how long reads and writes on a socket may block
+ * @param[IN] socket_fd: The socket
+ * @param[IN] milliseconds: The longest a single read or write may block
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: A read or write that times out fails with EAGAIN, so a peer that stops talking can't stall the caller
+ */
+error_code_t set_socket_timeout(IN int socket_fd, IN int milliseconds){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    struct timeval timeout = {0};
+
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+
+    error_check = setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if(-1 == error_check){
+        perror("SET_SOCKET_TIMEOUT: Setsockopt error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_UNDEFINED;
+        goto cleanup;
+    }
+
+    error_check = setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if(-1 == error_check){
+        perror("SET_SOCKET_TIMEOUT: Setsockopt error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_UNDEFINED;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets a path that resolves like a path relative to a directory fd, for the calls that have no *at variant
+ * @param[IN] dir_fd: The directory (AT_FDCWD for the working directory)
+ * @param[IN] path: The path, relative to dir_fd
+ * @param[OUT] full_path: The path to use instead
+ * @param[IN] size: The size of full_path
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: Relative paths go through /proc/self/fd, which resolves to the directory itself
+ */
+error_code_t path_at(IN int dir_fd, IN const char * path, OUT char * full_path, IN size_t size){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    if(AT_FDCWD == dir_fd || '/' == path[0]){
+        error_check = snprintf(full_path, size, "%s", path);
+    }
+    else{
+        error_check = snprintf(full_path, size, "/proc/self/fd/%i/%s", dir_fd, path);
+    }
+    if(error_check < 0 || (size_t)error_check >= size){
+        printf("\e[31mThe path %s is too long.\e[0m\n", path);
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Opens a stream of a file relative to a directory fd, like fopen
+ * @param[IN] dir_fd: The directory (AT_FDCWD for the working directory)
+ * @param[IN] path: The path, relative to dir_fd
+ * @param[IN] mode: "r", "w" or "a", optionally followed by "+"
+ *
+ * @returns: The stream, or NULL with errno set
+ */
+FILE * fopenat(IN int dir_fd, IN const char * path, IN const char * mode){
+    FILE * file = NULL;
+    int fd = -1;
+    int flags = 0;
+    bool update = ('\0' != mode[0] && '+' == mode[1]);
+
+    switch(mode[0]){
+    case 'r':
+        flags = update ? O_RDWR : O_RDONLY;
+        break;
+    case 'w':
+        flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+        break;
+    case 'a':
+        flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+        break;
+    default:
+        errno = EINVAL;
+        goto cleanup;
+    }
+
+    fd = openat(dir_fd, path, flags | O_CLOEXEC, 0666);
+    if(-1 == fd){
+        goto cleanup;
+    }
+
+    file = fdopen(fd, mode);
+    if(NULL == file){
+        close(fd);
+    }
+
+cleanup:
+    return file;
+}
+
+/**
+ * @brief: Resolves a path relative to a directory fd, like realpath
+ * @param[IN] dir_fd: The directory (AT_FDCWD for the working directory)
+ * @param[IN] path: The path, relative to dir_fd
+ *
+ * @returns: The absolute path, to be freed by the caller, or NULL with errno set
+ */
+char * realpathat(IN int dir_fd, IN const char * path){
+    char full_path[PATH_MAX] = {0};
+
+    if(ERROR_CODE_SUCCESS != path_at(dir_fd, path, full_path, sizeof(full_path))){
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    return realpath(full_path, NULL);
+}
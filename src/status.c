@@ -0,0 +1,191 @@
+#include "slap_commands.h"
+
+/**
+ * @brief: Updates the index entries whose working directory sha changed
+ * @param[IN] entries: The entries of the cached index
+ * @param[IN] paths: The paths of the entries that may have changed
+ * @param[IN] positions: The position in entries of each path
+ * @param[IN] num_of_paths: The number of paths
+ * @param[OUT] changed: Set if an entry changed, else left as is
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The paths are hashed together with bulk_hash_files. A file that was deleted gets an all zeros
+ *         working directory sha, its entry stays in the index.
+ */
+static error_code_t refresh_index_chunk(IN index_file_segement_t * entries, IN char ** paths, IN size_t * positions,
+                                        IN int num_of_paths, OUT bool * changed){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int difference = 0;
+    unsigned char * hashes = NULL;
+    index_file_segement_t * entry = NULL;
+
+    if(0 == num_of_paths){
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+
+    hashes = malloc((size_t)num_of_paths * SHA_DIGEST_LENGTH);
+    if(NULL == hashes){
+        perror("REFRESH_INDEX_CHUNK: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    return_value = bulk_hash_files(paths, num_of_paths, true, hashes);
+    if(ERROR_CODE_SUCCESS != return_value){
+        return_value = ERROR_CODE_COULDNT_GET_HASH;
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_paths; i++){
+        entry = &entries[positions[i]];
+
+        difference = memcmp(hashes + (size_t)i * SHA_DIGEST_LENGTH, entry->wdir_sha, SHA_DIGEST_LENGTH);
+        if(0 == difference){
+            continue;
+        }
+
+        memcpy(entry->wdir_sha, hashes + (size_t)i * SHA_DIGEST_LENGTH, SHA_DIGEST_LENGTH);
+        *changed = true;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != hashes){
+        free(hashes);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Brings the working directory shas of the index up to date
+ * @param[IN] fsmonitor_result: The result of fsmonitor_query, used to skip files that didn't change
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The files that may have changed are hashed BULK_IO_CHUNK at a time, so the io_uring backend can
+ *         keep many of them in flight. The cached index is only written if a working directory sha changed.
+ */
+error_code_t refresh_index(IN fsmonitor_result_t * fsmonitor_result){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int num_of_paths = 0;
+    bool changed = false;
+    size_t i = 0;
+    size_t num_of_entries = 0;
+    size_t * positions = NULL;
+    char ** paths = NULL;
+    index_file_segement_t * entries = NULL;
+
+    positions = calloc(BULK_IO_CHUNK, sizeof(*positions));
+    paths = calloc(BULK_IO_CHUNK, sizeof(*paths));
+    if(NULL == positions || NULL == paths){
+        perror("REFRESH_INDEX: Calloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    return_value = sparse_load();
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = index_cache_entries(&entries, &num_of_entries);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_entries; i++){
+        /* Paths outside the sparse checkout keep their hashes, they aren't even stat'ed */
+        if(sparse_contains(entries[i].name, entries[i].name_len) && fsmonitor_is_dirty(fsmonitor_result, entries[i].name)){
+            paths[num_of_paths] = entries[i].name;
+            positions[num_of_paths] = i;
+            num_of_paths++;
+        }
+
+        if(BULK_IO_CHUNK == num_of_paths){
+            return_value = refresh_index_chunk(entries, paths, positions, num_of_paths, &changed);
+            if(ERROR_CODE_SUCCESS != return_value){
+                goto cleanup;
+            }
+            num_of_paths = 0;
+        }
+    }
+
+    return_value = refresh_index_chunk(entries, paths, positions, num_of_paths, &changed);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    if(changed){
+        index_cache_changed();
+        return_value = index_cache_write();
+    }
+
+cleanup:
+    if(NULL != positions){
+        free(positions);
+    }
+    if(NULL != paths){
+        free(paths);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints which files in the index were modified and which are staged for the next commit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: If the fsmonitor daemon is running only the files it reports are hashed. Files that were deleted
+ *         from the working directory are listed as deleted.
+ */
+error_code_t status(){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int difference = 0;
+    size_t i = 0;
+    size_t num_of_entries = 0;
+    unsigned char deleted_sha[SHA_DIGEST_LENGTH] = {0};
+    index_file_segement_t * entries = NULL;
+    fsmonitor_result_t fsmonitor_result = {0};
+
+    return_value = fsmonitor_query(&fsmonitor_result);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = refresh_index(&fsmonitor_result);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = index_cache_entries(&entries, &num_of_entries);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    for(i=0; i<num_of_entries; i++){
+        difference = memcmp(entries[i].stage_sha, entries[i].repo_sha, SHA_DIGEST_LENGTH);
+        if(0 != difference){
+            printf("\e[32mstaged:   %s\e[0m\n", entries[i].name);
+        }
+
+        difference = memcmp(entries[i].wdir_sha, entries[i].stage_sha, SHA_DIGEST_LENGTH);
+        if(0 != difference && 0 == memcmp(entries[i].wdir_sha, deleted_sha, SHA_DIGEST_LENGTH)){
+            printf("\e[31mdeleted:  %s\e[0m\n", entries[i].name);
+        }
+        else if(0 != difference){
+            printf("\e[31mmodified: %s\e[0m\n", entries[i].name);
+        }
+    }
+
+    return_value = fsmonitor_save_token(&fsmonitor_result);
+
+cleanup:
+    fsmonitor_free_result(&fsmonitor_result);
+
+    return return_value;
+}
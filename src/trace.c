@@ -0,0 +1,248 @@
+#include "slap_commands.h"
+
+#include <time.h>
+
+typedef struct trace_counters_s{
+    unsigned long long reads;
+    unsigned long long writes;
+    unsigned long long bytes_read;
+    unsigned long long bytes_written;
+    unsigned long long opens;
+    unsigned long long closes;
+    unsigned long long stats;
+    unsigned long long syncs;
+    unsigned long long bytes_hashed;
+    unsigned long long allocations;
+}trace_counters_t;
+
+typedef struct trace_span_s{
+    const char * name;
+    trace_counters_t counters;
+}trace_span_t;
+
+bool trace_enabled = false;
+unsigned long long trace_bytes_hashed = 0;
+unsigned long long trace_allocations = 0;
+unsigned long long trace_reads = 0;
+unsigned long long trace_writes = 0;
+unsigned long long trace_bytes_read = 0;
+unsigned long long trace_bytes_written = 0;
+unsigned long long trace_opens = 0;
+unsigned long long trace_closes = 0;
+unsigned long long trace_stats = 0;
+unsigned long long trace_syncs = 0;
+
+static FILE * trace_file = NULL;
+static bool trace_first_event = true;
+static int trace_depth = 0;
+static trace_span_t trace_stack[TRACE_MAX_DEPTH] = {0};
+
+/**
+ * @brief: Gets the current time of the monotonic clock
+ *
+ * @returns: The time in microseconds
+ */
+static double trace_now(){
+    struct timespec now = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+/**
+ * @brief: Reads the current values of the counters
+ * @param[OUT] counters: The counters
+ *
+ * @notes: The I/O counts are kept by the I/O paths themselves (bulk I/O, both backends, and the object
+ *         helpers), so they include io_uring requests and none of the tracer's own I/O
+ */
+static void trace_read_counters(OUT trace_counters_t * counters){
+    counters->reads = __atomic_load_n(&trace_reads, __ATOMIC_RELAXED);
+    counters->writes = __atomic_load_n(&trace_writes, __ATOMIC_RELAXED);
+    counters->bytes_read = __atomic_load_n(&trace_bytes_read, __ATOMIC_RELAXED);
+    counters->bytes_written = __atomic_load_n(&trace_bytes_written, __ATOMIC_RELAXED);
+    counters->opens = __atomic_load_n(&trace_opens, __ATOMIC_RELAXED);
+    counters->closes = __atomic_load_n(&trace_closes, __ATOMIC_RELAXED);
+    counters->stats = __atomic_load_n(&trace_stats, __ATOMIC_RELAXED);
+    counters->syncs = __atomic_load_n(&trace_syncs, __ATOMIC_RELAXED);
+    counters->bytes_hashed = __atomic_load_n(&trace_bytes_hashed, __ATOMIC_RELAXED);
+    counters->allocations = __atomic_load_n(&trace_allocations, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief: Reads how many bytes the process read and wrote according to the kernel
+ * @param[OUT] rchar: The bytes read by the read family of system calls
+ * @param[OUT] wchar: The bytes written by the write family of system calls
+ *
+ * @notes: Only a cross-check of the counters: /proc/self/io misses io_uring I/O and includes the tracer's own
+ *         reads of it. Both are 0 if it can't be read.
+ */
+static void trace_read_proc_io(OUT unsigned long long * rchar, OUT unsigned long long * wchar){
+    int fd = -1;
+    ssize_t bytes_read = 0;
+    char buffer[BUFFER_SIZE] = {0};
+    char * line = NULL;
+    char * value = NULL;
+
+    *rchar = 0;
+    *wchar = 0;
+
+    fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    if(-1 == fd){
+        errno = 0;
+        goto cleanup;
+    }
+
+    bytes_read = read(fd, buffer, sizeof(buffer) - 1);
+    if(bytes_read <= 0){
+        errno = 0;
+        goto cleanup;
+    }
+
+    for(line=buffer; NULL != line && '\0' != *line; line=strchr(line, '\n')){
+        if('\n' == *line){
+            line++;
+        }
+
+        value = strchr(line, ':');
+        if(NULL == value){
+            break;
+        }
+
+        if(0 == strncmp(line, "rchar:", strlen("rchar:"))){
+            *rchar = strtoull(value + 1, NULL, 10);
+        }
+        else if(0 == strncmp(line, "wchar:", strlen("wchar:"))){
+            *wchar = strtoull(value + 1, NULL, 10);
+        }
+    }
+
+cleanup:
+    if(-1 != fd){
+        close(fd);
+    }
+}
+
+/**
+ * @brief: Writes the separator that goes before every event but the first
+ */
+static void trace_separator(){
+    fprintf(trace_file, "%s\n", trace_first_event ? "" : ",");
+    trace_first_event = false;
+}
+
+/**
+ * @brief: Starts tracing to a file in the Chrome trace event format (chrome://tracing, Perfetto)
+ * @param[IN] path: The path of the trace file
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The trace is only complete (valid JSON) after trace_stop
+ */
+error_code_t trace_start(IN const char * path){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+
+    trace_file = fopen(path, "w");
+    if(NULL == trace_file){
+        perror("TRACE_START: Fopen error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    fprintf(trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    trace_first_event = true;
+    trace_depth = 0;
+    trace_enabled = true;
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Begins a span, nested in the span that is currently open
+ * @param[IN] name: The name of the span (a string literal, it isn't copied)
+ */
+void trace_begin(IN const char * name){
+    if(TRACE_MAX_DEPTH == trace_depth){
+        return;
+    }
+
+    trace_stack[trace_depth].name = name;
+    trace_read_counters(&trace_stack[trace_depth].counters);
+    trace_depth++;
+
+    trace_separator();
+    fprintf(trace_file, "{\"name\": \"%s\", \"ph\": \"B\", \"ts\": %.3f, \"pid\": %i, \"tid\": %i}",
+            name, trace_now(), getpid(), getpid());
+}
+
+/**
+ * @brief: Ends the innermost open span with a given name
+ * @param[IN] name: The name of the span
+ *
+ * @notes: Spans opened inside it and left open (by an error path) are ended first. The end event
+ *         carries how much every counter grew during the span, and a counter event holds their totals
+ *         next to the totals of /proc/self/io to check them against.
+ */
+void trace_end(IN const char * name){
+    int depth = 0;
+    double now = 0;
+    unsigned long long rchar = 0;
+    unsigned long long wchar = 0;
+    trace_counters_t counters = {0};
+    trace_counters_t * begin = NULL;
+
+    for(depth=trace_depth-1; depth>=0; depth--){
+        if(0 == strcmp(trace_stack[depth].name, name)){
+            break;
+        }
+    }
+    if(depth < 0){
+        return;
+    }
+
+    trace_read_counters(&counters);
+    now = trace_now();
+
+    while(trace_depth > depth){
+        trace_depth--;
+        begin = &trace_stack[trace_depth].counters;
+
+        trace_separator();
+        fprintf(trace_file, "{\"name\": \"%s\", \"ph\": \"E\", \"ts\": %.3f, \"pid\": %i, \"tid\": %i, \"args\": "
+                "{\"reads\": %llu, \"writes\": %llu, \"bytes_read\": %llu, \"bytes_written\": %llu, "
+                "\"opens\": %llu, \"closes\": %llu, \"stats\": %llu, \"syncs\": %llu, \"bytes_hashed\": %llu, \"allocations\": %llu}}",
+                trace_stack[trace_depth].name, now, getpid(), getpid(),
+                counters.reads - begin->reads, counters.writes - begin->writes,
+                counters.bytes_read - begin->bytes_read, counters.bytes_written - begin->bytes_written,
+                counters.opens - begin->opens, counters.closes - begin->closes, counters.stats - begin->stats, counters.syncs - begin->syncs,
+                counters.bytes_hashed - begin->bytes_hashed, counters.allocations - begin->allocations);
+    }
+
+    trace_read_proc_io(&rchar, &wchar);
+    trace_separator();
+    fprintf(trace_file, "{\"name\": \"io\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %i, \"tid\": %i, \"args\": "
+            "{\"bytes_read\": %llu, \"bytes_written\": %llu, \"bytes_hashed\": %llu, \"proc_rchar\": %llu, \"proc_wchar\": %llu}}",
+            now, getpid(), getpid(), counters.bytes_read, counters.bytes_written, counters.bytes_hashed, rchar, wchar);
+}
+
+/**
+ * @brief: Ends every open span and closes the trace file
+ */
+void trace_stop(){
+    if(!trace_enabled){
+        return;
+    }
+
+    if(trace_depth > 0){
+        trace_end(trace_stack[0].name);
+    }
+
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+    trace_file = NULL;
+    trace_enabled = false;
+}
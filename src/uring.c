@@ -0,0 +1,204 @@
+#include "slap_commands.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief: Sets up an io_uring instance
+ * @param[OUT] ring: The ring to set up
+ * @param[IN] entries: The number of submission queue entries
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The raw system calls are used, so liburing isn't needed. No error is printed if the
+ *         kernel doesn't support io_uring (or it is blocked), so callers can silently fall back.
+ */
+error_code_t uring_init(OUT uring_t * ring, IN unsigned int entries){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    struct io_uring_params params = {0};
+
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+
+    ring->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(-1 == ring->ring_fd){
+        errno = 0;
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    /* openat, close and the fixed buffer ops all need a kernel that has single mmap as well */
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP)){
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    ring->sq_entries = params.sq_entries;
+    ring->cq_entries = params.cq_entries;
+
+    ring->sq_map_len = max(params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+                           params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if(MAP_FAILED == ring->sq_map){
+        ring->sq_map = NULL;
+        perror("URING_INIT: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+    ring->cq_map = ring->sq_map;
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if(MAP_FAILED == ring->sqes){
+        ring->sqes = NULL;
+        perror("URING_INIT: Mmap error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    ring->sq_head = (unsigned int *)((char *)ring->sq_map + params.sq_off.head);
+    ring->sq_tail = (unsigned int *)((char *)ring->sq_map + params.sq_off.tail);
+    ring->sq_mask = (unsigned int *)((char *)ring->sq_map + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int *)((char *)ring->sq_map + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head = (unsigned int *)((char *)ring->cq_map + params.cq_off.head);
+    ring->cq_tail = (unsigned int *)((char *)ring->cq_map + params.cq_off.tail);
+    ring->cq_mask = (unsigned int *)((char *)ring->cq_map + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_map + params.cq_off.cqes);
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(ERROR_CODE_SUCCESS != return_value){
+        uring_close(ring);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Registers buffers with the ring, so they can be used by READ_FIXED and WRITE_FIXED
+ * @param[IN] ring: The ring
+ * @param[IN] buffers: The buffers
+ * @param[IN] num_of_buffers: The number of buffers
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t uring_register_buffers(IN uring_t * ring, IN struct iovec * buffers, IN unsigned int num_of_buffers){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+
+    error_check = syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS, buffers, num_of_buffers);
+    if(-1 == error_check){
+        errno = 0;
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Gets a free submission queue entry
+ * @param[IN] ring: The ring
+ *
+ * @returns: A zeroed entry, or NULL if the submission queue is full
+ * @notes: The entry is only submitted by the next uring_submit_and_wait
+ */
+struct io_uring_sqe * uring_get_sqe(IN uring_t * ring){
+    unsigned int head = 0;
+    unsigned int index = 0;
+    struct io_uring_sqe * sqe = NULL;
+
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if(ring->sq_local_tail - head >= ring->sq_entries){
+        return NULL;
+    }
+
+    index = ring->sq_local_tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+
+    return sqe;
+}
+
+/**
+ * @brief: Submits every queued entry and waits for completions
+ * @param[IN] ring: The ring
+ * @param[IN] wait_for: The number of completions to wait for
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t uring_submit_and_wait(IN uring_t * ring, IN unsigned int wait_for){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    unsigned int to_submit = 0;
+
+    to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    do{
+        error_check = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_for, (0 != wait_for) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    }while(-1 == error_check && EINTR == errno);
+    if(-1 == error_check){
+        perror("URING_SUBMIT_AND_WAIT: Io_uring_enter error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Pops the next completion
+ * @param[IN] ring: The ring
+ * @param[OUT] cqe: The completion
+ *
+ * @returns: true if there was a completion, else false
+ */
+bool uring_next_cqe(IN uring_t * ring, OUT struct io_uring_cqe * cqe){
+    unsigned int head = 0;
+    unsigned int tail = 0;
+
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if(head == tail){
+        return false;
+    }
+
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * @brief: Tears down a ring
+ * @param[IN] ring: The ring
+ */
+void uring_close(IN uring_t * ring){
+    if(NULL != ring->sqes){
+        munmap(ring->sqes, ring->sqes_len);
+        ring->sqes = NULL;
+    }
+    if(NULL != ring->sq_map){
+        munmap(ring->sq_map, ring->sq_map_len);
+        ring->sq_map = NULL;
+        ring->cq_map = NULL;
+    }
+    if(-1 != ring->ring_fd){
+        close(ring->ring_fd);
+        ring->ring_fd = -1;
+    }
+}
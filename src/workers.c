@@ -0,0 +1,59 @@
+#include "slap_commands.h"
+
+#include <pthread.h>
+
+/* What a thread of run_workers starts with, so it works on the repository of the thread that started it */
+typedef struct worker_start_s{
+    worker_t worker;
+    void * argument;
+    repository_state_t * state;
+}worker_start_t;
+
+/**
+ * @brief: The body of every thread run_workers creates, which switches to the repository and runs the worker
+ * @param[IN] argument: The worker_start_t of the pool
+ */
+static void * worker_start(IN void * argument){
+    worker_start_t * start = argument;
+
+    repository_state_switch(start->state);
+
+    return start->worker(start->argument);
+}
+
+/**
+ * @brief: Runs a worker on a pool of threads, one per online core, and waits for all of them
+ * @param[IN] worker: The body of every thread. The workers share argument and claim their items from it
+ * @param[IN] argument: Passed to every worker
+ * @param[IN] num_of_items: The number of items to process, so no more threads than batches are started
+ * @param[IN] batch: The number of items a worker claims at a time
+ *
+ * @notes: The calling thread is one of the workers. If a thread can't be created the others
+ *         (at least the calling thread) do its share. The threads work on the repository of the calling thread.
+ */
+void run_workers(IN worker_t worker, IN void * argument, IN size_t num_of_items, IN size_t batch){
+    int error_check = 0;
+    long num_of_threads = 0;
+    long started = 0;
+    long i = 0;
+    pthread_t threads[WORKERS_MAX_THREADS] = {0};
+    worker_start_t start = {.worker = worker, .argument = argument, .state = repository_state()};
+
+    num_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    num_of_threads = max(num_of_threads, 1);
+    num_of_threads = min(num_of_threads, WORKERS_MAX_THREADS);
+    num_of_threads = min(num_of_threads, (long)((num_of_items + batch - 1) / batch));
+
+    for(started=0; started<num_of_threads - 1; started++){
+        error_check = pthread_create(&threads[started], NULL, worker_start, &start);
+        if(0 != error_check){
+            break;
+        }
+    }
+
+    worker(argument);
+
+    for(i=0; i<started; i++){
+        pthread_join(threads[i], NULL);
+    }
+}
@@ -0,0 +1,480 @@
+#include "slap_commands.h"
+
+const char * worktree_file_name = "worktrees";
+
+/**
+ * @brief: Gets the repository directory whose objects directory this work tree uses
+ * @param[OUT] common_dir: The absolute path of the directory, to be freed by the caller
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects directory of an added work tree is a symlink, so this is the repository directory of
+ *         the work tree it was added from (or the current one)
+ */
+static error_code_t worktree_common_dir(OUT char ** common_dir){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char * slash = NULL;
+
+    *common_dir = realpathat(work_tree_fd(), object_dir_path);
+    if(NULL == *common_dir){
+        perror("WORKTREE_COMMON_DIR: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    slash = strrchr(*common_dir, '/');
+    if(NULL == slash || slash == *common_dir){
+        free(*common_dir);
+        *common_dir = NULL;
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+    *slash = '\0';
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Calls a function for every other work tree that shares the objects directory
+ * @param[IN] callback: The function. If it fails, the iteration stops and its error is returned
+ * @param[IN] context: Passed to the function
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The work trees are the one that owns the objects directory and the ones listed in its worktrees
+ *         file. Work trees whose directory was removed are skipped, they don't use any object anymore.
+ */
+error_code_t worktree_for_each(IN worktree_callback_t callback, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    char path[PATH_MAX] = {0};
+    char line[PATH_MAX + 1] = {0};
+    char * common_dir = NULL;
+    char * current_dir = NULL;
+    FILE * file = NULL;
+
+    return_value = worktree_common_dir(&common_dir);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    current_dir = realpathat(work_tree_fd(), repo_dir_name);
+    if(NULL == current_dir){
+        perror("WORKTREE_FOR_EACH: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    if(0 != strcmp(common_dir, current_dir)){
+        return_value = callback(common_dir, context);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    error_check = snprintf(path, PATH_MAX, "%s/%s", common_dir, worktree_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    file = fopen(path, "r");
+    if(NULL == file && ENOENT == errno){
+        errno = 0;
+        return_value = ERROR_CODE_SUCCESS;
+        goto cleanup;
+    }
+    if(NULL == file){
+        perror("WORKTREE_FOR_EACH: Fopen error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    while(NULL != fgets(line, sizeof(line), file)){
+        line[strcspn(line, "\n")] = '\0';
+        if('\0' == line[0] || 0 == strcmp(line, current_dir)){
+            continue;
+        }
+
+        error_check = access(line, F_OK);
+        if(-1 == error_check){
+            errno = 0;
+            continue;
+        }
+
+        return_value = callback(line, context);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+    }
+
+    return_value = ERROR_CODE_SUCCESS;
+
+cleanup:
+    if(NULL != file){
+        fclose(file);
+    }
+    if(NULL != common_dir){
+        free(common_dir);
+    }
+    if(NULL != current_dir){
+        free(current_dir);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Writes an index that matches a commit, without reading the working directory
+ * @param[IN] hash: The sha of the commit
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The files are about to be checked out, so their working directory, staged and committed shas
+ *         are all the commit's. The whole index is built in memory and written with a single replace_file.
+ */
+error_code_t worktree_write_index(IN const unsigned char * hash){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int i = 0;
+    int num_of_parents = 0;
+    size_t size = 0;
+    size_t offset = 0;
+    size_t length = 0;
+    size_t entries_offset = 0;
+    unsigned char * data = NULL;
+    char * buffer = NULL;
+    const unsigned char * parents = NULL;
+    commit_entry_t entry = {0};
+
+    return_value = read_object(hash, &data, &size);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = commit_parents(data, size, &num_of_parents, &parents);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    entries_offset = sizeof(num_of_parents) + (size_t)num_of_parents * SHA_DIGEST_LENGTH;
+
+    for(offset=entries_offset; ERROR_CODE_SUCCESS == (return_value = commit_next_entry(data, size, &offset, &entry));){
+        length += 3 * SHA_DIGEST_LENGTH + sizeof(entry.mode) + sizeof(entry.name_len) + entry.name_len;
+    }
+    if(ERROR_CODE_EOF != return_value){
+        goto cleanup;
+    }
+
+    buffer = malloc(max(length, 1));
+    if(NULL == buffer){
+        perror("WORKTREE_WRITE_INDEX: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+
+    for(offset=entries_offset, length=0; ERROR_CODE_SUCCESS == commit_next_entry(data, size, &offset, &entry);){
+        for(i=0; i<3; i++){
+            memcpy(buffer + length, entry.sha, SHA_DIGEST_LENGTH);
+            length += SHA_DIGEST_LENGTH;
+        }
+        memcpy(buffer + length, &entry.mode, sizeof(entry.mode));
+        length += sizeof(entry.mode);
+        memcpy(buffer + length, &entry.name_len, sizeof(entry.name_len));
+        length += sizeof(entry.name_len);
+        memcpy(buffer + length, entry.name, entry.name_len);
+        length += entry.name_len;
+    }
+
+    return_value = replace_file(index_file_path, buffer, length);
+
+cleanup:
+    if(NULL != buffer){
+        free(buffer);
+    }
+    if(NULL != data){
+        free(data);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Adds a work tree that shares the objects directory, with its own index and HEAD
+ * @param[IN] path: The directory of the new work tree (created if it doesn't exist)
+ * @param[IN] commit: The commit to check out in it (HEAD or a possibly abbreviated sha)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ * @notes: The objects directory of the new work tree is a symlink to this one's, and so is its alternates
+ *         file if there is one. The work tree is listed in the worktrees file of the repository that owns
+ *         the objects, so gc in any of them keeps the objects all of them use. The index is written from
+ *         the commit, so nothing is hashed and the checkout only writes the files.
+ */
+error_code_t worktree_add(IN const char * path, IN const char * commit){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_fd = -1;
+    int list_fd = -1;
+    size_t line_len = 0;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    char alternates_path[PATH_MAX] = {0};
+    char list_path[PATH_MAX] = {0};
+    char * common_dir = NULL;
+    char * objects_real = NULL;
+    char * alternates_real = NULL;
+    char * repo_real = NULL;
+    char * line = NULL;
+    repository_state_t * state = NULL;
+    repository_state_t * previous = NULL;
+
+    return_value = resolve_commit(commit, hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = worktree_common_dir(&common_dir);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    objects_real = realpathat(work_tree_fd(), object_dir_path);
+    if(NULL == objects_real){
+        perror("WORKTREE_ADD: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    error_check = snprintf(alternates_path, PATH_MAX, "%s/%s", repo_dir_name, alternates_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    alternates_real = realpathat(work_tree_fd(), alternates_path);
+    if(NULL == alternates_real && ENOENT != errno){
+        perror("WORKTREE_ADD: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+    errno = 0;
+
+    error_check = snprintf(list_path, PATH_MAX, "%s/%s", common_dir, worktree_file_name);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = make_dir(path);
+    if(ERROR_CODE_SUCCESS != return_value && ERROR_CODE_ALREADY_EXISTS != return_value){
+        goto cleanup;
+    }
+
+    dir_fd = openat(work_tree_fd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(-1 == dir_fd){
+        perror("WORKTREE_ADD: Openat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    /* The new work tree gets a state of its own, so the caches of this one are left alone */
+    return_value = repository_state_create(dir_fd, &state);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+    previous = repository_state_switch(state);
+
+    return_value = make_dir(repo_dir_name);
+    if(ERROR_CODE_ALREADY_EXISTS == return_value){
+        printf("\e[31m%s already has a repository.\e[0m\n", path);
+        return_value = ERROR_CODE_INVALID_INPUT;
+        goto cleanup;
+    }
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    error_check = symlinkat(objects_real, work_tree_fd(), object_dir_path);
+    if(-1 == error_check){
+        perror("WORKTREE_ADD: Symlinkat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_CREATE;
+        goto cleanup;
+    }
+
+    if(NULL != alternates_real){
+        error_check = symlinkat(alternates_real, work_tree_fd(), alternates_path);
+        if(-1 == error_check){
+            perror("WORKTREE_ADD: Symlinkat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_CREATE;
+            goto cleanup;
+        }
+    }
+
+    return_value = worktree_write_index(hash);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    return_value = replace_file(HEAD_file_path, hash, SHA_DIGEST_LENGTH);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    repo_real = realpathat(work_tree_fd(), repo_dir_name);
+    if(NULL == repo_real){
+        perror("WORKTREE_ADD: Realpathat error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_GET_PATH;
+        goto cleanup;
+    }
+
+    line_len = strlen(repo_real) + 1;
+    line = malloc(line_len + 1);
+    if(NULL == line){
+        perror("WORKTREE_ADD: Malloc error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_ALLOCATE_MEMORY;
+        goto cleanup;
+    }
+    sprintf(line, "%s\n", repo_real);
+
+    /* A single O_APPEND write, so work trees that are added at the same time don't interleave their lines */
+    list_fd = open(list_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if(-1 == list_fd){
+        perror("WORKTREE_ADD: Open error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_OPEN;
+        goto cleanup;
+    }
+
+    error_check = write(list_fd, line, line_len);
+    if(-1 == error_check || line_len != (size_t)error_check){
+        perror("WORKTREE_ADD: Write error");
+        printf("(Errno: %i)\n", errno);
+        return_value = ERROR_CODE_COULDNT_WRITE;
+        goto cleanup;
+    }
+
+    return_value = sync_file(list_fd);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    sha_to_hex(hash, hex);
+    return_value = checkout(hex);
+
+cleanup:
+    if(NULL != state){
+        repository_state_switch(previous);
+        repository_state_destroy(state);
+    }
+    if(-1 != dir_fd){
+        close(dir_fd);
+    }
+    if(-1 != list_fd){
+        close(list_fd);
+    }
+    if(NULL != line){
+        free(line);
+    }
+    if(NULL != repo_real){
+        free(repo_real);
+    }
+    if(NULL != alternates_real){
+        free(alternates_real);
+    }
+    if(NULL != objects_real){
+        free(objects_real);
+    }
+    if(NULL != common_dir){
+        free(common_dir);
+    }
+
+    return return_value;
+}
+
+/**
+ * @brief: Prints a work tree and the commit its HEAD points to (a worktree_for_each callback)
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+static error_code_t worktree_print(IN const char * repo_dir, IN void * context){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    int error_check = 0;
+    int dir_len = 0;
+    bool exists = false;
+    unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+    char hex[OBJECT_HEX_LEN + 1] = {0};
+    char path[PATH_MAX] = {0};
+    const char * slash = NULL;
+
+    error_check = snprintf(path, PATH_MAX, "%s/HEAD", repo_dir);
+    if(error_check < 0 || error_check >= PATH_MAX){
+        return_value = ERROR_CODE_COULDNT_SPRINTF;
+        goto cleanup;
+    }
+
+    return_value = read_head_file(path, hash, &exists);
+    if(ERROR_CODE_SUCCESS != return_value){
+        goto cleanup;
+    }
+
+    slash = strrchr(repo_dir, '/');
+    dir_len = (NULL == slash) ? (int)strlen(repo_dir) : (int)(slash - repo_dir);
+
+    sha_to_hex(hash, hex);
+    printf("%.*s %s\n", dir_len, repo_dir, exists ? hex : "(nothing committed)");
+
+cleanup:
+    return return_value;
+}
+
+/**
+ * @brief: Runs the worktree command
+ * @param[IN] argc: The number of arguments (after worktree)
+ * @param[IN] argv: The arguments: add <dir> <commit> | list
+ *
+ * @returns: ERROR_CODE_SUCCESS upon success, else an indicative error code
+ */
+error_code_t worktree_command(IN int argc, IN char ** argv){
+    error_code_t return_value = ERROR_CODE_UNINITIALIZED;
+    char * current_dir = NULL;
+
+    if(3 == argc && 0 == valid_strncmp(argv[0], "add")){
+        return_value = worktree_add(argv[1], argv[2]);
+    }
+    else if(1 == argc && 0 == valid_strncmp(argv[0], "list")){
+        current_dir = realpathat(work_tree_fd(), repo_dir_name);
+        if(NULL == current_dir){
+            perror("WORKTREE_COMMAND: Realpathat error");
+            printf("(Errno: %i)\n", errno);
+            return_value = ERROR_CODE_COULDNT_GET_PATH;
+            goto cleanup;
+        }
+
+        return_value = worktree_print(current_dir, NULL);
+        if(ERROR_CODE_SUCCESS != return_value){
+            goto cleanup;
+        }
+
+        return_value = worktree_for_each(worktree_print, NULL);
+    }
+    else{
+        printf("USAGE: slap worktree: add <dir> <commit> | list\n");
+        return_value = ERROR_CODE_INVALID_INPUT;
+    }
+
+cleanup:
+    if(NULL != current_dir){
+        free(current_dir);
+    }
+
+    return return_value;
+}
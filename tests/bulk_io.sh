@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Adds, commits and checks out the same files with the sync and the uring bulk I/O backends, and checks that
+# both write the same objects, index and HEAD, and check out the same files.
+#
+# USAGE: bulk_io.sh
+#
+# Environment:
+#   TEST_DIR  Where the repositories are created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "bulk_io: $1" >&2
+    exit 1
+}
+
+files=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'rm -rf "$files" "$files.sync" "$files.uring"' EXIT
+
+# Empty, smaller than a buffer, spanning many buffers, and duplicated contents
+: > "$files/empty"
+echo "small" > "$files/small"
+head -c 1000000 /dev/urandom > "$files/large"
+cp "$files/large" "$files/large_copy"
+i=0
+while [ $i -lt 100 ]; do
+    echo "many $i" > "$files/many$i"
+    i=$((i + 1))
+done
+
+for backend in sync uring; do
+    repo="$files.$backend"
+    mkdir "$repo"
+    cp "$files"/* "$repo"
+
+    cd "$repo"
+    "$SLAP" init > /dev/null
+    SLAP_IO=$backend "$SLAP" add * > /dev/null
+    SLAP_IO=$backend "$SLAP" commit -m "Commit" > /dev/null
+
+    # Changed, truncated and deleted files are restored by checkout
+    echo "changed" > small
+    : > large
+    rm many7
+    SLAP_IO=$backend "$SLAP" checkout "$(od -An -tx1 .slap/HEAD | tr -d ' \n')" > /dev/null
+    for file in "$files"/*; do
+        cmp -s "$file" "$repo/$(basename "$file")" || fail "$(basename "$file") wasn't checked out ($backend)"
+    done
+    cd "$TEST_ROOT"
+done
+
+cmp -s "$files.sync/.slap/index" "$files.uring/.slap/index" || fail "the indexes differ"
+cmp -s "$files.sync/.slap/HEAD" "$files.uring/.slap/HEAD" || fail "the HEADs differ"
+objects=$(cd "$files.sync/.slap/objects" && find . -path './??/*' -type f | sort)
+[ "$objects" = "$(cd "$files.uring/.slap/objects" && find . -path './??/*' -type f | sort)" ] || fail "the objects differ"
+for object in $objects; do
+    cmp -s "$files.sync/.slap/objects/$object" "$files.uring/.slap/objects/$object" || fail "object $object differs"
+done
+
+echo "bulk_io: OK"
@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# Bundles a repository into a file and through the standard output, unbundles it into empty repositories and
+# checks out the same files, and checks that bundles with a corrupted trailer, a corrupted object or a missing
+# tail are rejected without updating HEAD.
+#
+# USAGE: bundle.sh
+#
+# Environment:
+#   TEST_DIR  Where the repositories are created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "bundle: $1" >&2
+    exit 1
+}
+
+# Overwrites one byte of a file
+corrupt(){
+    printf 'X' | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# Unbundles a bundle into a new empty repository, whose path is printed
+unbundle(){
+    target=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+    echo "$target" >> "$work/targets"
+    cd "$target"
+    "$SLAP" init > /dev/null
+    "$SLAP" bundle unbundle "$1" > "$target.output" 2>&1
+    cd "$work"
+    echo "$target"
+}
+
+work=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'for target in $(cat "$work/targets" 2> /dev/null); do rm -rf "$target" "$target.output"; done; rm -rf "$work"' EXIT
+
+mkdir "$work/source"
+cd "$work/source"
+"$SLAP" init > /dev/null
+echo "first" > first.txt
+head -c 300000 /dev/urandom > large.bin
+"$SLAP" add first.txt large.bin > /dev/null
+"$SLAP" commit -m "First" > /dev/null
+echo "second" > second.txt
+"$SLAP" add second.txt > /dev/null
+"$SLAP" commit -m "Second" > /dev/null
+head=$(od -An -tx1 .slap/HEAD | tr -d ' \n')
+
+"$SLAP" bundle create "$work/file.bundle" > /dev/null
+"$SLAP" bundle create - > "$work/stdout.bundle" 2> /dev/null
+cmp -s "$work/file.bundle" "$work/stdout.bundle" || fail "bundling to a file and to the standard output differ"
+cd "$work"
+
+# Round trip, from a file and from the standard input
+for source in file stdin; do
+    if [ file = $source ]; then
+        target=$(unbundle "$work/file.bundle")
+    else
+        target=$(unbundle - < "$work/stdout.bundle")
+    fi
+    [ "$(od -An -tx1 "$target/.slap/HEAD" | tr -d ' \n')" = "$head" ] || fail "HEAD wasn't set ($source)"
+    cd "$target"
+    "$SLAP" checkout "$head" > /dev/null
+    for file in first.txt large.bin second.txt; do
+        cmp -s "$work/source/$file" "$file" || fail "$file wasn't restored ($source)"
+    done
+    "$SLAP" fsck | grep -q "no problems" || fail "fsck found problems ($source)"
+    cd "$work"
+done
+
+# The trailer is the last bytes of the bundle
+cp "$work/file.bundle" "$work/trailer.bundle"
+corrupt "$work/trailer.bundle" $(($(wc -c < "$work/trailer.bundle") - 1))
+target=$(unbundle "$work/trailer.bundle")
+grep -q "checksum of the bundle doesn't match" "$target.output" || fail "a corrupted trailer wasn't reported"
+[ -s "$target/.slap/HEAD" ] && fail "HEAD was set from a bundle with a corrupted trailer"
+
+# Inside the contents of the large object
+cp "$work/file.bundle" "$work/object.bundle"
+corrupt "$work/object.bundle" 1000
+target=$(unbundle "$work/object.bundle")
+grep -q "doesn't match its sha" "$target.output" || fail "a corrupted object wasn't reported"
+[ -s "$target/.slap/HEAD" ] && fail "HEAD was set from a bundle with a corrupted object"
+cd "$target"
+"$SLAP" fsck | grep -q "no problems" || fail "a corrupted object was stored"
+cd "$work"
+
+head -c 1000 "$work/file.bundle" > "$work/truncated.bundle"
+target=$(unbundle "$work/truncated.bundle")
+grep -q "truncated" "$target.output" || fail "a truncated bundle wasn't reported"
+[ -s "$target/.slap/HEAD" ] && fail "HEAD was set from a truncated bundle"
+
+cd "$TEST_ROOT"
+echo "bundle: OK"
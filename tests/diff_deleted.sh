@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Deletes a tracked file and checks that status lists it as deleted and that diff prints its deletion hunk.
+#
+# USAGE: diff_deleted.sh
+#
+# Environment:
+#   TEST_DIR  Where the repository is created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "diff_deleted: $1" >&2
+    exit 1
+}
+
+for backend in sync uring; do
+    repo=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+    trap 'rm -rf "$repo"' EXIT
+
+    cd "$repo"
+    "$SLAP" init > /dev/null
+    printf 'first\nsecond\n' > kept.txt
+    printf 'gone\n' > deleted.txt
+    "$SLAP" add kept.txt > /dev/null
+    "$SLAP" add deleted.txt > /dev/null
+    "$SLAP" commit -m "Initial commit" > /dev/null
+    rm deleted.txt
+
+    status_output=$(SLAP_IO=$backend "$SLAP" status) || fail "status failed ($backend)"
+    echo "$status_output" | grep -q "deleted:  deleted.txt" || fail "status doesn't list deleted.txt as deleted ($backend)"
+    echo "$status_output" | grep -q "kept.txt" && fail "status lists kept.txt ($backend)"
+
+    diff_output=$(SLAP_IO=$backend "$SLAP" diff) || fail "diff failed ($backend)"
+    echo "$diff_output" | grep -q "Error" && fail "diff printed an error ($backend)"
+    echo "$diff_output" | grep -q "^deleted file mode" || fail "diff has no deleted file header ($backend)"
+    echo "$diff_output" | grep -q "^+++ /dev/null" || fail "diff isn't against /dev/null ($backend)"
+    echo "$diff_output" | grep -q "^-gone" || fail "diff doesn't remove the deleted line ($backend)"
+
+    cd "$TEST_ROOT"
+    rm -rf "$repo"
+    trap - EXIT
+done
+
+echo "diff_deleted: OK"
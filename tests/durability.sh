@@ -0,0 +1,73 @@
+#!/bin/sh
+#
+# Adds and commits files under every core.fsync mode and checks, through the sync counts of --trace, that none
+# never syncs, batch syncs the same number of times however many objects are added, and full syncs every object.
+#
+# USAGE: durability.sh
+#
+# Environment:
+#   TEST_DIR  Where the repository is created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "durability: $1" >&2
+    exit 1
+}
+
+# The syncs of the outermost span, which ends last
+syncs(){
+    grep -o '"syncs": [0-9]*' "$1" | tail -n 1 | grep -o '[0-9]*$'
+}
+
+for mode in none batch full; do
+    repo=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+    trap 'rm -rf "$repo"' EXIT
+
+    cd "$repo"
+    "$SLAP" init > /dev/null
+    "$SLAP" config core.fsync $mode
+    [ "$("$SLAP" config core.fsync)" = "$mode" ] || fail "core.fsync isn't $mode"
+
+    for i in 1 2 3 4 5 6 7 8 9; do
+        echo "file $i" > "file$i.txt"
+    done
+    "$SLAP" --trace="$repo/one.trace" add file1.txt > /dev/null
+    "$SLAP" --trace="$repo/many.trace" add file2.txt file3.txt file4.txt file5.txt file6.txt file7.txt file8.txt file9.txt > /dev/null
+    one=$(syncs "$repo/one.trace")
+    many=$(syncs "$repo/many.trace")
+
+    case $mode in
+    none)
+        [ "$one" -eq 0 ] && [ "$many" -eq 0 ] || fail "none synced ($one, $many)";;
+    batch)
+        [ "$one" -gt 0 ] || fail "batch didn't sync"
+        [ "$one" -eq "$many" ] || fail "batch synced $one times for one object and $many for eight";;
+    full)
+        [ "$many" -ge $((one + 7)) ] || fail "full synced $one times for one object and only $many for eight";;
+    esac
+
+    "$SLAP" commit -m "Commit" > /dev/null
+    [ 20 -eq "$(wc -c < .slap/HEAD)" ] || fail "HEAD wasn't written ($mode)"
+    "$SLAP" fsck | grep -q "no problems" || fail "fsck found problems ($mode)"
+    ls .slap | grep -q "\.lock$" && fail "a lock file was left behind ($mode)"
+
+    cd "$TEST_ROOT"
+    rm -rf "$repo"
+    trap - EXIT
+done
+
+repo=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'rm -rf "$repo"' EXIT
+cd "$repo"
+"$SLAP" init > /dev/null
+"$SLAP" config core.fsync sometimes
+echo "file" > file.txt
+"$SLAP" add file.txt | grep -q "Unknown core.fsync mode sometimes" || fail "an unknown mode isn't reported"
+cd "$TEST_ROOT"
+
+echo "durability: OK"
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Leaves an unreachable object in a repository with a work tree, and checks that gc keeps it within the grace
+# period and removes it after, and that it keeps the objects only a work tree's HEAD or index references.
+#
+# USAGE: gc.sh
+#
+# Environment:
+#   TEST_DIR  Where the repository is created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "gc: $1" >&2
+    exit 1
+}
+
+# The path of the object of a file's contents
+object_path(){
+    sha=$(sha1sum "$1" | cut -c1-40)
+    echo "$repo/.slap/objects/$(echo "$sha" | cut -c1-2)/$(echo "$sha" | cut -c3-)"
+}
+
+repo=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'rm -rf "$repo" "$repo.worktree"' EXIT
+
+cd "$repo"
+"$SLAP" init > /dev/null
+echo "committed" > file.txt
+"$SLAP" add file.txt > /dev/null
+"$SLAP" commit -m "Commit" > /dev/null
+"$SLAP" worktree add "$repo.worktree" "$(od -An -tx1 .slap/HEAD | tr -d ' \n')" > /dev/null
+
+# Only referenced by the work tree's HEAD, and only by its index
+cd "$repo.worktree"
+echo "committed in the work tree" > committed.txt
+echo "added in the work tree" > added.txt
+"$SLAP" add committed.txt > /dev/null
+"$SLAP" commit -m "Work tree commit" > /dev/null
+"$SLAP" add added.txt > /dev/null
+committed_object=$(object_path committed.txt)
+added_object=$(object_path added.txt)
+
+# Unreachable once file.txt is added again with other contents
+cd "$repo"
+echo "unreachable" > file.txt
+"$SLAP" add file.txt > /dev/null
+unreachable_object=$(object_path file.txt)
+echo "committed" > file.txt
+"$SLAP" add file.txt > /dev/null
+
+"$SLAP" gc > /dev/null
+[ -e "$unreachable_object" ] || fail "an object within the default grace period was removed"
+"$SLAP" config gc.grace 3600
+"$SLAP" gc > /dev/null
+[ -e "$unreachable_object" ] || fail "an object within gc.grace was removed"
+
+touch -d "2 hours ago" "$unreachable_object"
+"$SLAP" gc | grep -q "Removed 1 unreachable objects" || fail "gc didn't report removing the unreachable object"
+[ -e "$unreachable_object" ] && fail "an object older than gc.grace was kept"
+
+"$SLAP" gc --grace 0 > /dev/null
+[ -e "$committed_object" ] || fail "an object committed in a work tree was removed"
+[ -e "$added_object" ] || fail "an object added in a work tree was removed"
+"$SLAP" fsck | grep -q "no problems" || fail "fsck found problems in the repository"
+cd "$repo.worktree"
+"$SLAP" fsck | grep -q "no problems" || fail "fsck found problems in the work tree"
+
+# A work tree whose directory was removed doesn't keep anything
+cd "$repo"
+rm -rf "$repo.worktree"
+"$SLAP" gc --grace 0 > /dev/null
+[ -e "$committed_object" ] && fail "an object of a removed work tree was kept"
+[ -e "$added_object" ] && fail "an object added in a removed work tree was kept"
+"$SLAP" fsck | grep -q "no problems" || fail "fsck found problems after the work tree was removed"
+
+cd "$TEST_ROOT"
+echo "gc: OK"
@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Changes the index, HEAD and the object index from other processes while a server keeps them cached, and checks
+# that the server notices every change by stat'ing the files, and that a batch refuses to write its cached index
+# over an index another process wrote meanwhile.
+#
+# USAGE: index_cache.sh
+#
+# Environment:
+#   TEST_DIR  Where the repository is created (default: /tmp)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+
+fail(){
+    echo "index_cache: $1" >&2
+    exit 1
+}
+
+# Commands run with --trace always run in their own process, never in the server
+local_slap(){
+    "$SLAP" --trace=/dev/null "$@"
+}
+
+repo=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'cd "$repo" && "$SLAP" serve stop > /dev/null 2>&1; rm -rf "$repo"' EXIT
+
+cd "$repo"
+"$SLAP" init > /dev/null
+echo "first" > first.txt
+echo "second" > second.txt
+echo "third" > third.txt
+"$SLAP" add first.txt > /dev/null
+"$SLAP" commit -m "First" > /dev/null
+first_commit=$(od -An -tx1 .slap/HEAD | tr -d ' \n')
+cp .slap/index "$repo/first_index"
+
+"$SLAP" serve start > /dev/null
+"$SLAP" status > /dev/null
+
+# A new index from another process
+local_slap add second.txt > /dev/null
+"$SLAP" status | grep -q "staged:   second.txt" || fail "the server didn't see an index written by another process"
+
+# The older index copied back, with an older mtime but a new inode
+cp "$repo/first_index" .slap/index
+"$SLAP" status | grep -q "second.txt" && fail "the server didn't see the index being replaced"
+
+# A new HEAD and new objects from another process: the server's commit must have it as a parent
+local_slap add third.txt > /dev/null
+local_slap commit -m "Second" > /dev/null
+"$SLAP" cat-file "$(od -An -tx1 .slap/HEAD | tr -d ' \n' | cut -c1-8)" > /dev/null || fail "the server didn't see a new object"
+"$SLAP" add second.txt > /dev/null
+"$SLAP" commit -m "Third" > /dev/null
+"$SLAP" fsck | grep -q "checked 3 commits" || fail "the server's commit doesn't follow the commit of another process"
+
+# The object index removed by another process is rebuilt
+rm .slap/objects/object_index
+"$SLAP" cat-file "$(echo "$first_commit" | cut -c1-8)" > /dev/null || fail "the object index wasn't rebuilt"
+
+"$SLAP" serve stop > /dev/null
+
+# A batch holding changes to the index that another process replaces meanwhile must not overwrite it
+echo "fourth" > fourth.txt
+echo "fifth" > fifth.txt
+mkfifo "$repo/commands"
+"$SLAP" batch < "$repo/commands" > "$repo/batch_output" &
+batch_pid=$!
+exec 3> "$repo/commands"
+printf 'add fourth.txt\ncommit\n' >&3
+sleep 1
+"$SLAP" add fifth.txt > /dev/null
+exec 3>&-
+wait $batch_pid || true
+grep -q "was changed by another process" "$repo/batch_output" || fail "the batch didn't report the index changing underneath it"
+"$SLAP" status | grep -q "staged:   fifth.txt" || fail "the batch overwrote the index of another process"
+
+echo "index_cache: OK"
@@ -0,0 +1,91 @@
+#!/bin/sh
+#
+# Opens two repositories at once through libslap, from a third directory, and runs interleaved operations on
+# them. Checks that each repository got its own commit, and that the working directory was never changed.
+#
+# USAGE: library.sh
+#
+# Environment:
+#   TEST_DIR  Where the repositories are created (default: /tmp)
+#   CC        The compiler of the test program (default: gcc)
+
+set -e
+
+TEST_ROOT=$(cd "$(dirname "$0")" && pwd)
+SLAP="$TEST_ROOT/../slap"
+TEST_DIR=${TEST_DIR:-/tmp}
+CC=${CC:-gcc}
+
+fail(){
+    echo "library: $1" >&2
+    exit 1
+}
+
+root=$(mktemp -d "$TEST_DIR/slap_test.XXXXXX")
+trap 'rm -rf "$root"' EXIT
+mkdir "$root/first" "$root/second" "$root/caller"
+
+cat > "$root/library_test.c" <<'EOF'
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "slap.h"
+
+int main(int argc, char ** argv){
+    slap_repository_t * first = NULL;
+    slap_repository_t * second = NULL;
+    char * first_files[] = {"a.txt"};
+    char * second_files[] = {"b.txt"};
+    char before[PATH_MAX] = {0};
+    char after[PATH_MAX] = {0};
+
+    if(argc < 3 || NULL == getcwd(before, sizeof(before))){
+        return 1;
+    }
+
+    if(ERROR_CODE_SUCCESS != slap_open(argv[1], &first) || ERROR_CODE_SUCCESS != slap_open(argv[2], &second)){
+        return 2;
+    }
+
+    if(ERROR_CODE_SUCCESS != slap_init(first) || ERROR_CODE_SUCCESS != slap_init(second) ||
+       ERROR_CODE_SUCCESS != slap_add(first, 1, first_files) || ERROR_CODE_SUCCESS != slap_add(second, 1, second_files) ||
+       ERROR_CODE_SUCCESS != slap_commit(second) || ERROR_CODE_SUCCESS != slap_commit(first)){
+        return 3;
+    }
+
+    if(NULL == getcwd(after, sizeof(after)) || 0 != strcmp(before, after)){
+        return 4;
+    }
+
+    slap_close(first);
+    slap_close(second);
+
+    return 0;
+}
+EOF
+
+"$CC" -I"$TEST_ROOT/../include" "$root/library_test.c" "$TEST_ROOT/../libslap.a" -o "$root/library_test" \
+    -lssl -lcrypto -lz -pthread 2> /dev/null || fail "couldn't build the test program"
+
+echo first > "$root/first/a.txt"
+echo second > "$root/second/b.txt"
+
+(cd "$root/caller" && "$root/library_test" ../first ../second > /dev/null) || fail "the operations failed ($?)"
+
+[ -z "$(ls -A "$root/caller")" ] || fail "something was written to the working directory"
+[ -s "$root/first/.slap/HEAD" ] || fail "the first repository has no commit"
+[ -s "$root/second/.slap/HEAD" ] || fail "the second repository has no commit"
+
+first_sha=$(sha1sum "$root/first/a.txt" | cut -c1-40)
+second_sha=$(sha1sum "$root/second/b.txt" | cut -c1-40)
+[ -f "$root/first/.slap/objects/$(echo "$first_sha" | cut -c1-2)/$(echo "$first_sha" | cut -c3-)" ] \
+    || fail "a.txt wasn't stored in the first repository"
+[ ! -e "$root/first/.slap/objects/$(echo "$second_sha" | cut -c1-2)/$(echo "$second_sha" | cut -c3-)" ] \
+    || fail "b.txt was stored in the first repository"
+[ -f "$root/second/.slap/objects/$(echo "$second_sha" | cut -c1-2)/$(echo "$second_sha" | cut -c3-)" ] \
+    || fail "b.txt wasn't stored in the second repository"
+
+(cd "$root/first" && "$SLAP" fsck) | grep -q "no problems" || fail "fsck found problems in the first repository"
+(cd "$root/second" && "$SLAP" fsck) | grep -q "no problems" || fail "fsck found problems in the second repository"
+
+echo "library: OK"